@@ -0,0 +1,435 @@
+#ifndef ANIMATION_SAMPLER_H
+#define ANIMATION_SAMPLER_H
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <cfloat>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace GL_Engine {
+
+    // Linear interpolation for vectors, shortest path slerp for rotations
+    glm::vec3 interpolateKeys( const glm::vec3 & _a, const glm::vec3 & _b, float _t );
+    glm::quat interpolateKeys( const glm::quat & _a, const glm::quat & _b, float _t );
+    // Distance between two keys, the angle between them for rotations
+    float keyError( const glm::vec3 & _a, const glm::vec3 & _b );
+    float keyError( const glm::quat & _a, const glm::quat & _b );
+
+    // Index of the key before _time in the ascending _times, the key with
+    // _times[ key ] <= _time < _times[ key + 1 ], found by walking forward
+    // from _cursor or else by binary search. _time must be at or after
+    // the first time and before the last
+    template< typename Time >
+    uint32_t seekKey( const std::vector< Time > & _times, float _time, uint32_t _cursor ){
+        // Keys the cursor walks forward before searching instead
+        constexpr uint32_t MaxWalk = 4;
+        const uint32_t last = static_cast< uint32_t >( _times.size() - 1 );
+        uint32_t key = std::min( _cursor, last - 1 );
+        uint32_t steps = 0;
+        if ( _times[ key ] <= _time ){
+            while ( steps < MaxWalk && _times[ key + 1 ] <= _time ){
+                key++;
+                steps++;
+            }
+        }
+        if ( _times[ key ] > _time || _times[ key + 1 ] <= _time ){
+            key = static_cast< uint32_t >( std::upper_bound( _times.begin(), _times.end(), _time ) -
+                                           _times.begin() ) - 1;
+        }
+        return key;
+    }
+
+    /*-------------KeyTrack Class------------*/
+    /*
+    *Keyframes of one animated value, with the times and values in
+    *separate arrays so the key search only reads times.
+    *
+    *Sampling is driven by a cursor, the index of the key last sampled
+    *from, which is owned by whatever plays the track. Playback moving
+    *forward advances the cursor by a key or two per sample, making a
+    *sample constant time on average; seeks, loops and jumps back fall
+    *back to a binary search. Outside the keys the first or last value is
+    *held.
+    */
+    template< typename T >
+    class KeyTrack {
+    public:
+        // Keys must be added in time order
+        void addKey( float _time, const T & _value ){
+            times.push_back( _time );
+            values.push_back( _value );
+        }
+        void reserve( size_t _keys ){
+            times.reserve( _keys );
+            values.reserve( _keys );
+        }
+        size_t size() const {
+            return times.size();
+        }
+        bool empty() const {
+            return times.empty();
+        }
+        const std::vector< float > & getTimes() const {
+            return times;
+        }
+        const std::vector< T > & getValues() const {
+            return values;
+        }
+
+        // The value at _time, updating _cursor. The track must not be empty
+        T sample( float _time, uint32_t & _cursor ) const {
+            const uint32_t last = static_cast< uint32_t >( times.size() - 1 );
+            if ( _time <= times[ 0 ] || last == 0 ){
+                _cursor = 0;
+                return values[ 0 ];
+            }
+            if ( _time >= times[ last ] ){
+                _cursor = last;
+                return values[ last ];
+            }
+            const uint32_t key = seekKey( times, _time, _cursor );
+            _cursor = key;
+            const float t = ( _time - times[ key ] ) / ( times[ key + 1 ] - times[ key ] );
+            return interpolateKeys( values[ key ], values[ key + 1 ], t );
+        }
+
+    private:
+        std::vector< float > times;
+        std::vector< T > values;
+    };
+
+    // A key quantised to 16 bits per component
+    using PackedKey = std::array< uint16_t, 3 >;
+
+    // Bounds of a vector track's values, each component quantised over
+    // [ min, min + scale * 65535 ]. Unused by rotations
+    struct KeyRange {
+        glm::vec3 min{ 0.0f };
+        glm::vec3 scale{ 0.0f };
+    };
+    KeyRange keyRange( const std::vector< glm::vec3 > & _values );
+    KeyRange keyRange( const std::vector< glm::quat > & _values );
+
+    // Vectors are quantised within their track's range. Rotations are
+    // stored smallest three: the largest component is dropped, made
+    // positive by negating the quaternion, and rebuilt from the unit
+    // length; the other three take 15 bits each and the dropped index
+    // the top bits of the first two
+    PackedKey packKey( const glm::vec3 & _value, const KeyRange & _range );
+    PackedKey packKey( const glm::quat & _value, const KeyRange & _range );
+
+    inline void unpackKey( const PackedKey & _key, const KeyRange & _range, glm::vec3 & _value ){
+        _value = _range.min + _range.scale * glm::vec3( _key[ 0 ], _key[ 1 ], _key[ 2 ] );
+    }
+
+    inline void unpackKey( const PackedKey & _key, const KeyRange &, glm::quat & _value ){
+        // 15 bit values over [ -1 / sqrt( 2 ), 1 / sqrt( 2 ) ]
+        constexpr float Scale = 1.41421356f / 32767.0f;
+        constexpr float Bias = -0.70710678f;
+        const uint32_t largest = ( _key[ 0 ] >> 15 ) | ( ( _key[ 1 ] >> 15 ) << 1 );
+        const float a = ( _key[ 0 ] & 0x7FFF ) * Scale + Bias;
+        const float b = ( _key[ 1 ] & 0x7FFF ) * Scale + Bias;
+        const float c = ( _key[ 2 ] & 0x7FFF ) * Scale + Bias;
+        const float d = std::sqrt( std::max( 0.0f, 1.0f - a * a - b * b - c * c ) );
+        // The remaining components keep their x, y, z, w order
+        switch ( largest ){
+            case 0: _value = glm::quat( c, d, a, b ); break;
+            case 1: _value = glm::quat( c, a, d, b ); break;
+            case 2: _value = glm::quat( c, a, b, d ); break;
+            default: _value = glm::quat( d, a, b, c ); break;
+        }
+    }
+
+    /*-------------KeyTimes Class------------*/
+    /*
+    *The key times shared by the CompressedTracks of one animation, as 16
+    *bit frame numbers on a grid of uniformly spaced frames. Frames are
+    *chosen once for all the tracks (see select), so that sampling them
+    *seeks the key once, here, and each track only decodes the two keys
+    *either side.
+    */
+    class KeyTimes {
+    public:
+        // Frames addressable by a grid
+        static constexpr uint32_t MaxFrames = 65536;
+
+        // Start a grid of _frameCount frames spanning [ 0, _duration ],
+        // clamped to MaxFrames, with no frames chosen
+        void setGrid( double _duration, uint32_t _frameCount ){
+            frames.clear();
+            frameCount = std::clamp( _frameCount, 1u, MaxFrames );
+            framesPerTime = frameCount > 1 && _duration > 0.0 ?
+                static_cast< float >( ( frameCount - 1 ) / _duration ) : 0.0f;
+        }
+
+        // Choose the frames from the first to the last of the grid, each
+        // as far on from the one before as _fits( first, last ) allows.
+        // Adjacent frames are chosen even when they do not fit, which is
+        // the grid's best
+        template< typename Fits >
+        void select( Fits _fits ){
+            frames.assign( 1, 0 );
+            uint32_t key = 0;
+            while ( key + 1 < frameCount ){
+                // Grow the span by doubling while it fits, then bisect
+                // between the longest fitting and shortest failing spans
+                uint32_t fits = key + 1;
+                uint32_t fails = frameCount;
+                for ( uint32_t length = 2; key + length < frameCount; length *= 2 ){
+                    if ( !_fits( key, key + length ) ){
+                        fails = key + length;
+                        break;
+                    }
+                    fits = key + length;
+                }
+                while ( fails - fits > 1 ){
+                    const uint32_t middle = fits + ( fails - fits ) / 2;
+                    if ( _fits( key, middle ) ){
+                        fits = middle;
+                    }
+                    else {
+                        fails = middle;
+                    }
+                }
+                frames.push_back( static_cast< uint16_t >( fits ) );
+                key = fits;
+            }
+            frames.shrink_to_fit();
+        }
+
+        size_t size() const {
+            return frames.size();
+        }
+        bool empty() const {
+            return frames.empty();
+        }
+        const std::vector< uint16_t > & getFrames() const {
+            return frames;
+        }
+        uint32_t getFrameCount() const {
+            return frameCount;
+        }
+        float getFramesPerTime() const {
+            return framesPerTime;
+        }
+        // Bytes held by the frames
+        size_t getMemoryUsage() const {
+            return sizeof( *this ) + frames.capacity() * sizeof( uint16_t );
+        }
+
+        // The key before _time, with _t set to the fraction of the way to
+        // the next, updating _cursor. Outside the keys the first or last
+        // key is returned, with _t 0. There must be frames
+        uint32_t seek( float _time, uint32_t & _cursor, float & _t ) const {
+            const uint32_t last = static_cast< uint32_t >( frames.size() - 1 );
+            const float frame = _time * framesPerTime;
+            _t = 0.0f;
+            if ( frame <= 0.0f || last == 0 ){
+                _cursor = 0;
+                return 0;
+            }
+            if ( frame >= frames[ last ] ){
+                _cursor = last;
+                return last;
+            }
+            const uint32_t key = seekKey( frames, frame, _cursor );
+            _cursor = key;
+            _t = ( frame - frames[ key ] ) / float( frames[ key + 1 ] - frames[ key ] );
+            return key;
+        }
+
+    private:
+        std::vector< uint16_t > frames;
+        uint32_t frameCount{ 1 };
+        float framesPerTime{ 0.0f };
+    };
+
+    /*-------------TrackEncoder Class------------*/
+    /*
+    *A KeyTrack resampled on a KeyTimes grid and quantised, for choosing
+    *the frames a CompressedTrack keeps. A span between two frames fits if
+    *linear interpolation of the quantised frames restores the track
+    *within the tolerance, at the grid frames and at the track's keys,
+    *which may fall between frames.
+    */
+    template< typename T >
+    class TrackEncoder {
+    public:
+        // _track must outlive the encoder
+        TrackEncoder( const KeyTrack< T > & _track, const KeyTimes & _times, float _tolerance )
+            : values( _track.getValues() ), tolerance( _tolerance ){
+            if ( _track.empty() ){
+                return;
+            }
+            const uint32_t count = _times.getFrameCount();
+            const float framesPerTime = _times.getFramesPerTime();
+            dense.resize( count );
+            uint32_t cursor = 0;
+            for ( uint32_t frame = 0; frame < count; frame++ ){
+                const float time = framesPerTime > 0.0f ? frame / framesPerTime : 0.0f;
+                dense[ frame ] = _track.sample( time, cursor );
+            }
+            range = keyRange( dense );
+            decoded.resize( count );
+            for ( uint32_t frame = 0; frame < count; frame++ ){
+                unpackKey( packKey( dense[ frame ], range ), range, decoded[ frame ] );
+            }
+
+            // The track's keys' positions on the grid
+            const auto & times = _track.getTimes();
+            keyFrames.resize( times.size() );
+            for ( size_t i = 0; i < times.size(); i++ ){
+                keyFrames[ i ] = std::clamp( times[ i ] * framesPerTime, 0.0f, float( count - 1 ) );
+            }
+
+            // A constant track needs only its first key
+            for ( const T & value : dense ){
+                constantError = std::max( constantError, keyError( decoded[ 0 ], value ) );
+            }
+            for ( const T & value : values ){
+                constantError = std::max( constantError, keyError( decoded[ 0 ], value ) );
+            }
+        }
+
+        bool empty() const {
+            return dense.empty();
+        }
+        // Whether the first frame alone is within tolerance
+        bool isConstant() const {
+            return constantError <= tolerance;
+        }
+        // Largest error holding the first frame throughout
+        float getConstantError() const {
+            return constantError;
+        }
+        const KeyRange & getRange() const {
+            return range;
+        }
+        const T & getFrame( uint32_t _frame ) const {
+            return dense[ _frame ];
+        }
+
+        // Largest error interpolating between the quantised frames _first
+        // and _last, over the frames and keys from one to the other. Stops
+        // once above _limit
+        float spanError( uint32_t _first, uint32_t _last, float _limit ) const {
+            float error = std::max( keyError( decoded[ _first ], dense[ _first ] ),
+                                    keyError( decoded[ _last ], dense[ _last ] ) );
+            const float length = float( std::max( _last - _first, 1u ) );
+            for ( uint32_t frame = _first + 1; frame < _last && error <= _limit; frame++ ){
+                const float t = float( frame - _first ) / length;
+                error = std::max( error, keyError( interpolateKeys( decoded[ _first ], decoded[ _last ], t ),
+                                                   dense[ frame ] ) );
+            }
+            auto source = std::lower_bound( keyFrames.begin(), keyFrames.end(), float( _first ) );
+            for ( ; source != keyFrames.end() && *source <= float( _last ) && error <= _limit; source++ ){
+                const float t = _last > _first ? ( *source - float( _first ) ) / length : 0.0f;
+                error = std::max( error, keyError( interpolateKeys( decoded[ _first ], decoded[ _last ], t ),
+                                                   values[ source - keyFrames.begin() ] ) );
+            }
+            return error;
+        }
+
+        // Whether the span from _first to _last is within tolerance, always
+        // so for empty and constant tracks, which keep no frames but the
+        // first
+        bool spans( uint32_t _first, uint32_t _last ) const {
+            return empty() || isConstant() || spanError( _first, _last, tolerance ) <= tolerance;
+        }
+
+    private:
+        const std::vector< T > & values;
+        float tolerance;
+        std::vector< T > dense, decoded;
+        std::vector< float > keyFrames;
+        KeyRange range;
+        float constantError{ 0.0f };
+    };
+
+    /*-------------CompressedTrack Class------------*/
+    /*
+    *A KeyTrack compressed for storage and sampled in place. The track
+    *keeps a value at each frame of the KeyTimes it shares with the other
+    *tracks of its animation, each taking 6 bytes (see packKey), or only
+    *the first if it is constant.
+    *
+    *The frames are chosen so that linear interpolation of the quantised
+    *keys restores every track within its tolerance (see TrackEncoder).
+    *Where a tolerance cannot be met, the frame spacing or quantisation
+    *being too coarse (source keys between frames, grids clamped to
+    *MaxFrames, wide ranges of values), neighbouring frames are kept and
+    *encode reports the error reached.
+    *
+    *Sampling decodes only the two keys either side of the key
+    *KeyTimes::seek found.
+    */
+    template< typename T >
+    class CompressedTrack {
+    public:
+        // Keep _encoder's value at each of _times' frames, or only the
+        // first if the track is constant. Returns the largest error of the
+        // compressed track at the grid frames and the source keys, above
+        // the encoder's tolerance where it could not be met
+        float encode( const TrackEncoder< T > & _encoder, const KeyTimes & _times ){
+            keys.clear();
+            if ( _encoder.empty() || _times.empty() ){
+                return 0.0f;
+            }
+            range = _encoder.getRange();
+            const auto & frames = _times.getFrames();
+            if ( _encoder.isConstant() || frames.size() == 1 ){
+                keys.push_back( packKey( _encoder.getFrame( 0 ), range ) );
+                keys.shrink_to_fit();
+                return _encoder.getConstantError();
+            }
+            float maxError = 0.0f;
+            keys.reserve( frames.size() );
+            for ( size_t i = 0; i < frames.size(); i++ ){
+                keys.push_back( packKey( _encoder.getFrame( frames[ i ] ), range ) );
+                if ( i > 0 ){
+                    maxError = std::max( maxError, _encoder.spanError( frames[ i - 1 ], frames[ i ], FLT_MAX ) );
+                }
+            }
+            return maxError;
+        }
+
+        size_t size() const {
+            return keys.size();
+        }
+        bool empty() const {
+            return keys.empty();
+        }
+        // Bytes held by the track, without its KeyTimes
+        size_t getMemoryUsage() const {
+            return sizeof( *this ) + keys.capacity() * sizeof( PackedKey );
+        }
+
+        // The value _t of the way from _key to the next, as found by
+        // KeyTimes::seek. The track must not be empty
+        T sample( uint32_t _key, float _t ) const {
+            T value;
+            if ( keys.size() == 1 ){
+                unpackKey( keys[ 0 ], range, value );
+                return value;
+            }
+            unpackKey( keys[ _key ], range, value );
+            if ( _t <= 0.0f ){
+                return value;
+            }
+            T next;
+            unpackKey( keys[ _key + 1 ], range, next );
+            return interpolateKeys( value, next, _t );
+        }
+
+    private:
+        std::vector< PackedKey > keys;
+        KeyRange range;
+    };
+
+}
+
+#endif // ANIMATION_SAMPLER_H
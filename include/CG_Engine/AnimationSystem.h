@@ -0,0 +1,148 @@
+#ifndef ANIMATION_SYSTEM_H
+#define ANIMATION_SYSTEM_H
+
+#include <cfloat>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+#include "JobSystem.h"
+
+namespace GL_Engine {
+
+    class Skeleton;
+    class BlendTree;
+    class Camera;
+
+    /*-------------AnimationSystem Class------------*/
+    /*
+    *Poses skeletons in batches on the job system. Skeletons submitted
+    *during a frame are posed in parallel once dispatch() is called (by
+    *CG_Engine::BeginFrame), overlapping the frame's culling and draw
+    *submission, and publish() (called by CG_Engine::EndFrame) waits for
+    *them and makes their poses current. A submitted pose is therefore
+    *drawn from the next frame on, while the current frame draws the last
+    *published one.
+    *
+    *Skeletons are given a level of detail tier by their distance from the
+    *viewer and their projected size. A tier poses every frame, poses
+    *every few frames and blends the palettes in between, or freezes the
+    *skeleton in its last pose. The tier's index is also the tier passed
+    *to the skeleton, selecting the joints it masks. With no tiers set,
+    *every skeleton is posed every frame. Tiers are measured from a viewer
+    *the application sets, usually its scene camera (see setViewer); with
+    *none, every skeleton takes the nearest tier.
+    *
+    *Main thread only.
+    */
+    class AnimationSystem {
+    public:
+        struct LodTier {
+            // The tier is used by skeletons within maxDistance of the
+            // viewer whose projected radius, as a fraction of the
+            // viewport's height, is at least minScreenSize
+            float maxDistance{ FLT_MAX };
+            float minScreenSize{ 0.0f };
+            // Frames between poses, blended in between. 1 poses every
+            // frame, 0 freezes the skeleton
+            uint32_t interval{ 1 };
+        };
+
+        // Of the last published batch
+        struct Statistics {
+            uint32_t submitted{ 0 };
+            // Skeletons posed every frame, blended between keys, and
+            // frozen
+            uint32_t posed{ 0 };
+            uint32_t blended{ 0 };
+            uint32_t frozen{ 0 };
+            // Joints sampled from animations
+            uint32_t jointsSampled{ 0 };
+        };
+
+        explicit AnimationSystem( JobSystem & _jobs = JobSystem::get() );
+        ~AnimationSystem();
+        AnimationSystem( const AnimationSystem & ) = delete;
+        AnimationSystem & operator=( const AnimationSystem & ) = delete;
+
+        // Pose _skeleton at _time in the next batch, its tier chosen by
+        // the world space bounding sphere _bounds (xyz centre, w radius,
+        // negative for the nearest tier). A later submission of the same
+        // skeleton before the batch starts replaces this one
+        void submit( Skeleton & _skeleton, unsigned int _animationId, double _time,
+                     const glm::vec4 & _bounds = glm::vec4( 0.0f, 0.0f, 0.0f, -1.0f ) );
+        // Pose _skeleton through _tree, which must outlive the batch (see
+        // BlendTree)
+        void submit( Skeleton & _skeleton, const BlendTree & _tree, double _time,
+                     const glm::vec4 & _bounds = glm::vec4( 0.0f, 0.0f, 0.0f, -1.0f ) );
+        // Drop _skeleton from the pending batch, and wait for it if it is
+        // being posed. Call before destroying or posing a submitted
+        // skeleton directly
+        void cancel( Skeleton & _skeleton );
+
+        // Tiers, nearest first. A skeleton fitting none takes the last
+        void setLodTiers( std::vector< LodTier > _tiers );
+        const std::vector< LodTier > & getLodTiers() const;
+        // Where tiers are measured from. _projectionScale is the
+        // projection matrix's [ 1 ][ 1 ], the cotangent of half the
+        // vertical field of view
+        void setViewer( const glm::vec3 & _position, float _projectionScale );
+        // Measure tiers from _camera as it is at each dispatch(), e.g. the
+        // main scene camera. The camera must outlive the system or be
+        // replaced; null drops it
+        void setViewer( const Camera * _camera );
+        // The tier _bounds would be given
+        uint32_t selectTier( const glm::vec4 & _bounds ) const;
+
+        // Start posing the pending batch on the workers. Does nothing while
+        // the previous batch is unpublished
+        void dispatch();
+        // Wait for the dispatched batch and publish its poses
+        void publish();
+
+        // Skeletons in the pending and dispatched batches
+        size_t getPendingCount() const;
+        size_t getRunningCount() const;
+        const Statistics & getStatistics() const;
+
+        // The engine-wide system
+        static AnimationSystem & get();
+
+    private:
+        struct Request {
+            Skeleton * skeleton;
+            // The tree posed through if set, else the clip
+            const BlendTree * tree;
+            unsigned int animationId;
+            double time;
+            glm::vec4 bounds;
+            uint32_t tier;
+            uint32_t interval;
+            // Written by the job posing it
+            uint32_t sampled;
+        };
+        // Skeletons posed by a single job
+        static constexpr size_t MinBatch = 4;
+
+        JobSystem & jobs;
+        JobSystem::Counter counter;
+        std::vector< Request > pending;
+        // Index of each skeleton in pending
+        std::unordered_map< const Skeleton *, size_t > pendingIndex;
+        std::vector< Request > running;
+
+        void submit( const Request & _request );
+
+        std::vector< LodTier > tiers;
+        glm::vec3 viewerPosition{ 0.0f };
+        float projectionScale{ 1.0f };
+        bool hasViewer{ false };
+        const Camera * viewerCamera{ nullptr };
+        Statistics statistics;
+        // Counts of the dispatched batch, until it is published
+        Statistics dispatched;
+    };
+
+}
+
+#endif // ANIMATION_SYSTEM_H
@@ -0,0 +1,144 @@
+#ifndef BLEND_TREE_H
+#define BLEND_TREE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace GL_Engine {
+
+    class Skeleton;
+
+    // Local transforms of a skeleton's joints, as separate translation,
+    // rotation and scale arrays so poses blend component-wise
+    struct LocalPose {
+        std::vector< glm::vec3 > translations;
+        std::vector< glm::quat > rotations;
+        std::vector< glm::vec3 > scales;
+
+        void resize( uint32_t _joints );
+        uint32_t size() const;
+    };
+
+    /*-------------PosePool Class------------*/
+    /*
+    *Recycles LocalPose buffers, so evaluating blend trees allocates only
+    *until the pool has grown to the most buffers in use at once, sized to
+    *the largest skeleton. Thread safe.
+    */
+    class PosePool {
+    public:
+        // A buffer on loan, returned to its pool on destruction
+        class Lease {
+        public:
+            Lease( PosePool & _pool, std::unique_ptr< LocalPose > _pose );
+            ~Lease();
+            Lease( Lease && ) = default;
+            Lease & operator=( Lease && ) = delete;
+            LocalPose & operator*() const;
+            LocalPose * operator->() const;
+        private:
+            PosePool * pool;
+            std::unique_ptr< LocalPose > pose;
+        };
+
+        // A buffer of _joints joints, with undefined contents
+        Lease acquire( uint32_t _joints );
+
+        // Buffers created, and those free
+        size_t getCreatedCount() const;
+        size_t getFreeCount() const;
+
+        // The engine-wide pool
+        static PosePool & get();
+
+    private:
+        void release( std::unique_ptr< LocalPose > _pose );
+
+        mutable std::mutex mutex;
+        std::vector< std::unique_ptr< LocalPose > > free;
+        size_t created{ 0 };
+    };
+
+    /*-------------BlendTree Class------------*/
+    /*
+    *Mixes a skeleton's clips into one pose. Nodes are kept in a flat
+    *array, inputs before the nodes using them, and the last node added is
+    *the root:
+    *- Clip nodes sample a clip, starting at a tree time and at a speed.
+    *- Blend nodes cross-fade from their first input to their second.
+    *- Additive nodes add the difference between their second input and
+    *  that clip's first frame onto their first input.
+    *- Layer nodes blend their second input over their first per joint, by
+    *  a mask of joint weights, for partial body layers.
+    *Inputs that do not contribute (a weight of 0 or 1) are not evaluated.
+    *
+    *Inputs must be nodes already added, or adding throws. Clips the
+    *posed skeleton lacks sample as its bind pose.
+    *
+    *A tree refers to a skeleton's clip indices and joint count, and
+    *samples through the skeleton's cursors. While the AnimationSystem
+    *poses with a tree, from CG_Engine::BeginFrame until CG_Engine::EndFrame,
+    *the tree must not change.
+    */
+    class BlendTree {
+    public:
+        using NodeId = uint32_t;
+
+        // Sample _clip at ( time - _start ) * _speed, looping or holding
+        // its ends
+        NodeId addClip( uint32_t _clip, double _start = 0.0, float _speed = 1.0f, bool _loop = true );
+        // _to weighted by _weight over _from
+        NodeId addBlend( NodeId _from, NodeId _to, float _weight = 0.0f );
+        // _additive's offset from its clip's first frame, scaled by
+        // _weight, added to _base. _additive must be a clip node
+        NodeId addAdditive( NodeId _base, NodeId _additive, float _weight = 1.0f );
+        // _layer over _base, weighted by _weight times the mask
+        NodeId addLayer( NodeId _base, NodeId _layer, std::vector< float > _mask, float _weight = 1.0f );
+
+        void setWeight( NodeId _node, float _weight );
+        float getWeight( NodeId _node ) const;
+        // Restart a clip node at _start
+        void setStart( NodeId _node, double _start );
+        void setSpeed( NodeId _node, float _speed );
+        size_t size() const;
+
+        // A mask weighting _joint and its descendants by 1, others by 0
+        static std::vector< float > subtreeMask( const Skeleton & _skeleton, uint32_t _joint );
+
+        // Pose the tree at _time into _pose, sampling only the joints
+        // _skeleton animates at _tier. Returns the number of joints sampled
+        uint32_t evaluate( Skeleton & _skeleton, double _time, uint32_t _tier, LocalPose & _pose,
+                           PosePool & _pool = PosePool::get() ) const;
+
+    private:
+        enum class NodeType { Clip, Blend, Additive, Layer };
+        struct Node {
+            NodeType type;
+            NodeId inputs[ 2 ];
+            float weight;
+            // Clip nodes
+            uint32_t clip;
+            double start;
+            float speed;
+            bool loop;
+            // Layer nodes
+            uint32_t mask;
+        };
+
+        NodeId add( const Node & _node );
+        uint32_t evaluate( NodeId _node, Skeleton & _skeleton, double _time, uint32_t _tier,
+                           LocalPose & _pose, PosePool & _pool ) const;
+        // Time in the clip of a clip node
+        double clipTime( const Node & _node, const Skeleton & _skeleton, double _time ) const;
+
+        std::vector< Node > nodes;
+        std::vector< std::vector< float > > masks;
+    };
+
+}
+
+#endif // BLEND_TREE_H
@@ -9,12 +9,16 @@
 #include <iostream>
 #include <tuple>
 #include <memory>
+#include <utility>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <list>
 #include <map>
 #include "File_IO.h"
+#include "Culling.h"
+#include "UniformBinder.h"
+#include "RingBuffer.h"
 
 
 namespace GL_Engine{
@@ -42,9 +46,13 @@ namespace GL_Engine{
 			//Binds the VBO
 			void BindVBO() const;
 
-			//Sets the VBO data
+			//Sets the VBO data. Storage is only re-specified if the size
+			//changes; otherwise the existing storage is overwritten
 			void SetVBOData(void* _Data, uint64_t _DataSize) const;
 
+			//Overwrites _DataSize bytes at _Offset, leaving the rest intact
+			void UpdateVBOData(const void* _Data, uint64_t _DataSize, uint64_t _Offset = 0) const;
+
 		protected:
 			//The VBO target, e.g. GL_ARRAY_BUFFER
 			GLenum Target{ GL_ARRAY_BUFFER };
@@ -57,6 +65,9 @@ namespace GL_Engine{
 		private:
 			//Indicates whether or not the VBO has been initialised
 			bool initialised{ false };
+
+			//Size of the current storage, in bytes
+			mutable uint64_t StorageSize{ 0 };
 		};
 
 		/*-------------VAO Class------------*/
@@ -73,9 +84,14 @@ namespace GL_Engine{
 			void BindVAO() const;
 			void AddVBO(std::unique_ptr<VBO> _VBO);
 			GLuint getIndexCount() const;
+
+			//Model space bounds of the vertex data, empty if never set
+			const BoundingVolume & GetBounds() const;
+			void SetBounds(const BoundingVolume &_Bounds);
 		protected:
 			std::vector<std::unique_ptr<VBO>> VBOs;
 			GLuint numIndices{ 0 };
+			BoundingVolume Bounds;
 		private:
 			GLuint VAOId{ InvalidGlId };
 			bool initialised{ false };
@@ -112,10 +128,20 @@ namespace GL_Engine{
 		
 		/*-------------Uniform Class------------*/
 		/*
-		*Handles everything to do with shader uniforms
+		*A program uniform fed from a data pointer. Typed uniforms (see
+		*SetType) keep a copy of the bytes last uploaded, and Update skips
+		*the GL call while the data is unchanged. Uniforms set by callback
+		*are always uploaded, as their size is unknown.
+		*Null data (e.g. from DataSource of an entity lacking the component)
+		*uploads zeros to typed uniforms, and nothing through a callback.
 		*/
 		class Uniform{
 		public:
+			struct Statistics {
+				uint64_t issued{ 0 };
+				uint64_t skipped{ 0 };
+			};
+
 			Uniform(GLint _Location, void* _Data, std::function<void(const CG_Data::Uniform&)> _Callback);
 			Uniform();
 			~Uniform();
@@ -123,22 +149,52 @@ namespace GL_Engine{
 
 			void Update() const;
 			void SetUpdateCallback(std::function<void(const CG_Data::Uniform&)> _callback);
+
+			//Upload _Count values of type T on Update, with a direct glUniform*
+			//call instead of a callback
+			template<typename T>
+			void SetType(GLsizei _Count = 1) {
+				SetUploader(&uploadUniformData<T>, _Count, sizeof(T));
+			}
+			void SetUploader(UniformUploader _Uploader, GLsizei _Count, size_t _ElementSize);
+
+			//Forget the last uploaded value, so the next Update always uploads.
+			//Needed if the value was set on the program by other means
+			void Invalidate();
+
+			//Upload counts over the last completed frame, and the current one
+			static const Statistics & GetStatistics();
+			static const Statistics & GetCurrentStatistics();
+			//Close the frame's statistics, called from CG_Engine::EndFrame
+			static void EndFrame();
 			const GLint GetID() const;
 			void SetData(const void* _Data);
 			void SetID(GLint _ID);
 			const void* GetData() const;
+			//Bytes a typed uniform uploads, 0 if set by callback
+			size_t GetDataSize() const;
 
 		private:
-			bool NeedsUpdating{ false };
 			bool Initialised{ false };
 			const void *Data{ nullptr };
 			GLint ID;
 			std::function<void(const CG_Data::Uniform&)> UpdateCallback;
+			UniformUploader Uploader{ nullptr };
+			GLsizei Count{ 1 };
+			//Bytes last uploaded, for typed uniforms
+			mutable std::vector<uint8_t> Shadow;
+			mutable bool ShadowValid{ false };
+			static Statistics FrameStatistics, LastFrameStatistics;
 		};
 
 		/*-------------UBO Class------------*/
 		/*
 		*Handles everything to do with uniform buffer objects
+		*Updates are streamed into RingBuffer::Uniforms() and bound as a
+		*range. Within a frame the data is written again only when it has
+		*changed; a new frame always writes its own copy (see
+		*RingBuffer::IsLive). The UBO's own buffer is used if the ring runs
+		*out of space for the frame.
 		*/
 		class UBO : VBO {
 		public:
@@ -147,12 +203,20 @@ namespace GL_Engine{
 			void UpdateUBO() const;
 			const GLuint GetBindingPost() const;
 			void setData( void * _data );
+
+			//Claim a uniform buffer binding point no UBO will use, for
+			//blocks bound to ranges of a shared buffer
+			static GLuint ReserveBindingPost();
 		private:
 			bool Initialised{ false };
 			void* Data;
 			size_t DataSize;
 			GLuint BindingPost;
 			static GLuint UBO_Count;
+
+			//Copy of the data last written, and where it was written to
+			mutable std::vector<uint8_t> Shadow;
+			mutable RingBuffer::Allocation Current;
 		};
 
 
@@ -238,12 +302,23 @@ namespace GL_Engine{
 					   const GLenum * _colourAttachments ) const;
 			
 			const GLuint getID() const;
+			uint16_t getWidth() const;
+			uint16_t getHeight() const;
+			bool isComplete() const;
 			void unbind() const;
 
 			static FramebufferBindToken staticBind( GLuint id );
 
+			// Framebuffer bound when the framebuffer stack empties. 0 (the
+			// window's) unless a headless context installs its offscreen FBO
+			static void setDefaultFramebuffer( GLuint id );
+			static GLuint getDefaultFramebuffer();
+
 		private:
 			static void staticUnbind( GLuint id );
+			static GLuint DefaultFramebuffer;
+			// Profiler event of each FramebufferStack entry
+			static std::list<uint32_t> FramebufferProfileEvents;
 			uint16_t width, height;
 			
 
@@ -1,13 +1,44 @@
 #pragma once
 #include "Properties.h"
+#include <memory>
 
 namespace GL_Engine{
+	namespace CG_Data {
+		class FBO;
+	}
+
 	class CG_Engine{
 	public:
 		CG_Engine();
 		~CG_Engine();
 		static bool CG_CreateWindow(Properties::GLFWproperties *_DisplayProperties);
+		//Alternative to CG_CreateWindow for hosts without a display: a GL 3.3
+		//core context on EGL's surfaceless platform (e.g. Mesa llvmpipe).
+		//CG_StartGlad then loads through EGL and creates the offscreen
+		//framebuffer that takes the place of the window's. Requires a build
+		//with CG_ENGINE_HEADLESS, returns false otherwise
+		static bool CG_CreateHeadlessContext(Properties::HeadlessProperties *_HeadlessProperties);
+		static void CG_DestroyHeadlessContext();
 		static bool CG_StartGlad(Properties::GLADproperties * _GladProperties);
+		static bool IsHeadless();
+		//The headless context's framebuffer, null with a window
+		static std::shared_ptr<CG_Data::FBO> GetOffscreenFramebuffer();
+		//Call once per frame, after the frame's scene updates and before
+		//its first Render. Dispatches the frame's skeleton poses (see
+		//AnimationSystem), rebuilds the moved entities' matrices (see
+		//TransformStore) and refits their bounds (see SpatialIndex), which
+		//every Render of the frame then shares
+		static void BeginFrame();
+		//Call once per frame, after the frame's last draw. Publishes the
+		//frame's skeleton poses (see AnimationSystem), runs the jobs
+		//queued for the GL thread (see JobSystem), releases the per-frame
+		//allocations (see FrameArena) and closes the frame's statistics
+		//and profile (see Profiler)
+		static void EndFrame();
+		//Release the GL resources the engine holds itself (see
+		//RingBuffer::ReleaseShared). Call while the context is still
+		//current, before glfwTerminate; CG_DestroyHeadlessContext calls it
+		static void Shutdown();
 		static uint32_t ViewportWidth, ViewportHeight;
 	private:
 
@@ -0,0 +1,71 @@
+#ifndef COMMAND_BUCKET_H
+#define COMMAND_BUCKET_H
+
+#include "Common.h"
+#include <vector>
+#include <cstdint>
+
+namespace GL_Engine {
+
+    struct RenderPass;
+
+    /*-------------CommandBucket Class------------*/
+    /*
+    *Collects the render passes submitted for a frame, each tagged with a
+    *64-bit sort key, and executes them in key order.
+    *
+    *Key layout (most significant bits first):
+    *   [63..60] layer   - coarse ordering (opaque/translucent/overlay)
+    *   [59..48] shader  - program ID
+    *   [47..32] material - folded texture set
+    *   [31..16] VAO     - vertex array ID
+    *   [15..0]  depth   - quantised depth
+    *
+    *Sorting is a stable LSD radix sort, so passes with equal keys keep
+    *their submission order.
+    */
+    class CommandBucket {
+    public:
+        // Coarse layers, occupying the top 4 bits of the key
+        enum SortLayer : uint8_t {
+            Opaque = 0, Translucent = 8, Overlay = 15
+        };
+
+        struct Command {
+            uint64_t key;
+            RenderPass * pass;
+        };
+
+        // Remove all commands, keeping the allocated storage
+        void clear();
+
+        // Submit a pass with an explicit sort key
+        void submit( uint64_t _key, RenderPass * _pass );
+
+        // Submit a pass, building its key from the pass state
+        void submit( RenderPass * _pass );
+
+        // Radix sort the submitted commands by key
+        void sort();
+
+        // Run the render function of every command, in order
+        void execute() const;
+
+        const std::vector< Command > & getCommands() const;
+        size_t size() const;
+
+        // Build a key from its individual fields
+        static uint64_t makeKey( uint8_t _layer, GLuint _shader,
+                                 uint16_t _material, GLuint _vao,
+                                 uint16_t _depth );
+
+        // Build a key from the state a render pass will bind
+        static uint64_t makeKey( const RenderPass & _pass );
+
+    private:
+        std::vector< Command > commands, scratch;
+    };
+
+}
+
+#endif // COMMAND_BUCKET_H
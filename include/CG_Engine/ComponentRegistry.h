@@ -0,0 +1,239 @@
+#ifndef COMPONENT_REGISTRY_H
+#define COMPONENT_REGISTRY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace GL_Engine {
+
+    // Identifies an entity, the same value as its TransformStore handle
+    using EntityId = uint32_t;
+
+    /*-------------ComponentPool Class------------*/
+    /*
+    *The components of one type, as a sparse set: a sparse array indexed
+    *by entity maps to a densely packed array of components, and back
+    *through a parallel array of entities. Lookup, insertion and removal
+    *are constant time, and iteration walks contiguous memory.
+    *
+    *Removal moves the last component into the gap, so a reference to a
+    *component is only valid until the pool next changes.
+    */
+    class ComponentPoolBase {
+    public:
+        static constexpr uint32_t Absent = UINT32_MAX;
+
+        virtual ~ComponentPoolBase() = default;
+        virtual void remove( EntityId _entity ) = 0;
+        // Give _to a copy of _from's component, if it has one
+        virtual void copy( EntityId _from, EntityId _to ) = 0;
+
+        bool has( EntityId _entity ) const {
+            return _entity < sparse.size() && sparse[ _entity ] != Absent;
+        }
+        size_t size() const {
+            return dense.size();
+        }
+        // The entities with a component, in component order
+        const std::vector< EntityId > & getEntities() const {
+            return dense;
+        }
+
+    protected:
+        std::vector< uint32_t > sparse;
+        std::vector< EntityId > dense;
+    };
+
+    template< typename T >
+    class ComponentPool : public ComponentPoolBase {
+    public:
+        // Replaces any component _entity already has
+        template< typename... Args >
+        T & emplace( EntityId _entity, Args &&... _args ){
+            if ( has( _entity ) ){
+                return components[ sparse[ _entity ] ] = T{ std::forward< Args >( _args )... };
+            }
+            if ( _entity >= sparse.size() ){
+                sparse.resize( _entity + 1, Absent );
+            }
+            sparse[ _entity ] = static_cast< uint32_t >( dense.size() );
+            dense.push_back( _entity );
+            components.push_back( T{ std::forward< Args >( _args )... } );
+            return components.back();
+        }
+
+        void remove( EntityId _entity ) override {
+            if ( !has( _entity ) ){
+                return;
+            }
+            const uint32_t index = sparse[ _entity ];
+            const EntityId last = dense.back();
+            components[ index ] = std::move( components.back() );
+            dense[ index ] = last;
+            sparse[ last ] = index;
+            components.pop_back();
+            dense.pop_back();
+            sparse[ _entity ] = Absent;
+        }
+
+        void copy( EntityId _from, EntityId _to ) override {
+            if constexpr ( std::is_copy_constructible_v< T > ){
+                if ( has( _from ) ){
+                    T component = components[ sparse[ _from ] ];
+                    emplace( _to, std::move( component ) );
+                }
+            }
+        }
+
+        T * tryGet( EntityId _entity ){
+            return has( _entity ) ? &components[ sparse[ _entity ] ] : nullptr;
+        }
+        const T * tryGet( EntityId _entity ) const {
+            return has( _entity ) ? &components[ sparse[ _entity ] ] : nullptr;
+        }
+
+        // Packed components, parallel to getEntities()
+        T * data(){
+            return components.data();
+        }
+        const T * data() const {
+            return components.data();
+        }
+
+    private:
+        std::vector< T > components;
+    };
+
+    template< typename... Ts >
+    class ComponentView;
+
+    /*-------------ComponentRegistry Class------------*/
+    /*
+    *Owns one ComponentPool per component type, created on first use.
+    *Entities add their components here, and systems iterate the
+    *entities with a given set of them through view(). Not thread safe.
+    */
+    class ComponentRegistry {
+    public:
+        ComponentRegistry() = default;
+        ComponentRegistry( const ComponentRegistry & ) = delete;
+        ComponentRegistry & operator=( const ComponentRegistry & ) = delete;
+
+        template< typename T >
+        ComponentPool< T > & pool(){
+            const uint32_t id = typeId< T >();
+            if ( id >= pools.size() ){
+                pools.resize( id + 1 );
+            }
+            if ( !pools[ id ] ){
+                pools[ id ] = std::make_unique< ComponentPool< T > >();
+            }
+            return static_cast< ComponentPool< T > & >( *pools[ id ] );
+        }
+
+        template< typename T, typename... Args >
+        T & add( EntityId _entity, Args &&... _args ){
+            return pool< T >().emplace( _entity, std::forward< Args >( _args )... );
+        }
+
+        template< typename T >
+        void remove( EntityId _entity ){
+            pool< T >().remove( _entity );
+        }
+
+        template< typename T >
+        T * tryGet( EntityId _entity ){
+            return pool< T >().tryGet( _entity );
+        }
+
+        template< typename T >
+        bool has( EntityId _entity ){
+            return pool< T >().has( _entity );
+        }
+
+        // Remove all of _entity's components
+        void destroy( EntityId _entity );
+        // Give _to a copy of each of _from's components
+        void copy( EntityId _from, EntityId _to );
+
+        // The entities having all of Ts
+        template< typename... Ts >
+        ComponentView< Ts... > view(){
+            return ComponentView< Ts... >( pool< Ts >()... );
+        }
+
+        // The engine-wide registry, which Entity components live in
+        static ComponentRegistry & get();
+
+    private:
+        static uint32_t nextTypeId();
+        template< typename T >
+        static uint32_t typeId(){
+            static const uint32_t id = nextTypeId();
+            return id;
+        }
+
+        std::vector< std::unique_ptr< ComponentPoolBase > > pools;
+    };
+
+    /*-------------ComponentView Class------------*/
+    /*
+    *The entities having every component in Ts. Iteration walks the
+    *smallest of the pools and skips entities missing any of the others;
+    *a single component view walks its pool directly. The pools must not
+    *gain or lose components during iteration.
+    */
+    template< typename... Ts >
+    class ComponentView {
+    public:
+        explicit ComponentView( ComponentPool< Ts > &... _pools ) : pools( &_pools... ){}
+
+        // Call _function( EntityId, Ts &... ) for each entity
+        template< typename Function >
+        void each( Function && _function ){
+            if constexpr ( sizeof...( Ts ) == 1 ){
+                auto & pool = *std::get< 0 >( pools );
+                const auto & entities = pool.getEntities();
+                auto * components = pool.data();
+                for ( size_t i = 0; i < entities.size(); i++ ){
+                    _function( entities[ i ], components[ i ] );
+                }
+            }
+            else {
+                const ComponentPoolBase * smallest = nullptr;
+                std::apply( [ &smallest ]( auto *... _pool ){
+                    ( ( smallest = ( !smallest || _pool->size() < smallest->size() ) ?
+                                   _pool : smallest ), ... );
+                }, pools );
+                for ( EntityId entity : smallest->getEntities() ){
+                    if ( std::apply( [ entity ]( auto *... _pool ){
+                             return ( _pool->has( entity ) && ... ); }, pools ) ){
+                        std::apply( [ &_function, entity ]( auto *... _pool ){
+                            _function( entity, *_pool->tryGet( entity )... );
+                        }, pools );
+                    }
+                }
+            }
+        }
+
+        // Entities in the view, at most the size of the smallest pool
+        size_t sizeHint() const {
+            size_t size = SIZE_MAX;
+            std::apply( [ &size ]( auto *... _pool ){
+                ( ( size = std::min( size, _pool->size() ) ), ... );
+            }, pools );
+            return size;
+        }
+
+    private:
+        std::tuple< ComponentPool< Ts > *... > pools;
+    };
+
+}
+
+#endif // COMPONENT_REGISTRY_H
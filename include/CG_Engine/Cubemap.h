@@ -5,6 +5,7 @@
 #include "File_IO.h"
 #include "Shader.h"
 #include "Camera.h"
+#include "RenderGraph.h"
 #include <filesystem>
 
 namespace GL_Engine {
@@ -53,6 +54,10 @@ namespace GL_Engine {
 		void renderStaticMap();
 		void renderDynamicMap();
 
+		// Schedule the dynamic map render in a frame graph, in place of
+		// calling renderDynamicMap(). The map is marked as a frame output
+		void addPasses( RenderGraph & _graph );
+
 		std::shared_ptr< CG_Data::Texture > getStaticTexture();
 		std::shared_ptr< CG_Data::Texture > getDynamicTexture();
 
@@ -60,6 +65,8 @@ namespace GL_Engine {
 		const Camera & getCamera() const;
 
 	private:
+		// Render all six faces of the dynamic map, with its FBO bound
+		void renderDynamicFaces();
 
 		std::shared_ptr< CG_Data::Texture > staticColourTex, staticDepthTex;
 		std::shared_ptr< CG_Data::Texture > dynamicColourTex, dynamicDepthTex;
@@ -0,0 +1,117 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+
+namespace GL_Engine {
+
+    struct RenderPass;
+
+    /*-------------BoundingVolume------------*/
+    /*
+    *Axis aligned box and enclosing sphere of a mesh, computed once at load
+    *time in model space and transformed into world space as needed.
+    */
+    struct BoundingVolume {
+        glm::vec3 min{ 0.0f }, max{ 0.0f };
+        glm::vec3 centre{ 0.0f };
+        float radius{ -1.0f };
+
+        // Volumes with no points have a negative radius
+        bool isEmpty() const;
+
+        // Build from _count points, _stride floats apart
+        static BoundingVolume fromPoints( const float * _points, size_t _count,
+                                          size_t _stride = 3 );
+
+        // Build from a box, the sphere enclosing the box
+        static BoundingVolume fromBox( const glm::vec3 & _min,
+                                       const glm::vec3 & _max );
+
+        // Transform the volume. The box is refitted around the transformed
+        // box, and the radius scaled by the largest axis scale
+        BoundingVolume transformed( const glm::mat4 & _transform ) const;
+    };
+
+    /*-------------SphereList------------*/
+    /*
+    *World space bounding spheres gathered from the passes of a renderer,
+    *stored as a structure of arrays so the frustum test can run four
+    *spheres at a time.
+    */
+    class SphereList {
+    public:
+        void clear();
+        void push( const glm::vec3 & _centre, float _radius );
+        void push( const BoundingVolume & _volume );
+        size_t size() const;
+
+        std::vector< float > x, y, z, r;
+    };
+
+    /*-------------Frustum------------*/
+    class Frustum {
+    public:
+        enum class Containment { Outside, Intersecting, Inside };
+
+        // Extract the six normalised planes from a projection * view matrix
+        void extract( const glm::mat4 & _pvMatrix );
+
+        bool testSphere( const glm::vec3 & _centre, float _radius ) const;
+        // Classify an axis aligned box. Conservative: a box near a corner
+        // of the frustum may be reported intersecting while outside
+        Containment testBox( const glm::vec3 & _centre,
+                             const glm::vec3 & _halfExtents ) const;
+
+        // Test _spheres[ _first, _first + _count ), writing 1 (visible) or
+        // 0 (culled) per sphere to _visible
+        void testSpheres( const SphereList & _spheres, size_t _first,
+                          size_t _count, uint8_t * _visible ) const;
+
+    private:
+        // Planes as a structure of arrays, ( a, b, c, d ) with the normal
+        // pointing into the frustum
+        alignas( 16 ) float planeA[ 6 ], planeB[ 6 ], planeC[ 6 ], planeD[ 6 ];
+    };
+
+    /*-------------CullingStage Class------------*/
+    /*
+    *Runs before a renderer draws its passes. Every pass with a bounds
+    *gatherer has its items' bounding spheres collected into one list, which
+    *is then tested against the frustum four spheres at a time. The result
+    *is written to each pass' visibility list, which the render functions
+    *consult.
+    */
+    class CullingStage {
+    public:
+        struct Statistics {
+            uint64_t tested{ 0 };
+            uint64_t visible{ 0 };
+        };
+
+        void cull( const glm::mat4 & _pvMatrix,
+                   const std::vector< std::shared_ptr< RenderPass > > & _passes );
+
+        const Frustum & getFrustum() const;
+        const Statistics & getStatistics() const;
+        void resetStatistics();
+
+    private:
+        struct PassRange {
+            RenderPass * pass;
+            size_t first, count;
+        };
+
+        Frustum frustum;
+        SphereList spheres;
+        std::vector< PassRange > ranges;
+        Statistics statistics;
+    };
+
+}
+
+#endif // CULLING_H
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <cstring>
 #include "CG_Data.h"
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -11,12 +12,29 @@
 #include <glm/mat4x4.hpp>
 #include <map>
 #include "Shader.h"
+#include "TransformStore.h"
+#include "SpatialIndex.h"
+#include "AnimationSampler.h"
+#include "NameTable.h"
+#include "ComponentRegistry.h"
 
 namespace GL_Engine {
+	struct DataSource;
+
+	/*-------------Entity Class------------*/
+	/*
+	*A handle onto a transform in the TransformStore, and onto the
+	*entity's components in the ComponentRegistry, both keyed by the
+	*entity's id. Render passes read per-entity data through DataSources.
+	*/
 	class Entity {
 	public:
 		Entity();
 		~Entity();
+		//A copy gets its own transform, starting from the same values
+		//but without a parent
+		Entity(const Entity &_Other);
+		Entity &operator=(const Entity &_Other);
 
 		void SetPosition(glm::vec3 _Position);
 		void Translate(glm::vec3 _Translation);
@@ -28,63 +46,267 @@ namespace GL_Engine {
 		void ScaleBy(glm::vec3 _ScaleBy);
 		void SetOrientation(glm::quat _Orientation);
 		void Rotate(glm::quat _Rotation);
+		//Make the transform relative to _Parent's world matrix, or
+		//absolute for nullptr. _ParentOffset goes between the two, see
+		//TransformStore::setParent
+		void SetParent(Entity *_Parent, const glm::mat4 *_ParentOffset = nullptr);
 
 		const glm::mat4 GetTransformMatrix();
 		const glm::quat GetOrientation() const;
 		const glm::vec4 GetPosition() const;
+		const glm::vec3 GetScale() const;
+		//Local axes, derived from the orientation
+		const glm::vec3 GetForward() const;
+		const glm::vec3 GetUp() const;
+		const glm::vec3 GetRight() const;
+		TransformStore::Handle GetTransformHandle() const;
+		//Track the entity in the SpatialIndex, with _LocalBounds in model
+		//space (e.g. the bounds of its VAO). Empty bounds stop tracking it
+		void SetBounds(const BoundingVolume &_LocalBounds);
 
 		void update();
 
+		//Premultiply the entity's local transform by _Transform, which
+		//should be an affine transform without shear
 		const glm::mat4 TransformBy(glm::mat4 _Transform);
 
-		const uint16_t AddData(void* _Data);
+		EntityId GetId() const;
+
+		//Components are stored packed by type in the ComponentRegistry.
+		//References are valid until a component of the type is removed
+		template<typename T, typename... Args>
+		T &AddComponent(Args&&... _Args) {
+			return ComponentRegistry::get().add<T>(GetId(), std::forward<Args>(_Args)...);
+		}
+		template<typename T>
+		T *GetComponent() const {
+			return ComponentRegistry::get().tryGet<T>(GetId());
+		}
+		template<typename T>
+		bool HasComponent() const {
+			return ComponentRegistry::get().has<T>(GetId());
+		}
+		template<typename T>
+		void RemoveComponent() {
+			ComponentRegistry::get().remove<T>(GetId());
+		}
 
-		void SetData(int index, void* data);
+		//The data _Source reads for this entity, nullptr if it lacks the
+		//component
+		const void *GetData(const DataSource &_Source) const;
 
 		void SetActive(bool _State);
 
-		void* GetData(int index);
 		bool isActive() const;
 		void Activate();
 		void Deactivate();
 
-		const std::vector<void*> GeteDataList() const;
-
 		void UpdateUniforms() const;
-		glm::mat4 TransformMatrix;
 
 	protected:
-		glm::vec4 Position{ 0, 0, 0, 1 };
-		glm::vec3 Forward{ 0, 0, 1 }, Up{ 0, 1, 0 }, Right{ 1, 0, 0 };
-		glm::vec3 Scale{ 1, 1, 1 };
-		glm::quat Orientation;
+		//The world matrix in the store, as of its last rebuild
+		glm::mat4 &TransformMatrix();
+		TransformStore::Handle Transform;
 		std::vector<CG_Data::Uniform*> EntityUniforms;
 		bool Active{ true };
-		std::vector<void*> eData;
-		void UpdateMatrix();
-		bool MatrixNeedsUpdating{ true };
+	};
+
+	/*-------------DataSource Struct------------*/
+	/*
+	*Where a render pass reads a piece of per-entity data: the entity's
+	*world matrix, a whole component, or a member of one, e.g.
+	*DataSource::Member<&ParticleEmitter::Position>(). Resolved on every
+	*use, as components move when their pool changes.
+	*
+	*Renderers read the data of a pass' drawn entities in bulk through
+	*gather, which for components walks the pool's packed storage through
+	*a registry view, rather than resolving entity by entity.
+	*/
+	struct DataSource {
+	private:
+		template<typename> struct MemberOwner;
+		template<typename T, typename M> struct MemberOwner<M T::*> {
+			using Type = T;
+		};
+		template<typename T>
+		struct WholeComponent {
+			static const void *get(const T &_Component) { return &_Component; }
+		};
+		template<auto _Member>
+		struct ComponentMember {
+			using Owner = typename MemberOwner<decltype(_Member)>::Type;
+			static const void *get(const Owner &_Component) { return &(_Component.*_Member); }
+		};
+
+		//Output slots of each entity being gathered, as the head of a
+		//list per entity (entities may be drawn more than once)
+		struct GatherSlots {
+			static constexpr uint32_t None = UINT32_MAX;
+			std::vector<uint32_t> first, next;
+
+			void build(const EntityId *_Entities, size_t _Count);
+			void clear(const EntityId *_Entities, size_t _Count);
+		};
+		static GatherSlots &Slots();
+
+		template<typename T, typename Projection>
+		static void GatherComponents(const EntityId *_Entities, size_t _Count, size_t _Size,
+									 uint8_t *_Out, size_t _Stride) {
+			auto &pool = ComponentRegistry::get().pool<T>();
+			//Only a few of the pool's components are wanted, look them up
+			if (pool.size() > _Count * 4) {
+				for (size_t i = 0; i < _Count; i++) {
+					const T *component = pool.tryGet(_Entities[i]);
+					if (component)
+						std::memcpy(_Out + i * _Stride, Projection::get(*component), _Size);
+					else
+						std::memset(_Out + i * _Stride, 0, _Size);
+				}
+				return;
+			}
+			//Otherwise walk the packed components in order, copying each
+			//to the slots of its entity
+			for (size_t i = 0; i < _Count; i++)
+				std::memset(_Out + i * _Stride, 0, _Size);
+			auto &slots = Slots();
+			slots.build(_Entities, _Count);
+			ComponentRegistry::get().view<T>().each([&](EntityId _Id, const T &_Component) {
+				if (_Id >= slots.first.size())
+					return;
+				for (uint32_t slot = slots.first[_Id]; slot != GatherSlots::None; slot = slots.next[slot])
+					std::memcpy(_Out + slot * _Stride, Projection::get(_Component), _Size);
+			});
+			slots.clear(_Entities, _Count);
+		}
+
+		static void GatherWorldMatrices(const EntityId *_Entities, size_t _Count, size_t _Size,
+										uint8_t *_Out, size_t _Stride);
+
+	public:
+		const void *(*resolve)(EntityId);
+		//Copy _Size bytes of each of _Count entities' data to _Out, _Stride
+		//bytes apart, zeros for entities lacking it
+		void (*gather)(const EntityId *_Entities, size_t _Count, size_t _Size,
+					   uint8_t *_Out, size_t _Stride);
+
+		static DataSource WorldMatrix() {
+			return { [](EntityId _Id) -> const void* {
+				return glm::value_ptr(TransformStore::get().getMatrix(_Id));
+			}, &GatherWorldMatrices };
+		}
+		template<typename T>
+		static DataSource Component() {
+			return { [](EntityId _Id) -> const void* {
+				return ComponentRegistry::get().tryGet<T>(_Id);
+			}, &GatherComponents<T, WholeComponent<T>> };
+		}
+		template<auto _Member>
+		static DataSource Member() {
+			using T = typename MemberOwner<decltype(_Member)>::Type;
+			return { [](EntityId _Id) -> const void* {
+				const T *component = ComponentRegistry::get().tryGet<T>(_Id);
+				return component ? &(component->*_Member) : nullptr;
+			}, &GatherComponents<T, ComponentMember<_Member>> };
+		}
 	};
 
 	struct BatchUnit {
 		Entity* entity;
 		bool active{ true };
 	};
-	struct eDataUniLink {
+	struct DataUniLink {
 		CG_Data::Uniform *uniform;
-		uint16_t eDataIndex;
+		DataSource source;
+	};
+	//Per-instance attribute fed from an entity's data (float components)
+	struct DataInstanceLink {
+		DataSource source;
+		GLuint location;
+		GLint components;
+	};
+	//Member of a pass' per-draw uniform block fed from an entity's data
+	struct DataBlockLink {
+		DataSource source;
+		GLint offset;
+		GLint size;
 	};
 
 	struct RenderPass {
 		BatchUnit* AddBatchUnit(Entity* _Entity);
 		void SetDrawFunction(std::function<void(void)> _dFunc);
-		void AddDataLink(CG_Data::Uniform *_Uniform, uint16_t _DataIndex) {
-			eDataUniLink link = { _Uniform, _DataIndex };
+		void AddDataLink(CG_Data::Uniform *_Uniform, DataSource _Source) {
+			DataUniLink link = { _Uniform, _Source };
 			this->dataLink.push_back(link);
 		}
+		//Gather every data link's values for the units drawn this frame,
+		//one DataSource::gather per link, for render functions drawing
+		//batch units one by one
+		void GatherLinkData();
+		//Set every data link's uniform to the gathered values of the
+		//_Drawn'th unit drawn (in batch order) and upload them. Links to
+		//uniforms set by callback resolve _Entity's data directly
+		void UpdateDataLinks(size_t _Drawn, const Entity &_Entity);
 		void AddUniform( CG_Data::Uniform *_uniform, void * _data ) {
 			auto uniDataPair = std::make_pair( _uniform, _data );
 			this->uniforms.push_back( uniDataPair );
 		}
+
+		//Default attribute location of the per-instance model matrix
+		//(occupies 4 consecutive locations)
+		static constexpr GLuint DefaultInstanceLocation = 8;
+
+		//Draw all active batch units with a single instanced draw call.
+		//The shader reads the model matrix from a mat4 attribute at
+		//_TransformLocation instead of a uniform.
+		void EnableInstancing(GLuint _TransformLocation = DefaultInstanceLocation);
+
+		//Pack _Source (_Components floats) per instance, in place of a
+		//per-entity uniform data link
+		void AddInstanceDataLink(DataSource _Source, GLuint _Location, GLint _Components);
+
+		//Set the instanced draw call, given the number of instances.
+		//Defaults to glDrawElementsInstanced over BatchVao's index count
+		void SetInstancedDrawFunction(std::function<void(GLsizei)> _dFunc);
+
+		//Pack and upload the per-instance data of all active batch units
+		//and issue the instanced draw. Shader, VAO and textures must
+		//already be bound. Returns the number of instances drawn
+		GLsizei DrawBatchInstanced();
+
+		//Feed per-entity data through the uniform block _BlockName of the
+		//pass' (compiled) shader instead of per-entity uniforms. Before
+		//drawing, the renderer packs the block of every visible batch unit
+		//into one shared buffer, and the render function binds each unit's
+		//range with BindDrawBlock
+		void EnableDrawBlock(const std::string &_BlockName);
+
+		//Copy _Source (_Size bytes) into block member _Member
+		void AddDrawBlockLink(DataSource _Source, const std::string &_Member, GLint _Size);
+		template<typename T>
+		void AddDrawBlockLink(DataSource _Source, const std::string &_Member) {
+			AddDrawBlockLink(_Source, _Member, static_cast<GLint>(sizeof(T)));
+		}
+
+		bool UsesDrawBlock() const {
+			return drawBlockSize > 0;
+		}
+
+		//Bind the packed block of batch unit _Index, if the pass has one
+		void BindDrawBlock(size_t _Index) const;
+
+		//Binding point shared by the draw blocks of every pass
+		static GLuint DrawBlockBinding();
+
+		//Whether item _Index (batch unit, chunk, attribute...) survived
+		//the last culling stage. Always true for unculled passes and for
+		//items added since
+		bool IsVisible(size_t _Index) const {
+			return _Index >= Visibility.size() || Visibility[_Index];
+		}
+
+		//Default bounds gatherer for batch unit passes, BatchVao's bounds
+		//transformed by each unit's entity
+		static bool GatherBatchBounds(RenderPass &_Pass, SphereList &_Spheres);
 		~RenderPass() {
 			BatchVao.reset();
 			for (auto &t : Textures) {
@@ -97,7 +319,7 @@ namespace GL_Engine {
 				t.reset();
 			}
 		}
-		std::vector<eDataUniLink> dataLink;
+		std::vector<DataUniLink> dataLink;
 		std::vector< std::pair< CG_Data::Uniform *, void * > > uniforms;
 		void* Data;
 		Shader* shader;
@@ -106,68 +328,90 @@ namespace GL_Engine {
 		std::function<void(RenderPass&, void*)> renderFunction;
 		std::function<void(void)> DrawFunction;
 		std::vector<std::shared_ptr<CG_Data::Texture>> Textures;
-	};
+		//Profile scope the pass is drawn under, see CommandBucket::execute
+		std::string name{ "RenderPass" };
+		//Top 4 bits of the pass' sort key, see CommandBucket::SortLayer
+		uint8_t sortLayer{ 0 };
+		//Quantised depth, lowest bits of the pass' sort key
+		uint16_t sortDepth{ 0 };
 
+		bool instanced{ false };
+		GLuint instanceTransformLocation{ DefaultInstanceLocation };
+		std::vector<DataInstanceLink> instanceLinks;
+		std::function<void(GLsizei)> InstancedDrawFunction;
 
+		//Push the world space bounds of each item the pass draws, in draw
+		//order. Return false to leave the pass unculled. Unset means the
+		//pass is never culled
+		std::function<bool(RenderPass&, SphereList&)> GatherBounds;
+		//Per-item visibility for the renderer drawing the pass, written by
+		//its culling stage. Unculled renderers clear it, as a pass may be
+		//shared between renderers
+		std::vector<uint8_t> Visibility;
 
-	class MeshBone {
-	public:
-		MeshBone(const aiBone* _Bone);
-		const glm::mat4 &GetFinalTransform(const glm::mat4 &_GlobalInverse, const glm::mat4& nodeGlobalTransform);
-		glm::mat4 OffsetMatrix;
-		glm::mat4 FinalTransformation;
-		std::string Name;
+		//Name and size of the per-draw block, 0 if the pass has none
+		std::string drawBlockName;
+		GLint drawBlockSize{ 0 };
+		std::vector<DataBlockLink> drawBlockLinks;
+		//Where each batch unit's block was packed by the last Render, -1
+		//for units that are not drawn
+		std::vector<GLintptr> drawBlockOffsets;
+		GLuint drawBlockBuffer{ 0 };
+	private:
+		//Ids of the units drawn this frame (active and visible), in batch
+		//order
+		const std::vector<EntityId> &DrawnEntities();
+
+		std::unique_ptr<CG_Data::VBO> instanceVBO;
+		std::vector<float> instanceData;
+		std::vector<EntityId> drawnEntities;
+		//Gathered data link values, each link's packed for every drawn
+		//unit from linkOffsets[link]
+		std::vector<uint8_t> linkData;
+		std::vector<size_t> linkOffsets;
+		friend class Renderer;
 	};
 
-	class SceneBone {
-	public:
-		SceneBone(const aiBone *_Bone);
-		void AddMeshBone(std::shared_ptr<MeshBone> _mBone);
-		void UpdateBone(const glm::mat4 &GlobalInverse, const glm::mat4 &_GlobalTransform);
-		glm::mat4 GlobalTransformation{ 1.0f };
-		std::string Name;
-		std::vector<std::shared_ptr<MeshBone>> meshBones;
+
+
+	//Largest error compressing a NodeAnimation's tracks may add, in model
+	//units for positions, radians for rotations, and scale
+	struct AnimationCompression {
+		float PositionTolerance{ 1e-3f };
+		float RotationTolerance{ 1e-3f };
+		float ScalingTolerance{ 1e-4f };
 	};
 
 	class NodeAnimation {
 	public:
+		//Key last sampled from, kept per playing instance
+		struct Cursor {
+			uint32_t Key{ 0 };
+		};
 		std::string Name;
-		std::vector<std::pair<glm::vec3, double>> Positions, Scalings;
-		std::vector < std::pair < glm::quat, double>> Rotations;
+		//Key times shared by the three tracks
+		KeyTimes Times;
+		CompressedTrack<glm::vec3> Positions, Scalings;
+		CompressedTrack<glm::quat> Rotations;
 		double AnimationLength;
-		NodeAnimation(const aiNodeAnim *animNode, double _Length);
+		//The node's keys are resampled at the finest key spacing of its
+		//tracks, then compressed onto key times chosen for all three (see
+		//KeyTimes, CompressedTrack). Tracks that could not be kept within
+		//tolerance are reported on stderr
+		NodeAnimation(const aiNodeAnim *animNode, double _Length,
+					  const AnimationCompression &_Compression = AnimationCompression());
+		//Bytes held by the tracks
+		size_t GetMemoryUsage() const;
+		//Local transform at _Time, translate * rotate * scale. Empty
+		//tracks leave their part as the identity
+		glm::mat4 Sample(float _Time, Cursor &_Cursor) const;
+		//The parts of the local transform at _Time, for blending
+		void Sample(float _Time, Cursor &_Cursor, glm::vec3 &_Translation,
+					glm::quat &_Rotation, glm::vec3 &_Scale) const;
 	};
 
-	class SceneNode {
-		public:
-			SceneNode(const aiNode* _node);
-			void Update(const glm::mat4 &ParentTransform, const glm::mat4 &GlobalInverse, unsigned int AnimationID, double Time);
-			void AddChild(std::shared_ptr<SceneNode> _node);
-			void Update(const glm::mat4 &ParentTransform, const glm::mat4 &GlobalInverse);
-			std::shared_ptr<SceneBone> sceneBone;
-			std::vector<std::shared_ptr<SceneNode>> ChildNodes;
-			std::shared_ptr<NodeAnimation> Animation{ nullptr };
-			glm::mat4 NodeTransform, GlobalTransform;
-			std::string Name;
-	private:
-		static glm::mat4 GetInterpolatedScale(std::vector<std::pair<glm::vec3, double>> Scalings, double time);
-		static glm::mat4 GetInterpolatedTranslate(std::vector<std::pair<glm::vec3, double>> Translations, double time);
-		static glm::mat4 GetInterpolatedRotate(std::vector<std::pair<glm::quat, double>> Rotations, double time);
-	};
-
-	class Skeleton {
-	public:
-		Skeleton(std::shared_ptr<SceneNode> _Root, std::map<std::string, std::shared_ptr<SceneNode>> SkeletonNodeMap);
-		std::shared_ptr<SceneNode> rootNode;
-		void Update();
-		void Update(unsigned int AnimationID, double Time);
-		glm::mat4 GlobalInverseMatrix;
-		std::map<std::string, std::shared_ptr<SceneNode>> NodeMap;
-	protected:
-		
-	private:
-		
-	};
+	class Skeleton;
+	class BlendTree;
 
 	/*-------------ModelAttribute Class------------*/
 	/*
@@ -184,8 +428,6 @@ namespace GL_Engine {
 		void AddTexture(std::shared_ptr<CG_Data::Texture> _Texture);
 		std::vector<std::shared_ptr<CG_Data::Texture>> ModelTextures;
 		std::vector<std::string> BoneNames;
-		std::vector<std::shared_ptr<MeshBone>> meshBones;
-		std::map<std::string, unsigned int> BoneIndex;
 		const std::string getName() const;
 	private:
 		uint64_t VertexCount = 0;
@@ -193,22 +435,43 @@ namespace GL_Engine {
 	};
 	using ModelAttribList = std::vector<std::shared_ptr<ModelAttribute>>;
 
-	//Shader can take max 5 bones. Weight is 0 if bone not used
+	//Shader can take max 5 bones. Weight is 0 if bone not used.
+	//Mesh a is skinned by palette a of the rig
 	class RiggedModel : public Entity {
 	public:
 		RiggedModel(std::unique_ptr<Skeleton> _Rig, ModelAttribList &&_AttributeList);
 		~RiggedModel();
 		std::unique_ptr<RenderPass> GenerateRenderpass(Shader* _Shader);
+		//Pose the rig in its bind pose, now
 		void Update();
+		//Pose the rig at Time on the AnimationSystem's next batch, drawn
+		//from the next frame on. Its LOD tier is chosen by the model's
+		//bind pose bounds
 		void Update(unsigned int AnimationID, double Time);
+		//As above, posed through Tree, which must not change until the
+		//frame ends (see BlendTree)
+		void Update(const BlendTree &Tree, double Time);
 		Skeleton *GetRig() const;
+		//Parent _Child to the bone node _BoneName, following its animation.
+		//Throws std::runtime_error if the rig has no such node
+		void AttachToBone(Entity &_Child, const std::string &_BoneName);
+		void AttachToBone(Entity &_Child, NameId _BoneName);
 	protected:
 		Entity ModelEntity;
 		std::unique_ptr<Skeleton> ModelRig;
-		glm::mat4 GlobalInverseTransform;
+		BoundingVolume LocalBounds;
+		//World space sphere of LocalBounds, for the animation LOD
+		glm::vec4 GetAnimationBounds();
 
 	private:
+		//Per render pass data, the model plus the pass' shader locations
+		struct RiggedPassData {
+			RiggedModel *model;
+			CG_Data::UniformBinder<glm::mat4> modelMatrix, boneMatrices;
+		};
+		std::vector<std::unique_ptr<RiggedPassData>> passData;
 		static void RiggedModelRenderer(RenderPass &_Pass, void* _Data);
+		static bool GatherAttributeBounds(RenderPass &_Pass, SphereList &_Spheres);
 		ModelAttribList ModelAttributes;
 	};
 
@@ -0,0 +1,102 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <memory_resource>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace GL_Engine {
+
+    /*-------------FrameArena Class------------*/
+    /*
+    *Bump allocator for data that only lives until the end of the frame.
+    *Allocation is a pointer increment, deallocation is a no-op, and
+    *everything is released at once by reset(), called from
+    *CG_Engine::EndFrame(). Blocks are kept across frames, and coalesced
+    *into one block after a frame that needed more than one, so a steady
+    *state frame makes no heap allocations at all.
+    *
+    *Derives from std::pmr::memory_resource, so std::pmr containers can
+    *draw from it directly, e.g. FrameVector< glm::mat4 > v( &arena ).
+    *Not thread safe.
+    */
+    class FrameArena : public std::pmr::memory_resource {
+    public:
+        static constexpr size_t DefaultBlockSize = 1 << 20;
+
+        struct Statistics {
+            // Bytes handed out, and the arena's capacity
+            size_t bytesAllocated{ 0 };
+            size_t capacity{ 0 };
+            // Blocks the arena had to take from the heap
+            uint64_t blockAllocations{ 0 };
+            // Global operator new calls over the frame. Only counted when
+            // built with CG_ENGINE_TRACK_ALLOCATIONS, 0 otherwise
+            uint64_t heapAllocations{ 0 };
+        };
+
+        // Position in the arena, to release a scope's allocations early
+        struct Marker {
+            size_t block, offset;
+        };
+
+        explicit FrameArena( size_t _blockSize = DefaultBlockSize );
+        ~FrameArena();
+        FrameArena( const FrameArena & ) = delete;
+        FrameArena & operator=( const FrameArena & ) = delete;
+
+        template< typename T >
+        T * allocateArray( size_t _count ){
+            return static_cast< T * >( this->allocate( _count * sizeof( T ),
+                                                       alignof( T ) ) );
+        }
+
+        Marker getMarker() const;
+        // Release everything allocated since _marker was taken
+        void rewind( const Marker & _marker );
+
+        // Release all allocations and close the frame's statistics
+        void reset();
+
+        // Statistics of the last completed frame, and of the current one
+        const Statistics & getStatistics() const;
+        const Statistics & getCurrentStatistics() const;
+        size_t getPeakBytes() const;
+
+        // The engine-wide per-frame arena
+        static FrameArena & get();
+
+        // Global operator new calls since startup (tracking builds only)
+        static uint64_t getHeapAllocationCount();
+        static bool isTrackingHeapAllocations();
+
+    private:
+        void * do_allocate( size_t _bytes, size_t _alignment ) override;
+        void do_deallocate( void * _p, size_t _bytes,
+                            size_t _alignment ) override;
+        bool do_is_equal( const std::pmr::memory_resource & _other )
+            const noexcept override;
+
+        void addBlock( size_t _size );
+
+        struct Block {
+            std::unique_ptr< std::byte[] > data;
+            size_t size;
+        };
+
+        std::vector< Block > blocks;
+        size_t blockSize;
+        size_t currentBlock{ 0 }, offset{ 0 };
+        size_t peakBytes{ 0 };
+        uint64_t frameStartHeapAllocations{ 0 };
+        Statistics frameStatistics, lastFrameStatistics;
+    };
+
+    template< typename T >
+    using FrameVector = std::pmr::vector< T >;
+
+}
+
+#endif // FRAME_ARENA_H
@@ -0,0 +1,90 @@
+#ifndef GL_BACKEND_H
+#define GL_BACKEND_H
+
+#include "Common.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace GL_Engine {
+	namespace CG_Data {
+
+		/*-------------GLBackend Class------------*/
+		/*
+		*Selects where the engine's GL calls go. By default they go to the
+		*driver glad loaded. UseRecording swaps glad's function pointers for
+		*a recording backend that needs neither a context nor a GPU, so the
+		*CPU cost of submission can be measured on headless hosts:
+		*   - object names are handed out deterministically, shader status
+		*     queries succeed and mapped buffers point at host memory
+		*   - uniforms and std140 uniform blocks are reflected from the
+		*     shader sources, so Shader and the draw block work unchanged
+		*   - draws, binds, state changes and uploaded bytes are counted,
+		*     and the size of every buffer, texture and renderbuffer is kept
+		*   - with capture on, every call and its arguments are appended to
+		*     a command stream which can be dumped and diffed between runs
+		*
+		*Only the entry points the engine uses are recorded, calling any
+		*other while recording is an error.
+		*/
+		class GLBackend {
+		public:
+			static constexpr unsigned int MaxCommandArgs = 10;
+
+			struct Command {
+				const char *name;
+				uint8_t argCount;
+				//Pointer arguments are recorded as offsets, and only if GL
+				//reads them as such (attribute pointers, index offsets)
+				double args[MaxCommandArgs];
+			};
+
+			struct Statistics {
+				uint64_t calls{ 0 };
+				uint64_t drawCalls{ 0 };
+				uint64_t instances{ 0 };
+				//Indices or vertices submitted, over all instances
+				uint64_t vertices{ 0 };
+				uint64_t clears{ 0 };
+				uint64_t bufferBinds{ 0 };
+				uint64_t textureBinds{ 0 };
+				uint64_t framebufferBinds{ 0 };
+				uint64_t programBinds{ 0 };
+				uint64_t vertexArrayBinds{ 0 };
+				//Fixed function state, active texture unit and draw buffers
+				uint64_t stateChanges{ 0 };
+				uint64_t uniformUploads{ 0 };
+				uint64_t uniformBytes{ 0 };
+				//Buffer and texture data, including writes through mappings
+				uint64_t bytesUploaded{ 0 };
+			};
+
+			//Route GL calls to the recording backend, or back to the driver.
+			//Objects created under one backend must not be used with the other
+			static void UseRecording();
+			static void UseDriver();
+			static bool IsRecording();
+
+			//Keep the command stream (off by default, it costs memory)
+			static void SetCapture(bool _Capture);
+
+			//Clear the statistics and command stream, objects are kept
+			static void Reset();
+
+			static const Statistics &GetStatistics();
+			static const std::vector<Command> &GetCommands();
+			//One call per line, as name(arg, ...)
+			static void DumpCommands(std::ostream &_Stream);
+
+			//Storage size of a live object, 0 if unknown
+			static uint64_t GetBufferSize(GLuint _Buffer);
+			static uint64_t GetTextureSize(GLuint _Texture);
+			static uint64_t GetRenderbufferSize(GLuint _Renderbuffer);
+			//Storage of all live buffers, textures and renderbuffers
+			static uint64_t GetResidentBytes();
+		};
+
+	}
+}
+
+#endif // GL_BACKEND_H
@@ -0,0 +1,107 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include "Common.h"
+#include <cstdint>
+#include <unordered_map>
+
+namespace GL_Engine {
+	namespace CG_Data {
+
+		/*-------------StateCache Class------------*/
+		/*
+		*Shadows the GL context state that the CG_Data wrappers touch, so
+		*binds that would not change anything are never sent to the driver.
+		*All state starts as "unknown", so the first call for any binding is
+		*always issued. Call invalidate() after handing the context to code
+		*that talks to GL directly.
+		*/
+		class StateCache {
+		public:
+			struct Statistics {
+				uint64_t issued{ 0 };
+				uint64_t filtered{ 0 };
+			};
+
+			// Programs, VAOs and framebuffers
+			static void useProgram( GLuint _program );
+			static void bindVertexArray( GLuint _vao );
+			static void bindFramebuffer( GLuint _fbo );
+
+			// Textures. _unit is the GLenum unit, i.e. GL_TEXTURE0 + n.
+			// A filtered bind leaves the active unit untouched, so only
+			// upload to a texture straight after binding it if it is new
+			static void activeTexture( GLenum _unit );
+			static void bindTexture( GLenum _unit, GLenum _target, GLuint _id );
+			static void bindTexture( GLenum _target, GLuint _id );
+
+			// Uniform blocks
+			static void uniformBlockBinding( GLuint _program, GLuint _blockIndex,
+											 GLuint _binding );
+			static void bindBufferBase( GLenum _target, GLuint _index,
+										GLuint _buffer );
+			static void bindBufferRange( GLenum _target, GLuint _index,
+										 GLuint _buffer, GLintptr _offset,
+										 GLsizeiptr _size );
+
+			// Fixed function state
+			static void enable( GLenum _cap );
+			static void disable( GLenum _cap );
+			static void setCapability( GLenum _cap, bool _enabled );
+			static void blendFunc( GLenum _src, GLenum _dst );
+			static void depthFunc( GLenum _func );
+			static void cullFace( GLenum _mode );
+
+			// Notify the cache of deleted objects, so a recycled name is
+			// never mistaken for the current binding
+			static void programDeleted( GLuint _program );
+			static void vertexArrayDeleted( GLuint _vao );
+			static void framebufferDeleted( GLuint _fbo );
+			static void textureDeleted( GLuint _id );
+
+			static GLuint getProgram();
+			static GLuint getVertexArray();
+			static GLuint getFramebuffer();
+			static GLenum getActiveTexture();
+
+			// Forget all shadowed state
+			static void invalidate();
+
+			static const Statistics & getStatistics();
+			static void resetStatistics();
+
+		private:
+			static constexpr GLuint Unknown = static_cast< GLuint >( -1 );
+			static constexpr unsigned int MaxTextureUnits = 32;
+			static constexpr unsigned int MaxUniformBuffers = 64;
+
+			struct TextureUnit {
+				GLenum target{ Unknown };
+				GLuint id{ Unknown };
+			};
+
+			// A size of WholeBuffer marks a glBindBufferBase binding
+			static constexpr GLsizeiptr WholeBuffer = -1;
+			struct BufferBinding {
+				GLuint buffer{ Unknown };
+				GLintptr offset{ 0 };
+				GLsizeiptr size{ WholeBuffer };
+			};
+
+			// Returns true if the call should be issued
+			static bool record( bool _changed );
+
+			static GLuint program, vertexArray, framebuffer;
+			static GLenum activeUnit;
+			static TextureUnit textureUnits[ MaxTextureUnits ];
+			static BufferBinding uniformBuffers[ MaxUniformBuffers ];
+			static GLenum blendSrc, blendDst, depthFunction, cullMode;
+			static std::unordered_map< GLenum, bool > capabilities;
+			static std::unordered_map< uint64_t, GLuint > blockBindings;
+			static Statistics statistics;
+		};
+
+	}
+}
+
+#endif // GL_STATE_H
@@ -0,0 +1,138 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace GL_Engine {
+
+    /*-------------JobSystem Class------------*/
+    /*
+    *A work-stealing thread pool. Each worker owns a deque: it runs its own
+    *jobs newest first and, once out of work, steals the oldest job of
+    *another worker. Jobs scheduled from outside the pool are dealt round
+    *robin to the workers.
+    *
+    *A thread waiting on a Counter runs queued jobs rather than block, so
+    *jobs may fork and join recursively, and a pool without workers still
+    *completes its jobs on the waiting thread.
+    *
+    *Jobs must not throw, touch the GL context or use the Profiler. Work
+    *for the GL thread goes through runOnMainThread, and is run by
+    *CG_Engine::EndFrame.
+    */
+    class JobSystem {
+    public:
+        using Job = std::function< void() >;
+
+        // Jobs outstanding, see wait()
+        class Counter {
+        public:
+            bool isDone() const {
+                return pending.load( std::memory_order_acquire ) == 0;
+            }
+        private:
+            friend class JobSystem;
+            std::atomic< uint32_t > pending{ 0 };
+        };
+
+        explicit JobSystem( uint32_t _workers );
+        ~JobSystem();
+        JobSystem( const JobSystem & ) = delete;
+        JobSystem & operator=( const JobSystem & ) = delete;
+
+        // Queue _job, counted by _counter if set
+        void schedule( Job _job, Counter * _counter = nullptr );
+        // Run jobs until every job counted by _counter has finished
+        void wait( const Counter & _counter );
+
+        // Call _body( begin, end ) over [ _begin, _end ) in ranges of
+        // _grain items (0 picks one), on the pool and the calling thread,
+        // and return once all ranges are done
+        void parallelFor( size_t _begin, size_t _end, size_t _grain,
+                          const std::function< void( size_t, size_t ) > & _body );
+
+        // Queue _job for the GL thread, from any thread
+        void runOnMainThread( Job _job );
+        // Run the queued main thread jobs, returning how many ran. Jobs
+        // queued meanwhile wait for the next call
+        size_t runMainThreadJobs();
+
+        uint32_t getWorkerCount() const;
+
+        // The engine-wide pool, one worker per hardware thread besides
+        // the main thread
+        static JobSystem & get();
+
+    private:
+        struct Entry {
+            Job job;
+            Counter * counter;
+        };
+        struct Worker {
+            std::mutex mutex;
+            std::deque< Entry > jobs;
+            std::thread thread;
+        };
+
+        void workerLoop( uint32_t _index );
+        // Pop a job of the calling worker, or steal one
+        bool take( Entry & _entry );
+        bool steal( Entry & _entry, uint32_t _first );
+        static void run( Entry & _entry );
+
+        std::vector< std::unique_ptr< Worker > > workers;
+        // Deque for jobs scheduled while the pool has no workers
+        Worker overflow;
+        std::atomic< uint32_t > nextWorker{ 0 };
+        std::atomic< size_t > queued{ 0 };
+        std::atomic< bool > running{ true };
+        std::mutex sleepMutex;
+        std::condition_variable sleepCondition;
+
+        std::mutex mainThreadMutex;
+        std::vector< Job > mainThreadJobs;
+    };
+
+    /*-------------TaskGraph Class------------*/
+    /*
+    *Jobs with dependencies. run() schedules each task once all of its
+    *predecessors have finished, and returns when the whole graph has.
+    *A graph may be run any number of times.
+    */
+    class TaskGraph {
+    public:
+        using TaskId = uint32_t;
+
+        TaskId add( JobSystem::Job _job );
+        // _after starts only once _before has finished
+        void precede( TaskId _before, TaskId _after );
+
+        // Throws std::runtime_error if the dependencies form a cycle
+        void run( JobSystem & _jobs = JobSystem::get() );
+
+        size_t size() const;
+
+    private:
+        struct Task {
+            JobSystem::Job job;
+            std::vector< TaskId > successors;
+            uint32_t dependencies{ 0 };
+            std::atomic< uint32_t > remaining{ 0 };
+        };
+
+        void schedule( JobSystem & _jobs, TaskId _task, JobSystem::Counter & _counter );
+
+        std::deque< Task > tasks;
+    };
+
+}
+
+#endif // JOB_SYSTEM_H
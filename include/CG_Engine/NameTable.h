@@ -0,0 +1,43 @@
+#ifndef NAME_TABLE_H
+#define NAME_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace GL_Engine {
+
+    using NameId = uint32_t;
+
+    /*-------------NameTable Class------------*/
+    /*
+    *Interns strings as small integer ids, so names loaded with assets
+    *(node and bone names) are compared and stored as integers once
+    *loading is done. An id stays valid, and maps to the same string, for
+    *the life of the table. Thread safe.
+    */
+    class NameTable {
+    public:
+        static constexpr NameId InvalidName = UINT32_MAX;
+
+        // The id of _name, added if new
+        NameId intern( const std::string & _name );
+        // The id of _name, or InvalidName if it was never interned
+        NameId find( const std::string & _name ) const;
+        const std::string & getName( NameId _id ) const;
+
+        // The engine-wide table
+        static NameTable & get();
+
+    private:
+        mutable std::mutex mutex;
+        std::unordered_map< std::string, NameId > ids;
+        // Deque, so references to names survive later insertions
+        std::deque< std::string > names;
+    };
+
+}
+
+#endif // NAME_TABLE_H
@@ -4,6 +4,13 @@
 #include "Renderer.h"
 
 namespace GL_Engine {
+	//Per-emitter data, read by the particle pass' draw block
+	struct ParticleEmitter {
+		glm::vec3 Position{ 0.0f };
+		glm::vec3 Direction{ 0.0f, 0.0f, 1.0f };
+		float Time{ 0.0f };
+	};
+
 	class ParticleSystem : public Entity
 	{
 	public:
@@ -23,17 +30,18 @@ namespace GL_Engine {
 		std::unique_ptr<RenderPass> GenerateParticleSystem(const ParticleStats &stats, std::shared_ptr< CG_Data::UBO > _CameraUBO);
 		void UpdateTime(const float &_Diff);
 		void SetTime(const float &_CurrentTime);
-		const float& GetTime() const;
+		float GetTime() const;
 
 	private:
 		static void ParticleRenderer(RenderPass &_Pass, void *_Data);
+		//Copy the emitter's transform into its ParticleEmitter
+		void UpdateEmitter();
 		static const std::string ParticleSystemFSource;
 		static const std::string ParticleSystemVSource;
 		uint32_t ParticleCount;
 		std::shared_ptr< CG_Data::UBO > cameraUBO;
 		std::unique_ptr<Shader> ParticleShader;
 		std::shared_ptr<CG_Data::VAO> ParticleVAO;
-		float Time;
 	};
 
 }
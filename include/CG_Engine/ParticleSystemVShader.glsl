@@ -18,10 +18,14 @@ in vec3 Colour;
 in float Opacity;
 in float Lifetime;
 
-uniform float CurrentTime;
-uniform vec3 EmitterPosition;
-uniform vec3 EmitterDirection;
-uniform mat4 model;
+// Per-emitter data, packed by the renderer
+layout (std140) uniform EmitterData
+{
+  mat4 model;
+  vec3 EmitterPosition;
+  float CurrentTime;
+  vec3 EmitterDirection;
+};
 uniform vec3 Gravity;
 
 out float PassTime;
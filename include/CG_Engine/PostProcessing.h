@@ -2,6 +2,7 @@
 
 #include "CG_Data.h"
 #include "Shader.h"
+#include "RenderGraph.h"
 #include <sstream>
 #include <glm/vec2.hpp>
 namespace GL_Engine {
@@ -19,9 +20,15 @@ namespace GL_Engine {
 		std::shared_ptr<CG_Data::Texture> Compile(std::shared_ptr<CG_Data::Texture> _TextureInput, uint16_t _Width, uint16_t _Height);
 		const std::shared_ptr<CG_Data::Texture> GetOutputTexture() const;
 		void Process();
+		// Schedule the processing in a frame graph, in place of calling
+		// Process(). The output texture is marked as a frame output
+		void AddPasses(RenderGraph &_Graph);
 		const CG_Data::FBO *GetFBO() const;
 
 	private:
+		// Clear and draw into the bound framebuffer
+		void Draw();
+
 		std::unique_ptr<CG_Data::FBO> ProcessingFBO;
 		std::shared_ptr<CG_Data::Texture> OutputColourBuffer, InputTexture;
 		Shader shader;
@@ -30,6 +37,7 @@ namespace GL_Engine {
 		std::string AttachmentStringComponents[2];
 		std::map<PostprocessingAttachment, std::string> uniforms;
 		glm::vec2 Resolution;
+		CG_Data::UniformBinder<glm::vec2> ResolutionBinder;
 		std::string VertexShader = {
 				#include "PostprocessingV.glsl" 
 		};
@@ -0,0 +1,161 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "Common.h"
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace GL_Engine {
+
+    /*-------------Profiler Class------------*/
+    /*
+    *Hierarchical frame profiler. Scopes (see CG_PROFILE_SCOPE) record
+    *their CPU time with steady_clock and, with GPU timing on, bracket
+    *their GL commands with GL_TIMESTAMP queries. Timestamps rather than
+    *GL_TIME_ELAPSED, as elapsed-time queries cannot nest. Query objects
+    *come from CG_Data::QueryPool.
+    *
+    *endFrame(), called from CG_Engine::EndFrame(), closes the frame. GPU
+    *results are read back GpuLatency frames later, and only once
+    *available, so profiling never stalls the pipeline; frames whose
+    *results are still missing after MaxPendingFrames lose their GPU
+    *times instead. Completed frames are kept for HistoryFrames frames and
+    *can be written out as Chrome trace-event JSON (chrome://tracing,
+    *Perfetto).
+    *
+    *Disabled by default, a disabled scope costs one branch. Main thread
+    *only.
+    */
+    class Profiler {
+    public:
+        static constexpr uint32_t InvalidEvent = UINT32_MAX;
+        static constexpr uint64_t GpuLatency = 3;
+        static constexpr size_t MaxPendingFrames = 8;
+        static constexpr size_t HistoryFrames = 300;
+
+        struct Event {
+            const char * name;
+            // Scopes open when this one began
+            uint16_t depth;
+            // Nanoseconds since the profiler was created
+            int64_t cpuBegin, cpuEnd;
+            // GPU execution on the same timeline, -1 when not measured
+            int64_t gpuBegin{ -1 }, gpuEnd{ -1 };
+        };
+
+        struct Frame {
+            uint64_t index{ 0 };
+            int64_t cpuBegin{ 0 }, cpuEnd{ 0 };
+            std::vector< Event > events;
+            bool gpuResolved{ false };
+        };
+
+        // Per scope name totals over a frame
+        struct Summary {
+            const char * name;
+            uint32_t calls;
+            double cpuMilliseconds, gpuMilliseconds;
+        };
+
+        Profiler();
+        ~Profiler() = default;
+        Profiler( const Profiler & ) = delete;
+        Profiler & operator=( const Profiler & ) = delete;
+
+        void setEnabled( bool _enabled );
+        bool isEnabled() const;
+        // Also time scopes on the GPU (needs a GL context)
+        void setGpuTiming( bool _gpuTiming );
+        bool isGpuTiming() const;
+
+        // _name must outlive the profiler's history, e.g. a literal. Use
+        // the std::string overload for anything else
+        uint32_t begin( const char * _name );
+        uint32_t begin( const std::string & _name );
+        void end( uint32_t _event );
+
+        // Close the current frame and collect finished GPU results
+        void endFrame();
+
+        // Completed frames, oldest first
+        const std::deque< Frame > & getFrames() const;
+        // The newest completed frame, null if none
+        const Frame * getLatestFrame() const;
+        static std::vector< Summary > summarise( const Frame & _frame );
+
+        // Completed frames as Chrome trace-event JSON
+        void writeChromeTrace( std::ostream & _stream ) const;
+        bool saveChromeTrace( const std::string & _path ) const;
+
+        // Drop all recorded frames
+        void clear();
+
+        // The engine-wide profiler
+        static Profiler & get();
+
+    private:
+        struct PendingFrame {
+            Frame frame;
+            // GPU time minus CPU time when the frame ended
+            int64_t gpuOffset;
+            // Begin and end query of each event, 0 if not issued
+            std::vector< GLuint > queries;
+            // Issued last, so available last
+            GLuint lastQuery;
+        };
+
+        int64_t now() const;
+        GLuint acquireQuery();
+        void releaseQueries( const std::vector< GLuint > & _queries );
+        void resolvePendingFrames();
+        void pushHistory( Frame && _frame );
+
+        bool enabled{ false };
+        bool gpuTiming{ false };
+        uint16_t openEvents{ 0 };
+        int64_t epoch;
+        // Event handles are eventBase + index into the current frame
+        uint32_t eventBase{ 0 };
+        uint64_t frameIndex{ 0 };
+        GLuint lastQuery{ 0 };
+
+        Frame current;
+        std::vector< GLuint > currentQueries;
+        std::deque< PendingFrame > pending;
+        std::deque< Frame > history;
+        std::unordered_set< std::string > names;
+    };
+
+    /*-------------ProfileScope Class------------*/
+    /*
+    *RAII profiler marker, see CG_PROFILE_SCOPE.
+    */
+    class ProfileScope {
+    public:
+        explicit ProfileScope( const char * _name )
+            : event( Profiler::get().begin( _name ) ){}
+        explicit ProfileScope( const std::string & _name )
+            : event( Profiler::get().begin( _name ) ){}
+        ~ProfileScope(){
+            Profiler::get().end( event );
+        }
+        ProfileScope( const ProfileScope & ) = delete;
+        ProfileScope & operator=( const ProfileScope & ) = delete;
+
+    private:
+        uint32_t event;
+    };
+
+}
+
+#define CG_PROFILE_CONCAT_( a, b ) a##b
+#define CG_PROFILE_CONCAT( a, b ) CG_PROFILE_CONCAT_( a, b )
+// Profile the rest of the enclosing scope under _name
+#define CG_PROFILE_SCOPE( _name ) \
+    GL_Engine::ProfileScope CG_PROFILE_CONCAT( cgProfileScope, __LINE__ )( _name )
+
+#endif // PROFILER_H
@@ -3,6 +3,8 @@
 
 #include "Camera.h"
 #include "Renderer.h"
+#include "RenderGraph.h"
+#include "QueryPool.h"
 
 namespace GL_Engine {
 
@@ -11,9 +13,12 @@ namespace GL_Engine {
     public:
         ProjectionMapping(uint16_t _fbWidth, uint16_t _fbHeight, glm::vec3 _dir, const std::shared_ptr< CG_Data::UBO > ubo);
 
-        std::shared_ptr< RenderPass > addRenderPass(uint16_t _modelMatrixIdx = -1);
+        // Default pass, feeding modelMatrix from _modelMatrix
+        std::shared_ptr< RenderPass > addRenderPass(DataSource _modelMatrix = DataSource::WorldMatrix());
         std::shared_ptr< RenderPass > addRenderPass(Shader* _shader);
         void addRenderPass(std::shared_ptr< RenderPass > _renderPass);
+        // Pass drawing its batch units with one instanced draw call
+        std::shared_ptr< RenderPass > addInstancedRenderPass();
 
         enum ProjectionMapType {
             ShadowMap, CausticMap
@@ -23,14 +28,20 @@ namespace GL_Engine {
         std::shared_ptr< Renderer > getRenderer();
 
         void render(Renderer* renderer);
+        // Schedule the shadow map render in a frame graph, in place of
+        // calling render(). The map is marked as a frame output
+        void addPasses(RenderGraph& _graph);
         Camera mappingCamera;
 
     private:
+        // Clear and render into the bound framebuffer
+        void renderMap();
+
         std::shared_ptr< Renderer > renderer;
         std::unordered_map< ProjectionMapType,
             std::shared_ptr< CG_Data::Texture > > textureMaps;
 
-        Shader defaultShader;
+        Shader defaultShader, defaultInstancedShader;
 
         static void defaultRenderFunction(RenderPass& _pass, void* _data);
 
@@ -52,19 +63,27 @@ namespace GL_Engine {
 
         // Functions for receiver-object render passes
         std::shared_ptr< RenderPass >
-            addReceiverPass(uint16_t _modelMatrixIdx = -1);
+            addReceiverPass(DataSource _modelMatrix = DataSource::WorldMatrix());
         std::shared_ptr< RenderPass > addReceiverPass(Shader* shader);
         void addReceiverPass(std::shared_ptr< RenderPass > _renderPass);
 
         // Functions for caustic-object render passes
-        std::shared_ptr< RenderPass > addCausticPass(uint16_t _modelMatrixIdx = -1);
+        std::shared_ptr< RenderPass > addCausticPass(DataSource _modelMatrix = DataSource::WorldMatrix());
         std::shared_ptr< RenderPass > addCausticPass(Shader* shader);
         void addCausticPass(std::shared_ptr< RenderPass > _renderPass);
 
+        // Passes drawing their batch units with one instanced draw call
+        std::shared_ptr< RenderPass > addInstancedReceiverPass();
+        std::shared_ptr< RenderPass > addInstancedCausticPass();
+
 
         std::shared_ptr< Renderer > getRenderer();
 
         void render(std::shared_ptr< Camera > _sceneCam);
+        // Schedule the receiver and caustic renders in a frame graph, in
+        // place of calling render(). The caustic and depth textures are
+        // marked as frame outputs
+        void addPasses(RenderGraph& _graph, std::shared_ptr< Camera > _sceneCam);
         Camera mappingCamera;
         enum TextureType {
             ReceiverWorldspaceTexture, CausticSplatterTexture, CausticDepthTexture
@@ -78,6 +97,7 @@ namespace GL_Engine {
             std::shared_ptr< CG_Data::Texture > > textureMaps;
 
         Shader defaultShader, defaultCausticShader;
+        Shader defaultInstancedShader, defaultInstancedCausticShader;
 
         static void defaultRenderFunction(RenderPass& _pass, void* _data);
         static void defaultCausticRenderFunction(RenderPass& _pass, void* _data);
@@ -86,6 +106,10 @@ namespace GL_Engine {
 
         void updateProjectionCamera(std::shared_ptr< Camera > _sceneCamera);
 
+        // Clear and render each stage into the bound framebuffer
+        void renderReceivers();
+        void renderCaustics();
+
 
         glm::vec3 direction;
         uint16_t fbWidth, fbHeight;
@@ -95,7 +119,9 @@ namespace GL_Engine {
         // These may be merged later
         std::unique_ptr< CG_Data::FBO > receiverFbo, causticFbo;
 
+        // Samples the caustic splatter covers, read back a few frames late
         uint32_t surfaceArea;
+        CG_Data::QueryPool::AsyncQuery samplesQuery{ GL_SAMPLES_PASSED };
         float distance;
 
     };
@@ -16,6 +16,12 @@ namespace GL_Engine {
 			bool			fullscreen;
 		};
 
+		struct HeadlessProperties {
+			//Size of the offscreen framebuffer standing in for the window
+			uint32_t		width;
+			uint32_t		height;
+		};
+
 		struct GLADproperties {
 			bool	success;
 		};
@@ -0,0 +1,102 @@
+#ifndef QUERY_POOL_H
+#define QUERY_POOL_H
+
+#include "Common.h"
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace GL_Engine {
+	namespace CG_Data {
+
+		/*-------------QueryPool Class------------*/
+		/*
+		*Recycles GL query objects, so that per-frame queries cost no
+		*glGenQueries/glDeleteQueries, and reads their results back without
+		*stalling: an AsyncQuery keeps the queries it issued in flight and
+		*only reads one once GL reports its result available, typically a
+		*few frames later. Consumers use the latest result available.
+		*/
+		class QueryPool {
+		public:
+			class AsyncQuery {
+			public:
+				//Frames of queries kept in flight. While that many are
+				//unanswered, Begin/End are skipped rather than stall
+				static constexpr size_t MaxInFlight = 8;
+
+				//_Target is an occlusion, primitive or GL_TIME_ELAPSED target
+				explicit AsyncQuery(GLenum _Target);
+				~AsyncQuery();
+				AsyncQuery(const AsyncQuery&) = delete;
+				AsyncQuery &operator=(const AsyncQuery&) = delete;
+
+				void Begin();
+				void End();
+
+				//Read back whichever results are available, never blocks.
+				//Called for every query by QueryPool::EndFrame
+				void Poll();
+
+				bool HasResult() const;
+				//Latest result read back, 0 before the first
+				GLuint64 GetResult() const;
+				//Frames between issuing the latest result and reading it
+				uint64_t GetResultLatency() const;
+
+			private:
+				struct InFlight {
+					GLuint query;
+					uint64_t frame;
+				};
+
+				GLenum Target;
+				GLuint Active{ 0 };
+				std::deque<InFlight> Queries;
+				bool Resolved{ false };
+				GLuint64 Result{ 0 };
+				uint64_t Latency{ 0 };
+			};
+
+			struct Statistics {
+				//Query objects created, and those waiting for reuse
+				uint64_t created{ 0 };
+				uint64_t free{ 0 };
+				//Results read back, and issues skipped with too many in flight
+				uint64_t results{ 0 };
+				uint64_t skipped{ 0 };
+			};
+
+			QueryPool() = default;
+			~QueryPool();
+			QueryPool(const QueryPool&) = delete;
+			QueryPool &operator=(const QueryPool&) = delete;
+
+			//A query object for _Target. Objects are only reused for the
+			//target they were first used with, as GL binds a query's type on
+			//its first glBeginQuery/glQueryCounter
+			GLuint Acquire(GLenum _Target);
+			void Release(GLenum _Target, GLuint _Query);
+
+			//Poll every AsyncQuery and advance the frame, called from
+			//CG_Engine::EndFrame
+			void EndFrame();
+			uint64_t GetFrame() const;
+			const Statistics &GetStatistics() const;
+
+			//The engine-wide pool
+			static QueryPool &Get();
+
+		private:
+			//Free objects per target
+			std::unordered_map<GLenum, std::vector<GLuint>> Free;
+			std::vector<AsyncQuery*> AsyncQueries;
+			uint64_t Frame{ 0 };
+			Statistics Stats;
+		};
+
+	}
+}
+
+#endif // QUERY_POOL_H
@@ -0,0 +1,162 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include "CG_Data.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+
+namespace GL_Engine {
+
+    /*-------------RenderGraph Class------------*/
+    /*
+    *Schedules the offscreen passes of a frame (shadow and caustic maps,
+    *water reflections, environment maps, post processing...). The graph
+    *is rebuilt every frame: each pass declares the textures it reads and
+    *writes and the framebuffer it draws to, then execute() compiles and
+    *runs the frame:
+    *   - passes none of whose outputs reach a side-effect pass or a
+    *     resource marked as a frame output are culled
+    *   - the remaining passes run in dependency order, preferring the
+    *     pass that keeps the current framebuffer bound
+    *   - transient textures (created by the graph rather than imported)
+    *     share physical textures when their lifetimes do not overlap
+    *
+    *Framebuffers are bound by the graph through FBO::staticBind, so pass
+    *functions only clear and draw.
+    */
+    class RenderGraph {
+    public:
+        using ResourceHandle = uint32_t;
+        static constexpr ResourceHandle InvalidResource = UINT32_MAX;
+
+        // Description of a transient texture
+        struct TextureDesc {
+            uint16_t width{ 0 }, height{ 0 };
+            // Sized internal format, depth formats are attached as depth
+            GLenum internalFormat{ GL_RGBA8 };
+
+            bool operator==( const TextureDesc & _other ) const;
+        };
+
+        class PassBuilder {
+        public:
+            ResourceHandle read( ResourceHandle _resource );
+            ResourceHandle write( ResourceHandle _resource );
+
+            // Draw to colour attachment(s) of an FBO the pass' owner keeps
+            void setFramebuffer( const CG_Data::FBO & _fbo,
+                                 uint8_t _colourAttachment = 0 );
+            void setFramebuffer( const CG_Data::FBO & _fbo, uint16_t _count,
+                                 const GLenum * _colourAttachments );
+
+            // Never cull the pass, e.g. it draws to the screen
+            void setSideEffect();
+
+        private:
+            friend class RenderGraph;
+            PassBuilder( RenderGraph & _graph, uint32_t _pass );
+            RenderGraph & graph;
+            uint32_t pass;
+        };
+
+        struct Statistics {
+            uint32_t passes{ 0 };
+            uint32_t culledPasses{ 0 };
+            uint32_t framebufferBinds{ 0 };
+            // Transient resources, and the physical textures behind them
+            uint32_t transientResources{ 0 };
+            uint32_t transientTextures{ 0 };
+        };
+
+        using SetupFunction = std::function< void( PassBuilder & ) >;
+        using ExecuteFunction = std::function< void( const RenderGraph & ) >;
+
+        RenderGraph() = default;
+        ~RenderGraph();
+        RenderGraph( const RenderGraph & ) = delete;
+        RenderGraph & operator=( const RenderGraph & ) = delete;
+
+        // Remove all passes and resources, keeping the transient textures
+        // and framebuffers for reuse
+        void reset();
+
+        // Import a texture owned elsewhere. Importing the same texture
+        // twice returns the same handle
+        ResourceHandle importTexture( const std::string & _name,
+                                      std::shared_ptr< CG_Data::Texture > _texture );
+
+        // Declare a texture the graph allocates, and may alias
+        ResourceHandle createTexture( const std::string & _name,
+                                      const TextureDesc & _desc );
+
+        // Consumed after the graph runs, so its writers are never culled
+        void markOutput( ResourceHandle _resource );
+
+        void addPass( const std::string & _name, const SetupFunction & _setup,
+                      ExecuteFunction _execute );
+
+        // Compile and run the frame's passes
+        void execute();
+
+        // The texture behind a resource. Transient resources only have one
+        // while the graph executes
+        std::shared_ptr< CG_Data::Texture > getTexture( ResourceHandle _resource ) const;
+
+        // Pass names in execution order, culled passes omitted
+        std::vector< std::string > getExecutionOrder() const;
+        const Statistics & getStatistics() const;
+
+    private:
+        struct Resource {
+            std::string name;
+            std::shared_ptr< CG_Data::Texture > texture;
+            TextureDesc desc;
+            bool transient{ false };
+            bool output{ false };
+            // Index into the physical texture pool (transient only)
+            int32_t physical{ -1 };
+        };
+
+        struct Pass {
+            std::string name;
+            ExecuteFunction execute;
+            std::vector< ResourceHandle > reads, writes;
+            GLuint framebuffer{ 0 };
+            uint16_t width{ 0 }, height{ 0 };
+            std::vector< GLenum > drawBuffers;
+            bool explicitFramebuffer{ false };
+            bool sideEffect{ false };
+            bool culled{ false };
+        };
+
+        struct PhysicalTexture {
+            TextureDesc desc;
+            std::shared_ptr< CG_Data::Texture > texture;
+            // Execution slot of the last pass using it this frame
+            int32_t lastUse{ -1 };
+        };
+
+        void cullPasses();
+        void schedulePasses();
+        void allocateTransients();
+        void prepareTransientFramebuffer( Pass & _pass );
+        static bool isDepthFormat( GLenum _format );
+
+        std::vector< Resource > resources;
+        std::vector< Pass > passes;
+        std::vector< uint32_t > executionOrder;
+        std::unordered_map< GLuint, ResourceHandle > importedTextures;
+
+        // Kept across frames
+        std::vector< PhysicalTexture > texturePool;
+        std::unordered_map< std::string, GLuint > transientFramebuffers;
+        Statistics statistics;
+    };
+
+}
+
+#endif // RENDER_GRAPH_H
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Entity.h"
+#include "CommandBucket.h"
+#include "Culling.h"
+#include "Camera.h"
 namespace GL_Engine {
 
 	class Renderer {
@@ -17,12 +20,32 @@ namespace GL_Engine {
 
 		const std::vector< std::shared_ptr< RenderPass > > & getRenderPasses() const;
 
+		//Cull the passes against the culling camera (if set), sort them by
+		//state (see CommandBucket) and render them. Reads the transforms
+		//and bounds CG_Engine::BeginFrame updated, so may be called many
+		//times a frame
 		void Render() const;
 
+		//Camera whose frustum the passes are culled against before each
+		//Render. Null (the default) disables culling
+		void SetCullingCamera(Camera *_Camera);
+		Camera *GetCullingCamera() const;
+		const CullingStage & GetCullingStage() const;
+
 	private:
 		std::vector< std::shared_ptr< RenderPass > > renderPasses;
 		static void DefaultRenderer(RenderPass&, void*);
 		std::vector<CG_Data::UBO*> UBO_List;
+		//Pack the draw blocks of all passes into one upload, see
+		//RenderPass::EnableDrawBlock
+		void PackDrawBlocks() const;
+		mutable std::vector<uint8_t> drawBlockData;
+		//Used if the uniform ring is full for the frame
+		mutable std::unique_ptr<CG_Data::VBO> drawBlockVBO;
+		//Storage reused across calls, not shared by nested Render calls
+		mutable CommandBucket commandBucket;
+		mutable CullingStage cullingStage;
+		Camera *cullingCamera{ nullptr };
 	};
 
 }
\ No newline at end of file
@@ -0,0 +1,112 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include "Common.h"
+#include <cstdint>
+#include <vector>
+
+namespace GL_Engine {
+	namespace CG_Data {
+
+		/*-------------RingBuffer Class------------*/
+		/*
+		*Streaming allocator for per-frame GPU data. The buffer is split into
+		*one region per frame in flight; each frame sub-allocates linearly
+		*from its region, and EndFrame fences the region and moves on to the
+		*next, waiting only if the GPU is still reading it (N frames ago).
+		*
+		*With GL 4.4 / ARB_buffer_storage the buffer is mapped once,
+		*persistently and coherently, so a write is a memcpy. Otherwise each
+		*write maps its range with GL_MAP_UNSYNCHRONIZED_BIT, which the
+		*fences make safe.
+		*/
+		class RingBuffer {
+		public:
+			static constexpr unsigned int DefaultFrameCount = 3;
+
+			struct Allocation {
+				GLuint buffer{ 0 };
+				GLintptr offset{ 0 };
+				GLsizeiptr size{ 0 };
+				//Ring (see Serial) and frame the allocation was made in, see
+				//IsLive
+				uint64_t ring{ 0 };
+				uint64_t frame{ 0 };
+
+				//Allocations fail (buffer 0) if the frame's region is full
+				bool Valid() const { return buffer != 0; }
+			};
+
+			struct Statistics {
+				uint64_t bytesWritten{ 0 };
+				uint64_t allocations{ 0 };
+				//Allocations that did not fit in the frame's region
+				uint64_t failedAllocations{ 0 };
+				//EndFrame calls that had to block on the GPU
+				uint64_t stalls{ 0 };
+			};
+
+			//_FrameCapacity bytes per frame, _FrameCount frames in flight
+			RingBuffer(GLenum _Target, GLsizeiptr _FrameCapacity,
+					   unsigned int _FrameCount = DefaultFrameCount);
+			~RingBuffer();
+			RingBuffer(const RingBuffer&) = delete;
+			RingBuffer &operator=(const RingBuffer&) = delete;
+
+			//Copy _Size bytes into the current frame's region, at an offset
+			//aligned to _Alignment (0 for the target's default alignment)
+			Allocation Write(const void *_Data, GLsizeiptr _Size, GLsizeiptr _Alignment = 0);
+
+			//Whether _Allocation was written by this ring in the current
+			//frame. Only then is it safe to bind again: the region's fence
+			//covers the frame it was written in, not the draws of later
+			//frames, so those must write their own copy
+			bool IsLive(const Allocation &_Allocation) const;
+
+			//Fence the current region and advance to the next one
+			void EndFrame();
+
+			GLuint GetID() const;
+			GLenum GetTarget() const;
+			//Alignment used when Write is given none
+			GLsizeiptr GetAlignment() const;
+			bool IsPersistent() const;
+			uint64_t GetFrame() const;
+			const Statistics &GetStatistics() const;
+
+			//Engine-wide rings, created on first use (needs a GL context)
+			static RingBuffer &Uniforms();
+			static RingBuffer &Vertices();
+			//Destroy the engine-wide rings while the context is current,
+			//called from CG_Engine::Shutdown. Rings never released are left
+			//to the context
+			static void ReleaseShared();
+
+			//EndFrame on every ring, called from CG_Engine::EndFrame
+			static void EndFrameAll();
+
+		private:
+			GLenum Target;
+			GLuint ID{ 0 };
+			GLsizeiptr FrameCapacity;
+			unsigned int FrameCount;
+			GLsizeiptr DefaultAlignment{ 16 };
+			bool Persistent{ false };
+			uint8_t *MappedPointer{ nullptr };
+
+			//Distinguishes this ring's allocations from those of a released
+			//ring whose buffer name was reused
+			uint64_t Serial;
+			uint64_t Frame{ 0 };
+			GLsizeiptr Head{ 0 };
+			std::vector<GLsync> Fences;
+			Statistics Stats;
+
+			static std::vector<RingBuffer*> Rings;
+			static uint64_t NextSerial;
+		};
+
+	}
+}
+
+#endif // RING_BUFFER_H
@@ -4,6 +4,7 @@
 #include "Common.h"
 #include "CG_Data.h"
 #include <map>
+#include <unordered_map>
 #include <filesystem>
 
 namespace GL_Engine{
@@ -49,8 +50,47 @@ namespace GL_Engine{
                          std::function< void( const CG_Data::Uniform & ) > 
                             _callbackFunction );
 
+        //Register a Uniform uploading _count values of type T
+        template< typename T >
+        std::shared_ptr< CG_Data::Uniform >
+        registerUniform( const std::string & _uniformName, GLsizei _count = 1 ){
+            auto uniform = registerUniform( _uniformName );
+            uniform->SetType< T >( _count );
+            return uniform;
+        }
+
+        //Location of an active uniform, resolved at compile time. Arrays are
+        //found by "name", "name[0]" and each element's "name[N]". -1 if the
+        //uniform is not active (which GL silently ignores)
+        GLint getUniformLocation( const std::string & _uniformName ) const;
+
+        //Typed binder for an active uniform. Resolve once after compiling,
+        //and keep the binder for the draw loop
+        template< typename T >
+        CG_Data::UniformBinder< T > getBinder( const std::string & _uniformName ) const {
+            return CG_Data::UniformBinder< T >( getUniformLocation( _uniformName ) );
+        }
+
         void registerUBO( const std::string &_uboName,
                           std::shared_ptr< const CG_Data::UBO > _ubo );
+
+        //Layout of a uniform block, queried at compile time
+        struct UniformBlockLayout {
+            GLint dataSize{ 0 };
+            //Byte offset of each active member within the block
+            std::unordered_map< std::string, GLint > offsets;
+        };
+
+        //Bind the uniform block _blockName to binding point _binding
+        //whenever the program is used, for blocks fed by ranges of a
+        //shared buffer rather than a UBO of their own
+        void registerUniformBlock( const std::string & _blockName,
+                                   GLuint _binding );
+
+        //Layout of an active uniform block, nullptr if it is not active
+        const UniformBlockLayout *
+        getUniformBlockLayout( const std::string & _blockName ) const;
+
         std::shared_ptr< CG_Data::Uniform >
         getUniform( uint8_t index ) const;
 
@@ -80,12 +120,19 @@ namespace GL_Engine{
             std::shared_ptr< const CG_Data::UBO > ubo;
             GLuint blockIndex;
         };
+        struct UniformBlockStruct {
+            GLuint binding{ 0 };
+            GLuint blockIndex{ GL_INVALID_INDEX };
+        };
         std::vector< ShaderStage* > shaderStages;
         std::vector< Attribute* > attributes;
         std::vector< UniformStruct* > uniforms;
         std::map< std::string, std::shared_ptr< CG_Data::Uniform > > uniformMap;
         std::map< std::string, std::unique_ptr< UboStruct > > uboBlockIndices;
         std::map< std::string, GLuint > textureLocations;
+        std::unordered_map< std::string, GLint > uniformLocations;
+        std::map< std::string, UniformBlockStruct > uniformBlocks;
+        std::unordered_map< std::string, UniformBlockLayout > blockLayouts;
 
         GLuint shaderID = InvalidShaderId;
         bool initialised{ false };
@@ -0,0 +1,177 @@
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Entity.h"
+#include "NameTable.h"
+#include "BlendTree.h"
+
+namespace GL_Engine {
+
+    /*-------------Skeleton Class------------*/
+    /*
+    *A model's node hierarchy, compiled at load into flat arrays ordered
+    *so every joint follows its parent. Posing is a linear pass: each
+    *joint's local transform (its animation sample, or its bind transform)
+    *is concatenated onto its parent's model space transform, then the
+    *joints used for skinning are multiplied by their inverse bind
+    *matrices into the palette of each mesh.
+    *
+    *Joints are named by NameTable ids, so lookups compare integers.
+    *
+    *Animations are held as clips, each with a track per animated joint.
+    *A pose samples either one clip or a BlendTree mixing several.
+    *
+    *Posing writes a back buffer, which publish() makes current, so a
+    *skeleton may be posed on a worker (see AnimationSystem) while its
+    *last published pose is drawn. Only one thread may pose it at a time.
+    *
+    *For level of detail, a pose may be given a tier: joints masked at
+    *that tier hold their last local transform rather than being sampled.
+    *poseBlended() samples keyframe poses a few frames ahead and blends
+    *the palettes between them on the frames in between.
+    */
+    class Skeleton {
+    public:
+        static constexpr uint32_t NoJoint = UINT32_MAX;
+        static constexpr uint32_t NoClip = UINT32_MAX;
+
+        // Add a joint below _parent, or a root for NoJoint, returning its
+        // index. Parents must be added before their children
+        uint32_t addJoint( NameId _name, uint32_t _parent, const glm::mat4 & _bindLocal );
+        // Add a clip of _length, returning its index. Joints must all be
+        // added first
+        uint32_t addClip( NameId _name, double _length );
+        void setAnimation( uint32_t _clip, uint32_t _joint, std::shared_ptr< NodeAnimation > _animation );
+        // Start the palette of the next mesh, returning its index
+        uint32_t addPalette();
+        // Append a bone skinned by _joint to the last palette, returning
+        // its index in that palette
+        uint32_t addPaletteEntry( uint32_t _joint, const glm::mat4 & _inverseBind );
+        // Applied above the roots, taking the model out of the file's
+        // root space
+        void setGlobalInverse( const glm::mat4 & _globalInverse );
+
+        // The joint named _name, NoJoint if there is none
+        uint32_t findJoint( NameId _name ) const;
+        uint32_t getJointCount() const;
+        uint32_t getParent( uint32_t _joint ) const;
+        NameId getJointName( uint32_t _joint ) const;
+        // The clip named _name, NoClip if there is none
+        uint32_t findClip( NameId _name ) const;
+        uint32_t getClipCount() const;
+        // 0 for clips the skeleton does not have
+        double getClipLength( uint32_t _clip ) const;
+
+        // Stop sampling _joint in tiers from _fromTier on
+        void maskJoint( uint32_t _joint, uint32_t _fromTier );
+        // Mask, from _fromTier on, every joint more than _depth joints
+        // below its root, such as fingers and facial joints
+        void maskBelowDepth( uint32_t _fromTier, uint32_t _depth );
+
+        // Pose the back buffer in the bind pose
+        void pose();
+        // Pose the back buffer at _time through clip _animationId, looped,
+        // returning the number of joints sampled. Clips out of range give
+        // the bind pose
+        uint32_t pose( unsigned int _animationId, double _time, uint32_t _tier = 0 );
+        // Pose the back buffer at _time through _tree
+        uint32_t pose( const BlendTree & _tree, double _time, uint32_t _tier = 0 );
+        // Blend the back buffer between keyframe poses _interval frames
+        // apart, posing a new key once _time passes the last. The frame
+        // time is taken from the previous call. Bone attachments follow
+        // the keys. Returns the number of joints sampled
+        uint32_t poseBlended( unsigned int _animationId, double _time,
+                              uint32_t _interval, uint32_t _tier = 0 );
+        uint32_t poseBlended( const BlendTree & _tree, double _time,
+                              uint32_t _interval, uint32_t _tier = 0 );
+        // Make the back buffer the published pose
+        void publish();
+
+        // Pose and publish the bind pose
+        void update();
+        // Pose and publish the pose at _time
+        void update( unsigned int _animationId, double _time, uint32_t _tier = 0 );
+        void update( const BlendTree & _tree, double _time, uint32_t _tier = 0 );
+
+        // A joint's published model space transform. Once all joints are
+        // added the reference stays valid for the life of the skeleton
+        const glm::mat4 & getModelTransform( uint32_t _joint ) const;
+        // Published skinning matrices of a mesh, in the order of its bones
+        const glm::mat4 * getPalette( uint32_t _palette ) const;
+        uint32_t getPaletteSize( uint32_t _palette ) const;
+
+        // Sample _clip at _time, within the clip, into _pose. Joints the
+        // clip does not animate, or masked at _tier, take their bind
+        // transform, as do all joints for a clip the skeleton does not
+        // have. _advanceCursors false leaves the cursors untouched, for
+        // one-off samples. Returns the number of joints sampled
+        uint32_t sampleClip( uint32_t _clip, double _time, uint32_t _tier, LocalPose & _pose,
+                             bool _advanceCursors = true );
+
+    private:
+        // What a pose samples, a tree if set, else a clip
+        struct Source {
+            const BlendTree * tree;
+            unsigned int clip;
+        };
+        struct Clip {
+            NameId name;
+            double length;
+            // Per joint, null where the clip does not animate the joint
+            std::vector< std::shared_ptr< NodeAnimation > > channels;
+            std::vector< NodeAnimation::Cursor > cursors;
+        };
+
+        // Sample _source into the locals of the joints animated at _tier,
+        // returning the number sampled
+        uint32_t sample( const Source & _source, double _time, uint32_t _tier );
+        uint32_t pose( const Source & _source, double _time, uint32_t _tier );
+        uint32_t poseBlended( const Source & _source, double _time, uint32_t _interval, uint32_t _tier );
+        // Concatenate locals into model transforms, then build the
+        // palette entries into _palette
+        void evaluate( glm::mat4 * _palette );
+
+        // Per joint, parent first
+        std::vector< NameId > names;
+        std::vector< uint32_t > parents;
+        std::vector< glm::mat4 > bindLocals;
+        std::vector< glm::vec3 > bindTranslations;
+        std::vector< glm::quat > bindRotations;
+        std::vector< glm::vec3 > bindScales;
+        // Whether any clip animates the joint
+        std::vector< uint8_t > animated;
+        // The first tier at which the joint is not sampled
+        std::vector< uint32_t > maskedFrom;
+        std::vector< glm::mat4 > locals;
+        std::vector< glm::mat4 > models;
+        std::vector< glm::mat4 > publishedModels;
+
+        // Per palette entry, palette p being the range
+        // [ paletteOffsets[ p ], paletteOffsets[ p + 1 ] )
+        std::vector< uint32_t > paletteJoints;
+        std::vector< glm::mat4 > inverseBinds;
+        // Front and back buffers, palettes[ front ] being published
+        std::vector< glm::mat4 > palettes[ 2 ];
+        uint32_t front{ 0 };
+        std::vector< uint32_t > paletteOffsets{ 0 };
+
+        // poseBlended's keys, posed at keyTimes, and the time of the last
+        // animated pose if timed
+        std::vector< glm::mat4 > keyPalettes[ 2 ];
+        double keyTimes[ 2 ]{ 0.0, 0.0 };
+        double lastTime{ 0.0 };
+        bool timed{ false };
+        bool keysValid{ false };
+
+        std::vector< Clip > clips;
+
+        glm::mat4 globalInverse{ 1.0f };
+    };
+
+}
+
+#endif // SKELETON_H
@@ -0,0 +1,189 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Culling.h"
+#include "ComponentRegistry.h"
+#include "TransformStore.h"
+
+namespace GL_Engine {
+
+    /*-------------SpatialIndex Class------------*/
+    /*
+    *A loose octree over the world space bounding spheres of entities.
+    *Each node's loose bounds are twice its cell, so an entity is stored at
+    *the depth where its radius fits the cell size, in the cell holding its
+    *centre. Placing or moving an entity is a constant amount of work and
+    *never splits or merges nodes.
+    *
+    *update() refits only the entities whose transform moved since the
+    *last update() (see TransformStore::takeMoved), and relinks the few that left their cell.
+    *Queries append the ids of the entities they hit to a list, skipping
+    *empty subtrees and taking whole subtrees that are fully inside
+    *without testing their entities. Entities outside the octree's bounds
+    *are kept in a list which every query tests.
+    *
+    *Queries are const and may run concurrently with each other, but not
+    *with changes to the index. Empty nodes are recycled.
+    */
+    class SpatialIndex {
+    public:
+        // Deepest supported tree, bounding the query stacks
+        static constexpr uint32_t MaxDepthLimit = 16;
+
+        struct Statistics {
+            uint32_t entities{ 0 };
+            uint32_t nodes{ 0 };
+            // Entities outside the octree's bounds
+            uint32_t outside{ 0 };
+            // Entities refitted by the last update(), and those of them
+            // that moved to another node
+            uint32_t refitted{ 0 };
+            uint32_t relinked{ 0 };
+        };
+
+        // Results of a batch of queries, packed: the entities hit by
+        // query i are entities[ offsets[ i ], offsets[ i + 1 ] )
+        struct QueryResults {
+            std::vector< EntityId > entities;
+            std::vector< uint32_t > offsets;
+
+            void clear();
+            // Number of queries
+            size_t size() const;
+            const EntityId * begin( size_t _query ) const;
+            const EntityId * end( size_t _query ) const;
+        };
+
+        // Octree covering the cube of _halfSize about _centre, at most
+        // _maxDepth levels below the root
+        explicit SpatialIndex( TransformStore & _transforms = TransformStore::get(),
+                               const glm::vec3 & _centre = glm::vec3( 0.0f ),
+                               float _halfSize = 1024.0f, uint32_t _maxDepth = 8 );
+        SpatialIndex( const SpatialIndex & ) = delete;
+        SpatialIndex & operator=( const SpatialIndex & ) = delete;
+
+        // Rebuild the tree over new bounds, keeping the entities
+        void reset( const glm::vec3 & _centre, float _halfSize, uint32_t _maxDepth );
+
+        // Track _entity, with _localBounds in the space of its transform.
+        // Replaces any bounds it had; empty bounds remove it
+        void insert( EntityId _entity, const BoundingVolume & _localBounds );
+        void remove( EntityId _entity );
+        // Track _to with the local bounds of _from, if it is tracked
+        void copy( EntityId _from, EntityId _to );
+        bool contains( EntityId _entity ) const;
+        // The entity's world space bounding sphere, as ( centre, radius )
+        glm::vec4 getSphere( EntityId _entity ) const;
+
+        // Refit the entities moved since the last update(), taking the
+        // TransformStore's moved list
+        void update();
+
+        // Append the entities whose sphere passes each test
+        void queryFrustum( const Frustum & _frustum, std::vector< EntityId > & _out ) const;
+        void querySphere( const glm::vec3 & _centre, float _radius,
+                          std::vector< EntityId > & _out ) const;
+        void queryBox( const glm::vec3 & _min, const glm::vec3 & _max,
+                       std::vector< EntityId > & _out ) const;
+
+        // One query per sphere ( centre, radius ) or frustum, e.g. light
+        // volumes or shadow cascades. _results is cleared first
+        void querySpheres( const glm::vec4 * _spheres, size_t _count,
+                           QueryResults & _results ) const;
+        void queryFrustums( const Frustum * _frustums, size_t _count,
+                            QueryResults & _results ) const;
+
+        // The entity whose sphere the ray enters first within
+        // _maxDistance, or InvalidEntity. _direction must be normalised
+        EntityId raycast( const glm::vec3 & _origin, const glm::vec3 & _direction,
+                          float _maxDistance, float * _distance = nullptr ) const;
+
+        const Statistics & getStatistics() const;
+
+        static constexpr EntityId InvalidEntity = TransformStore::InvalidHandle;
+
+        // The engine-wide index, refitted by CG_Engine::BeginFrame
+        static SpatialIndex & get();
+
+    private:
+        static constexpr uint32_t None = UINT32_MAX;
+        // Node holding the entities outside the root's cell
+        static constexpr uint32_t Outside = 0;
+        static constexpr uint32_t Root = 1;
+
+        struct Node {
+            glm::vec3 centre;
+            // Half size of the cell, the loose bounds are twice this
+            float halfSize;
+            uint32_t depth;
+            uint32_t parent;
+            // 0 where there is no child, as the root is nobody's child
+            uint32_t children[ 8 ];
+            // Head of the node's list of items
+            uint32_t first;
+            // Items in the node and its descendants
+            uint32_t count;
+        };
+
+        struct Item {
+            // World space sphere
+            glm::vec4 sphere;
+            glm::vec3 localCentre;
+            float localRadius;
+            // Cell of the item's node, so refitting an item that stays
+            // put reads no nodes
+            glm::vec3 cellCentre;
+            float cellHalfSize;
+            EntityId entity;
+            uint32_t node;
+            // Neighbours in the node's list
+            uint32_t previous, next;
+        };
+
+        uint32_t targetDepth( float _radius ) const;
+        // Whether a sphere belongs in the outside list
+        bool isOutside( const glm::vec4 & _sphere ) const;
+        bool inCell( const glm::vec4 & _sphere, uint32_t _node ) const;
+        // Whether an item still belongs in its node
+        bool fits( const Item & _item ) const;
+        // Node below _from a sphere belongs in, created if needed
+        uint32_t descend( uint32_t _from, const glm::vec4 & _sphere );
+        // Free _node and its ancestors while they are empty
+        void release( uint32_t _node );
+        // Add to or take from a node's list, leaving the counts alone
+        void attach( uint32_t _item, uint32_t _node );
+        void detach( uint32_t _item );
+        // Add an item to the node its sphere belongs in, or remove it from
+        // its node, keeping the counts
+        void link( uint32_t _item );
+        void unlink( uint32_t _item );
+        // Recompute an item's sphere from its transform, moving it to
+        // another node if it has left its own
+        void refit( uint32_t _item );
+        void appendSubtree( uint32_t _node, std::vector< EntityId > & _out ) const;
+        // Walk the tree, testing loose node bounds with _box (returning a
+        // Frustum::Containment) and items with _sphere
+        template< typename BoxTest, typename SphereTest >
+        void query( BoxTest && _box, SphereTest && _sphere,
+                    std::vector< EntityId > & _out ) const;
+
+        TransformStore & transforms;
+        std::vector< Node > nodes;
+        std::vector< uint32_t > freeNodes;
+        std::vector< Item > items;
+        // Item index of each entity, None if untracked
+        std::vector< uint32_t > itemOf;
+        uint32_t maxDepth;
+        // Half size of the deepest cells
+        float minHalfSize;
+        Statistics statistics;
+        // Taken from the TransformStore, kept for its capacity
+        std::vector< TransformStore::Handle > moved;
+    };
+
+}
+
+#endif // SPATIAL_INDEX_H
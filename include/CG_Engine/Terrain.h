@@ -1,11 +1,14 @@
 #pragma once
 #include "Renderer.h"
+#include "JobSystem.h"
+#include <memory_resource>
 
 namespace GL_Engine {
 
+	//Generated per-chunk data, only needed until it is uploaded
 	struct ChunkData {
-		std::vector<float> Heights;
-		std::vector<glm::vec3> Normals, Tangents, Bitangents;
+		std::pmr::vector<float> Heights;
+		std::pmr::vector<glm::vec3> Normals;
 	};
 	struct MeshData {
 		std::vector<unsigned int> Indices;
@@ -18,9 +21,14 @@ namespace GL_Engine {
 	class TerrainGenerator {
 	public:
 		static MeshData CreateMesh(uint32_t MeshSize, uint32_t Divisions);
-		static std::vector<float> GenerateHeights(int MeshSize, int DivisionCount, int GridX, int GridZ);
-		static std::vector<glm::vec3> GetSmoothNormals(const MeshData &meshData, const std::vector<float> Heights);
-		static ChunkData GenerateChunk(int GridX, int GridZ, const MeshData &meshData);
+		//The generators allocate their results from _Resource, so callers
+		//can keep the temporary data off the general heap
+		static std::pmr::vector<float> GenerateHeights(int MeshSize, int DivisionCount, int GridX, int GridZ,
+			std::pmr::memory_resource *_Resource = std::pmr::get_default_resource());
+		static std::pmr::vector<glm::vec3> GetSmoothNormals(const MeshData &meshData, const std::pmr::vector<float> &Heights,
+			std::pmr::memory_resource *_Resource = std::pmr::get_default_resource());
+		static ChunkData GenerateChunk(int GridX, int GridZ, const MeshData &meshData,
+			std::pmr::memory_resource *_Resource = std::pmr::get_default_resource());
 		static float getHeight(int x, int z);
 
 	private:
@@ -33,23 +41,38 @@ namespace GL_Engine {
 	class TerrainChunk : public CG_Data::VAO {
 	public:
 		TerrainChunk(const MeshBaseVBOs &baseVBOs, const MeshData &meshData, int GridX, int GridZ);
+		//Upload data already generated by TerrainGenerator::GenerateChunk
+		TerrainChunk(const MeshBaseVBOs &baseVBOs, const MeshData &meshData, int GridX, int GridZ,
+			ChunkData &_Data);
 		glm::vec2 WorldPos;
 		glm::vec2 WorldGridPosition;
 		glm::mat4 Translation;
 	private:
-		
+		void Upload(const MeshBaseVBOs &baseVBOs, const MeshData &meshData, int GridX, int GridZ,
+			ChunkData &_Data);
 	};
 
 	class Terrain{
 	private:
 		struct TerrainPack {
 			std::vector<std::shared_ptr<TerrainChunk>> TerrainChunks;
-			unsigned int translationUniformLocation;
 			Entity terrainEntity;
 		};
+		//Per render pass data, the chunks plus the pass' shader locations
+		struct TerrainPassData {
+			TerrainPack *pack;
+			CG_Data::UniformBinder<glm::mat4> translation;
+		};
 	public:
 		Terrain(uint32_t _MeshSize, uint32_t _DivisionCount);
 		std::shared_ptr<TerrainChunk> GenerateChunk(int xGrid, int zGrid);
+		//Generate the chunks' data in parallel on the job system, then
+		//upload them in order. Blocks until all are added
+		std::vector<std::shared_ptr<TerrainChunk>> GenerateChunks(const std::vector<glm::ivec2> &_Grids);
+		//Generate the chunk's data on the job system, then upload it and
+		//add it to the terrain from CG_Engine::EndFrame. The terrain must
+		//outlive the job
+		void GenerateChunkAsync(int xGrid, int zGrid);
 
 		std::unique_ptr<RenderPass> GetRenderPass( Shader *_GroundShader,
 												   bool isProj=false );
@@ -59,8 +82,10 @@ namespace GL_Engine {
 		MeshBaseVBOs baseVBOs;
 		uint32_t MeshSize, DivisionCount;
 	private:
+		std::vector<std::unique_ptr<TerrainPassData>> passData;
 		static void TerrainRenderer(RenderPass &Pass, void* _Data);
 		static void TerrainProjRenderer( RenderPass &rPass, void* _data );
+		static bool GatherChunkBounds( RenderPass &rPass, SphereList &_spheres );
 	};
 
 }
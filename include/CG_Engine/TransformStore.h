@@ -0,0 +1,163 @@
+#ifndef TRANSFORM_STORE_H
+#define TRANSFORM_STORE_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace GL_Engine {
+
+    /*-------------TransformStore Class------------*/
+    /*
+    *Positions, orientations and scales of every entity, kept as a
+    *structure of arrays, with the world matrices built from them. Entity
+    *holds a handle into the store.
+    *
+    *Setting a component marks the transform dirty, and update() rebuilds
+    *every dirty matrix in one pass, four at a time with SSE. The batch
+    *kernel only writes the lanes that are dirty.
+    *
+    *A transform may have a parent, making its position, orientation and
+    *scale relative to the parent's world matrix. Transforms in a hierarchy
+    *have their local matrix built by the batch kernel, then a second pass
+    *over the hierarchy, stored breadth first with one flat range per
+    *depth, derives world matrices for the subtrees that changed.
+    *
+    *Storage is split into fixed size chunks which never move, so
+    *pointers to a matrix stay valid for the life of its handle.
+    *Orientations are expected to be normalised. Not thread safe.
+    */
+    class TransformStore {
+    public:
+        using Handle = uint32_t;
+        static constexpr Handle InvalidHandle = UINT32_MAX;
+        // Lanes per chunk, a multiple of 64 (one dirty word)
+        static constexpr uint32_t ChunkSize = 256;
+
+        struct Statistics {
+            uint32_t transforms{ 0 };
+            // Matrices rebuilt by the last update(), and the lanes it
+            // computed (rebuilt plus clean lanes sharing a SIMD group)
+            uint32_t rebuilt{ 0 };
+            uint32_t lanesComputed{ 0 };
+            // Transforms in a hierarchy, its depth, and the world matrices
+            // derived from a parent by the last update()
+            uint32_t hierarchyNodes{ 0 };
+            uint32_t hierarchyLevels{ 0 };
+            uint32_t propagated{ 0 };
+        };
+
+        TransformStore() = default;
+        TransformStore( const TransformStore & ) = delete;
+        TransformStore & operator=( const TransformStore & ) = delete;
+
+        // A new identity transform
+        Handle create();
+        void destroy( Handle _handle );
+
+        void setPosition( Handle _handle, const glm::vec3 & _position );
+        void setOrientation( Handle _handle, const glm::quat & _orientation );
+        void setScale( Handle _handle, const glm::vec3 & _scale );
+        glm::vec3 getPosition( Handle _handle ) const;
+        glm::quat getOrientation( Handle _handle ) const;
+        glm::vec3 getScale( Handle _handle ) const;
+
+        bool isDirty( Handle _handle ) const;
+        void markDirty( Handle _handle );
+
+        // Make _handle relative to _parent, or a root for InvalidHandle.
+        // _parentOffset, if set, goes between the parent and the child and
+        // is read on every update (e.g. a bone's model space transform).
+        // Throws std::runtime_error if _parent is a descendant of _handle
+        void setParent( Handle _handle, Handle _parent,
+                        const glm::mat4 * _parentOffset = nullptr );
+        Handle getParent( Handle _handle ) const;
+
+        // The world matrix, current as of the last rebuild
+        glm::mat4 & getMatrix( Handle _handle );
+        const glm::mat4 & getMatrix( Handle _handle ) const;
+        // The matrix of the transform's own position, orientation and
+        // scale, the world matrix for a transform without a parent
+        glm::mat4 getLocalMatrix( Handle _handle ) const;
+
+        // Bring _handle's world matrix up to date now, along with its
+        // ancestors'
+        void update( Handle _handle );
+        // Rebuild all dirty matrices
+        void update();
+
+        // Transforms whose world matrix was written, by update() or by an
+        // on demand rebuild, since the list was last taken. May hold
+        // duplicates and destroyed handles
+        const std::vector< Handle > & getMoved() const;
+        // Move the list into _out and start a new one, for the consumer
+        // refitting against it (SpatialIndex::update, once per frame)
+        void takeMoved( std::vector< Handle > & _out );
+
+        const Statistics & getStatistics() const;
+
+        // The engine-wide store
+        static TransformStore & get();
+
+    private:
+        struct alignas( 16 ) Chunk {
+            float px[ ChunkSize ], py[ ChunkSize ], pz[ ChunkSize ];
+            float qx[ ChunkSize ], qy[ ChunkSize ], qz[ ChunkSize ], qw[ ChunkSize ];
+            float sx[ ChunkSize ], sy[ ChunkSize ], sz[ ChunkSize ];
+            uint64_t dirty[ ChunkSize / 64 ];
+            glm::mat4 world[ ChunkSize ];
+
+            // Set for transforms with a parent, children or offset, whose
+            // matrices are built into local instead of world
+            uint64_t linked[ ChunkSize / 64 ];
+            // Linked transforms whose local matrix was rebuilt since the
+            // last propagation
+            uint64_t changed[ ChunkSize / 64 ];
+            glm::mat4 local[ ChunkSize ];
+            Handle parent[ ChunkSize ];
+            uint32_t children[ ChunkSize ];
+            const glm::mat4 * offset[ ChunkSize ];
+        };
+
+        struct Node {
+            Handle handle;
+            // Index of the parent node, NoParent for roots
+            uint32_t parent;
+        };
+        static constexpr uint32_t NoParent = UINT32_MAX;
+
+        Chunk & chunk( Handle _handle ) const;
+        static uint32_t lane( Handle _handle );
+        static bool isLinked( const Chunk & _chunk, uint32_t _lane );
+        // Where the kernel writes the matrix of a lane, local or world
+        static glm::mat4 & target( Chunk & _chunk, uint32_t _lane );
+        static void buildMatrix( Chunk & _chunk, uint32_t _lane );
+        // Build the four matrices from _first, writing the lanes in _mask
+        static void buildMatrices( Chunk & _chunk, uint32_t _first, uint32_t _mask );
+        // Rebuild _handle's matrix if dirty, without resolving its parents
+        void rebuild( Handle _handle );
+        // Move _handle in or out of the hierarchy as its links change
+        void updateLinked( Handle _handle );
+        void buildHierarchy();
+        void propagate();
+
+        std::vector< std::unique_ptr< Chunk > > chunks;
+        std::vector< Handle > freeHandles;
+        Handle next{ 0 };
+        // Dirty transforms per chunk, so clean chunks are skipped
+        std::vector< uint32_t > dirtyCounts;
+        // Linked transforms, breadth first. Level d is the range
+        // [ levelOffsets[ d ], levelOffsets[ d + 1 ] )
+        std::vector< Node > nodes;
+        std::vector< uint32_t > levelOffsets;
+        std::vector< uint8_t > nodeChanged;
+        bool hierarchyDirty{ false };
+        std::vector< Handle > moved;
+        Statistics statistics;
+    };
+
+}
+
+#endif // TRANSFORM_STORE_H
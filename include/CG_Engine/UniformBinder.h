@@ -0,0 +1,117 @@
+#ifndef UNIFORM_BINDER_H
+#define UNIFORM_BINDER_H
+
+#include "Common.h"
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace GL_Engine {
+    namespace CG_Data {
+
+        /*
+        *Typed glUniform* uploads. UniformTraits is specialised for each
+        *supported value type, so an unsupported type fails to compile
+        *rather than uploading garbage.
+        */
+        template< typename T >
+        struct UniformTraits;
+
+        template<> struct UniformTraits< float > {
+            static void upload( GLint _l, GLsizei _c, const float * _v ){
+                glUniform1fv( _l, _c, _v );
+            }
+        };
+        template<> struct UniformTraits< GLint > {
+            static void upload( GLint _l, GLsizei _c, const GLint * _v ){
+                glUniform1iv( _l, _c, _v );
+            }
+        };
+        template<> struct UniformTraits< GLuint > {
+            static void upload( GLint _l, GLsizei _c, const GLuint * _v ){
+                glUniform1uiv( _l, _c, _v );
+            }
+        };
+        template<> struct UniformTraits< glm::vec2 > {
+            static void upload( GLint _l, GLsizei _c, const glm::vec2 * _v ){
+                glUniform2fv( _l, _c, glm::value_ptr( *_v ) );
+            }
+        };
+        template<> struct UniformTraits< glm::vec3 > {
+            static void upload( GLint _l, GLsizei _c, const glm::vec3 * _v ){
+                glUniform3fv( _l, _c, glm::value_ptr( *_v ) );
+            }
+        };
+        template<> struct UniformTraits< glm::vec4 > {
+            static void upload( GLint _l, GLsizei _c, const glm::vec4 * _v ){
+                glUniform4fv( _l, _c, glm::value_ptr( *_v ) );
+            }
+        };
+        template<> struct UniformTraits< glm::ivec2 > {
+            static void upload( GLint _l, GLsizei _c, const glm::ivec2 * _v ){
+                glUniform2iv( _l, _c, glm::value_ptr( *_v ) );
+            }
+        };
+        template<> struct UniformTraits< glm::mat3 > {
+            static void upload( GLint _l, GLsizei _c, const glm::mat3 * _v ){
+                glUniformMatrix3fv( _l, _c, GL_FALSE, glm::value_ptr( *_v ) );
+            }
+        };
+        template<> struct UniformTraits< glm::mat4 > {
+            static void upload( GLint _l, GLsizei _c, const glm::mat4 * _v ){
+                glUniformMatrix4fv( _l, _c, GL_FALSE, glm::value_ptr( *_v ) );
+            }
+        };
+
+        template< typename T >
+        inline void uploadUniform( GLint _location, const T * _values,
+                                   GLsizei _count = 1 ){
+            UniformTraits< T >::upload( _location, _count, _values );
+        }
+
+        // Type-erased form, as stored by CG_Data::Uniform
+        using UniformUploader = void ( * )( GLint, const void *, GLsizei );
+
+        template< typename T >
+        void uploadUniformData( GLint _location, const void * _data,
+                                GLsizei _count ){
+            uploadUniform< T >( _location, static_cast< const T * >( _data ),
+                                _count );
+        }
+
+        /*-------------UniformBinder Class------------*/
+        /*
+        *A uniform location resolved once (see Shader::getBinder), for
+        *render functions that set uniforms directly. The program must be
+        *in use when set() is called. An invalid (-1) location is ignored
+        *by GL, as with glUniform* itself.
+        */
+        template< typename T >
+        class UniformBinder {
+        public:
+            UniformBinder() = default;
+            explicit UniformBinder( GLint _location ) : location( _location ){}
+
+            void set( const T & _value ) const {
+                uploadUniform< T >( location, &_value );
+            }
+
+            void set( const T * _values, GLsizei _count ) const {
+                uploadUniform< T >( location, _values, _count );
+            }
+
+            GLint getLocation() const {
+                return location;
+            }
+
+            bool isValid() const {
+                return location >= 0;
+            }
+
+        private:
+            GLint location{ -1 };
+        };
+
+    }
+}
+
+#endif // UNIFORM_BINDER_H
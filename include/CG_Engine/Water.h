@@ -2,11 +2,18 @@
 #ifndef WATER_H
 #define WATER_H
 #include "Renderer.h"
+#include "RenderGraph.h"
 #include "Shader.h"
 #include "Camera.h"
 #include "CgTime.h"
 
 namespace GL_Engine {
+    // Per-surface data, read by the water pass
+    struct WaterPlane {
+        // Seconds the surface has been drawn, animates the ripples
+        float time{ 0.0f };
+    };
+
     class Water : public Entity {
     public:
         Water(uint16_t _fbWidth, uint16_t _fbHeight,
@@ -19,6 +26,12 @@ namespace GL_Engine {
         ~Water();
 
         std::shared_ptr< RenderPass > getRenderPass();
+
+        // Schedule the reflection and refraction renders in a frame graph,
+        // marking both textures as outputs. Nothing is scheduled while the
+        // water is inactive. The water pass renders any texture the graph
+        // did not, then draws the surface
+        void addPasses( RenderGraph & _graph );
         std::vector< std::shared_ptr< Renderer > > renderers;
         std::shared_ptr< CG_Data::Texture > refrTex, reflTex;
         std::shared_ptr< CG_Data::Texture > dudvTexture;
@@ -34,9 +47,15 @@ namespace GL_Engine {
         std::shared_ptr< CG_Data::VAO > waterVao;
 
         static void defaultWaterRenderer(RenderPass& _rPass, void* _data);
+
+        // Render the scene into the bound framebuffer, reflected in or
+        // refracted through the water plane, with all water hidden
+        void renderScene( bool _reflect );
+        // Set by the graph passes, so the draw skips rendering that texture
+        bool reflectionRendered{ false };
+        bool refractionRendered{ false };
         static std::vector< Water* > waterObjects;
         Stopwatch< std::chrono::microseconds > waterStopwatch;
-        float time;
 
     };
 }
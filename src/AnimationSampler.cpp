@@ -0,0 +1,81 @@
+#include "AnimationSampler.h"
+
+namespace GL_Engine {
+
+    glm::vec3 interpolateKeys( const glm::vec3 & _a, const glm::vec3 & _b, float _t ){
+        return _a + ( _b - _a ) * _t;
+    }
+
+    glm::quat interpolateKeys( const glm::quat & _a, const glm::quat & _b, float _t ){
+        return glm::slerp( _a, _b, _t );
+    }
+
+    float keyError( const glm::vec3 & _a, const glm::vec3 & _b ){
+        return glm::length( _a - _b );
+    }
+
+    float keyError( const glm::quat & _a, const glm::quat & _b ){
+        // From the chord between the two, as acos loses precision for
+        // nearby rotations
+        const glm::quat b = glm::dot( _a, _b ) < 0.0f ? -_b : _b;
+        const float chord = glm::length( glm::vec4( _a.x - b.x, _a.y - b.y, _a.z - b.z, _a.w - b.w ) );
+        return 4.0f * std::asin( std::min( 1.0f, chord * 0.5f ) );
+    }
+
+    KeyRange keyRange( const std::vector< glm::vec3 > & _values ){
+        KeyRange range;
+        if ( _values.empty() ){
+            return range;
+        }
+        glm::vec3 max = _values[ 0 ];
+        range.min = _values[ 0 ];
+        for ( const auto & value : _values ){
+            range.min = glm::min( range.min, value );
+            max = glm::max( max, value );
+        }
+        range.scale = ( max - range.min ) / 65535.0f;
+        return range;
+    }
+
+    KeyRange keyRange( const std::vector< glm::quat > & ){
+        return KeyRange();
+    }
+
+    PackedKey packKey( const glm::vec3 & _value, const KeyRange & _range ){
+        PackedKey key;
+        for ( int i = 0; i < 3; i++ ){
+            const float steps = _range.scale[ i ] > 0.0f ?
+                std::round( ( _value[ i ] - _range.min[ i ] ) / _range.scale[ i ] ) : 0.0f;
+            key[ i ] = static_cast< uint16_t >( std::clamp( steps, 0.0f, 65535.0f ) );
+        }
+        return key;
+    }
+
+    PackedKey packKey( const glm::quat & _value, const KeyRange & ){
+        const glm::quat unit = glm::normalize( _value );
+        const float components[ 4 ] = { unit.x, unit.y, unit.z, unit.w };
+        uint32_t largest = 0;
+        for ( uint32_t i = 1; i < 4; i++ ){
+            if ( std::abs( components[ i ] ) > std::abs( components[ largest ] ) ){
+                largest = i;
+            }
+        }
+        // q and -q are the same rotation, so the dropped component is
+        // made positive
+        const float sign = components[ largest ] < 0.0f ? -1.0f : 1.0f;
+        uint16_t smallest[ 3 ];
+        uint32_t next = 0;
+        for ( uint32_t i = 0; i < 4; i++ ){
+            if ( i == largest ){
+                continue;
+            }
+            const float normalised = ( components[ i ] * sign + 0.70710678f ) / 1.41421356f;
+            smallest[ next++ ] = static_cast< uint16_t >(
+                std::clamp( std::round( normalised * 32767.0f ), 0.0f, 32767.0f ) );
+        }
+        return { static_cast< uint16_t >( smallest[ 0 ] | ( ( largest & 1 ) << 15 ) ),
+                 static_cast< uint16_t >( smallest[ 1 ] | ( ( largest >> 1 ) << 15 ) ),
+                 smallest[ 2 ] };
+    }
+
+}
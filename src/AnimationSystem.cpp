@@ -0,0 +1,185 @@
+#include "AnimationSystem.h"
+#include "Skeleton.h"
+#include "Camera.h"
+#include <algorithm>
+
+namespace GL_Engine {
+
+    AnimationSystem::AnimationSystem( JobSystem & _jobs ) : jobs( _jobs ){}
+
+    AnimationSystem::~AnimationSystem(){
+        jobs.wait( counter );
+    }
+
+    void AnimationSystem::submit( Skeleton & _skeleton, unsigned int _animationId, double _time,
+                                  const glm::vec4 & _bounds ){
+        submit( Request{ &_skeleton, nullptr, _animationId, _time, _bounds, 0, 1, 0 } );
+    }
+
+    void AnimationSystem::submit( Skeleton & _skeleton, const BlendTree & _tree, double _time,
+                                  const glm::vec4 & _bounds ){
+        submit( Request{ &_skeleton, &_tree, 0, _time, _bounds, 0, 1, 0 } );
+    }
+
+    void AnimationSystem::submit( const Request & _request ){
+        auto found = pendingIndex.find( _request.skeleton );
+        if ( found != pendingIndex.end() ){
+            pending[ found->second ] = _request;
+            return;
+        }
+        pendingIndex.emplace( _request.skeleton, pending.size() );
+        pending.push_back( _request );
+    }
+
+    void AnimationSystem::cancel( Skeleton & _skeleton ){
+        auto found = pendingIndex.find( &_skeleton );
+        if ( found != pendingIndex.end() ){
+            const size_t index = found->second;
+            pendingIndex.erase( found );
+            if ( index != pending.size() - 1 ){
+                pending[ index ] = pending.back();
+                pendingIndex[ pending[ index ].skeleton ] = index;
+            }
+            pending.pop_back();
+        }
+        auto posing = std::find_if( running.begin(), running.end(), [ & ]( const Request & _request ){
+            return _request.skeleton == &_skeleton;
+        } );
+        if ( posing != running.end() ){
+            jobs.wait( counter );
+            running.erase( posing );
+        }
+    }
+
+    void AnimationSystem::setLodTiers( std::vector< LodTier > _tiers ){
+        tiers = std::move( _tiers );
+    }
+
+    const std::vector< AnimationSystem::LodTier > & AnimationSystem::getLodTiers() const {
+        return tiers;
+    }
+
+    void AnimationSystem::setViewer( const glm::vec3 & _position, float _projectionScale ){
+        viewerPosition = _position;
+        projectionScale = _projectionScale;
+        hasViewer = true;
+        viewerCamera = nullptr;
+    }
+
+    void AnimationSystem::setViewer( const Camera * _camera ){
+        viewerCamera = _camera;
+        hasViewer = false;
+    }
+
+    uint32_t AnimationSystem::selectTier( const glm::vec4 & _bounds ) const {
+        if ( tiers.empty() || !hasViewer || _bounds.w < 0.0f ){
+            return 0;
+        }
+        const float distance = glm::length( glm::vec3( _bounds ) - viewerPosition );
+        // Half the viewport's height spans the cotangent at unit distance
+        const float screenSize = distance > _bounds.w ?
+            _bounds.w * projectionScale / ( 2.0f * distance ) : FLT_MAX;
+        for ( uint32_t tier = 0; tier < tiers.size(); tier++ ){
+            if ( distance <= tiers[ tier ].maxDistance && screenSize >= tiers[ tier ].minScreenSize ){
+                return tier;
+            }
+        }
+        return static_cast< uint32_t >( tiers.size() - 1 );
+    }
+
+    void AnimationSystem::dispatch(){
+        if ( !running.empty() ){
+            return;
+        }
+        if ( pending.empty() ){
+            statistics = Statistics();
+            return;
+        }
+        if ( viewerCamera ){
+            viewerPosition = viewerCamera->getCameraPosition();
+            projectionScale = viewerCamera->getProjectionMatrix()[ 1 ][ 1 ];
+            hasViewer = true;
+        }
+        dispatched = Statistics();
+        dispatched.submitted = static_cast< uint32_t >( pending.size() );
+        for ( auto & request : pending ){
+            request.tier = selectTier( request.bounds );
+            request.interval = tiers.empty() ? 1 : tiers[ request.tier ].interval;
+            if ( request.interval == 0 ){
+                dispatched.frozen++;
+            }
+            else if ( request.interval == 1 ){
+                dispatched.posed++;
+            }
+            else {
+                dispatched.blended++;
+            }
+        }
+        // Frozen skeletons keep their published pose
+        pending.erase( std::remove_if( pending.begin(), pending.end(), []( const Request & _request ){
+            return _request.interval == 0;
+        } ), pending.end() );
+        running.swap( pending );
+        pendingIndex.clear();
+        if ( running.empty() ){
+            statistics = dispatched;
+            return;
+        }
+
+        // A few batches per thread, so workers that finish early steal
+        // the remainder
+        const size_t threads = jobs.getWorkerCount() + 1;
+        const size_t batch = std::max( MinBatch, running.size() / ( threads * 4 ) + 1 );
+        for ( size_t begin = 0; begin < running.size(); begin += batch ){
+            const size_t end = std::min( begin + batch, running.size() );
+            jobs.schedule( [ this, begin, end ](){
+                for ( size_t i = begin; i < end; i++ ){
+                    Request & request = running[ i ];
+                    Skeleton & skeleton = *request.skeleton;
+                    if ( request.tree ){
+                        request.sampled = request.interval == 1 ?
+                            skeleton.pose( *request.tree, request.time, request.tier ) :
+                            skeleton.poseBlended( *request.tree, request.time, request.interval, request.tier );
+                    }
+                    else {
+                        request.sampled = request.interval == 1 ?
+                            skeleton.pose( request.animationId, request.time, request.tier ) :
+                            skeleton.poseBlended( request.animationId, request.time,
+                                                  request.interval, request.tier );
+                    }
+                }
+            }, &counter );
+        }
+    }
+
+    void AnimationSystem::publish(){
+        if ( running.empty() ){
+            return;
+        }
+        jobs.wait( counter );
+        for ( const auto & request : running ){
+            request.skeleton->publish();
+            dispatched.jointsSampled += request.sampled;
+        }
+        running.clear();
+        statistics = dispatched;
+    }
+
+    size_t AnimationSystem::getPendingCount() const {
+        return pending.size();
+    }
+
+    size_t AnimationSystem::getRunningCount() const {
+        return running.size();
+    }
+
+    const AnimationSystem::Statistics & AnimationSystem::getStatistics() const {
+        return statistics;
+    }
+
+    AnimationSystem & AnimationSystem::get(){
+        static AnimationSystem system;
+        return system;
+    }
+
+}
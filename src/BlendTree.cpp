@@ -0,0 +1,227 @@
+#include "BlendTree.h"
+#include "Skeleton.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace GL_Engine {
+
+    // Normalised lerp along the shorter arc, which is close to slerp for
+    // the nearby rotations blended here and far cheaper
+    static inline glm::quat nlerp( const glm::quat & _a, const glm::quat & _b, float _t ){
+        const float sign = glm::dot( _a, _b ) < 0.0f ? -1.0f : 1.0f;
+        return glm::normalize( _a * ( 1.0f - _t ) + _b * ( _t * sign ) );
+    }
+
+    /*-------------LocalPose------------*/
+
+    void LocalPose::resize( uint32_t _joints ){
+        translations.resize( _joints );
+        rotations.resize( _joints );
+        scales.resize( _joints );
+    }
+
+    uint32_t LocalPose::size() const {
+        return static_cast< uint32_t >( translations.size() );
+    }
+
+    /*-------------PosePool------------*/
+
+    PosePool::Lease::Lease( PosePool & _pool, std::unique_ptr< LocalPose > _pose ) :
+        pool( &_pool ), pose( std::move( _pose ) ){}
+
+    PosePool::Lease::~Lease(){
+        if ( pose ){
+            pool->release( std::move( pose ) );
+        }
+    }
+
+    LocalPose & PosePool::Lease::operator*() const {
+        return *pose;
+    }
+
+    LocalPose * PosePool::Lease::operator->() const {
+        return pose.get();
+    }
+
+    PosePool::Lease PosePool::acquire( uint32_t _joints ){
+        std::unique_ptr< LocalPose > pose;
+        {
+            std::lock_guard< std::mutex > lock( mutex );
+            if ( !free.empty() ){
+                pose = std::move( free.back() );
+                free.pop_back();
+            }
+            else {
+                created++;
+            }
+        }
+        if ( !pose ){
+            pose = std::make_unique< LocalPose >();
+        }
+        // Buffers only grow, so a reused buffer has room
+        pose->resize( _joints );
+        return Lease( *this, std::move( pose ) );
+    }
+
+    void PosePool::release( std::unique_ptr< LocalPose > _pose ){
+        std::lock_guard< std::mutex > lock( mutex );
+        free.push_back( std::move( _pose ) );
+    }
+
+    size_t PosePool::getCreatedCount() const {
+        std::lock_guard< std::mutex > lock( mutex );
+        return created;
+    }
+
+    size_t PosePool::getFreeCount() const {
+        std::lock_guard< std::mutex > lock( mutex );
+        return free.size();
+    }
+
+    PosePool & PosePool::get(){
+        static PosePool pool;
+        return pool;
+    }
+
+    /*-------------BlendTree------------*/
+
+    BlendTree::NodeId BlendTree::add( const Node & _node ){
+        // Inputs precede the node, which also keeps the tree acyclic
+        if ( _node.type != NodeType::Clip &&
+             ( _node.inputs[ 0 ] >= nodes.size() || _node.inputs[ 1 ] >= nodes.size() ) ){
+            throw std::runtime_error( "Blend tree inputs must be nodes already added" );
+        }
+        nodes.push_back( _node );
+        return static_cast< NodeId >( nodes.size() - 1 );
+    }
+
+    BlendTree::NodeId BlendTree::addClip( uint32_t _clip, double _start, float _speed, bool _loop ){
+        return add( Node{ NodeType::Clip, { 0, 0 }, 1.0f, _clip, _start, _speed, _loop, 0 } );
+    }
+
+    BlendTree::NodeId BlendTree::addBlend( NodeId _from, NodeId _to, float _weight ){
+        return add( Node{ NodeType::Blend, { _from, _to }, _weight, 0, 0.0, 1.0f, false, 0 } );
+    }
+
+    BlendTree::NodeId BlendTree::addAdditive( NodeId _base, NodeId _additive, float _weight ){
+        if ( _additive < nodes.size() && nodes[ _additive ].type != NodeType::Clip ){
+            throw std::runtime_error( "Additive input must be a clip node" );
+        }
+        return add( Node{ NodeType::Additive, { _base, _additive }, _weight, 0, 0.0, 1.0f, false, 0 } );
+    }
+
+    BlendTree::NodeId BlendTree::addLayer( NodeId _base, NodeId _layer, std::vector< float > _mask, float _weight ){
+        const uint32_t mask = static_cast< uint32_t >( masks.size() );
+        const NodeId node = add( Node{ NodeType::Layer, { _base, _layer }, _weight, 0, 0.0, 1.0f, false, mask } );
+        masks.push_back( std::move( _mask ) );
+        return node;
+    }
+
+    void BlendTree::setWeight( NodeId _node, float _weight ){
+        nodes[ _node ].weight = _weight;
+    }
+
+    float BlendTree::getWeight( NodeId _node ) const {
+        return nodes[ _node ].weight;
+    }
+
+    void BlendTree::setStart( NodeId _node, double _start ){
+        nodes[ _node ].start = _start;
+    }
+
+    void BlendTree::setSpeed( NodeId _node, float _speed ){
+        nodes[ _node ].speed = _speed;
+    }
+
+    size_t BlendTree::size() const {
+        return nodes.size();
+    }
+
+    std::vector< float > BlendTree::subtreeMask( const Skeleton & _skeleton, uint32_t _joint ){
+        // Parents precede children, so one pass marks every descendant
+        std::vector< float > mask( _skeleton.getJointCount(), 0.0f );
+        for ( uint32_t joint = _joint; joint < mask.size(); joint++ ){
+            const uint32_t parent = _skeleton.getParent( joint );
+            if ( joint == _joint || ( parent != Skeleton::NoJoint && mask[ parent ] > 0.0f ) ){
+                mask[ joint ] = 1.0f;
+            }
+        }
+        return mask;
+    }
+
+    double BlendTree::clipTime( const Node & _node, const Skeleton & _skeleton, double _time ) const {
+        const double length = _skeleton.getClipLength( _node.clip );
+        const double time = ( _time - _node.start ) * _node.speed;
+        if ( length <= 0.0 ){
+            return 0.0;
+        }
+        if ( !_node.loop ){
+            return std::clamp( time, 0.0, length );
+        }
+        const double wrapped = std::fmod( time, length );
+        return wrapped < 0.0 ? wrapped + length : wrapped;
+    }
+
+    uint32_t BlendTree::evaluate( Skeleton & _skeleton, double _time, uint32_t _tier, LocalPose & _pose,
+                                  PosePool & _pool ) const {
+        _pose.resize( _skeleton.getJointCount() );
+        if ( nodes.empty() ){
+            return 0;
+        }
+        return evaluate( static_cast< NodeId >( nodes.size() - 1 ), _skeleton, _time, _tier, _pose, _pool );
+    }
+
+    uint32_t BlendTree::evaluate( NodeId _node, Skeleton & _skeleton, double _time, uint32_t _tier,
+                                  LocalPose & _pose, PosePool & _pool ) const {
+        const Node & node = nodes[ _node ];
+        if ( node.type == NodeType::Clip ){
+            return _skeleton.sampleClip( node.clip, clipTime( node, _skeleton, _time ), _tier, _pose );
+        }
+        // Skip inputs that do not contribute
+        if ( node.weight <= 0.0f ){
+            return evaluate( node.inputs[ 0 ], _skeleton, _time, _tier, _pose, _pool );
+        }
+        if ( node.type == NodeType::Blend && node.weight >= 1.0f ){
+            return evaluate( node.inputs[ 1 ], _skeleton, _time, _tier, _pose, _pool );
+        }
+
+        const uint32_t jointCount = _pose.size();
+        uint32_t sampled = evaluate( node.inputs[ 0 ], _skeleton, _time, _tier, _pose, _pool );
+        auto input = _pool.acquire( jointCount );
+        sampled += evaluate( node.inputs[ 1 ], _skeleton, _time, _tier, *input, _pool );
+        const float weight = node.weight;
+
+        if ( node.type == NodeType::Additive ){
+            // The offset from the clip's first frame, sampled without
+            // disturbing the clip's cursors
+            auto reference = _pool.acquire( jointCount );
+            sampled += _skeleton.sampleClip( nodes[ node.inputs[ 1 ] ].clip, 0.0, _tier, *reference, false );
+            const glm::quat identity( 1.0f, 0.0f, 0.0f, 0.0f );
+            for ( uint32_t joint = 0; joint < jointCount; joint++ ){
+                const glm::vec3 & referenceScale = reference->scales[ joint ];
+                const glm::vec3 scale = glm::vec3( referenceScale.x != 0.0f ? input->scales[ joint ].x / referenceScale.x : 1.0f,
+                                                   referenceScale.y != 0.0f ? input->scales[ joint ].y / referenceScale.y : 1.0f,
+                                                   referenceScale.z != 0.0f ? input->scales[ joint ].z / referenceScale.z : 1.0f );
+                const glm::quat rotation = glm::inverse( reference->rotations[ joint ] ) * input->rotations[ joint ];
+                _pose.translations[ joint ] += ( input->translations[ joint ] - reference->translations[ joint ] ) * weight;
+                _pose.rotations[ joint ] = glm::normalize( _pose.rotations[ joint ] * nlerp( identity, rotation, weight ) );
+                _pose.scales[ joint ] *= glm::mix( glm::vec3( 1.0f ), scale, weight );
+            }
+            return sampled;
+        }
+
+        const std::vector< float > * mask = node.type == NodeType::Layer ? &masks[ node.mask ] : nullptr;
+        for ( uint32_t joint = 0; joint < jointCount; joint++ ){
+            const float t = mask ? weight * ( joint < mask->size() ? ( *mask )[ joint ] : 0.0f ) : weight;
+            if ( t <= 0.0f ){
+                continue;
+            }
+            _pose.translations[ joint ] = glm::mix( _pose.translations[ joint ], input->translations[ joint ], t );
+            _pose.rotations[ joint ] = nlerp( _pose.rotations[ joint ], input->rotations[ joint ], t );
+            _pose.scales[ joint ] = glm::mix( _pose.scales[ joint ], input->scales[ joint ], t );
+        }
+        return sampled;
+    }
+
+}
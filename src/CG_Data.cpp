@@ -1,7 +1,10 @@
 #include "CG_Data.h"
 #include <stdexcept>
+#include <cstring>
 #include <glm/vec3.hpp>
 #include "CG_Engine.h"
+#include "GLState.h"
+#include "Profiler.h"
 
 namespace GL_Engine{
 	namespace CG_Data{
@@ -45,7 +48,22 @@ namespace GL_Engine{
 
 		void VBO::SetVBOData(void* _Data, uint64_t _DataSize) const{
 			glBindBuffer(Target, this->ID);
+			//Streamed buffers keep orphaning, so a write never waits on the
+			//GPU reading the previous contents
+			if (_Data && _DataSize > 0 && _DataSize == StorageSize && Usage != GL_STREAM_DRAW) {
+				glBufferSubData(Target, 0, _DataSize, _Data);
+				return;
+			}
 			glBufferData(Target, _DataSize, _Data, Usage);
+			StorageSize = _DataSize;
+		}
+
+		void VBO::UpdateVBOData(const void* _Data, uint64_t _DataSize, uint64_t _Offset) const{
+			if (_Offset + _DataSize > StorageSize) {
+				throw std::runtime_error("VBO update out of range");
+			}
+			glBindBuffer(Target, this->ID);
+			glBufferSubData(Target, _Offset, _DataSize, _Data);
 		}
 #pragma endregion
 
@@ -64,6 +82,7 @@ namespace GL_Engine{
 				}
 				VBOs.clear();
 				glDeleteVertexArrays(1, &this->VAOId);
+				StateCache::vertexArrayDeleted(this->VAOId);
 				initialised = false;
 			}
 		}
@@ -76,6 +95,7 @@ namespace GL_Engine{
 				}
 				VBOs.clear();
 				glDeleteVertexArrays(1, &this->VAOId);
+				StateCache::vertexArrayDeleted(this->VAOId);
 				initialised = false;
 			}
 		}
@@ -84,12 +104,20 @@ namespace GL_Engine{
 			return this->numIndices;
 		}
 
+		const BoundingVolume & VAO::GetBounds() const{
+			return this->Bounds;
+		}
+
+		void VAO::SetBounds(const BoundingVolume &_Bounds){
+			this->Bounds = _Bounds;
+		}
+
 		const GLuint VAO::GetID() const{
 			return this->VAOId;
 		}
 
 		void VAO::BindVAO() const{
-			glBindVertexArray(this->VAOId);
+			StateCache::bindVertexArray(this->VAOId);
 		}
 		void VAO::AddVBO(std::unique_ptr<VBO> _VBO) {
 			this->VBOs.push_back(std::move(_VBO));
@@ -102,8 +130,7 @@ namespace GL_Engine{
 			glGenTextures(1, &this->ID);
 			this->Target = _Target;
 			this->Unit = _Unit;
-			glActiveTexture(this->Unit);
-			glBindTexture(this->Target, this->ID);
+			StateCache::bindTexture(this->Unit, this->Target, this->ID);
 			_Parameters();
 
 			glTexImage2D(this->Target, 0, GL_RGBA, width, height, 0, _ImageFormat, GL_UNSIGNED_BYTE, _Data);
@@ -122,8 +149,7 @@ namespace GL_Engine{
 			glGenTextures(1, &this->ID);
 			this->Target = _Target;
 			this->Unit = _Unit;
-			glActiveTexture(this->Unit);
-			glBindTexture(this->Target, this->ID);
+			StateCache::bindTexture(this->Unit, this->Target, this->ID);
 			_Parameters();
 			Initialised = true;
 		}
@@ -138,12 +164,14 @@ namespace GL_Engine{
 		Texture::~Texture() {
 			if (Initialised) {
 				glDeleteTextures(1, &this->ID);
+				StateCache::textureDeleted(this->ID);
 				Initialised = false;
 			}
 		}
 		void Texture::Cleanup() {
 			if (Initialised) {
 				glDeleteTextures(1, &this->ID);
+				StateCache::textureDeleted(this->ID);
 				Initialised = false;
 			}
 		}
@@ -153,8 +181,7 @@ namespace GL_Engine{
 		}
 
 		void Texture::Bind() {
-			glActiveTexture(this->Unit);
-			glBindTexture(this->Target, this->ID);
+			StateCache::bindTexture(this->Unit, this->Target, this->ID);
 		}
 
 		const GLuint Texture::GetID() const { return this->ID; }
@@ -188,10 +215,11 @@ namespace GL_Engine{
 
 		void Uniform::SetID(GLint _ID) {
 			this->ID = _ID;
+			//New location (i.e. the program was relinked), so the value is gone
+			this->ShadowValid = false;
 		}
 
 		void Uniform::SetData(const void* _Data) {
-			this->NeedsUpdating = true;
 			this->Data = _Data;
 		}
 
@@ -199,16 +227,72 @@ namespace GL_Engine{
 			return this->Data; 
 		}
 
+		size_t Uniform::GetDataSize() const {
+			return Uploader ? Shadow.size() : 0;
+		}
+
 		void Uniform::Update() const{
 			if (!Initialised)
 				return;
+			if (Uploader) {
+				//No data, e.g. the linked entity lacks the component
+				static std::vector<uint8_t> Zeros;
+				const void *data = Data;
+				if (!data) {
+					if (Zeros.size() < Shadow.size())
+						Zeros.resize(Shadow.size(), 0);
+					data = Zeros.data();
+				}
+				if (ShadowValid && std::memcmp(Shadow.data(), data, Shadow.size()) == 0) {
+					FrameStatistics.skipped++;
+					return;
+				}
+				std::memcpy(Shadow.data(), data, Shadow.size());
+				ShadowValid = true;
+				FrameStatistics.issued++;
+				Uploader(ID, data, Count);
+				return;
+			}
+			//A callback has no size to fill with zeros, so keeps the last value
+			if (!Data)
+				return;
+			FrameStatistics.issued++;
 			UpdateCallback(*this);
 		}
 		void Uniform::SetUpdateCallback( 
 			std::function< void( const CG_Data::Uniform &u )> _callback ){
 			this->UpdateCallback = _callback;
+			this->Uploader = nullptr;
 			this->Initialised = true;
 		}
+
+		void Uniform::SetUploader(UniformUploader _Uploader, GLsizei _Count, size_t _ElementSize) {
+			this->Uploader = _Uploader;
+			this->Count = _Count;
+			this->Shadow.resize(_ElementSize * _Count);
+			this->ShadowValid = false;
+			this->Initialised = true;
+		}
+
+		void Uniform::Invalidate() {
+			this->ShadowValid = false;
+		}
+
+		Uniform::Statistics Uniform::FrameStatistics;
+		Uniform::Statistics Uniform::LastFrameStatistics;
+
+		const Uniform::Statistics & Uniform::GetStatistics() {
+			return LastFrameStatistics;
+		}
+
+		const Uniform::Statistics & Uniform::GetCurrentStatistics() {
+			return FrameStatistics;
+		}
+
+		void Uniform::EndFrame() {
+			LastFrameStatistics = FrameStatistics;
+			FrameStatistics = Statistics();
+		}
 #pragma endregion
 
 #pragma region UBO
@@ -220,7 +304,7 @@ namespace GL_Engine{
 			this->Usage = GL_DYNAMIC_DRAW;
 			this->SetVBOData(Data, DataSize);
 			this->BindingPost = UBO_Count++;
-			glBindBufferBase(GL_UNIFORM_BUFFER, this->BindingPost, this->ID);
+			StateCache::bindBufferBase(GL_UNIFORM_BUFFER, this->BindingPost, this->ID);
 		}
 		UBO::~UBO() {
 			this->Cleanup();
@@ -232,14 +316,40 @@ namespace GL_Engine{
 		}
 
 		void UBO::UpdateUBO() const {
-			glBindBuffer(GL_UNIFORM_BUFFER, this->ID);
-			GLvoid* UBO_Pointer = glMapBuffer(GL_UNIFORM_BUFFER, GL_WRITE_ONLY);
-			memcpy(UBO_Pointer, this->Data, this->DataSize);
-			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			auto &ring = RingBuffer::Uniforms();
+			const bool changed = Shadow.size() != DataSize ||
+				memcmp(Shadow.data(), this->Data, this->DataSize) != 0;
+			if (!changed) {
+				if (ring.IsLive(Current)) {
+					StateCache::bindBufferRange(GL_UNIFORM_BUFFER, this->BindingPost,
+												Current.buffer, Current.offset, Current.size);
+					return;
+				}
+				if (!Current.Valid()) {
+					//Last written to our own buffer, which still holds it
+					StateCache::bindBufferBase(GL_UNIFORM_BUFFER, this->BindingPost, this->ID);
+					return;
+				}
+			}
+
+			const auto bytes = static_cast<const uint8_t*>(this->Data);
+			Shadow.assign(bytes, bytes + this->DataSize);
+			Current = ring.Write(this->Data, this->DataSize);
+			if (Current.Valid()) {
+				StateCache::bindBufferRange(GL_UNIFORM_BUFFER, this->BindingPost,
+											Current.buffer, Current.offset, Current.size);
+				return;
+			}
+			//The ring is full for this frame
+			this->UpdateVBOData(this->Data, this->DataSize);
+			StateCache::bindBufferBase(GL_UNIFORM_BUFFER, this->BindingPost, this->ID);
 		}
 		const GLuint UBO::GetBindingPost()const {
 			return this->BindingPost;
 		}
+		GLuint UBO::ReserveBindingPost() {
+			return UBO_Count++;
+		}
 
 #pragma endregion
 
@@ -305,6 +415,7 @@ namespace GL_Engine{
 			void FBO::cleanup() {
 				if ( initialised ) {
 					glDeleteFramebuffers( 1, &this->ID );
+					StateCache::framebufferDeleted( this->ID );
 					initialised = false;
 				}
 			}
@@ -328,7 +439,7 @@ namespace GL_Engine{
 				case DepthTexture: {
 					GLuint depthTextureId;
 					glGenTextures( 1, &depthTextureId );
-					glBindTexture( GL_TEXTURE_2D, depthTextureId );
+					StateCache::bindTexture( GL_TEXTURE_2D, depthTextureId );
 					glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
 									 GL_NEAREST );
 					glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
@@ -404,7 +515,7 @@ namespace GL_Engine{
 			FBO::FramebufferBindToken FBO::bind(uint16_t _Count, const GLenum* _ColourAttachments) const {
 				if (!this->complete)
 					throw std::runtime_error("Attempting to bind incomplete framebuffer!\n");
-				glBindTexture(GL_TEXTURE_2D, 0);
+				StateCache::bindTexture(GL_TEXTURE_2D, 0);
 				auto bindToken = staticBind( this->ID );
 				glClearColor(0.0, 0.0, 0.0, 1.0);
 				for (int i = 0; i < _Count; i++) {
@@ -419,16 +530,28 @@ namespace GL_Engine{
 			const GLuint FBO::getID() const {
 				return this->ID;
 			}
+			uint16_t FBO::getWidth() const {
+				return this->width;
+			}
+			uint16_t FBO::getHeight() const {
+				return this->height;
+			}
 
+			bool FBO::isComplete() const {
+				return this->complete;
+			}
 			void FBO::unbind() const {
 				staticUnbind( this->ID );
 			}
 
 			std::list<GLuint> FBO::FramebufferStack;
+			GLuint FBO::DefaultFramebuffer = 0;
+			std::list<uint32_t> FBO::FramebufferProfileEvents;
 
 			FBO::FramebufferBindToken FBO::staticBind( GLuint id ) {
-				glBindFramebuffer( GL_FRAMEBUFFER, id );
+				StateCache::bindFramebuffer( id );
 				FramebufferStack.push_back( id );
+				FramebufferProfileEvents.push_back( Profiler::get().begin( "Framebuffer" ) );
 				return FramebufferBindToken( id );
 			}
 
@@ -438,11 +561,16 @@ namespace GL_Engine{
 					throw std::runtime_error( "Attempting to unbind untracked framebuffer!\n" );
 				}
 
+				auto profileEvent = std::next( FramebufferProfileEvents.begin(),
+					std::distance( entry, FramebufferStack.crend() ) - 1 );
+				Profiler::get().end( *profileEvent );
+				FramebufferProfileEvents.erase( profileEvent );
+
 				if ( entry == FramebufferStack.crbegin() ) {
 					FramebufferStack.pop_back();
 					const auto newFboIdIt = FramebufferStack.crbegin();
-					const auto newFboId = newFboIdIt == FramebufferStack.crend() ? 0 : *newFboIdIt;
-					glBindFramebuffer( GL_FRAMEBUFFER, newFboId );
+					const auto newFboId = newFboIdIt == FramebufferStack.crend() ? DefaultFramebuffer : *newFboIdIt;
+					StateCache::bindFramebuffer( newFboId );
 					glViewport( 0, 0, CG_Engine::ViewportWidth, CG_Engine::ViewportHeight );
 				}
 				else {
@@ -450,5 +578,16 @@ namespace GL_Engine{
 				}
 			}
 
+			void FBO::setDefaultFramebuffer( GLuint id ) {
+				DefaultFramebuffer = id;
+				if ( FramebufferStack.empty() ) {
+					StateCache::bindFramebuffer( id );
+				}
+			}
+
+			GLuint FBO::getDefaultFramebuffer() {
+				return DefaultFramebuffer;
+			}
+
 	}
 }
\ No newline at end of file
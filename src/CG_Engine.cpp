@@ -1,9 +1,28 @@
 #include "CG_Engine.h"
 #include "Common.h"
+#include "FrameArena.h"
+#include "CG_Data.h"
+#include "Profiler.h"
+#include "QueryPool.h"
+#include "JobSystem.h"
+#include "AnimationSystem.h"
+#include "TransformStore.h"
+#include "SpatialIndex.h"
 #include <stdexcept>
+#include <cstring>
+#ifdef CG_ENGINE_HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
 
 namespace GL_Engine{
 
+#ifdef CG_ENGINE_HEADLESS
+	static EGLDisplay HeadlessDisplay = EGL_NO_DISPLAY;
+	static EGLContext HeadlessContext = EGL_NO_CONTEXT;
+#endif
+	static std::shared_ptr<CG_Data::FBO> OffscreenFramebuffer;
+
 	CG_Engine::CG_Engine(){
 	}
 
@@ -37,11 +56,157 @@ namespace GL_Engine{
 		return true;
 	}
 
+	bool CG_Engine::CG_CreateHeadlessContext(Properties::HeadlessProperties *_HeadlessProperties){
+#ifdef CG_ENGINE_HEADLESS
+		if (HeadlessContext != EGL_NO_CONTEXT)
+			return false;
+
+		//Prefer Mesa's surfaceless platform, which needs no display server
+		//or device node
+		EGLDisplay display = EGL_NO_DISPLAY;
+		auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay)
+			display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		if (display == EGL_NO_DISPLAY)
+			display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+			return false;
+
+		const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+		if (!extensions || !std::strstr(extensions, "EGL_KHR_surfaceless_context") ||
+			!eglBindAPI(EGL_OPENGL_API)) {
+			eglTerminate(display);
+			return false;
+		}
+
+		const EGLint configAttributes[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+			EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configCount = 0;
+		if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+			eglTerminate(display);
+			return false;
+		}
+
+		const EGLint contextAttributes[] = {
+			EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+			EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+			EGL_NONE
+		};
+		EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+		if (context == EGL_NO_CONTEXT) {
+			eglTerminate(display);
+			return false;
+		}
+		if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+			eglDestroyContext(display, context);
+			eglTerminate(display);
+			return false;
+		}
+
+		HeadlessDisplay = display;
+		HeadlessContext = context;
+		ViewportWidth = _HeadlessProperties->width;
+		ViewportHeight = _HeadlessProperties->height;
+		return true;
+#else
+		(void)_HeadlessProperties;
+		return false;
+#endif
+	}
+
+	void CG_Engine::CG_DestroyHeadlessContext(){
+#ifdef CG_ENGINE_HEADLESS
+		if (HeadlessContext == EGL_NO_CONTEXT)
+			return;
+		Shutdown();
+		CG_Data::FBO::setDefaultFramebuffer(0);
+		OffscreenFramebuffer.reset();
+		eglMakeCurrent(HeadlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(HeadlessDisplay, HeadlessContext);
+		eglTerminate(HeadlessDisplay);
+		HeadlessContext = EGL_NO_CONTEXT;
+		HeadlessDisplay = EGL_NO_DISPLAY;
+#endif
+	}
+
 	bool CG_Engine::CG_StartGlad(Properties::GLADproperties * _GladProperties){
-		_GladProperties->success = gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+		if (!IsHeadless()) {
+			_GladProperties->success = gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+			return _GladProperties->success;
+		}
+#ifdef CG_ENGINE_HEADLESS
+		_GladProperties->success = gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+		if (!_GladProperties->success)
+			return false;
+
+		//Surfaceless contexts have no default framebuffer, so render to
+		//one of our own wherever the window's would be used
+		const uint16_t width = (uint16_t)ViewportWidth, height = (uint16_t)ViewportHeight;
+		OffscreenFramebuffer = std::make_shared<CG_Data::FBO>(width, height);
+		OffscreenFramebuffer->addAttachment(CG_Data::FBO::ColourTexture, width, height);
+		OffscreenFramebuffer->addAttachment(CG_Data::FBO::DepthRenderbuffer, width, height);
+		if (!OffscreenFramebuffer->isComplete()) {
+			OffscreenFramebuffer.reset();
+			_GladProperties->success = false;
+			return false;
+		}
+		CG_Data::FBO::setDefaultFramebuffer(OffscreenFramebuffer->getID());
+		glDrawBuffer(GL_COLOR_ATTACHMENT0);
+		glViewport(0, 0, width, height);
+#endif
 		return _GladProperties->success;
 	}
 
+	bool CG_Engine::IsHeadless(){
+#ifdef CG_ENGINE_HEADLESS
+		return HeadlessContext != EGL_NO_CONTEXT;
+#else
+		return false;
+#endif
+	}
+
+	std::shared_ptr<CG_Data::FBO> CG_Engine::GetOffscreenFramebuffer(){
+		return OffscreenFramebuffer;
+	}
+
+	void CG_Engine::BeginFrame(){
+		{
+			//Pose this frame's skeletons on the workers while the frame is
+			//culled and drawn with the last published poses
+			CG_PROFILE_SCOPE("AnimationSystem::dispatch");
+			AnimationSystem::get().dispatch();
+		}
+		{
+			//Rebuild every moved entity's matrix in one batch, before bounds
+			//and draw blocks read them
+			CG_PROFILE_SCOPE("TransformStore::update");
+			TransformStore::get().update();
+		}
+		{
+			CG_PROFILE_SCOPE("SpatialIndex::update");
+			SpatialIndex::get().update();
+		}
+	}
+
+	void CG_Engine::EndFrame(){
+		AnimationSystem::get().publish();
+		JobSystem::get().runMainThreadJobs();
+		FrameArena::get().reset();
+		CG_Data::Uniform::EndFrame();
+		CG_Data::RingBuffer::EndFrameAll();
+		CG_Data::QueryPool::Get().EndFrame();
+		Profiler::get().endFrame();
+	}
+
+	void CG_Engine::Shutdown(){
+		CG_Data::RingBuffer::ReleaseShared();
+	}
+
 
 
 
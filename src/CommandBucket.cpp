@@ -0,0 +1,111 @@
+#include "CommandBucket.h"
+#include "Entity.h"
+#include "Profiler.h"
+
+namespace GL_Engine {
+
+    void CommandBucket::clear(){
+        this->commands.clear();
+    }
+
+    void CommandBucket::submit( uint64_t _key, RenderPass * _pass ){
+        this->commands.push_back( Command{ _key, _pass } );
+    }
+
+    void CommandBucket::submit( RenderPass * _pass ){
+        this->submit( makeKey( *_pass ), _pass );
+    }
+
+    void CommandBucket::sort(){
+        const size_t count = this->commands.size();
+        if ( count < 2 ) {
+            return;
+        }
+
+        // Build the histograms for all 8 key bytes in one sweep
+        uint32_t histograms[ 8 ][ 256 ] = {};
+        for ( const auto & cmd : this->commands ) {
+            for ( int b = 0; b < 8; b++ ) {
+                histograms[ b ][ ( cmd.key >> ( b * 8 ) ) & 0xFF ]++;
+            }
+        }
+
+        this->scratch.resize( count );
+        Command * src = this->commands.data();
+        Command * dst = this->scratch.data();
+
+        for ( int b = 0; b < 8; b++ ) {
+            uint32_t * histogram = histograms[ b ];
+            const uint8_t firstDigit = ( src[ 0 ].key >> ( b * 8 ) ) & 0xFF;
+
+            // Every key shares this digit, so the pass would be a no-op
+            if ( histogram[ firstDigit ] == count ) {
+                continue;
+            }
+
+            uint32_t offset = 0;
+            for ( int d = 0; d < 256; d++ ) {
+                uint32_t c = histogram[ d ];
+                histogram[ d ] = offset;
+                offset += c;
+            }
+
+            for ( size_t i = 0; i < count; i++ ) {
+                const uint8_t digit = ( src[ i ].key >> ( b * 8 ) ) & 0xFF;
+                dst[ histogram[ digit ]++ ] = src[ i ];
+            }
+            std::swap( src, dst );
+        }
+
+        // Odd number of scatter passes leaves the result in the scratch
+        if ( src != this->commands.data() ) {
+            this->commands.swap( this->scratch );
+        }
+    }
+
+    void CommandBucket::execute() const {
+        for ( const auto & cmd : this->commands ) {
+            CG_PROFILE_SCOPE( cmd.pass->name );
+            cmd.pass->renderFunction( *cmd.pass, cmd.pass->Data );
+        }
+    }
+
+    const std::vector< CommandBucket::Command > &
+    CommandBucket::getCommands() const {
+        return this->commands;
+    }
+
+    size_t CommandBucket::size() const {
+        return this->commands.size();
+    }
+
+    uint64_t CommandBucket::makeKey( uint8_t _layer, GLuint _shader,
+                                     uint16_t _material, GLuint _vao,
+                                     uint16_t _depth ){
+        return ( static_cast< uint64_t >( _layer & 0xF ) << 60 ) |
+               ( static_cast< uint64_t >( _shader & 0xFFF ) << 48 ) |
+               ( static_cast< uint64_t >( _material ) << 32 ) |
+               ( static_cast< uint64_t >( _vao & 0xFFFF ) << 16 ) |
+               static_cast< uint64_t >( _depth );
+    }
+
+    uint64_t CommandBucket::makeKey( const RenderPass & _pass ){
+        GLuint shaderId = _pass.shader ? _pass.shader->getShaderID() : 0;
+        GLuint vaoId = _pass.BatchVao ? _pass.BatchVao->GetID() : 0;
+
+        // Fold the texture IDs down to 16 bits (FNV-1a), so passes using the
+        // same texture set end up adjacent
+        uint32_t material = 2166136261u;
+        for ( const auto & tex : _pass.Textures ) {
+            if ( tex ) {
+                material = ( material ^ tex->GetID() ) * 16777619u;
+            }
+        }
+        material = _pass.Textures.empty() ? 0 : ( material ^ ( material >> 16 ) );
+
+        return makeKey( _pass.sortLayer, shaderId,
+                        static_cast< uint16_t >( material ), vaoId,
+                        _pass.sortDepth );
+    }
+
+}
@@ -0,0 +1,31 @@
+#include "ComponentRegistry.h"
+
+namespace GL_Engine {
+
+    void ComponentRegistry::destroy( EntityId _entity ){
+        for ( auto & pool : pools ){
+            if ( pool ){
+                pool->remove( _entity );
+            }
+        }
+    }
+
+    void ComponentRegistry::copy( EntityId _from, EntityId _to ){
+        for ( auto & pool : pools ){
+            if ( pool ){
+                pool->copy( _from, _to );
+            }
+        }
+    }
+
+    uint32_t ComponentRegistry::nextTypeId(){
+        static uint32_t next = 0;
+        return next++;
+    }
+
+    ComponentRegistry & ComponentRegistry::get(){
+        static ComponentRegistry registry;
+        return registry;
+    }
+
+}
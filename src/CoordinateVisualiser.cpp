@@ -79,7 +79,7 @@ void CoordinateVisualiser::initialise() {
     GLint buffSize{ 0 };
     m_coordinateVbo->BindVBO();
     glGetBufferParameteriv( GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &buffSize );
-    glBufferSubData( GL_ARRAY_BUFFER, 0, cx_originDataLen, (void*)cx_origin.data() );
+    m_coordinateVbo->UpdateVBOData( cx_origin.data(), cx_originDataLen );
     setCoordinateSystem( defaultCoordinateSystem );
     glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
     glEnableVertexAttribArray( 0 );
@@ -111,8 +111,7 @@ void CoordinateVisualiser::cleanup() {
 
 //-----------------------------------------------------------------------------
 void CoordinateVisualiser::setCoordinateSystem( glm::mat3 coordinateSystem ) {
-    m_coordinateVbo->BindVBO();
-    glBufferSubData( GL_ARRAY_BUFFER, cx_originDataLen, cx_coordSystemDataLen, (void*)&coordinateSystem );
+    m_coordinateVbo->UpdateVBOData( &coordinateSystem, cx_coordSystemDataLen, cx_originDataLen );
 }
 
 //-----------------------------------------------------------------------------
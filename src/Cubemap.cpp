@@ -1,4 +1,5 @@
 #include "Cubemap.h"
+#include "Profiler.h"
 
 namespace GL_Engine {
     const float Cubemap::vertices[24] = {
@@ -70,6 +71,7 @@ namespace GL_Engine {
     }
     void Cubemap::SetupRenderPass(Renderer *_Renderer) {
         this->CubeRenderPass = _Renderer->AddRenderPass(this->CubemapShader, std::function<void(RenderPass &, void*)>(Cubemap::CubemapRenderer), nullptr);
+        CubeRenderPass->name = "Cubemap";
         CubeRenderPass->SetDrawFunction([]() {glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0); });
         CubeRenderPass->BatchVao = CubemapVAO;
         CubeRenderPass->Textures.push_back(MapTexture);
@@ -189,6 +191,7 @@ namespace GL_Engine {
     }
 
     void EnvironmentMap::renderStaticMap(){
+        CG_PROFILE_SCOPE( "EnvironmentMap::static" );
         auto fbo = CG_Data::FBO( this->fbSize, this->fbSize );
         auto depthBuffer = fbo.addAttachment(
                              CG_Data::FBO::AttachmentType::DepthRenderbuffer,
@@ -220,7 +223,26 @@ namespace GL_Engine {
     void EnvironmentMap::renderDynamicMap(){
 
         auto bindToken = this->dynamicFbo->bind( 0 );
+        this->renderDynamicFaces();
+        std::move( bindToken ).unbind();
+    }
 
+    void EnvironmentMap::addPasses( RenderGraph & _graph ){
+        auto colour = _graph.importTexture( "EnvironmentMap",
+                                            this->dynamicColourTex );
+        _graph.addPass( "EnvironmentMap",
+            [ & ]( RenderGraph::PassBuilder & _builder ){
+                _builder.write( colour );
+                _builder.setFramebuffer( *this->dynamicFbo );
+            },
+            [ this ]( const RenderGraph & ){
+                this->renderDynamicFaces();
+            } );
+        _graph.markOutput( colour );
+    }
+
+    void EnvironmentMap::renderDynamicFaces(){
+        CG_PROFILE_SCOPE( "EnvironmentMap::dynamic" );
         // Render in all directions
         for( uint8_t i = 0; i < 6; i++ ){
             this->envCamera.environDirect( GL_TEXTURE_CUBE_MAP_POSITIVE_X + i );
@@ -237,6 +259,5 @@ namespace GL_Engine {
             glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
             this->dynamicRenderer->Render();
         }
-        std::move( bindToken ).unbind();
     }
 }
\ No newline at end of file
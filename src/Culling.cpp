@@ -0,0 +1,247 @@
+#include "Culling.h"
+#include "Entity.h"
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || \
+    ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#define CG_CULLING_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace GL_Engine {
+
+    /* --- BoundingVolume --- */
+
+    bool BoundingVolume::isEmpty() const {
+        return this->radius < 0.0f;
+    }
+
+    BoundingVolume BoundingVolume::fromPoints( const float * _points,
+                                               size_t _count, size_t _stride ){
+        if ( _count == 0 ) {
+            return BoundingVolume();
+        }
+        glm::vec3 bMin( _points[ 0 ], _points[ 1 ], _points[ 2 ] );
+        glm::vec3 bMax = bMin;
+        for ( size_t i = 1; i < _count; i++ ) {
+            const float * p = _points + i * _stride;
+            const glm::vec3 point( p[ 0 ], p[ 1 ], p[ 2 ] );
+            bMin = glm::min( bMin, point );
+            bMax = glm::max( bMax, point );
+        }
+
+        // Start from the box' sphere, then tighten the radius to the
+        // furthest point from its centre
+        BoundingVolume volume = fromBox( bMin, bMax );
+        float radiusSq = 0.0f;
+        for ( size_t i = 0; i < _count; i++ ) {
+            const float * p = _points + i * _stride;
+            const glm::vec3 d = glm::vec3( p[ 0 ], p[ 1 ], p[ 2 ] ) - volume.centre;
+            radiusSq = glm::max( radiusSq, glm::dot( d, d ) );
+        }
+        volume.radius = glm::sqrt( radiusSq );
+        return volume;
+    }
+
+    BoundingVolume BoundingVolume::fromBox( const glm::vec3 & _min,
+                                            const glm::vec3 & _max ){
+        BoundingVolume volume;
+        volume.min = _min;
+        volume.max = _max;
+        volume.centre = ( _min + _max ) * 0.5f;
+        volume.radius = glm::length( _max - volume.centre );
+        return volume;
+    }
+
+    BoundingVolume BoundingVolume::transformed( const glm::mat4 & _transform ) const {
+        if ( this->isEmpty() ) {
+            return *this;
+        }
+        // Refit the box (Arvo): the new half extents are the old ones
+        // through the absolute value of the upper 3x3
+        const glm::vec3 boxCentre = ( this->min + this->max ) * 0.5f;
+        const glm::vec3 halfExtents = ( this->max - this->min ) * 0.5f;
+        const glm::mat3 absolute( glm::abs( glm::vec3( _transform[ 0 ] ) ),
+                                  glm::abs( glm::vec3( _transform[ 1 ] ) ),
+                                  glm::abs( glm::vec3( _transform[ 2 ] ) ) );
+        const glm::vec3 newCentre = glm::vec3( _transform * glm::vec4( boxCentre, 1.0f ) );
+        const glm::vec3 newExtents = absolute * halfExtents;
+
+        BoundingVolume volume;
+        volume.min = newCentre - newExtents;
+        volume.max = newCentre + newExtents;
+        volume.centre = glm::vec3( _transform * glm::vec4( this->centre, 1.0f ) );
+
+        const float scaleSq = glm::max( glm::dot( glm::vec3( _transform[ 0 ] ), glm::vec3( _transform[ 0 ] ) ),
+                              glm::max( glm::dot( glm::vec3( _transform[ 1 ] ), glm::vec3( _transform[ 1 ] ) ),
+                                        glm::dot( glm::vec3( _transform[ 2 ] ), glm::vec3( _transform[ 2 ] ) ) ) );
+        volume.radius = this->radius * glm::sqrt( scaleSq );
+        return volume;
+    }
+
+    /* --- SphereList --- */
+
+    void SphereList::clear(){
+        x.clear();
+        y.clear();
+        z.clear();
+        r.clear();
+    }
+
+    void SphereList::push( const glm::vec3 & _centre, float _radius ){
+        x.push_back( _centre.x );
+        y.push_back( _centre.y );
+        z.push_back( _centre.z );
+        r.push_back( _radius );
+    }
+
+    void SphereList::push( const BoundingVolume & _volume ){
+        push( _volume.centre, _volume.radius );
+    }
+
+    size_t SphereList::size() const {
+        return r.size();
+    }
+
+    /* --- Frustum --- */
+
+    void Frustum::extract( const glm::mat4 & _pvMatrix ){
+        // glm is column major, so row i is ( m[0][i], m[1][i], m[2][i], m[3][i] )
+        auto row = [ &_pvMatrix ]( int i ){
+            return glm::vec4( _pvMatrix[ 0 ][ i ], _pvMatrix[ 1 ][ i ],
+                              _pvMatrix[ 2 ][ i ], _pvMatrix[ 3 ][ i ] );
+        };
+        const glm::vec4 planes[ 6 ] = {
+            row( 3 ) + row( 0 ), row( 3 ) - row( 0 ),   // Left, right
+            row( 3 ) + row( 1 ), row( 3 ) - row( 1 ),   // Bottom, top
+            row( 3 ) + row( 2 ), row( 3 ) - row( 2 )    // Near, far
+        };
+        for ( int i = 0; i < 6; i++ ) {
+            const float invLength = 1.0f / glm::length( glm::vec3( planes[ i ] ) );
+            planeA[ i ] = planes[ i ].x * invLength;
+            planeB[ i ] = planes[ i ].y * invLength;
+            planeC[ i ] = planes[ i ].z * invLength;
+            planeD[ i ] = planes[ i ].w * invLength;
+        }
+    }
+
+    bool Frustum::testSphere( const glm::vec3 & _centre, float _radius ) const {
+        for ( int i = 0; i < 6; i++ ) {
+            const float distance = planeA[ i ] * _centre.x + planeB[ i ] * _centre.y +
+                                   planeC[ i ] * _centre.z + planeD[ i ];
+            if ( distance < -_radius ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Frustum::Containment Frustum::testBox( const glm::vec3 & _centre,
+                                           const glm::vec3 & _halfExtents ) const {
+        Containment containment = Containment::Inside;
+        for ( int i = 0; i < 6; i++ ) {
+            const float distance = planeA[ i ] * _centre.x + planeB[ i ] * _centre.y +
+                                   planeC[ i ] * _centre.z + planeD[ i ];
+            // Extent of the box along the plane normal
+            const float extent = glm::abs( planeA[ i ] ) * _halfExtents.x +
+                                 glm::abs( planeB[ i ] ) * _halfExtents.y +
+                                 glm::abs( planeC[ i ] ) * _halfExtents.z;
+            if ( distance < -extent ) {
+                return Containment::Outside;
+            }
+            if ( distance < extent ) {
+                containment = Containment::Intersecting;
+            }
+        }
+        return containment;
+    }
+
+    void Frustum::testSpheres( const SphereList & _spheres, size_t _first,
+                               size_t _count, uint8_t * _visible ) const {
+        const float * xs = _spheres.x.data() + _first;
+        const float * ys = _spheres.y.data() + _first;
+        const float * zs = _spheres.z.data() + _first;
+        const float * rs = _spheres.r.data() + _first;
+        size_t i = 0;
+
+#ifdef CG_CULLING_SSE
+        for ( ; i + 4 <= _count; i += 4 ) {
+            const __m128 x = _mm_loadu_ps( xs + i );
+            const __m128 y = _mm_loadu_ps( ys + i );
+            const __m128 z = _mm_loadu_ps( zs + i );
+            const __m128 negR = _mm_sub_ps( _mm_setzero_ps(), _mm_loadu_ps( rs + i ) );
+
+            __m128 inside = _mm_cmpeq_ps( x, x );
+            for ( int p = 0; p < 6; p++ ) {
+                __m128 distance = _mm_mul_ps( x, _mm_set1_ps( planeA[ p ] ) );
+                distance = _mm_add_ps( distance, _mm_mul_ps( y, _mm_set1_ps( planeB[ p ] ) ) );
+                distance = _mm_add_ps( distance, _mm_mul_ps( z, _mm_set1_ps( planeC[ p ] ) ) );
+                distance = _mm_add_ps( distance, _mm_set1_ps( planeD[ p ] ) );
+                inside = _mm_and_ps( inside, _mm_cmpge_ps( distance, negR ) );
+            }
+
+            const int mask = _mm_movemask_ps( inside );
+            _visible[ i ] = mask & 1;
+            _visible[ i + 1 ] = ( mask >> 1 ) & 1;
+            _visible[ i + 2 ] = ( mask >> 2 ) & 1;
+            _visible[ i + 3 ] = ( mask >> 3 ) & 1;
+        }
+#endif
+
+        for ( ; i < _count; i++ ) {
+            _visible[ i ] = testSphere( glm::vec3( xs[ i ], ys[ i ], zs[ i ] ), rs[ i ] );
+        }
+    }
+
+    /* --- CullingStage --- */
+
+    void CullingStage::cull( const glm::mat4 & _pvMatrix,
+                             const std::vector< std::shared_ptr< RenderPass > > & _passes ){
+        frustum.extract( _pvMatrix );
+        spheres.clear();
+        ranges.clear();
+
+        for ( const auto & pass : _passes ) {
+            if ( !pass->GatherBounds ) {
+                continue;
+            }
+            const size_t first = spheres.size();
+            if ( !pass->GatherBounds( *pass, spheres ) ) {
+                // Pass opted out, drop anything it pushed
+                spheres.x.resize( first );
+                spheres.y.resize( first );
+                spheres.z.resize( first );
+                spheres.r.resize( first );
+                pass->Visibility.clear();
+                continue;
+            }
+            ranges.push_back( PassRange{ pass.get(), first, spheres.size() - first } );
+        }
+
+        for ( const auto & range : ranges ) {
+            auto & visibility = range.pass->Visibility;
+            visibility.resize( range.count );
+            if ( range.count == 0 ) {
+                continue;
+            }
+            frustum.testSpheres( spheres, range.first, range.count,
+                                 visibility.data() );
+            statistics.tested += range.count;
+            for ( auto v : visibility ) {
+                statistics.visible += v;
+            }
+        }
+    }
+
+    const Frustum & CullingStage::getFrustum() const {
+        return this->frustum;
+    }
+
+    const CullingStage::Statistics & CullingStage::getStatistics() const {
+        return this->statistics;
+    }
+
+    void CullingStage::resetStatistics(){
+        this->statistics = Statistics();
+    }
+
+}
@@ -7,79 +7,118 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/matrix_decompose.hpp>
 #include "Utilities.h"
+#include "FrameArena.h"
+#include "Skeleton.h"
+#include "AnimationSystem.h"
+#include <stdexcept>
+#include <cfloat>
+#include <iostream>
 
 namespace GL_Engine {
 #pragma region ENTITY
 	Entity::Entity() {
-		Orientation = glm::quat(1, 0, 0, 0);
-		eData.push_back(glm::value_ptr(this->TransformMatrix));
+		this->Transform = TransformStore::get().create();
 	}
 
 	Entity::~Entity() {
+		SpatialIndex::get().remove(this->GetId());
+		ComponentRegistry::get().destroy(this->GetId());
+		TransformStore::get().destroy(this->Transform);
+	}
+
+	Entity::Entity(const Entity &_Other) : EntityUniforms(_Other.EntityUniforms),
+		Active(_Other.Active) {
+		auto &store = TransformStore::get();
+		this->Transform = store.create();
+		store.setPosition(Transform, store.getPosition(_Other.Transform));
+		store.setOrientation(Transform, store.getOrientation(_Other.Transform));
+		store.setScale(Transform, store.getScale(_Other.Transform));
+		this->TransformMatrix() = store.getMatrix(_Other.Transform);
+		ComponentRegistry::get().copy(_Other.GetId(), this->GetId());
+		SpatialIndex::get().copy(_Other.GetId(), this->GetId());
+	}
+
+	Entity &Entity::operator=(const Entity &_Other) {
+		if (this == &_Other)
+			return *this;
+		auto &store = TransformStore::get();
+		store.setPosition(Transform, store.getPosition(_Other.Transform));
+		store.setOrientation(Transform, store.getOrientation(_Other.Transform));
+		store.setScale(Transform, store.getScale(_Other.Transform));
+		this->TransformMatrix() = store.getMatrix(_Other.Transform);
+		this->EntityUniforms = _Other.EntityUniforms;
+		this->Active = _Other.Active;
+		ComponentRegistry::get().destroy(this->GetId());
+		ComponentRegistry::get().copy(_Other.GetId(), this->GetId());
+		SpatialIndex::get().remove(this->GetId());
+		SpatialIndex::get().copy(_Other.GetId(), this->GetId());
+		return *this;
+	}
+
+	glm::mat4 &Entity::TransformMatrix() {
+		return TransformStore::get().getMatrix(this->Transform);
 	}
 
-
 	void Entity::SetPosition(glm::vec3 _Position) {
-		this->Position = glm::vec4(_Position, 1.0);
-		this->MatrixNeedsUpdating = true;
+		TransformStore::get().setPosition(this->Transform, _Position);
 	}
 
 	void Entity::Translate(glm::vec3 _Translation) {
-		this->Position += glm::vec4(_Translation, 0.0);
-		this->MatrixNeedsUpdating = true;
+		auto &store = TransformStore::get();
+		store.setPosition(this->Transform, store.getPosition(this->Transform) + _Translation);
 	}
 
 	void Entity::YawBy(float _Degrees) {
-		float Radians = glm::radians(_Degrees);
-		glm::quat Versor = glm::angleAxis(Radians, this->Up);
-
-		Orientation = Versor * Orientation;
-		this->Forward = glm::rotate(Versor, this->Forward);
-		this->Right = glm::rotate(Versor, this->Right);
-		this->MatrixNeedsUpdating = true;
+		RotateBy(_Degrees, this->GetUp());
 	}
 	void Entity::PitchBy(float _degrees) {
-		float Radians = glm::radians(_degrees);
-		glm::quat Versor = glm::angleAxis(Radians, this->Right);
-
-		Orientation = Versor * Orientation;
-		this->Forward = glm::rotate(Versor, this->Forward);
-		this->Up = glm::rotate(Versor, this->Up);
-		this->MatrixNeedsUpdating = true;
+		RotateBy(_degrees, this->GetRight());
 	}
 
 	void Entity::RollBy(float _Degrees) {
-		float Radians = glm::radians(_Degrees);
-		glm::quat Versor = glm::angleAxis(Radians, this->Forward);
-
-		Orientation = Versor * Orientation;
-		this->Right = glm::rotate(Versor, this->Right);
-		this->Up = glm::rotate(Versor, this->Up);
-		this->MatrixNeedsUpdating = true;
+		RotateBy(_Degrees, this->GetForward());
 	}
 
 	void Entity::RotateBy(float _Degrees, glm::vec3 _Axis) {
 		float Radians = glm::radians(_Degrees);
-		glm::quat Versor = glm::angleAxis(Radians, _Axis);
-
-		Orientation = Versor * Orientation;
-		this->Forward = glm::rotate(Versor, this->Forward);
-		this->Right = glm::rotate(Versor, this->Right);
-		this->MatrixNeedsUpdating = true;
+		Rotate(glm::angleAxis(Radians, _Axis));
 	}
 
 	void Entity::SetScale(glm::vec3 _Scale) {
-		this->Scale = _Scale;
-		MatrixNeedsUpdating = true;
+		TransformStore::get().setScale(this->Transform, _Scale);
 	}
 
 	void Entity::ScaleBy(glm::vec3 _Scale) {
-		this->Scale *= _Scale;
-		MatrixNeedsUpdating = true;
+		auto &store = TransformStore::get();
+		store.setScale(this->Transform, store.getScale(this->Transform) * _Scale);
 	}
 
 	const glm::quat Entity::GetOrientation() const {
-		return this->Orientation;
+		return TransformStore::get().getOrientation(this->Transform);
+	}
+
+	const glm::vec3 Entity::GetScale() const {
+		return TransformStore::get().getScale(this->Transform);
+	}
+
+	const glm::vec3 Entity::GetForward() const {
+		return glm::rotate(this->GetOrientation(), glm::vec3(0, 0, 1));
+	}
+
+	const glm::vec3 Entity::GetUp() const {
+		return glm::rotate(this->GetOrientation(), glm::vec3(0, 1, 0));
+	}
+
+	const glm::vec3 Entity::GetRight() const {
+		return glm::rotate(this->GetOrientation(), glm::vec3(1, 0, 0));
+	}
+
+	void Entity::SetBounds(const BoundingVolume &_LocalBounds) {
+		SpatialIndex::get().insert(this->GetId(), _LocalBounds);
+	}
+
+	TransformStore::Handle Entity::GetTransformHandle() const {
+		return this->Transform;
 	}
 
 	void Entity::UpdateUniforms() const {
@@ -89,16 +128,17 @@ namespace GL_Engine {
 	}
 
 	void Entity::Rotate(glm::quat _Rotation) {
-		this->Orientation = _Rotation * Orientation;
-		this->Forward = _Rotation * Forward;
-		this->Up = _Rotation * Up;
-		this->Right = _Rotation * Right;
-		this->MatrixNeedsUpdating = true;
+		auto &store = TransformStore::get();
+		store.setOrientation(this->Transform, _Rotation * store.getOrientation(this->Transform));
 	}
 
 	void Entity::SetOrientation(glm::quat _Orientation) {
-		this->Orientation = _Orientation; 
-		this->MatrixNeedsUpdating = true; 
+		TransformStore::get().setOrientation(this->Transform, _Orientation);
+	}
+
+	void Entity::SetParent(Entity *_Parent, const glm::mat4 *_ParentOffset) {
+		TransformStore::get().setParent(this->Transform,
+			_Parent ? _Parent->Transform : TransformStore::InvalidHandle, _ParentOffset);
 	}
 
 	const glm::mat4 Entity::GetTransformMatrix() {
@@ -106,62 +146,73 @@ namespace GL_Engine {
 		this->update();
 		
 		//Return the model matrix
-		return this->TransformMatrix;
+		return this->TransformMatrix();
 	}
 
 	void Entity::update() {
-		//Check if the local values have changed
-		if (MatrixNeedsUpdating) {
-			UpdateMatrix();	//Update matrix if so
-			MatrixNeedsUpdating = false;
-		}
-	}
-
-	void Entity::UpdateMatrix() {
-		//Generate rotation matrix from the orientation versor
-		glm::mat4 R = glm::toMat4(Orientation);		
-
-		//Create a translation matrix from identity
-		glm::mat4 T = glm::translate(glm::mat4(1.0), glm::vec3(this->Position));	
-
-		//Generate a scale matrix from identity
-		glm::mat4 S = glm::scale(glm::mat4(1.0), this->Scale);
-
-		//Regenerate local axes for next set of rotations
-		this->Forward = glm::vec3(R * glm::vec4(0, 0, 1, 0));
-		this->Up = glm::vec3(R * glm::vec4(0, 1, 0, 0));
-		this->Right = glm::vec3(R * glm::vec4(1, 0, 0, 0));
-
-		//Rotation matrix needs to be inverted to correctly
-		//rotate the vertices. (I think, I was having 
-		//problems when R isn't inverted)
-		this->TransformMatrix = T * glm::inverse(R) * S;
-
+		//Rebuild now rather than wait for the store's batch update
+		TransformStore::get().update(this->Transform);
 	}
 
 	const glm::vec4 Entity::GetPosition() const { 
-		return this->Position; 
+		return glm::vec4(TransformStore::get().getPosition(this->Transform), 1.0f);
 	}
 
 	const glm::mat4 Entity::TransformBy(glm::mat4 _Transform) {
-		return this->TransformMatrix = _Transform * this->TransformMatrix;
+		//Fold the transform back into position, orientation and scale, so
+		//it survives the next rebuild
+		auto &store = TransformStore::get();
+		const glm::mat4 Local = _Transform * store.getLocalMatrix(this->Transform);
+		glm::vec3 Scale, Translation, Skew;
+		glm::vec4 Perspective;
+		glm::quat Rotation;
+		glm::decompose(Local, Scale, Rotation, Translation, Skew, Perspective);
+		//The local matrix holds the inverse of the orientation
+		store.setPosition(this->Transform, Translation);
+		store.setOrientation(this->Transform, glm::conjugate(Rotation));
+		store.setScale(this->Transform, Scale);
+		return Local;
+	}
+
+	EntityId Entity::GetId() const {
+		return this->Transform;
+	}
+
+	const void *Entity::GetData(const DataSource &_Source) const {
+		return _Source.resolve(this->GetId());
+	}
+
+	void DataSource::GatherSlots::build(const EntityId *_Entities, size_t _Count) {
+		next.resize(_Count);
+		for (size_t i = 0; i < _Count; i++) {
+			const EntityId id = _Entities[i];
+			if (id >= first.size())
+				first.resize(id + 1, None);
+			next[i] = first[id];
+			first[id] = static_cast<uint32_t>(i);
+		}
 	}
 
-	const uint16_t Entity::AddData(void* _Data) {
-		eData.push_back(_Data);
-		return (uint16_t)eData.size() - 1;
+	void DataSource::GatherSlots::clear(const EntityId *_Entities, size_t _Count) {
+		//Reset only the entries used, first stays sized to the largest id
+		for (size_t i = 0; i < _Count; i++)
+			first[_Entities[i]] = None;
 	}
 
-	void Entity::SetData(int index, void* data) {
-		eData[index] = data;
+	DataSource::GatherSlots &DataSource::Slots() {
+		static GatherSlots slots;
+		return slots;
 	}
 
-	void Entity::SetActive(bool _State) {
-		this->Active = _State;
+	void DataSource::GatherWorldMatrices(const EntityId *_Entities, size_t _Count, size_t _Size,
+										 uint8_t *_Out, size_t _Stride) {
+		const auto &store = TransformStore::get();
+		for (size_t i = 0; i < _Count; i++)
+			std::memcpy(_Out + i * _Stride, glm::value_ptr(store.getMatrix(_Entities[i])), _Size);
 	}
 
-	void* Entity::GetData(int index) {
-		return eData[index];
+	void Entity::SetActive(bool _State) {
+		this->Active = _State;
 	}
 
 	bool Entity::isActive() const { 
@@ -174,178 +225,109 @@ namespace GL_Engine {
 		Active = false;
 	}
 
-	const std::vector<void*> Entity::GeteDataList() const { 
-		return this->eData; 
-	};
 
 #pragma endregion
 
 #pragma region RiggedModel
-#pragma region MeshBone
-
-	MeshBone::MeshBone(const aiBone* _Bone) {
-		this->OffsetMatrix = Utilities::AiToGLMMat4(_Bone->mOffsetMatrix);
-		this->Name = _Bone->mName.data;
-	}
-	const glm::mat4 &MeshBone::GetFinalTransform(const glm::mat4 &_GlobalInverse, const glm::mat4& nodeGlobalTransform) {
-		this->FinalTransformation = _GlobalInverse * nodeGlobalTransform * this->OffsetMatrix;
-		return this->FinalTransformation;
-	}
-
-
-#pragma region SceneBone
-
-	SceneBone::SceneBone(const aiBone *_Bone) {
-		this->Name = _Bone->mName.data;
-	}
-	void SceneBone::AddMeshBone(std::shared_ptr<MeshBone> _mBone) {
-		this->meshBones.push_back(_mBone);
-	}
-	void SceneBone::UpdateBone(const glm::mat4 &GlobalInverse, const glm::mat4 &_GlobalTransform) {
-		this->GlobalTransformation = _GlobalTransform;
-		for (auto mb : meshBones) {
-			mb->GetFinalTransform(GlobalInverse, this->GlobalTransformation);
-		}
-	}
-
 #pragma region NodeAnimation
-	NodeAnimation::NodeAnimation(const aiNodeAnim *animNode, double _Length) {
+	NodeAnimation::NodeAnimation(const aiNodeAnim *animNode, double _Length, const AnimationCompression &_Compression) {
 		this->Name = animNode->mNodeName.data;
 		this->AnimationLength = _Length;
+		KeyTrack<glm::vec3> RawPositions, RawScalings;
+		KeyTrack<glm::quat> RawRotations;
+		RawPositions.reserve(animNode->mNumPositionKeys);
 		for (unsigned int i = 0; i < animNode->mNumPositionKeys; i++) {
 			aiVector3D pos = animNode->mPositionKeys[i].mValue;
-			double time = animNode->mPositionKeys[i].mTime;
-			this->Positions.push_back(std::make_pair(glm::vec3(pos.x, pos.y, pos.z), time));
+			float time = static_cast<float>(animNode->mPositionKeys[i].mTime);
+			RawPositions.addKey(time, glm::vec3(pos.x, pos.y, pos.z));
 		}
+		RawScalings.reserve(animNode->mNumScalingKeys);
 		for (unsigned int i = 0; i < animNode->mNumScalingKeys; i++) {
 			aiVector3D scale = animNode->mScalingKeys[i].mValue;
-			double time = animNode->mScalingKeys[i].mTime;
-			this->Scalings.push_back(std::make_pair(glm::vec3(scale.x, scale.y, scale.z), time));
+			float time = static_cast<float>(animNode->mScalingKeys[i].mTime);
+			RawScalings.addKey(time, glm::vec3(scale.x, scale.y, scale.z));
 		}
+		RawRotations.reserve(animNode->mNumRotationKeys);
 		for (unsigned int i = 0; i < animNode->mNumRotationKeys; i++) {
 			auto rot = animNode->mRotationKeys[i];
-			double time = animNode->mPositionKeys[i].mTime;
+			float time = static_cast<float>(rot.mTime);
 			glm::quat rotQuat;
 			rotQuat.x = rot.mValue.x;
 			rotQuat.y = rot.mValue.y;
 			rotQuat.z = rot.mValue.z;
 			rotQuat.w = rot.mValue.w;
-			this->Rotations.push_back(std::make_pair(rotQuat, time));
+			RawRotations.addKey(time, rotQuat);
 		}
-	}
-	
 
-#pragma region SceneNode
-	SceneNode::SceneNode(const aiNode* _node) {
-		this->NodeTransform = Utilities::AiToGLMMat4(_node->mTransformation);
-		this->Name = _node->mName.data;
-	}
-	void SceneNode::AddChild(std::shared_ptr<SceneNode> _node) {
-		this->ChildNodes.push_back(_node);
-	}
-	void SceneNode::Update(const glm::mat4 &ParentTransform, const glm::mat4 &GlobalInverse) {
-		this->GlobalTransform = ParentTransform * this->NodeTransform;
-		if(sceneBone)
-			sceneBone->UpdateBone(GlobalInverse, this->GlobalTransform);
-		
-		for (auto cn : ChildNodes) {
-			cn->Update(this->GlobalTransform, GlobalInverse);
+		//Frame spacing: the closest two keys of any track
+		float Spacing = static_cast<float>(_Length);
+		for (const auto *Times : { &RawPositions.getTimes(), &RawScalings.getTimes(), &RawRotations.getTimes() }) {
+			for (size_t i = 1; i < Times->size(); i++) {
+				const float Step = (*Times)[i] - (*Times)[i - 1];
+				if (Step > 0.0f)
+					Spacing = std::min(Spacing, Step);
+			}
 		}
-	}
-	void SceneNode::Update(const glm::mat4 &ParentTransform, const glm::mat4 &GlobalInverse, unsigned int AnimationID, double Time) {
-		auto LocalMatrix = this->NodeTransform;
-		if (Animation) {
-			Time = fmod(Time, Animation->AnimationLength);
-			glm::mat4 ScaleMatrix, RotateMatrix, TranslateMatrix;
-
-			ScaleMatrix = this->GetInterpolatedScale(Animation->Scalings, Time);
-			TranslateMatrix = this->GetInterpolatedTranslate(Animation->Positions, Time);
-			RotateMatrix = this->GetInterpolatedRotate(Animation->Rotations, Time);
-
-			LocalMatrix = TranslateMatrix * RotateMatrix * ScaleMatrix;
+		const uint32_t Frames = Spacing > 0.0f ?
+			static_cast<uint32_t>(std::min(std::round(_Length / Spacing) + 1.0, (double)UINT32_MAX)) : 1;
+		if (Frames > KeyTimes::MaxFrames) {
+			std::cerr << "Warning! Animation of node " << Name << " needs " << Frames
+					  << " frames, resampled on " << KeyTimes::MaxFrames << std::endl;
 		}
-		this->GlobalTransform = ParentTransform * LocalMatrix;
-		if(sceneBone)
-			sceneBone->UpdateBone(GlobalInverse, this->GlobalTransform);
-		
-		for (auto cn : ChildNodes) {
-			cn->Update(this->GlobalTransform, GlobalInverse, AnimationID, Time);
+		this->Times.setGrid(_Length, Frames);
+		const TrackEncoder<glm::vec3> PositionEncoder(RawPositions, this->Times, _Compression.PositionTolerance);
+		const TrackEncoder<glm::vec3> ScalingEncoder(RawScalings, this->Times, _Compression.ScalingTolerance);
+		const TrackEncoder<glm::quat> RotationEncoder(RawRotations, this->Times, _Compression.RotationTolerance);
+		if (!PositionEncoder.empty() || !ScalingEncoder.empty() || !RotationEncoder.empty()) {
+			this->Times.select([&](uint32_t _First, uint32_t _Last) {
+				return PositionEncoder.spans(_First, _Last) && ScalingEncoder.spans(_First, _Last) &&
+					RotationEncoder.spans(_First, _Last);
+			});
 		}
-	}
-	glm::mat4 SceneNode::GetInterpolatedScale(std::vector<std::pair<glm::vec3, double>> Scalings, double time) {
-		std::pair<glm::vec3, double> LowerScale, UpperScale;
-		for (int i = 0; i < Scalings.size() - 1; i++) {
-			if (time > Scalings[i].second && time < Scalings[i + 1].second) {
-				LowerScale = Scalings[i];
-				UpperScale = Scalings[i + 1];
-				break;
-			}
-			if (i == Scalings.size() - 2) {
-				return glm::scale(glm::mat4(1.0), Scalings[i + 1].first);
-			}
+		const float PositionError = this->Positions.encode(PositionEncoder, this->Times);
+		const float ScalingError = this->Scalings.encode(ScalingEncoder, this->Times);
+		const float RotationError = this->Rotations.encode(RotationEncoder, this->Times);
+		if (PositionError > _Compression.PositionTolerance || ScalingError > _Compression.ScalingTolerance ||
+			RotationError > _Compression.RotationTolerance) {
+			std::cerr << "Warning! Animation of node " << Name << " compressed beyond tolerance, errors "
+					  << PositionError << " (position), " << RotationError << " (rotation), "
+					  << ScalingError << " (scale)" << std::endl;
 		}
-
-		double timeDiff = UpperScale.second - LowerScale.second;
-		double timeNorm = time - LowerScale.second;
-		double ratio = timeNorm / timeDiff;
-		glm::vec3 interpolatedScale = (LowerScale.first * (float)(1.0 - ratio)) + (UpperScale.first * (float)ratio);
-		return glm::scale(glm::mat4(1.0), interpolatedScale);
-
 	}
-	glm::mat4 SceneNode::GetInterpolatedTranslate(std::vector<std::pair<glm::vec3, double>> Translations, double time) {
-		std::pair<glm::vec3, double> LowerScale, UpperScale;
-		for (int i = 0; i < Translations.size() - 1; i++) {
-			if (time > Translations[i].second && time < Translations[i + 1].second) {
-				LowerScale = Translations[i];
-				UpperScale = Translations[i + 1];
-				break;
-			}
-			if (i == Translations.size() - 2) {
-				return glm::translate(glm::mat4(1.0), Translations[i + 1].first);
-			}
-		}
 
-		double timeDiff = UpperScale.second - LowerScale.second;
-		double timeNorm = time - LowerScale.second;
-		double ratio = timeNorm / timeDiff;
-		glm::vec3 interpolatedTranslate = (LowerScale.first * (float)(1.0 - ratio)) + (UpperScale.first * (float)ratio);
-		return glm::translate(glm::mat4(1.0), interpolatedTranslate);
-	}
-	glm::mat4 SceneNode::GetInterpolatedRotate(std::vector<std::pair<glm::quat, double>> Rotations, double time) {
-		std::pair<glm::quat, double> LowerScale, UpperScale;
-		for (int i = 0; i < Rotations.size() - 1; i++) {
-			if (time > Rotations[i].second && time < Rotations[i + 1].second) {
-				LowerScale = Rotations[i];
-				UpperScale = Rotations[i + 1];
-				break;
-			}
-			if (i == Rotations.size() - 2) {
-				return glm::toMat4(Rotations[i + 1].first);
-			}
+	size_t NodeAnimation::GetMemoryUsage() const {
+		return Times.getMemoryUsage() + Positions.getMemoryUsage() + Scalings.getMemoryUsage() +
+			Rotations.getMemoryUsage();
+	}
+
+	glm::mat4 NodeAnimation::Sample(float _Time, Cursor &_Cursor) const {
+		glm::mat4 Local(1.0f);
+		if (Times.empty())
+			return Local;
+		float T;
+		const uint32_t Key = Times.seek(_Time, _Cursor.Key, T);
+		if (!Rotations.empty())
+			Local = glm::toMat4(Rotations.sample(Key, T));
+		if (!Scalings.empty()) {
+			const glm::vec3 Scale = Scalings.sample(Key, T);
+			Local[0] *= Scale.x;
+			Local[1] *= Scale.y;
+			Local[2] *= Scale.z;
 		}
-		double timeDiff = UpperScale.second - LowerScale.second;
-		double timeNorm = time - LowerScale.second;
-		double ratio = timeNorm / timeDiff;
-		glm::quat interp = glm::slerp(LowerScale.first, UpperScale.first, (float)ratio);
-		return glm::toMat4(interp);
-	}
-
-
-
-#pragma region Skeleton
-
-	Skeleton::Skeleton(std::shared_ptr<SceneNode> _Root, std::map<std::string, std::shared_ptr<SceneNode>> SkeletonNodeMap) {
-		this->rootNode = _Root;
-		this->GlobalInverseMatrix = glm::inverse(_Root->NodeTransform);
-		this->NodeMap = SkeletonNodeMap;
+		if (!Positions.empty())
+			Local[3] = glm::vec4(Positions.sample(Key, T), 1.0f);
+		return Local;
 	}
 
-	void Skeleton::Update() {
-		rootNode->Update(glm::mat4(1.0f), GlobalInverseMatrix);
-	}
-	void Skeleton::Update(unsigned int AnimationID, double Time) {
-		rootNode->Update(glm::mat4(1.0f), GlobalInverseMatrix, AnimationID, Time);
+	void NodeAnimation::Sample(float _Time, Cursor &_Cursor, glm::vec3 &_Translation,
+							   glm::quat &_Rotation, glm::vec3 &_Scale) const {
+		float T = 0.0f;
+		const uint32_t Key = Times.empty() ? 0 : Times.seek(_Time, _Cursor.Key, T);
+		_Translation = Positions.empty() ? glm::vec3(0.0f) : Positions.sample(Key, T);
+		_Rotation = Rotations.empty() ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : Rotations.sample(Key, T);
+		_Scale = Scalings.empty() ? glm::vec3(1.0f) : Scalings.sample(Key, T);
 	}
+	
 
 #pragma region RiggedModel
 
@@ -354,68 +336,115 @@ namespace GL_Engine {
 		this->ModelRig = std::move(_Rig);
 
 		this->ModelAttributes = std::forward<ModelAttribList>(_AttributeList);
+		//Bounds of all meshes in the bind pose, for the animation LOD
+		glm::vec3 Min(FLT_MAX), Max(-FLT_MAX);
+		for (const auto &attrib : this->ModelAttributes) {
+			if (attrib->GetBounds().isEmpty())
+				continue;
+			Min = glm::min(Min, attrib->GetBounds().min);
+			Max = glm::max(Max, attrib->GetBounds().max);
+		}
+		if (Min.x <= Max.x)
+			this->LocalBounds = BoundingVolume::fromBox(Min, Max);
 
-		Orientation = glm::quat(1, 0, 0, 0);
-		eData.push_back(glm::value_ptr(this->TransformMatrix));
-		this->ModelRig->Update();
+		this->ModelRig->update();
+	}
+	RiggedModel::~RiggedModel() {
+		AnimationSystem::get().cancel(*this->ModelRig);
 	}
-	RiggedModel::~RiggedModel() {};
 
 	std::unique_ptr<RenderPass> RiggedModel::GenerateRenderpass(Shader* _Shader) {
 		std::unique_ptr<RenderPass> renderPass = std::make_unique<RenderPass>();
 		renderPass->renderFunction = RiggedModelRenderer;
+		renderPass->GatherBounds = GatherAttributeBounds;
 		renderPass->shader = _Shader;
-		renderPass->Data = (void*)this;
+		auto data = std::make_unique<RiggedPassData>();
+		data->model = this;
+		data->modelMatrix = _Shader->getBinder<glm::mat4>("model");
+		data->boneMatrices = _Shader->getBinder<glm::mat4>("BoneMatrices");
+		renderPass->Data = (void*)data.get();
+		this->passData.push_back(std::move(data));
 		return std::move(renderPass);
 	}
 	void RiggedModel::Update() {
-		this->ModelRig->Update();
+		AnimationSystem::get().cancel(*this->ModelRig);
+		this->ModelRig->update();
 	}
 	void RiggedModel::Update(unsigned int AnimationID, double Time) {
-		this->ModelRig->Update(AnimationID, Time);
+		AnimationSystem::get().submit(*this->ModelRig, AnimationID, Time, this->GetAnimationBounds());
+	}
+	void RiggedModel::Update(const BlendTree &Tree, double Time) {
+		AnimationSystem::get().submit(*this->ModelRig, Tree, Time, this->GetAnimationBounds());
+	}
+	glm::vec4 RiggedModel::GetAnimationBounds() {
+		if (this->LocalBounds.isEmpty())
+			return glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+		const BoundingVolume World = this->LocalBounds.transformed(this->GetTransformMatrix());
+		return glm::vec4(World.centre, World.radius);
 	}
 	Skeleton *RiggedModel::GetRig() const { 
 		return this->ModelRig.get(); 
 	}
 
+	void RiggedModel::AttachToBone(Entity &_Child, const std::string &_BoneName) {
+		const NameId Name = NameTable::get().find(_BoneName);
+		if (Name == NameTable::InvalidName)
+			throw std::runtime_error("Rig has no bone " + _BoneName);
+		this->AttachToBone(_Child, Name);
+	}
+	void RiggedModel::AttachToBone(Entity &_Child, NameId _BoneName) {
+		const uint32_t Joint = this->ModelRig->findJoint(_BoneName);
+		if (Joint == Skeleton::NoJoint)
+			throw std::runtime_error("Rig has no bone " + NameTable::get().getName(_BoneName));
+		_Child.SetParent(this, &this->ModelRig->getModelTransform(Joint));
+	}
+
+
 
+	bool RiggedModel::GatherAttributeBounds(RenderPass &_Pass, SphereList &_Spheres) {
+		RiggedModel *Model = static_cast<RiggedPassData*>(_Pass.Data)->model;
+		//Bind pose bounds, animation is assumed to stay roughly within them
+		const auto transform = Model->GetTransformMatrix();
+		for (auto &attrib : Model->ModelAttributes) {
+			if (attrib->GetBounds().isEmpty())
+				return false;
+			_Spheres.push(attrib->GetBounds().transformed(transform));
+		}
+		return true;
+	}
 
 	void RiggedModel::RiggedModelRenderer(RenderPass& _Pass, void* _Data) {
 		
-		RiggedModel *Model = static_cast<RiggedModel*>(_Data);
-		auto Rig = Model->GetRig();
+		auto Data = static_cast<RiggedPassData*>(_Data);
+		RiggedModel *Model = Data->model;
 		_Pass.shader->useShader();
 
 		for (auto l : _Pass.dataLink) {
-			l.uniform->SetData(Model->GetData(l.eDataIndex));
+			l.uniform->SetData(Model->GetData(l.source));
 			l.uniform->Update();
 		}
 		Model->UpdateUniforms();
 
-		glm::mat4 t(1.0f);
-		auto modelMatLoc = glGetUniformLocation(_Pass.shader->getShaderID(), "model");
-		glUniformMatrix4fv(modelMatLoc, 1, GL_FALSE, glm::value_ptr(Model->GetTransformMatrix()));
+		Data->modelMatrix.set(Model->GetTransformMatrix());
 
 		
-		for (auto attrib : Model->ModelAttributes) {
+		for (size_t a = 0; a < Model->ModelAttributes.size(); a++) {
+			if (!_Pass.IsVisible(a))
+				continue;
+			auto &attrib = Model->ModelAttributes[a];
 			attrib->BindVAO();
 			for (auto tex : attrib->ModelTextures) {
 				tex->Bind();
 			}
-			auto boneMatLoc = glGetUniformLocation(_Pass.shader->getShaderID(), "BoneMatrices");
-			std::vector<glm::mat4> boneMatrices((const size_t)56, glm::mat4(1.0));
-			int i = 0;
-			if (attrib->meshBones.size() > 0) {
-				int i = 0;
-				for (auto bone : attrib->meshBones) {
-					boneMatrices.at(i++) = bone->FinalTransformation;
-				}
-				glUniformMatrix4fv(boneMatLoc, 56, GL_FALSE, glm::value_ptr(boneMatrices[0]));
+			const uint32_t PaletteSize = Model->ModelRig->getPaletteSize((uint32_t)a);
+			if (PaletteSize > 0) {
+				FrameVector<glm::mat4> boneMatrices((const size_t)56, glm::mat4(1.0), &FrameArena::get());
+				const glm::mat4 *Palette = Model->ModelRig->getPalette((uint32_t)a);
+				std::copy(Palette, Palette + std::min(PaletteSize, 56u), boneMatrices.begin());
+				Data->boneMatrices.set(boneMatrices.data(), 56);
 			}
 			else {
-				glm::mat4 id(1.0);
-				auto boneMatLoc = glGetUniformLocation(_Pass.shader->getShaderID(), "BoneMatrices");
-				glUniformMatrix4fv(boneMatLoc, 1, GL_FALSE, glm::value_ptr(id));
+				Data->boneMatrices.set(glm::mat4(1.0));
 			}
 			glDrawElements(GL_TRIANGLES, (GLsizei)attrib->GetVertexCount(), GL_UNSIGNED_INT, 0);
 		}
@@ -0,0 +1,147 @@
+#include "FrameArena.h"
+#include <algorithm>
+
+#ifdef CG_ENGINE_TRACK_ALLOCATIONS
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Replace the global allocation functions to count every heap allocation.
+// Array and nothrow forms forward to these by default
+static std::atomic< uint64_t > globalHeapAllocations{ 0 };
+
+void * operator new( std::size_t _bytes ){
+    globalHeapAllocations.fetch_add( 1, std::memory_order_relaxed );
+    if ( void * p = std::malloc( _bytes ? _bytes : 1 ) ) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete( void * _p ) noexcept {
+    std::free( _p );
+}
+
+void operator delete( void * _p, std::size_t ) noexcept {
+    std::free( _p );
+}
+#endif
+
+namespace GL_Engine {
+
+    FrameArena::FrameArena( size_t _blockSize ) : blockSize( _blockSize ){
+        addBlock( blockSize );
+        frameStartHeapAllocations = getHeapAllocationCount();
+    }
+
+    FrameArena::~FrameArena(){
+    }
+
+    void FrameArena::addBlock( size_t _size ){
+        // Left uninitialised, unlike make_unique
+        this->blocks.push_back( Block{ std::unique_ptr< std::byte[] >(
+                                           new std::byte[ _size ] ),
+                                       _size } );
+        frameStatistics.blockAllocations++;
+        frameStatistics.capacity += _size;
+    }
+
+    void * FrameArena::do_allocate( size_t _bytes, size_t _alignment ){
+        while ( true ) {
+            auto & block = this->blocks[ currentBlock ];
+            const uintptr_t base = reinterpret_cast< uintptr_t >( block.data.get() );
+            const uintptr_t aligned =
+                ( base + offset + _alignment - 1 ) & ~( uintptr_t )( _alignment - 1 );
+            const size_t end = ( aligned - base ) + _bytes;
+            if ( end <= block.size ) {
+                offset = end;
+                frameStatistics.bytesAllocated += _bytes;
+                peakBytes = std::max( peakBytes, frameStatistics.bytesAllocated );
+                return reinterpret_cast< void * >( aligned );
+            }
+
+            // Move on to the next block, growing the arena if there is none
+            if ( currentBlock + 1 == this->blocks.size() ) {
+                addBlock( std::max( blockSize, _bytes + _alignment ) );
+            }
+            currentBlock++;
+            offset = 0;
+        }
+    }
+
+    void FrameArena::do_deallocate( void *, size_t, size_t ){
+        // Released in bulk by reset() or rewind()
+    }
+
+    bool FrameArena::do_is_equal( const std::pmr::memory_resource & _other )
+        const noexcept {
+        return this == &_other;
+    }
+
+    FrameArena::Marker FrameArena::getMarker() const {
+        return Marker{ currentBlock, offset };
+    }
+
+    void FrameArena::rewind( const Marker & _marker ){
+        currentBlock = _marker.block;
+        offset = _marker.offset;
+    }
+
+    void FrameArena::reset(){
+        const uint64_t heapCount = getHeapAllocationCount();
+        frameStatistics.heapAllocations = heapCount - frameStartHeapAllocations;
+        lastFrameStatistics = frameStatistics;
+
+        // The frame spilled into more than one block; replace them with a
+        // single block big enough for the whole frame
+        if ( this->blocks.size() > 1 ) {
+            size_t total = 0;
+            for ( const auto & block : this->blocks ) {
+                total += block.size;
+            }
+            this->blocks.clear();
+            addBlock( total );
+        }
+        frameStatistics = Statistics();
+        frameStatistics.capacity = this->blocks[ 0 ].size;
+
+        currentBlock = 0;
+        offset = 0;
+        // Exclude the coalescing above from the next frame's count
+        frameStartHeapAllocations = getHeapAllocationCount();
+    }
+
+    const FrameArena::Statistics & FrameArena::getStatistics() const {
+        return this->lastFrameStatistics;
+    }
+
+    const FrameArena::Statistics & FrameArena::getCurrentStatistics() const {
+        return this->frameStatistics;
+    }
+
+    size_t FrameArena::getPeakBytes() const {
+        return this->peakBytes;
+    }
+
+    FrameArena & FrameArena::get(){
+        static FrameArena arena;
+        return arena;
+    }
+
+    uint64_t FrameArena::getHeapAllocationCount(){
+#ifdef CG_ENGINE_TRACK_ALLOCATIONS
+        return globalHeapAllocations.load( std::memory_order_relaxed );
+#else
+        return 0;
+#endif
+    }
+
+    bool FrameArena::isTrackingHeapAllocations(){
+#ifdef CG_ENGINE_TRACK_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+}
@@ -0,0 +1,1246 @@
+#include "GLBackend.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+namespace GL_Engine {
+	namespace CG_Data {
+
+		namespace {
+
+			struct Image {
+				GLsizei width{ 0 }, height{ 0 };
+				uint64_t texelSize{ 0 };
+			};
+
+			struct TextureInfo {
+				//Keyed by face << 8 | level
+				std::map<uint32_t, Image> images;
+
+				uint64_t Size() const {
+					uint64_t size = 0;
+					for (auto &image : images)
+						size += image.second.width * image.second.height * image.second.texelSize;
+					return size;
+				}
+			};
+
+			struct ProgramInfo {
+				struct Uniform {
+					std::string name;
+					GLenum type;
+					GLint size;
+					bool array;
+					//Default block uniforms have a location, block members
+					//a block index and offset
+					GLint location;
+					GLint block;
+					GLint offset;
+				};
+				struct Block {
+					std::string name;
+					GLint dataSize;
+					GLint activeUniforms;
+					GLuint binding;
+				};
+
+				std::vector<GLuint> shaders;
+				std::unordered_map<std::string, GLint> attribLocations;
+				std::vector<Uniform> uniforms;
+				std::vector<Block> blocks;
+			};
+
+			struct RecordState {
+				bool recording{ false };
+				bool capture{ false };
+				GLBackend::Statistics stats;
+				std::vector<GLBackend::Command> commands;
+
+				GLuint nextName{ 1 };
+				uintptr_t nextSync{ 1 };
+				std::unordered_map<GLuint, std::vector<uint8_t>> buffers;
+				std::unordered_map<GLuint, TextureInfo> textures;
+				std::unordered_map<GLuint, uint64_t> renderbuffers;
+				std::unordered_map<GLuint, std::string> shaders;
+				std::unordered_map<GLuint, ProgramInfo> programs;
+
+				std::unordered_map<GLenum, GLuint> boundBuffers;
+				//Keyed by unit << 32 | target
+				std::unordered_map<uint64_t, GLuint> boundTextures;
+				GLenum activeTexture{ GL_TEXTURE0 };
+				GLuint boundRenderbuffer{ 0 };
+				GLint viewport[4]{ 0, 0, 0, 0 };
+
+				//Puts the driver's entry points back
+				std::vector<std::function<void()>> restore;
+			};
+
+			RecordState &State() {
+				static RecordState state;
+				return state;
+			}
+
+			void Record(const char *_Name, std::initializer_list<double> _Args) {
+				auto &state = State();
+				state.stats.calls++;
+				if (!state.capture)
+					return;
+				GLBackend::Command command{ _Name, 0, {} };
+				for (double arg : _Args) {
+					if (command.argCount == GLBackend::MaxCommandArgs)
+						break;
+					command.args[command.argCount++] = arg;
+				}
+				state.commands.push_back(command);
+			}
+
+			double Offset(const void *_Pointer) {
+				return static_cast<double>(reinterpret_cast<uintptr_t>(_Pointer));
+			}
+
+			void GenNames(GLsizei _Count, GLuint *_Names) {
+				for (GLsizei i = 0; i < _Count; i++)
+					_Names[i] = State().nextName++;
+			}
+
+			std::vector<uint8_t> *BoundBuffer(GLenum _Target) {
+				auto &state = State();
+				auto binding = state.boundBuffers.find(_Target);
+				if (binding == state.boundBuffers.end())
+					return nullptr;
+				auto buffer = state.buffers.find(binding->second);
+				return buffer == state.buffers.end() ? nullptr : &buffer->second;
+			}
+
+			//Cube map faces are bound through the cube map target
+			GLenum BindingTarget(GLenum _Target) {
+				if (_Target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && _Target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z)
+					return GL_TEXTURE_CUBE_MAP;
+				return _Target;
+			}
+
+			TextureInfo *BoundTexture(GLenum _Target) {
+				auto &state = State();
+				const uint64_t key = (uint64_t(state.activeTexture) << 32) | BindingTarget(_Target);
+				auto binding = state.boundTextures.find(key);
+				if (binding == state.boundTextures.end())
+					return nullptr;
+				auto texture = state.textures.find(binding->second);
+				return texture == state.textures.end() ? nullptr : &texture->second;
+			}
+
+			uint64_t TexelSize(GLint _InternalFormat, GLenum _Format, GLenum _Type) {
+				switch (_InternalFormat) {
+				case GL_R8:
+					return 1;
+				case GL_RG8: case GL_R16F: case GL_DEPTH_COMPONENT16:
+					return 2;
+				case GL_RGB8:
+					return 3;
+				case GL_RGBA8: case GL_SRGB8_ALPHA8: case GL_RG16F: case GL_R32F: case GL_R11F_G11F_B10F:
+				case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32F: case GL_DEPTH24_STENCIL8:
+					return 4;
+				case GL_RGB16F:
+					return 6;
+				case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8:
+					return 8;
+				case GL_RGB32F:
+					return 12;
+				case GL_RGBA32F:
+					return 16;
+				default:
+					break;
+				}
+				//Unsized format, go by the client data
+				if (_Type == GL_UNSIGNED_INT_24_8)
+					return 4;
+				if (_Type == GL_FLOAT_32_UNSIGNED_INT_24_8_REV)
+					return 8;
+				uint64_t components = 4;
+				switch (_Format) {
+				case GL_RED: case GL_DEPTH_COMPONENT: case GL_DEPTH_STENCIL:
+					components = 1; break;
+				case GL_RG:
+					components = 2; break;
+				case GL_RGB: case GL_BGR:
+					components = 3; break;
+				default:
+					break;
+				}
+				switch (_Type) {
+				case GL_UNSIGNED_BYTE: case GL_BYTE:
+					return components;
+				case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT:
+					return components * 2;
+				default:
+					return components * 4;
+				}
+			}
+
+			/*
+			*Uniform reflection. Shader sources are tokenised at link time and
+			*the top level uniform declarations collected; block members are
+			*laid out by the std140 rules, which is what the engine's blocks
+			*declare.
+			*/
+			std::vector<std::string> Tokenise(const std::string &_Source) {
+				std::vector<std::string> tokens;
+				size_t i = 0;
+				while (i < _Source.size()) {
+					const char c = _Source[i];
+					if (c == '/' && i + 1 < _Source.size() && _Source[i + 1] == '/') {
+						i = _Source.find('\n', i);
+					}
+					else if (c == '/' && i + 1 < _Source.size() && _Source[i + 1] == '*') {
+						i = _Source.find("*/", i + 2);
+						if (i != std::string::npos)
+							i += 2;
+					}
+					else if (c == '#') {
+						i = _Source.find('\n', i);
+					}
+					else if (std::isalnum(static_cast<unsigned char>(c)) || c == '_') {
+						size_t end = i;
+						while (end < _Source.size() && (std::isalnum(static_cast<unsigned char>(_Source[end])) ||
+							_Source[end] == '_' || _Source[end] == '.'))
+							end++;
+						tokens.push_back(_Source.substr(i, end - i));
+						i = end;
+					}
+					else {
+						if (!std::isspace(static_cast<unsigned char>(c)))
+							tokens.push_back(std::string(1, c));
+						i++;
+					}
+				}
+				return tokens;
+			}
+
+			struct TypeLayout {
+				GLenum type;
+				GLint alignment, size;
+			};
+
+			TypeLayout Std140Layout(const std::string &_Type) {
+				static const std::unordered_map<std::string, TypeLayout> layouts = {
+					{ "float", { GL_FLOAT, 4, 4 } },
+					{ "int", { GL_INT, 4, 4 } },
+					{ "uint", { GL_UNSIGNED_INT, 4, 4 } },
+					{ "bool", { GL_BOOL, 4, 4 } },
+					{ "vec2", { GL_FLOAT_VEC2, 8, 8 } },
+					{ "ivec2", { GL_INT_VEC2, 8, 8 } },
+					{ "vec3", { GL_FLOAT_VEC3, 16, 12 } },
+					{ "ivec3", { GL_INT_VEC3, 16, 12 } },
+					{ "vec4", { GL_FLOAT_VEC4, 16, 16 } },
+					{ "ivec4", { GL_INT_VEC4, 16, 16 } },
+					{ "mat2", { GL_FLOAT_MAT2, 16, 32 } },
+					{ "mat3", { GL_FLOAT_MAT3, 16, 48 } },
+					{ "mat4", { GL_FLOAT_MAT4, 16, 64 } },
+					{ "sampler2D", { GL_SAMPLER_2D, 4, 4 } },
+					{ "sampler2DShadow", { GL_SAMPLER_2D_SHADOW, 4, 4 } },
+					{ "samplerCube", { GL_SAMPLER_CUBE, 4, 4 } },
+				};
+				auto layout = layouts.find(_Type);
+				return layout == layouts.end() ? TypeLayout{ GL_FLOAT_VEC4, 16, 16 } : layout->second;
+			}
+
+			bool IsQualifier(const std::string &_Token) {
+				return _Token == "highp" || _Token == "mediump" || _Token == "lowp" ||
+					_Token == "row_major" || _Token == "column_major";
+			}
+
+			//Parse "type name[N], name;" from _Index, calling _Declare for each
+			//name. Returns the index of the terminating ';'
+			size_t ParseDeclaration(const std::vector<std::string> &_Tokens, size_t _Index,
+				const std::function<void(const std::string&, const std::string&, GLint, bool)> &_Declare) {
+				while (_Index < _Tokens.size() && IsQualifier(_Tokens[_Index]))
+					_Index++;
+				if (_Index >= _Tokens.size())
+					return _Index;
+				const std::string type = _Tokens[_Index++];
+				while (_Index < _Tokens.size() && _Tokens[_Index] != ";") {
+					const std::string name = _Tokens[_Index++];
+					GLint count = 1;
+					bool array = false;
+					if (_Index + 2 < _Tokens.size() && _Tokens[_Index] == "[") {
+						count = std::max(std::atoi(_Tokens[_Index + 1].c_str()), 1);
+						array = true;
+						_Index += 3;
+					}
+					_Declare(type, name, count, array);
+					//Skip initialisers up to the next declarator
+					while (_Index < _Tokens.size() && _Tokens[_Index] != "," && _Tokens[_Index] != ";")
+						_Index++;
+					if (_Index < _Tokens.size() && _Tokens[_Index] == ",")
+						_Index++;
+				}
+				return _Index;
+			}
+
+			void Reflect(ProgramInfo &_Program) {
+				auto &state = State();
+				_Program.uniforms.clear();
+				_Program.blocks.clear();
+				GLint nextLocation = 0;
+				auto known = [&_Program](const std::string &_Name) {
+					return std::any_of(_Program.uniforms.begin(), _Program.uniforms.end(),
+						[&_Name](const ProgramInfo::Uniform &_U) { return _U.name == _Name; });
+				};
+
+				for (GLuint shader : _Program.shaders) {
+					const auto tokens = Tokenise(state.shaders[shader]);
+					int depth = 0;
+					for (size_t i = 0; i < tokens.size(); i++) {
+						if (tokens[i] == "{") {
+							depth++;
+							continue;
+						}
+						if (tokens[i] == "}") {
+							depth--;
+							continue;
+						}
+						if (depth != 0 || tokens[i] != "uniform")
+							continue;
+
+						size_t j = i + 1;
+						while (j < tokens.size() && IsQualifier(tokens[j]))
+							j++;
+						if (j + 1 < tokens.size() && tokens[j + 1] == "{") {
+							const std::string blockName = tokens[j];
+							const bool duplicate = std::any_of(_Program.blocks.begin(), _Program.blocks.end(),
+								[&blockName](const ProgramInfo::Block &_B) { return _B.name == blockName; });
+							const GLint blockIndex = static_cast<GLint>(_Program.blocks.size());
+							GLint offset = 0, members = 0;
+							j += 2;
+							while (j < tokens.size() && tokens[j] != "}") {
+								j = ParseDeclaration(tokens, j, [&](const std::string &_Type,
+									const std::string &_Name, GLint _Count, bool _Array) {
+									TypeLayout layout = Std140Layout(_Type);
+									GLint size = layout.size;
+									if (_Array) {
+										layout.alignment = 16;
+										size = ((layout.size + 15) / 16) * 16 * _Count;
+									}
+									offset = ((offset + layout.alignment - 1) / layout.alignment) * layout.alignment;
+									if (!duplicate) {
+										_Program.uniforms.push_back({ _Name, layout.type, _Count, _Array,
+											-1, blockIndex, offset });
+										members++;
+									}
+									offset += size;
+								}) + 1;
+							}
+							if (!duplicate)
+								_Program.blocks.push_back({ blockName, ((offset + 15) / 16) * 16, members, 0 });
+							//Skip the optional instance name
+							while (j < tokens.size() && tokens[j] != ";")
+								j++;
+						}
+						else {
+							j = ParseDeclaration(tokens, j, [&](const std::string &_Type,
+								const std::string &_Name, GLint _Count, bool _Array) {
+								if (known(_Name))
+									return;
+								_Program.uniforms.push_back({ _Name, Std140Layout(_Type).type, _Count, _Array,
+									nextLocation, -1, -1 });
+								nextLocation += _Count;
+							});
+						}
+						i = j;
+					}
+				}
+			}
+
+			ProgramInfo *Program(GLuint _Program) {
+				auto program = State().programs.find(_Program);
+				return program == State().programs.end() ? nullptr : &program->second;
+			}
+
+			void CountUniform(const char *_Name, GLint _Location, GLsizei _Count, uint64_t _Size) {
+				Record(_Name, { double(_Location), double(_Count) });
+				State().stats.uniformUploads++;
+				State().stats.uniformBytes += _Count * _Size;
+			}
+
+			void CountStateChange(const char *_Name, std::initializer_list<double> _Args) {
+				Record(_Name, _Args);
+				State().stats.stateChanges++;
+			}
+
+			void CountDraw(GLsizei _Count, GLsizei _Instances) {
+				auto &stats = State().stats;
+				stats.drawCalls++;
+				stats.instances += _Instances;
+				stats.vertices += uint64_t(_Count) * _Instances;
+			}
+
+		}
+
+		/*-------------Recording entry points------------*/
+		namespace RecordingStubs {
+
+			static GLenum APIENTRY GetError() {
+				return GL_NO_ERROR;
+			}
+
+			static void APIENTRY GetIntegerv(GLenum _PName, GLint *_Data) {
+				Record("glGetIntegerv", { double(_PName) });
+				switch (_PName) {
+				case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT:
+					*_Data = 256; break;
+				case GL_MAX_UNIFORM_BUFFER_BINDINGS:
+					*_Data = 36; break;
+				case GL_MAX_TEXTURE_IMAGE_UNITS: case GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS:
+					*_Data = 16; break;
+				case GL_MAX_DRAW_BUFFERS: case GL_MAX_COLOR_ATTACHMENTS:
+					*_Data = 8; break;
+				case GL_VIEWPORT:
+					std::copy(State().viewport, State().viewport + 4, _Data); break;
+				default:
+					*_Data = 0; break;
+				}
+			}
+
+			/*-------------Buffers------------*/
+			static void APIENTRY GenBuffers(GLsizei _N, GLuint *_Buffers) {
+				GenNames(_N, _Buffers);
+				for (GLsizei i = 0; i < _N; i++)
+					State().buffers[_Buffers[i]];
+				Record("glGenBuffers", { double(_N) });
+			}
+
+			static void APIENTRY DeleteBuffers(GLsizei _N, const GLuint *_Buffers) {
+				for (GLsizei i = 0; i < _N; i++)
+					State().buffers.erase(_Buffers[i]);
+				Record("glDeleteBuffers", { double(_N) });
+			}
+
+			static void APIENTRY BindBuffer(GLenum _Target, GLuint _Buffer) {
+				State().boundBuffers[_Target] = _Buffer;
+				State().stats.bufferBinds++;
+				Record("glBindBuffer", { double(_Target), double(_Buffer) });
+			}
+
+			static void APIENTRY BindBufferBase(GLenum _Target, GLuint _Index, GLuint _Buffer) {
+				State().boundBuffers[_Target] = _Buffer;
+				State().stats.bufferBinds++;
+				Record("glBindBufferBase", { double(_Target), double(_Index), double(_Buffer) });
+			}
+
+			static void APIENTRY BindBufferRange(GLenum _Target, GLuint _Index, GLuint _Buffer,
+				GLintptr _Offset, GLsizeiptr _Size) {
+				State().boundBuffers[_Target] = _Buffer;
+				State().stats.bufferBinds++;
+				Record("glBindBufferRange", { double(_Target), double(_Index), double(_Buffer),
+					double(_Offset), double(_Size) });
+			}
+
+			static void APIENTRY BufferData(GLenum _Target, GLsizeiptr _Size, const void *_Data, GLenum _Usage) {
+				if (auto buffer = BoundBuffer(_Target)) {
+					buffer->assign(_Size, 0);
+					if (_Data) {
+						std::memcpy(buffer->data(), _Data, _Size);
+						State().stats.bytesUploaded += _Size;
+					}
+				}
+				Record("glBufferData", { double(_Target), double(_Size), _Data ? 1.0 : 0.0, double(_Usage) });
+			}
+
+			static void APIENTRY BufferStorage(GLenum _Target, GLsizeiptr _Size, const void *_Data, GLbitfield _Flags) {
+				if (auto buffer = BoundBuffer(_Target)) {
+					buffer->assign(_Size, 0);
+					if (_Data) {
+						std::memcpy(buffer->data(), _Data, _Size);
+						State().stats.bytesUploaded += _Size;
+					}
+				}
+				Record("glBufferStorage", { double(_Target), double(_Size), _Data ? 1.0 : 0.0, double(_Flags) });
+			}
+
+			static void APIENTRY BufferSubData(GLenum _Target, GLintptr _Offset, GLsizeiptr _Size, const void *_Data) {
+				auto buffer = BoundBuffer(_Target);
+				if (buffer && _Offset + _Size <= GLsizeiptr(buffer->size())) {
+					std::memcpy(buffer->data() + _Offset, _Data, _Size);
+					State().stats.bytesUploaded += _Size;
+				}
+				Record("glBufferSubData", { double(_Target), double(_Offset), double(_Size) });
+			}
+
+			static void *APIENTRY MapBufferRange(GLenum _Target, GLintptr _Offset, GLsizeiptr _Length, GLbitfield _Access) {
+				Record("glMapBufferRange", { double(_Target), double(_Offset), double(_Length), double(_Access) });
+				auto buffer = BoundBuffer(_Target);
+				if (!buffer || _Length <= 0 || _Offset + _Length > GLsizeiptr(buffer->size()))
+					return nullptr;
+				if (_Access & GL_MAP_WRITE_BIT)
+					State().stats.bytesUploaded += _Length;
+				return buffer->data() + _Offset;
+			}
+
+			static void *APIENTRY MapBuffer(GLenum _Target, GLenum _Access) {
+				Record("glMapBuffer", { double(_Target), double(_Access) });
+				auto buffer = BoundBuffer(_Target);
+				if (!buffer || buffer->empty())
+					return nullptr;
+				if (_Access != GL_READ_ONLY)
+					State().stats.bytesUploaded += buffer->size();
+				return buffer->data();
+			}
+
+			static GLboolean APIENTRY UnmapBuffer(GLenum _Target) {
+				Record("glUnmapBuffer", { double(_Target) });
+				return GL_TRUE;
+			}
+
+			static void APIENTRY GetBufferParameteriv(GLenum _Target, GLenum _PName, GLint *_Params) {
+				Record("glGetBufferParameteriv", { double(_Target), double(_PName) });
+				auto buffer = BoundBuffer(_Target);
+				*_Params = (_PName == GL_BUFFER_SIZE && buffer) ? GLint(buffer->size()) : 0;
+			}
+
+			/*-------------Vertex arrays------------*/
+			static void APIENTRY GenVertexArrays(GLsizei _N, GLuint *_Arrays) {
+				GenNames(_N, _Arrays);
+				Record("glGenVertexArrays", { double(_N) });
+			}
+
+			static void APIENTRY DeleteVertexArrays(GLsizei _N, const GLuint *) {
+				Record("glDeleteVertexArrays", { double(_N) });
+			}
+
+			static void APIENTRY BindVertexArray(GLuint _Array) {
+				State().stats.vertexArrayBinds++;
+				//The element array binding belongs to the vertex array
+				State().boundBuffers.erase(GL_ELEMENT_ARRAY_BUFFER);
+				Record("glBindVertexArray", { double(_Array) });
+			}
+
+			static void APIENTRY EnableVertexAttribArray(GLuint _Index) {
+				Record("glEnableVertexAttribArray", { double(_Index) });
+			}
+
+			static void APIENTRY DisableVertexAttribArray(GLuint _Index) {
+				Record("glDisableVertexAttribArray", { double(_Index) });
+			}
+
+			static void APIENTRY VertexAttribPointer(GLuint _Index, GLint _Size, GLenum _Type,
+				GLboolean _Normalised, GLsizei _Stride, const void *_Pointer) {
+				Record("glVertexAttribPointer", { double(_Index), double(_Size), double(_Type),
+					double(_Normalised), double(_Stride), Offset(_Pointer) });
+			}
+
+			static void APIENTRY VertexAttribIPointer(GLuint _Index, GLint _Size, GLenum _Type,
+				GLsizei _Stride, const void *_Pointer) {
+				Record("glVertexAttribIPointer", { double(_Index), double(_Size), double(_Type),
+					double(_Stride), Offset(_Pointer) });
+			}
+
+			static void APIENTRY VertexAttribDivisor(GLuint _Index, GLuint _Divisor) {
+				Record("glVertexAttribDivisor", { double(_Index), double(_Divisor) });
+			}
+
+			/*-------------Textures------------*/
+			static void APIENTRY GenTextures(GLsizei _N, GLuint *_Textures) {
+				GenNames(_N, _Textures);
+				for (GLsizei i = 0; i < _N; i++)
+					State().textures[_Textures[i]];
+				Record("glGenTextures", { double(_N) });
+			}
+
+			static void APIENTRY DeleteTextures(GLsizei _N, const GLuint *_Textures) {
+				for (GLsizei i = 0; i < _N; i++)
+					State().textures.erase(_Textures[i]);
+				Record("glDeleteTextures", { double(_N) });
+			}
+
+			static void APIENTRY ActiveTexture(GLenum _Texture) {
+				State().activeTexture = _Texture;
+				CountStateChange("glActiveTexture", { double(_Texture) });
+			}
+
+			static void APIENTRY BindTexture(GLenum _Target, GLuint _Texture) {
+				auto &state = State();
+				state.boundTextures[(uint64_t(state.activeTexture) << 32) | _Target] = _Texture;
+				state.stats.textureBinds++;
+				Record("glBindTexture", { double(_Target), double(_Texture) });
+			}
+
+			static void APIENTRY TexImage2D(GLenum _Target, GLint _Level, GLint _InternalFormat, GLsizei _Width,
+				GLsizei _Height, GLint _Border, GLenum _Format, GLenum _Type, const void *_Pixels) {
+				const uint64_t texelSize = TexelSize(_InternalFormat, _Format, _Type);
+				if (auto texture = BoundTexture(_Target)) {
+					uint32_t face = 0;
+					if (BindingTarget(_Target) == GL_TEXTURE_CUBE_MAP)
+						face = _Target - GL_TEXTURE_CUBE_MAP_POSITIVE_X;
+					texture->images[(face << 8) | uint32_t(_Level)] = Image{ _Width, _Height, texelSize };
+				}
+				if (_Pixels)
+					State().stats.bytesUploaded += uint64_t(_Width) * _Height * texelSize;
+				Record("glTexImage2D", { double(_Target), double(_Level), double(_InternalFormat),
+					double(_Width), double(_Height), double(_Border), double(_Format), double(_Type),
+					_Pixels ? 1.0 : 0.0 });
+			}
+
+			static void APIENTRY TexParameteri(GLenum _Target, GLenum _PName, GLint _Param) {
+				Record("glTexParameteri", { double(_Target), double(_PName), double(_Param) });
+			}
+
+			static void APIENTRY GenerateMipmap(GLenum _Target) {
+				if (auto texture = BoundTexture(_Target)) {
+					std::vector<std::pair<uint32_t, Image>> bases;
+					for (auto &image : texture->images) {
+						if ((image.first & 0xFF) == 0)
+							bases.push_back(image);
+					}
+					for (auto &base : bases) {
+						Image image = base.second;
+						for (uint32_t level = 1; image.width > 1 || image.height > 1; level++) {
+							image.width = std::max(image.width / 2, 1);
+							image.height = std::max(image.height / 2, 1);
+							texture->images[(base.first & ~0xFFu) | level] = image;
+						}
+					}
+				}
+				Record("glGenerateMipmap", { double(_Target) });
+			}
+
+			/*-------------Framebuffers------------*/
+			static void APIENTRY GenFramebuffers(GLsizei _N, GLuint *_Framebuffers) {
+				GenNames(_N, _Framebuffers);
+				Record("glGenFramebuffers", { double(_N) });
+			}
+
+			static void APIENTRY DeleteFramebuffers(GLsizei _N, const GLuint *) {
+				Record("glDeleteFramebuffers", { double(_N) });
+			}
+
+			static void APIENTRY BindFramebuffer(GLenum _Target, GLuint _Framebuffer) {
+				State().stats.framebufferBinds++;
+				Record("glBindFramebuffer", { double(_Target), double(_Framebuffer) });
+			}
+
+			static GLenum APIENTRY CheckFramebufferStatus(GLenum _Target) {
+				Record("glCheckFramebufferStatus", { double(_Target) });
+				return GL_FRAMEBUFFER_COMPLETE;
+			}
+
+			static void APIENTRY FramebufferTexture(GLenum _Target, GLenum _Attachment, GLuint _Texture, GLint _Level) {
+				Record("glFramebufferTexture", { double(_Target), double(_Attachment), double(_Texture), double(_Level) });
+			}
+
+			static void APIENTRY FramebufferTexture2D(GLenum _Target, GLenum _Attachment, GLenum _TexTarget,
+				GLuint _Texture, GLint _Level) {
+				Record("glFramebufferTexture2D", { double(_Target), double(_Attachment), double(_TexTarget),
+					double(_Texture), double(_Level) });
+			}
+
+			static void APIENTRY GenRenderbuffers(GLsizei _N, GLuint *_Renderbuffers) {
+				GenNames(_N, _Renderbuffers);
+				for (GLsizei i = 0; i < _N; i++)
+					State().renderbuffers[_Renderbuffers[i]] = 0;
+				Record("glGenRenderbuffers", { double(_N) });
+			}
+
+			static void APIENTRY BindRenderbuffer(GLenum _Target, GLuint _Renderbuffer) {
+				State().boundRenderbuffer = _Renderbuffer;
+				Record("glBindRenderbuffer", { double(_Target), double(_Renderbuffer) });
+			}
+
+			static void APIENTRY RenderbufferStorage(GLenum _Target, GLenum _InternalFormat,
+				GLsizei _Width, GLsizei _Height) {
+				auto &state = State();
+				auto renderbuffer = state.renderbuffers.find(state.boundRenderbuffer);
+				if (renderbuffer != state.renderbuffers.end())
+					renderbuffer->second = uint64_t(_Width) * _Height * TexelSize(_InternalFormat, GL_RGBA, GL_UNSIGNED_BYTE);
+				Record("glRenderbufferStorage", { double(_Target), double(_InternalFormat),
+					double(_Width), double(_Height) });
+			}
+
+			static void APIENTRY FramebufferRenderbuffer(GLenum _Target, GLenum _Attachment,
+				GLenum _RenderbufferTarget, GLuint _Renderbuffer) {
+				Record("glFramebufferRenderbuffer", { double(_Target), double(_Attachment),
+					double(_RenderbufferTarget), double(_Renderbuffer) });
+			}
+
+			static void APIENTRY DrawBuffer(GLenum _Buffer) {
+				CountStateChange("glDrawBuffer", { double(_Buffer) });
+			}
+
+			static void APIENTRY DrawBuffers(GLsizei _N, const GLenum *_Buffers) {
+				CountStateChange("glDrawBuffers", { double(_N), _N > 0 ? double(_Buffers[0]) : 0.0 });
+			}
+
+			static void APIENTRY ReadBuffer(GLenum _Source) {
+				CountStateChange("glReadBuffer", { double(_Source) });
+			}
+
+			static void APIENTRY BlitFramebuffer(GLint _SrcX0, GLint _SrcY0, GLint _SrcX1, GLint _SrcY1,
+				GLint _DstX0, GLint _DstY0, GLint _DstX1, GLint _DstY1, GLbitfield _Mask, GLenum _Filter) {
+				Record("glBlitFramebuffer", { double(_SrcX0), double(_SrcY0), double(_SrcX1), double(_SrcY1),
+					double(_DstX0), double(_DstY0), double(_DstX1), double(_DstY1), double(_Mask), double(_Filter) });
+			}
+
+			/*-------------Fixed function state------------*/
+			static void APIENTRY Enable(GLenum _Cap) {
+				CountStateChange("glEnable", { double(_Cap) });
+			}
+
+			static void APIENTRY Disable(GLenum _Cap) {
+				CountStateChange("glDisable", { double(_Cap) });
+			}
+
+			static void APIENTRY BlendFunc(GLenum _SFactor, GLenum _DFactor) {
+				CountStateChange("glBlendFunc", { double(_SFactor), double(_DFactor) });
+			}
+
+			static void APIENTRY DepthFunc(GLenum _Func) {
+				CountStateChange("glDepthFunc", { double(_Func) });
+			}
+
+			static void APIENTRY CullFace(GLenum _Mode) {
+				CountStateChange("glCullFace", { double(_Mode) });
+			}
+
+			static void APIENTRY ProvokingVertex(GLenum _Mode) {
+				CountStateChange("glProvokingVertex", { double(_Mode) });
+			}
+
+			static void APIENTRY Viewport(GLint _X, GLint _Y, GLsizei _Width, GLsizei _Height) {
+				auto &viewport = State().viewport;
+				viewport[0] = _X; viewport[1] = _Y; viewport[2] = _Width; viewport[3] = _Height;
+				CountStateChange("glViewport", { double(_X), double(_Y), double(_Width), double(_Height) });
+			}
+
+			static void APIENTRY ClearColor(GLfloat _Red, GLfloat _Green, GLfloat _Blue, GLfloat _Alpha) {
+				CountStateChange("glClearColor", { _Red, _Green, _Blue, _Alpha });
+			}
+
+			static void APIENTRY Clear(GLbitfield _Mask) {
+				State().stats.clears++;
+				Record("glClear", { double(_Mask) });
+			}
+
+			/*-------------Draws------------*/
+			static void APIENTRY DrawArrays(GLenum _Mode, GLint _First, GLsizei _Count) {
+				CountDraw(_Count, 1);
+				Record("glDrawArrays", { double(_Mode), double(_First), double(_Count) });
+			}
+
+			static void APIENTRY DrawElements(GLenum _Mode, GLsizei _Count, GLenum _Type, const void *_Indices) {
+				CountDraw(_Count, 1);
+				Record("glDrawElements", { double(_Mode), double(_Count), double(_Type), Offset(_Indices) });
+			}
+
+			static void APIENTRY DrawElementsInstanced(GLenum _Mode, GLsizei _Count, GLenum _Type,
+				const void *_Indices, GLsizei _InstanceCount) {
+				CountDraw(_Count, _InstanceCount);
+				Record("glDrawElementsInstanced", { double(_Mode), double(_Count), double(_Type),
+					Offset(_Indices), double(_InstanceCount) });
+			}
+
+			/*-------------Shaders and programs------------*/
+			static GLuint APIENTRY CreateShader(GLenum _Type) {
+				const GLuint shader = State().nextName++;
+				State().shaders[shader];
+				Record("glCreateShader", { double(_Type) });
+				return shader;
+			}
+
+			static void APIENTRY DeleteShader(GLuint _Shader) {
+				State().shaders.erase(_Shader);
+				Record("glDeleteShader", { double(_Shader) });
+			}
+
+			static void APIENTRY ShaderSource(GLuint _Shader, GLsizei _Count, const GLchar *const *_Strings,
+				const GLint *_Lengths) {
+				std::string source;
+				for (GLsizei i = 0; i < _Count; i++) {
+					if (_Lengths && _Lengths[i] >= 0)
+						source.append(_Strings[i], _Lengths[i]);
+					else
+						source.append(_Strings[i]);
+				}
+				State().shaders[_Shader] = source;
+				Record("glShaderSource", { double(_Shader), double(_Count), double(source.size()) });
+			}
+
+			static void APIENTRY CompileShader(GLuint _Shader) {
+				Record("glCompileShader", { double(_Shader) });
+			}
+
+			static void APIENTRY GetShaderiv(GLuint _Shader, GLenum _PName, GLint *_Params) {
+				Record("glGetShaderiv", { double(_Shader), double(_PName) });
+				*_Params = _PName == GL_COMPILE_STATUS ? GL_TRUE : 0;
+			}
+
+			static void APIENTRY GetShaderInfoLog(GLuint _Shader, GLsizei _BufSize, GLsizei *_Length, GLchar *_InfoLog) {
+				Record("glGetShaderInfoLog", { double(_Shader) });
+				if (_Length)
+					*_Length = 0;
+				if (_BufSize > 0)
+					_InfoLog[0] = '\0';
+			}
+
+			static GLuint APIENTRY CreateProgram() {
+				const GLuint program = State().nextName++;
+				State().programs[program];
+				Record("glCreateProgram", {});
+				return program;
+			}
+
+			static void APIENTRY DeleteProgram(GLuint _Program) {
+				State().programs.erase(_Program);
+				Record("glDeleteProgram", { double(_Program) });
+			}
+
+			static void APIENTRY AttachShader(GLuint _Program, GLuint _Shader) {
+				if (auto program = Program(_Program))
+					program->shaders.push_back(_Shader);
+				Record("glAttachShader", { double(_Program), double(_Shader) });
+			}
+
+			static void APIENTRY BindAttribLocation(GLuint _Program, GLuint _Index, const GLchar *_Name) {
+				if (auto program = Program(_Program))
+					program->attribLocations[_Name] = GLint(_Index);
+				Record("glBindAttribLocation", { double(_Program), double(_Index) });
+			}
+
+			static void APIENTRY LinkProgram(GLuint _Program) {
+				if (auto program = Program(_Program))
+					Reflect(*program);
+				Record("glLinkProgram", { double(_Program) });
+			}
+
+			static void APIENTRY ValidateProgram(GLuint _Program) {
+				Record("glValidateProgram", { double(_Program) });
+			}
+
+			static void APIENTRY GetProgramiv(GLuint _Program, GLenum _PName, GLint *_Params) {
+				Record("glGetProgramiv", { double(_Program), double(_PName) });
+				auto program = Program(_Program);
+				switch (_PName) {
+				case GL_LINK_STATUS: case GL_VALIDATE_STATUS:
+					*_Params = GL_TRUE; break;
+				case GL_ACTIVE_UNIFORMS:
+					*_Params = program ? GLint(program->uniforms.size()) : 0; break;
+				case GL_ACTIVE_UNIFORM_BLOCKS:
+					*_Params = program ? GLint(program->blocks.size()) : 0; break;
+				default:
+					*_Params = 0; break;
+				}
+			}
+
+			static void APIENTRY GetProgramInfoLog(GLuint _Program, GLsizei _BufSize, GLsizei *_Length, GLchar *_InfoLog) {
+				Record("glGetProgramInfoLog", { double(_Program) });
+				if (_Length)
+					*_Length = 0;
+				if (_BufSize > 0)
+					_InfoLog[0] = '\0';
+			}
+
+			static void APIENTRY UseProgram(GLuint _Program) {
+				State().stats.programBinds++;
+				Record("glUseProgram", { double(_Program) });
+			}
+
+			static GLint APIENTRY GetAttribLocation(GLuint _Program, const GLchar *_Name) {
+				Record("glGetAttribLocation", { double(_Program) });
+				auto program = Program(_Program);
+				if (!program)
+					return -1;
+				auto location = program->attribLocations.find(_Name);
+				return location == program->attribLocations.end() ? -1 : location->second;
+			}
+
+			static GLint APIENTRY GetUniformLocation(GLuint _Program, const GLchar *_Name) {
+				Record("glGetUniformLocation", { double(_Program) });
+				auto program = Program(_Program);
+				if (!program)
+					return -1;
+				std::string name(_Name);
+				GLint element = 0;
+				const auto bracket = name.find('[');
+				if (bracket != std::string::npos) {
+					element = std::atoi(name.c_str() + bracket + 1);
+					name.resize(bracket);
+				}
+				for (auto &uniform : program->uniforms) {
+					if (uniform.name == name && uniform.location >= 0 && element < uniform.size)
+						return uniform.location + element;
+				}
+				return -1;
+			}
+
+			static void APIENTRY GetActiveUniform(GLuint _Program, GLuint _Index, GLsizei _BufSize,
+				GLsizei *_Length, GLint *_Size, GLenum *_Type, GLchar *_Name) {
+				Record("glGetActiveUniform", { double(_Program), double(_Index) });
+				auto program = Program(_Program);
+				if (!program || _Index >= program->uniforms.size() || _BufSize <= 0)
+					return;
+				const auto &uniform = program->uniforms[_Index];
+				const std::string name = uniform.array ? uniform.name + "[0]" : uniform.name;
+				const GLsizei length = std::min<GLsizei>(GLsizei(name.size()), _BufSize - 1);
+				std::memcpy(_Name, name.data(), length);
+				_Name[length] = '\0';
+				if (_Length)
+					*_Length = length;
+				*_Size = uniform.size;
+				*_Type = uniform.type;
+			}
+
+			static void APIENTRY GetActiveUniformsiv(GLuint _Program, GLsizei _UniformCount,
+				const GLuint *_UniformIndices, GLenum _PName, GLint *_Params) {
+				Record("glGetActiveUniformsiv", { double(_Program), double(_UniformCount), double(_PName) });
+				auto program = Program(_Program);
+				for (GLsizei i = 0; i < _UniformCount; i++) {
+					_Params[i] = 0;
+					if (!program || _UniformIndices[i] >= program->uniforms.size())
+						continue;
+					const auto &uniform = program->uniforms[_UniformIndices[i]];
+					switch (_PName) {
+					case GL_UNIFORM_BLOCK_INDEX: _Params[i] = uniform.block; break;
+					case GL_UNIFORM_OFFSET: _Params[i] = uniform.offset; break;
+					case GL_UNIFORM_TYPE: _Params[i] = GLint(uniform.type); break;
+					case GL_UNIFORM_SIZE: _Params[i] = uniform.size; break;
+					default: break;
+					}
+				}
+			}
+
+			static GLuint APIENTRY GetUniformBlockIndex(GLuint _Program, const GLchar *_Name) {
+				Record("glGetUniformBlockIndex", { double(_Program) });
+				auto program = Program(_Program);
+				if (!program)
+					return GL_INVALID_INDEX;
+				for (size_t i = 0; i < program->blocks.size(); i++) {
+					if (program->blocks[i].name == _Name)
+						return GLuint(i);
+				}
+				return GL_INVALID_INDEX;
+			}
+
+			static void APIENTRY GetActiveUniformBlockName(GLuint _Program, GLuint _Index, GLsizei _BufSize,
+				GLsizei *_Length, GLchar *_Name) {
+				Record("glGetActiveUniformBlockName", { double(_Program), double(_Index) });
+				auto program = Program(_Program);
+				if (!program || _Index >= program->blocks.size() || _BufSize <= 0)
+					return;
+				const std::string &name = program->blocks[_Index].name;
+				const GLsizei length = std::min<GLsizei>(GLsizei(name.size()), _BufSize - 1);
+				std::memcpy(_Name, name.data(), length);
+				_Name[length] = '\0';
+				if (_Length)
+					*_Length = length;
+			}
+
+			static void APIENTRY GetActiveUniformBlockiv(GLuint _Program, GLuint _Index, GLenum _PName, GLint *_Params) {
+				Record("glGetActiveUniformBlockiv", { double(_Program), double(_Index), double(_PName) });
+				auto program = Program(_Program);
+				*_Params = 0;
+				if (!program || _Index >= program->blocks.size())
+					return;
+				const auto &block = program->blocks[_Index];
+				switch (_PName) {
+				case GL_UNIFORM_BLOCK_DATA_SIZE: *_Params = block.dataSize; break;
+				case GL_UNIFORM_BLOCK_ACTIVE_UNIFORMS: *_Params = block.activeUniforms; break;
+				case GL_UNIFORM_BLOCK_BINDING: *_Params = GLint(block.binding); break;
+				default: break;
+				}
+			}
+
+			static void APIENTRY UniformBlockBinding(GLuint _Program, GLuint _Index, GLuint _Binding) {
+				auto program = Program(_Program);
+				if (program && _Index < program->blocks.size())
+					program->blocks[_Index].binding = _Binding;
+				Record("glUniformBlockBinding", { double(_Program), double(_Index), double(_Binding) });
+			}
+
+			/*-------------Uniforms------------*/
+			static void APIENTRY Uniform1i(GLint _Location, GLint _V0) {
+				CountUniform("glUniform1i", _Location, 1, sizeof(_V0));
+			}
+
+			static void APIENTRY Uniform1iv(GLint _Location, GLsizei _Count, const GLint *) {
+				CountUniform("glUniform1iv", _Location, _Count, sizeof(GLint));
+			}
+
+			static void APIENTRY Uniform1uiv(GLint _Location, GLsizei _Count, const GLuint *) {
+				CountUniform("glUniform1uiv", _Location, _Count, sizeof(GLuint));
+			}
+
+			static void APIENTRY Uniform1fv(GLint _Location, GLsizei _Count, const GLfloat *) {
+				CountUniform("glUniform1fv", _Location, _Count, sizeof(GLfloat));
+			}
+
+			static void APIENTRY Uniform2fv(GLint _Location, GLsizei _Count, const GLfloat *) {
+				CountUniform("glUniform2fv", _Location, _Count, 2 * sizeof(GLfloat));
+			}
+
+			static void APIENTRY Uniform2iv(GLint _Location, GLsizei _Count, const GLint *) {
+				CountUniform("glUniform2iv", _Location, _Count, 2 * sizeof(GLint));
+			}
+
+			static void APIENTRY Uniform3fv(GLint _Location, GLsizei _Count, const GLfloat *) {
+				CountUniform("glUniform3fv", _Location, _Count, 3 * sizeof(GLfloat));
+			}
+
+			static void APIENTRY Uniform4fv(GLint _Location, GLsizei _Count, const GLfloat *) {
+				CountUniform("glUniform4fv", _Location, _Count, 4 * sizeof(GLfloat));
+			}
+
+			static void APIENTRY UniformMatrix3fv(GLint _Location, GLsizei _Count, GLboolean, const GLfloat *) {
+				CountUniform("glUniformMatrix3fv", _Location, _Count, 9 * sizeof(GLfloat));
+			}
+
+			static void APIENTRY UniformMatrix4fv(GLint _Location, GLsizei _Count, GLboolean, const GLfloat *) {
+				CountUniform("glUniformMatrix4fv", _Location, _Count, 16 * sizeof(GLfloat));
+			}
+
+			/*-------------Queries and sync------------*/
+			static void APIENTRY GenQueries(GLsizei _N, GLuint *_IDs) {
+				GenNames(_N, _IDs);
+				Record("glGenQueries", { double(_N) });
+			}
+
+			static void APIENTRY DeleteQueries(GLsizei _N, const GLuint *) {
+				Record("glDeleteQueries", { double(_N) });
+			}
+
+			static void APIENTRY BeginQuery(GLenum _Target, GLuint _ID) {
+				Record("glBeginQuery", { double(_Target), double(_ID) });
+			}
+
+			static void APIENTRY EndQuery(GLenum _Target) {
+				Record("glEndQuery", { double(_Target) });
+			}
+
+			static void APIENTRY GetQueryObjectiv(GLuint _ID, GLenum _PName, GLint *_Params) {
+				Record("glGetQueryObjectiv", { double(_ID), double(_PName) });
+				*_Params = _PName == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+			}
+
+			static void APIENTRY GetQueryObjectui64v(GLuint _ID, GLenum _PName, GLuint64 *_Params) {
+				Record("glGetQueryObjectui64v", { double(_ID), double(_PName) });
+				*_Params = _PName == GL_QUERY_RESULT_AVAILABLE ? GL_TRUE : 0;
+			}
+
+			static void APIENTRY QueryCounter(GLuint _ID, GLenum _Target) {
+				Record("glQueryCounter", { double(_ID), double(_Target) });
+			}
+
+			static void APIENTRY GetInteger64v(GLenum _PName, GLint64 *_Data) {
+				Record("glGetInteger64v", { double(_PName) });
+				*_Data = 0;
+			}
+
+			static GLsync APIENTRY FenceSync(GLenum _Condition, GLbitfield _Flags) {
+				Record("glFenceSync", { double(_Condition), double(_Flags) });
+				return reinterpret_cast<GLsync>(State().nextSync++);
+			}
+
+			static GLenum APIENTRY ClientWaitSync(GLsync, GLbitfield _Flags, GLuint64 _Timeout) {
+				Record("glClientWaitSync", { double(_Flags), double(_Timeout) });
+				return GL_ALREADY_SIGNALED;
+			}
+
+			static void APIENTRY DeleteSync(GLsync) {
+				Record("glDeleteSync", {});
+			}
+
+		}
+
+		template <typename T>
+		static void Hook(T &_Slot, T _Stub) {
+			State().restore.push_back([&_Slot, original = _Slot]() { _Slot = original; });
+			_Slot = _Stub;
+		}
+
+		void GLBackend::UseRecording() {
+			auto &state = State();
+			if (state.recording)
+				return;
+			state.recording = true;
+
+			using namespace RecordingStubs;
+			Hook(glad_glGetError, &GetError);
+			Hook(glad_glGetIntegerv, &GetIntegerv);
+
+			Hook(glad_glGenBuffers, &GenBuffers);
+			Hook(glad_glDeleteBuffers, &DeleteBuffers);
+			Hook(glad_glBindBuffer, &BindBuffer);
+			Hook(glad_glBindBufferBase, &BindBufferBase);
+			Hook(glad_glBindBufferRange, &BindBufferRange);
+			Hook(glad_glBufferData, &BufferData);
+			Hook(glad_glBufferStorage, &BufferStorage);
+			Hook(glad_glBufferSubData, &BufferSubData);
+			Hook(glad_glMapBufferRange, &MapBufferRange);
+			Hook(glad_glMapBuffer, &MapBuffer);
+			Hook(glad_glUnmapBuffer, &UnmapBuffer);
+			Hook(glad_glGetBufferParameteriv, &GetBufferParameteriv);
+
+			Hook(glad_glGenVertexArrays, &GenVertexArrays);
+			Hook(glad_glDeleteVertexArrays, &DeleteVertexArrays);
+			Hook(glad_glBindVertexArray, &BindVertexArray);
+			Hook(glad_glEnableVertexAttribArray, &EnableVertexAttribArray);
+			Hook(glad_glDisableVertexAttribArray, &DisableVertexAttribArray);
+			Hook(glad_glVertexAttribPointer, &VertexAttribPointer);
+			Hook(glad_glVertexAttribIPointer, &VertexAttribIPointer);
+			Hook(glad_glVertexAttribDivisor, &VertexAttribDivisor);
+
+			Hook(glad_glGenTextures, &GenTextures);
+			Hook(glad_glDeleteTextures, &DeleteTextures);
+			Hook(glad_glActiveTexture, &ActiveTexture);
+			Hook(glad_glBindTexture, &BindTexture);
+			Hook(glad_glTexImage2D, &TexImage2D);
+			Hook(glad_glTexParameteri, &TexParameteri);
+			Hook(glad_glGenerateMipmap, &GenerateMipmap);
+
+			Hook(glad_glGenFramebuffers, &GenFramebuffers);
+			Hook(glad_glDeleteFramebuffers, &DeleteFramebuffers);
+			Hook(glad_glBindFramebuffer, &BindFramebuffer);
+			Hook(glad_glCheckFramebufferStatus, &CheckFramebufferStatus);
+			Hook(glad_glFramebufferTexture, &FramebufferTexture);
+			Hook(glad_glFramebufferTexture2D, &FramebufferTexture2D);
+			Hook(glad_glGenRenderbuffers, &GenRenderbuffers);
+			Hook(glad_glBindRenderbuffer, &BindRenderbuffer);
+			Hook(glad_glRenderbufferStorage, &RenderbufferStorage);
+			Hook(glad_glFramebufferRenderbuffer, &FramebufferRenderbuffer);
+			Hook(glad_glDrawBuffer, &DrawBuffer);
+			Hook(glad_glDrawBuffers, &DrawBuffers);
+			Hook(glad_glReadBuffer, &ReadBuffer);
+			Hook(glad_glBlitFramebuffer, &BlitFramebuffer);
+
+			Hook(glad_glEnable, &Enable);
+			Hook(glad_glDisable, &Disable);
+			Hook(glad_glBlendFunc, &BlendFunc);
+			Hook(glad_glDepthFunc, &DepthFunc);
+			Hook(glad_glCullFace, &CullFace);
+			Hook(glad_glProvokingVertex, &ProvokingVertex);
+			Hook(glad_glViewport, &Viewport);
+			Hook(glad_glClearColor, &ClearColor);
+			Hook(glad_glClear, &Clear);
+
+			Hook(glad_glDrawArrays, &DrawArrays);
+			Hook(glad_glDrawElements, &DrawElements);
+			Hook(glad_glDrawElementsInstanced, &DrawElementsInstanced);
+
+			Hook(glad_glCreateShader, &CreateShader);
+			Hook(glad_glDeleteShader, &DeleteShader);
+			Hook(glad_glShaderSource, &ShaderSource);
+			Hook(glad_glCompileShader, &CompileShader);
+			Hook(glad_glGetShaderiv, &GetShaderiv);
+			Hook(glad_glGetShaderInfoLog, &GetShaderInfoLog);
+			Hook(glad_glCreateProgram, &CreateProgram);
+			Hook(glad_glDeleteProgram, &DeleteProgram);
+			Hook(glad_glAttachShader, &AttachShader);
+			Hook(glad_glBindAttribLocation, &BindAttribLocation);
+			Hook(glad_glLinkProgram, &LinkProgram);
+			Hook(glad_glValidateProgram, &ValidateProgram);
+			Hook(glad_glGetProgramiv, &GetProgramiv);
+			Hook(glad_glGetProgramInfoLog, &GetProgramInfoLog);
+			Hook(glad_glUseProgram, &UseProgram);
+			Hook(glad_glGetAttribLocation, &GetAttribLocation);
+			Hook(glad_glGetUniformLocation, &GetUniformLocation);
+			Hook(glad_glGetActiveUniform, &GetActiveUniform);
+			Hook(glad_glGetActiveUniformsiv, &GetActiveUniformsiv);
+			Hook(glad_glGetUniformBlockIndex, &GetUniformBlockIndex);
+			Hook(glad_glGetActiveUniformBlockName, &GetActiveUniformBlockName);
+			Hook(glad_glGetActiveUniformBlockiv, &GetActiveUniformBlockiv);
+			Hook(glad_glUniformBlockBinding, &UniformBlockBinding);
+
+			Hook(glad_glUniform1i, &Uniform1i);
+			Hook(glad_glUniform1iv, &Uniform1iv);
+			Hook(glad_glUniform1uiv, &Uniform1uiv);
+			Hook(glad_glUniform1fv, &Uniform1fv);
+			Hook(glad_glUniform2fv, &Uniform2fv);
+			Hook(glad_glUniform2iv, &Uniform2iv);
+			Hook(glad_glUniform3fv, &Uniform3fv);
+			Hook(glad_glUniform4fv, &Uniform4fv);
+			Hook(glad_glUniformMatrix3fv, &UniformMatrix3fv);
+			Hook(glad_glUniformMatrix4fv, &UniformMatrix4fv);
+
+			Hook(glad_glGenQueries, &GenQueries);
+			Hook(glad_glDeleteQueries, &DeleteQueries);
+			Hook(glad_glBeginQuery, &BeginQuery);
+			Hook(glad_glEndQuery, &EndQuery);
+			Hook(glad_glGetQueryObjectiv, &GetQueryObjectiv);
+			Hook(glad_glGetQueryObjectui64v, &GetQueryObjectui64v);
+			Hook(glad_glQueryCounter, &QueryCounter);
+			Hook(glad_glGetInteger64v, &GetInteger64v);
+			Hook(glad_glFenceSync, &FenceSync);
+			Hook(glad_glClientWaitSync, &ClientWaitSync);
+			Hook(glad_glDeleteSync, &DeleteSync);
+		}
+
+		void GLBackend::UseDriver() {
+			auto &state = State();
+			if (!state.recording)
+				return;
+			for (auto &restore : state.restore)
+				restore();
+			state.restore.clear();
+			state.recording = false;
+		}
+
+		bool GLBackend::IsRecording() {
+			return State().recording;
+		}
+
+		void GLBackend::SetCapture(bool _Capture) {
+			State().capture = _Capture;
+		}
+
+		void GLBackend::Reset() {
+			State().stats = Statistics();
+			State().commands.clear();
+		}
+
+		const GLBackend::Statistics &GLBackend::GetStatistics() {
+			return State().stats;
+		}
+
+		const std::vector<GLBackend::Command> &GLBackend::GetCommands() {
+			return State().commands;
+		}
+
+		void GLBackend::DumpCommands(std::ostream &_Stream) {
+			for (auto &command : State().commands) {
+				_Stream << command.name << '(';
+				for (uint8_t i = 0; i < command.argCount; i++)
+					_Stream << (i ? ", " : "") << command.args[i];
+				_Stream << ")\n";
+			}
+		}
+
+		uint64_t GLBackend::GetBufferSize(GLuint _Buffer) {
+			auto buffer = State().buffers.find(_Buffer);
+			return buffer == State().buffers.end() ? 0 : buffer->second.size();
+		}
+
+		uint64_t GLBackend::GetTextureSize(GLuint _Texture) {
+			auto texture = State().textures.find(_Texture);
+			return texture == State().textures.end() ? 0 : texture->second.Size();
+		}
+
+		uint64_t GLBackend::GetRenderbufferSize(GLuint _Renderbuffer) {
+			auto renderbuffer = State().renderbuffers.find(_Renderbuffer);
+			return renderbuffer == State().renderbuffers.end() ? 0 : renderbuffer->second;
+		}
+
+		uint64_t GLBackend::GetResidentBytes() {
+			auto &state = State();
+			uint64_t bytes = 0;
+			for (auto &buffer : state.buffers)
+				bytes += buffer.second.size();
+			for (auto &texture : state.textures)
+				bytes += texture.second.Size();
+			for (auto &renderbuffer : state.renderbuffers)
+				bytes += renderbuffer.second;
+			return bytes;
+		}
+
+	}
+}
@@ -0,0 +1,250 @@
+#include "GLState.h"
+
+namespace GL_Engine {
+	namespace CG_Data {
+
+		GLuint StateCache::program = StateCache::Unknown;
+		GLuint StateCache::vertexArray = StateCache::Unknown;
+		GLuint StateCache::framebuffer = StateCache::Unknown;
+		GLenum StateCache::activeUnit = StateCache::Unknown;
+		StateCache::TextureUnit StateCache::textureUnits[ MaxTextureUnits ];
+		StateCache::BufferBinding StateCache::uniformBuffers[ MaxUniformBuffers ];
+		GLenum StateCache::blendSrc = StateCache::Unknown;
+		GLenum StateCache::blendDst = StateCache::Unknown;
+		GLenum StateCache::depthFunction = StateCache::Unknown;
+		GLenum StateCache::cullMode = StateCache::Unknown;
+		std::unordered_map< GLenum, bool > StateCache::capabilities;
+		std::unordered_map< uint64_t, GLuint > StateCache::blockBindings;
+		StateCache::Statistics StateCache::statistics;
+
+		bool StateCache::record( bool _changed ) {
+			if ( _changed ) {
+				statistics.issued++;
+			}
+			else {
+				statistics.filtered++;
+			}
+			return _changed;
+		}
+
+		void StateCache::useProgram( GLuint _program ) {
+			if ( record( program != _program ) ) {
+				glUseProgram( _program );
+				program = _program;
+			}
+		}
+
+		void StateCache::bindVertexArray( GLuint _vao ) {
+			if ( record( vertexArray != _vao ) ) {
+				glBindVertexArray( _vao );
+				vertexArray = _vao;
+			}
+		}
+
+		void StateCache::bindFramebuffer( GLuint _fbo ) {
+			if ( record( framebuffer != _fbo ) ) {
+				glBindFramebuffer( GL_FRAMEBUFFER, _fbo );
+				framebuffer = _fbo;
+			}
+		}
+
+		void StateCache::activeTexture( GLenum _unit ) {
+			if ( record( activeUnit != _unit ) ) {
+				glActiveTexture( _unit );
+				activeUnit = _unit;
+			}
+		}
+
+		void StateCache::bindTexture( GLenum _unit, GLenum _target,
+									  GLuint _id ) {
+			const GLuint index = _unit - GL_TEXTURE0;
+			if ( index >= MaxTextureUnits ) {
+				// Untracked unit, always pass through
+				activeTexture( _unit );
+				record( true );
+				glBindTexture( _target, _id );
+				return;
+			}
+
+			auto & unit = textureUnits[ index ];
+			if ( !record( unit.target != _target || unit.id != _id ) ) {
+				return;
+			}
+			activeTexture( _unit );
+			glBindTexture( _target, _id );
+			unit.target = _target;
+			unit.id = _id;
+		}
+
+		void StateCache::bindTexture( GLenum _target, GLuint _id ) {
+			if ( activeUnit == Unknown ) {
+				activeTexture( GL_TEXTURE0 );
+			}
+			bindTexture( activeUnit, _target, _id );
+		}
+
+		void StateCache::uniformBlockBinding( GLuint _program,
+											  GLuint _blockIndex,
+											  GLuint _binding ) {
+			const uint64_t key =
+				( static_cast< uint64_t >( _program ) << 32 ) | _blockIndex;
+			auto it = blockBindings.find( key );
+			if ( !record( it == blockBindings.end() || it->second != _binding ) ) {
+				return;
+			}
+			glUniformBlockBinding( _program, _blockIndex, _binding );
+			blockBindings[ key ] = _binding;
+		}
+
+		void StateCache::bindBufferBase( GLenum _target, GLuint _index,
+										 GLuint _buffer ) {
+			// Only uniform buffer bindings are tracked
+			if ( _target != GL_UNIFORM_BUFFER || _index >= MaxUniformBuffers ) {
+				record( true );
+				glBindBufferBase( _target, _index, _buffer );
+				return;
+			}
+			auto & binding = uniformBuffers[ _index ];
+			if ( record( binding.buffer != _buffer ||
+						 binding.size != WholeBuffer ) ) {
+				glBindBufferBase( _target, _index, _buffer );
+				binding = BufferBinding{ _buffer, 0, WholeBuffer };
+			}
+		}
+
+		void StateCache::bindBufferRange( GLenum _target, GLuint _index,
+										  GLuint _buffer, GLintptr _offset,
+										  GLsizeiptr _size ) {
+			if ( _target != GL_UNIFORM_BUFFER || _index >= MaxUniformBuffers ) {
+				record( true );
+				glBindBufferRange( _target, _index, _buffer, _offset, _size );
+				return;
+			}
+			auto & binding = uniformBuffers[ _index ];
+			if ( record( binding.buffer != _buffer || binding.offset != _offset ||
+						 binding.size != _size ) ) {
+				glBindBufferRange( _target, _index, _buffer, _offset, _size );
+				binding = BufferBinding{ _buffer, _offset, _size };
+			}
+		}
+
+		void StateCache::enable( GLenum _cap ) {
+			setCapability( _cap, true );
+		}
+
+		void StateCache::disable( GLenum _cap ) {
+			setCapability( _cap, false );
+		}
+
+		void StateCache::setCapability( GLenum _cap, bool _enabled ) {
+			auto it = capabilities.find( _cap );
+			if ( !record( it == capabilities.end() || it->second != _enabled ) ) {
+				return;
+			}
+			if ( _enabled ) {
+				glEnable( _cap );
+			}
+			else {
+				glDisable( _cap );
+			}
+			capabilities[ _cap ] = _enabled;
+		}
+
+		void StateCache::blendFunc( GLenum _src, GLenum _dst ) {
+			if ( record( blendSrc != _src || blendDst != _dst ) ) {
+				glBlendFunc( _src, _dst );
+				blendSrc = _src;
+				blendDst = _dst;
+			}
+		}
+
+		void StateCache::depthFunc( GLenum _func ) {
+			if ( record( depthFunction != _func ) ) {
+				glDepthFunc( _func );
+				depthFunction = _func;
+			}
+		}
+
+		void StateCache::cullFace( GLenum _mode ) {
+			if ( record( cullMode != _mode ) ) {
+				glCullFace( _mode );
+				cullMode = _mode;
+			}
+		}
+
+		void StateCache::programDeleted( GLuint _program ) {
+			if ( program == _program ) {
+				program = Unknown;
+			}
+			for ( auto it = blockBindings.begin(); it != blockBindings.end(); ) {
+				if ( ( it->first >> 32 ) == _program ) {
+					it = blockBindings.erase( it );
+				}
+				else {
+					++it;
+				}
+			}
+		}
+
+		void StateCache::vertexArrayDeleted( GLuint _vao ) {
+			// GL reverts to VAO 0 when the bound VAO is deleted
+			if ( vertexArray == _vao ) {
+				vertexArray = 0;
+			}
+		}
+
+		void StateCache::framebufferDeleted( GLuint _fbo ) {
+			// GL reverts to the default framebuffer when the bound one is deleted
+			if ( framebuffer == _fbo ) {
+				framebuffer = 0;
+			}
+		}
+
+		void StateCache::textureDeleted( GLuint _id ) {
+			for ( auto & unit : textureUnits ) {
+				if ( unit.id == _id ) {
+					unit.id = 0;
+				}
+			}
+		}
+
+		GLuint StateCache::getProgram() {
+			return program;
+		}
+
+		GLuint StateCache::getVertexArray() {
+			return vertexArray;
+		}
+
+		GLuint StateCache::getFramebuffer() {
+			return framebuffer;
+		}
+
+		GLenum StateCache::getActiveTexture() {
+			return activeUnit;
+		}
+
+		void StateCache::invalidate() {
+			program = vertexArray = framebuffer = Unknown;
+			activeUnit = Unknown;
+			for ( auto & unit : textureUnits ) {
+				unit = TextureUnit();
+			}
+			for ( auto & ubo : uniformBuffers ) {
+				ubo = BufferBinding();
+			}
+			blendSrc = blendDst = depthFunction = cullMode = Unknown;
+			capabilities.clear();
+			blockBindings.clear();
+		}
+
+		const StateCache::Statistics & StateCache::getStatistics() {
+			return statistics;
+		}
+
+		void StateCache::resetStatistics() {
+			statistics = Statistics();
+		}
+
+	}
+}
@@ -95,6 +95,7 @@ GUI::GUI( std::shared_ptr< RenderPass > _rPass,
     _rPass->BatchVao = this->guiVao;
     _rPass->renderFunction = DefaultRenderer;
     _rPass->Data = &this->active;
+    _rPass->sortLayer = CommandBucket::Overlay;
     _rPass->Textures.push_back( std::move( _texture ) );
     this->renderPass = std::move( _rPass );
 
@@ -0,0 +1,243 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace GL_Engine {
+
+    // Pool and index of the worker on this thread, if it is one
+    static thread_local const JobSystem * CurrentPool = nullptr;
+    static thread_local uint32_t CurrentWorker = 0;
+
+    JobSystem::JobSystem( uint32_t _workers ){
+        for ( uint32_t i = 0; i < _workers; i++ ){
+            workers.push_back( std::make_unique< Worker >() );
+        }
+        for ( uint32_t i = 0; i < _workers; i++ ){
+            workers[ i ]->thread = std::thread( &JobSystem::workerLoop, this, i );
+        }
+    }
+
+    JobSystem::~JobSystem(){
+        {
+            std::lock_guard< std::mutex > lock( sleepMutex );
+            running = false;
+        }
+        sleepCondition.notify_all();
+        for ( auto & worker : workers ){
+            worker->thread.join();
+        }
+    }
+
+    void JobSystem::schedule( Job _job, Counter * _counter ){
+        if ( _counter ){
+            _counter->pending.fetch_add( 1, std::memory_order_relaxed );
+        }
+        Worker * worker = &overflow;
+        if ( CurrentPool == this ){
+            // Keep forked work local, it is likely to share data
+            worker = workers[ CurrentWorker ].get();
+        }
+        else if ( !workers.empty() ){
+            worker = workers[ nextWorker++ % workers.size() ].get();
+        }
+        {
+            std::lock_guard< std::mutex > lock( worker->mutex );
+            worker->jobs.push_back( Entry{ std::move( _job ), _counter } );
+        }
+        queued.fetch_add( 1, std::memory_order_release );
+        {
+            // Pairs with the predicate check in workerLoop, so the
+            // notification cannot fall between a check and the wait
+            std::lock_guard< std::mutex > lock( sleepMutex );
+        }
+        sleepCondition.notify_one();
+    }
+
+    void JobSystem::run( Entry & _entry ){
+        _entry.job();
+        if ( _entry.counter ){
+            _entry.counter->pending.fetch_sub( 1, std::memory_order_release );
+        }
+    }
+
+    bool JobSystem::take( Entry & _entry ){
+        if ( queued.load( std::memory_order_acquire ) == 0 ){
+            return false;
+        }
+        if ( CurrentPool == this ){
+            auto & own = *workers[ CurrentWorker ];
+            std::lock_guard< std::mutex > lock( own.mutex );
+            if ( !own.jobs.empty() ){
+                _entry = std::move( own.jobs.back() );
+                own.jobs.pop_back();
+                queued.fetch_sub( 1, std::memory_order_relaxed );
+                return true;
+            }
+        }
+        return steal( _entry, CurrentPool == this ? CurrentWorker + 1 : 0 );
+    }
+
+    bool JobSystem::steal( Entry & _entry, uint32_t _first ){
+        const size_t count = workers.size();
+        for ( size_t i = 0; i <= count; i++ ){
+            Worker & victim = i < count ? *workers[ ( _first + i ) % count ] : overflow;
+            std::lock_guard< std::mutex > lock( victim.mutex );
+            if ( !victim.jobs.empty() ){
+                _entry = std::move( victim.jobs.front() );
+                victim.jobs.pop_front();
+                queued.fetch_sub( 1, std::memory_order_relaxed );
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void JobSystem::workerLoop( uint32_t _index ){
+        CurrentPool = this;
+        CurrentWorker = _index;
+        Entry entry;
+        while ( running ){
+            if ( take( entry ) ){
+                run( entry );
+                entry = Entry();
+                continue;
+            }
+            std::unique_lock< std::mutex > lock( sleepMutex );
+            sleepCondition.wait( lock, [ this ](){
+                return !running || queued.load( std::memory_order_acquire ) > 0;
+            } );
+        }
+    }
+
+    void JobSystem::wait( const Counter & _counter ){
+        Entry entry;
+        while ( !_counter.isDone() ){
+            if ( take( entry ) ){
+                run( entry );
+                entry = Entry();
+            }
+            else {
+                // The remaining jobs are running elsewhere
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void JobSystem::parallelFor( size_t _begin, size_t _end, size_t _grain,
+                                 const std::function< void( size_t, size_t ) > & _body ){
+        if ( _end <= _begin ){
+            return;
+        }
+        const size_t count = _end - _begin;
+        if ( _grain == 0 ){
+            // A few ranges per thread, so stealing can even out the load
+            _grain = std::max< size_t >( 1, count / ( ( workers.size() + 1 ) * 4 ) );
+        }
+        Counter counter;
+        size_t rangeBegin = _begin;
+        for ( ; _end - rangeBegin > _grain; rangeBegin += _grain ){
+            const size_t rangeEnd = rangeBegin + _grain;
+            schedule( [ &_body, rangeBegin, rangeEnd ](){
+                _body( rangeBegin, rangeEnd );
+            }, &counter );
+        }
+        _body( rangeBegin, _end );
+        wait( counter );
+    }
+
+    void JobSystem::runOnMainThread( Job _job ){
+        std::lock_guard< std::mutex > lock( mainThreadMutex );
+        mainThreadJobs.push_back( std::move( _job ) );
+    }
+
+    size_t JobSystem::runMainThreadJobs(){
+        std::vector< Job > jobs;
+        {
+            std::lock_guard< std::mutex > lock( mainThreadMutex );
+            jobs.swap( mainThreadJobs );
+        }
+        for ( auto & job : jobs ){
+            job();
+        }
+        return jobs.size();
+    }
+
+    uint32_t JobSystem::getWorkerCount() const {
+        return static_cast< uint32_t >( workers.size() );
+    }
+
+    JobSystem & JobSystem::get(){
+        const uint32_t threads = std::thread::hardware_concurrency();
+        static JobSystem jobSystem( threads > 1 ? threads - 1 : 0 );
+        return jobSystem;
+    }
+
+    /* --- TaskGraph --- */
+
+    TaskGraph::TaskId TaskGraph::add( JobSystem::Job _job ){
+        tasks.emplace_back();
+        tasks.back().job = std::move( _job );
+        return static_cast< TaskId >( tasks.size() - 1 );
+    }
+
+    void TaskGraph::precede( TaskId _before, TaskId _after ){
+        tasks[ _before ].successors.push_back( _after );
+        tasks[ _after ].dependencies++;
+    }
+
+    size_t TaskGraph::size() const {
+        return tasks.size();
+    }
+
+    void TaskGraph::schedule( JobSystem & _jobs, TaskId _task,
+                              JobSystem::Counter & _counter ){
+        _jobs.schedule( [ this, &_jobs, &_counter, _task ](){
+            Task & task = tasks[ _task ];
+            task.job();
+            // Successors are scheduled before this job is counted done,
+            // so the graph cannot look finished early
+            for ( TaskId successor : task.successors ){
+                if ( tasks[ successor ].remaining.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ){
+                    schedule( _jobs, successor, _counter );
+                }
+            }
+        }, &_counter );
+    }
+
+    void TaskGraph::run( JobSystem & _jobs ){
+        // Check the graph is acyclic, or run() would never return
+        std::vector< uint32_t > remaining( tasks.size() );
+        std::vector< TaskId > ready;
+        for ( TaskId i = 0; i < tasks.size(); i++ ){
+            remaining[ i ] = tasks[ i ].dependencies;
+            if ( remaining[ i ] == 0 ){
+                ready.push_back( i );
+            }
+        }
+        const std::vector< TaskId > roots = ready;
+        size_t visited = 0;
+        while ( !ready.empty() ){
+            const TaskId task = ready.back();
+            ready.pop_back();
+            visited++;
+            for ( TaskId successor : tasks[ task ].successors ){
+                if ( --remaining[ successor ] == 0 ){
+                    ready.push_back( successor );
+                }
+            }
+        }
+        if ( visited != tasks.size() ){
+            throw std::runtime_error( "Task graph has a dependency cycle" );
+        }
+
+        for ( auto & task : tasks ){
+            task.remaining.store( task.dependencies, std::memory_order_relaxed );
+        }
+        JobSystem::Counter counter;
+        for ( TaskId root : roots ){
+            schedule( _jobs, root, counter );
+        }
+        _jobs.wait( counter );
+    }
+
+}
@@ -1,4 +1,6 @@
 #include "ModelLoader.h"
+#include "Skeleton.h"
+#include "Utilities.h"
 #include <filesystem>
 
 namespace GL_Engine {
@@ -36,6 +38,8 @@ namespace GL_Engine {
         this->numIndices = static_cast<GLuint>( indices.size() );
         indices.clear();
 
+        this->Bounds = BoundingVolume::fromPoints( &mesh->mVertices[0].x, mesh->mNumVertices );
+
         std::unique_ptr<VBO> meshVBO = std::make_unique<VBO>(mesh->mVertices, mesh->mNumVertices * sizeof(aiVector3D), GL_STATIC_DRAW);
         meshVBO->BindVBO();
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
@@ -153,24 +157,35 @@ namespace GL_Engine {
         return attributes;
     }
     
-    void LoadAnimations(std::map<std::string, std::shared_ptr<SceneNode>> &NodeList, const aiScene *_Scene) {
+    //Joint of the node named _Name, throwing if the scene has none
+    uint32_t FindJoint(const Skeleton &_Rig, const std::string &_Name) {
+        const uint32_t joint = _Rig.findJoint(NameTable::get().intern(_Name));
+        if (joint == Skeleton::NoJoint)
+            throw std::runtime_error("Model has no node " + _Name);
+        return joint;
+    }
+
+    void LoadAnimations(Skeleton &_Rig, const aiScene *_Scene) {
         for (unsigned int animID = 0; animID < _Scene->mNumAnimations; animID++) {
             aiAnimation* anim = _Scene->mAnimations[animID];
+            //Clip index animID, so animation IDs match the file's
+            const uint32_t clip = _Rig.addClip(NameTable::get().intern(anim->mName.data), anim->mDuration);
             for (unsigned int i = 0; i < anim->mNumChannels; i++) {
                 aiNodeAnim *animNode = anim->mChannels[i];
-                auto node = NodeList[animNode->mNodeName.data];
-                node->Animation =std::make_shared<NodeAnimation>(animNode, anim->mDuration);
+                _Rig.setAnimation(clip, FindJoint(_Rig, animNode->mNodeName.data),
+                                  std::make_shared<NodeAnimation>(animNode, anim->mDuration));
             }
         }
     }
 
-    std::shared_ptr<SceneNode> LoadNodes(std::map<std::string, std::shared_ptr<SceneNode>> &NodeList, aiNode* node) {
-        auto newNode = std::make_shared<SceneNode>(node);
-        NodeList[node->mName.data] = newNode;
+    //Add node and its descendants to _Rig, depth first so parents come
+    //before their children
+    void LoadNodes(Skeleton &_Rig, const aiNode* node, uint32_t _Parent) {
+        const uint32_t joint = _Rig.addJoint(NameTable::get().intern(node->mName.data), _Parent,
+                                             Utilities::AiToGLMMat4(node->mTransformation));
         for (unsigned int i = 0; i < node->mNumChildren; i++) {
-            newNode->AddChild(LoadNodes(NodeList, node->mChildren[i]));
+            LoadNodes(_Rig, node->mChildren[i], joint);
         }
-        return newNode;
     }
 
     struct VertexBoneData {
@@ -221,39 +236,25 @@ namespace GL_Engine {
 									  aImporter.GetErrorString() + "\n" );
         }
         //Load in the scene's nodes
-        std::map<std::string, std::shared_ptr<SceneNode>> Nodes;
-        auto rootNode = LoadNodes(Nodes, _Scene->mRootNode);
-        LoadAnimations(Nodes, _Scene);
+        auto rig = std::make_unique<Skeleton>();
+        LoadNodes(*rig, _Scene->mRootNode, Skeleton::NoJoint);
+        rig->setGlobalInverse(glm::inverse(Utilities::AiToGLMMat4(_Scene->mRootNode->mTransformation)));
+        LoadAnimations(*rig, _Scene);
         auto numMeshes = _Scene->mNumMeshes;
         ModelAttribList attributes;
         attributes.reserve(numMeshes);
 
-        std::map<std::string, std::shared_ptr<SceneBone>> SceneBoneMap;
         //Load in the scene's meshes, as well as the bones for each mesh
         for (unsigned int i = 0; i < _Scene->mNumMeshes; i++) {
-            std::map<std::string, std::shared_ptr<MeshBone>> MeshBoneMap;
             auto mesh = _Scene->mMeshes[i];
             std::shared_ptr<ModelAttribute> newAttrib = std::make_shared<ModelAttribute>( _Scene, i, pathBase.generic_string() );
             std::vector<VertexBoneData> WeightVBOData;
             WeightVBOData.resize(mesh->mNumVertices);
+            rig->addPalette();
             for (unsigned int bi = 0; bi < mesh->mNumBones; bi++) {
-                unsigned int BoneIndex = 0;
                 aiBone *mBone = mesh->mBones[bi];
-                auto newMeshBone = std::make_shared<MeshBone>(mBone);
-                std::shared_ptr<SceneBone> sceneBone;
-                if (SceneBoneMap.count(mBone->mName.data) == 0) {
-                    sceneBone = std::make_shared<SceneBone>(mBone);
-                    SceneBoneMap[mBone->mName.data] = sceneBone;
-                    Nodes[mBone->mName.data]->sceneBone = sceneBone;
-                }
-                else {
-                    sceneBone = SceneBoneMap[mBone->mName.data];
-                }
-                sceneBone->AddMeshBone(newMeshBone);
-
-                newAttrib->meshBones.push_back(newMeshBone);
-                BoneIndex = (unsigned int)newAttrib->meshBones.size() - 1;
-                newAttrib->BoneIndex[mBone->mName.data] = BoneIndex;
+                const unsigned int BoneIndex = rig->addPaletteEntry(FindJoint(*rig, mBone->mName.data),
+                                                                    Utilities::AiToGLMMat4(mBone->mOffsetMatrix));
 
                 for (unsigned int bwi = 0; bwi < mBone->mNumWeights; bwi++) {
                     auto weightData = mBone->mWeights[bwi];
@@ -298,7 +299,7 @@ namespace GL_Engine {
 
         aImporter.FreeScene();
 
-        return std::make_unique<RiggedModel>(std::make_unique<Skeleton>(rootNode, Nodes), std::move(attributes));
+        return std::make_unique<RiggedModel>(std::move(rig), std::move(attributes));
     }
 
     void ModelLoader::cleanup() {
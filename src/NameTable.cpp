@@ -0,0 +1,33 @@
+#include "NameTable.h"
+
+namespace GL_Engine {
+
+    NameId NameTable::intern( const std::string & _name ){
+        std::lock_guard< std::mutex > lock( mutex );
+        auto found = ids.find( _name );
+        if ( found != ids.end() ){
+            return found->second;
+        }
+        const NameId id = static_cast< NameId >( names.size() );
+        names.push_back( _name );
+        ids.emplace( _name, id );
+        return id;
+    }
+
+    NameId NameTable::find( const std::string & _name ) const {
+        std::lock_guard< std::mutex > lock( mutex );
+        auto found = ids.find( _name );
+        return found != ids.end() ? found->second : InvalidName;
+    }
+
+    const std::string & NameTable::getName( NameId _id ) const {
+        std::lock_guard< std::mutex > lock( mutex );
+        return names[ _id ];
+    }
+
+    NameTable & NameTable::get(){
+        static NameTable table;
+        return table;
+    }
+
+}
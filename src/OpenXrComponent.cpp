@@ -1,6 +1,7 @@
 #include "OpenXrComponent.h"
 
 #include "Renderer.h"
+#include "GLState.h"
 #include "xr_linear.h"
 
 #include <algorithm>
@@ -405,6 +406,8 @@ void OpenXrComponent::unbind() {
 	VerifyResult( xrEndFrame( m_session, &frameEndInfo ) );
 
 	glBindFramebuffer( GL_DRAW_FRAMEBUFFER, 0 );
+	// Draw/read framebuffers were bound behind the state cache's back
+	GL_Engine::CG_Data::StateCache::invalidate();
 	//std::move( bindToken ).unbind();
 }
 
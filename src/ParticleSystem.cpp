@@ -1,6 +1,8 @@
 #include "ParticleSystem.h"
 #include <iostream>
 #include <time.h>
+#include <memory_resource>
+#include "GLState.h"
 
 namespace GL_Engine {
 
@@ -13,7 +15,7 @@ namespace GL_Engine {
 	};
 	
 	ParticleSystem::ParticleSystem(){
-		
+		this->AddComponent<ParticleEmitter>();
 	}
 
 
@@ -26,23 +28,23 @@ namespace GL_Engine {
 		srand(123184103u);
 		//Set entity/particle initial values
 		this->ParticleCount = stats.ParticleCount;
-		this->Position = glm::vec4(stats.Position, 1.0);
+		this->SetPosition(stats.Position);
 		this->cameraUBO = _CameraUBO;
-		this->Orientation = glm::quat(0.0, 0.0, 0.0, 1.0);
-		this->Forward = glm::vec3(0, 0, 1);
-		this->Up = glm::vec3(0, 1, 0);
-		this->Right = glm::vec3(1, 0, 0);
-		this->UpdateMatrix();
-		this->Time = 0.0;
+		this->SetOrientation(glm::quat(0.0, 0.0, 0.0, 1.0));
+		this->update();
+		this->UpdateEmitter();
+		this->SetTime(0.0f);
 
 		
-		//Generate initial data conditions
-		float *InitialVelocityData = new float[this->ParticleCount * 3]; // start velocities vec3
-		float *InitialTimeData = new float[this->ParticleCount]; // start times
-		float *InitialSizeData = new float[this->ParticleCount]; // initial size
-		float *InitialColourData = new float[this->ParticleCount * 3]; //initial colour
-		float *InitialOpacityData = new float[this->ParticleCount];	//initial opacity
-		float *LifetimeData = new float[this->ParticleCount];	//lifetime
+		//Generate initial data conditions, in one scratch buffer that only
+		//lives until the data is uploaded (12 floats per particle)
+		std::pmr::monotonic_buffer_resource scratch(this->ParticleCount * 12 * sizeof(float) + 64);
+		std::pmr::vector<float> InitialVelocityData(this->ParticleCount * 3, &scratch); // start velocities vec3
+		std::pmr::vector<float> InitialTimeData(this->ParticleCount, &scratch); // start times
+		std::pmr::vector<float> InitialSizeData(this->ParticleCount, &scratch); // initial size
+		std::pmr::vector<float> InitialColourData(this->ParticleCount * 3, &scratch); //initial colour
+		std::pmr::vector<float> InitialOpacityData(this->ParticleCount, &scratch);	//initial opacity
+		std::pmr::vector<float> LifetimeData(this->ParticleCount, &scratch);	//lifetime
 
 		float TimeAccumulator = 0.0f;
 		int j = 0;
@@ -135,17 +137,6 @@ namespace GL_Engine {
 		this->ParticleVAO->AddVBO(std::move(ColourVBO));
 		this->ParticleVAO->AddVBO(std::move(OpacityVBO));
 		this->ParticleVAO->AddVBO(std::move(LifetimeVBO));
-		delete[] InitialColourData;
-		delete[] InitialVelocityData;
-		delete[] InitialTimeData;
-		delete[] InitialSizeData;
-		delete[] LifetimeData;
-		delete[] InitialOpacityData;
-
-		auto MatrixLambda = [](const CG_Data::Uniform &u) {glUniformMatrix4fv(u.GetID(), 1, GL_FALSE, static_cast<const GLfloat*>(u.GetData())); };
-		auto FloatLambda = [](const CG_Data::Uniform &u) {glUniform1fv(u.GetID(), 1, static_cast<const GLfloat*>(u.GetData())); };
-		auto Vec3Lambda = [](const CG_Data::Uniform &u) {glUniform3fv(u.GetID(), 1, static_cast<const GLfloat*>(u.GetData())); };
-		auto Vec4Lambda = [](const CG_Data::Uniform &u) {glUniform4fv(u.GetID(), 1, static_cast<const GLfloat*>(u.GetData())); };
 
 		this->ParticleShader = std::make_unique<Shader>();
 		this->ParticleShader->registerShaderStage(ParticleSystemVSource.c_str(), GL_VERTEX_SHADER);
@@ -157,19 +148,10 @@ namespace GL_Engine {
 		this->ParticleShader->registerAttribute("Opacity", 4);
 		this->ParticleShader->registerAttribute("Lifetime", 5);
 		this->ParticleShader->registerUBO(std::string("CameraProjectionData"), this->cameraUBO);
-		auto TimeUniform = this->ParticleShader->registerUniform("CurrentTime", FloatLambda);
-		auto EmitterUniform = this->ParticleShader->registerUniform("EmitterPosition", Vec3Lambda);
-		auto DirectionUniform = this->ParticleShader->registerUniform("EmitterDirection", Vec3Lambda);
-		auto ModelUniform = this->ParticleShader->registerUniform("model", MatrixLambda);
-		auto GravityUniform = this->ParticleShader->registerUniform("Gravity", Vec3Lambda);
 		this->ParticleShader->compileShader();
 
-		glUniform3f(GravityUniform->GetID(), 0, -1, 0);
+		this->ParticleShader->getBinder<glm::vec3>("Gravity").set(glm::vec3(0, -1, 0));
 
-	//	auto ModelIndex = this->AddData((void*)glm::value_ptr(this->TransformMatrix));
-		auto EmitterIndex = this->AddData((void*)glm::value_ptr(this->Position));
-		auto DirectionIndex = this->AddData((void*)glm::value_ptr(this->Forward));
-		auto TimeIndex = this->AddData((void*)&(this->Time));
 
 		auto ParticlePass = std::make_unique<RenderPass>();
 		ParticlePass->renderFunction = std::function<void(RenderPass&, void*)>(this->ParticleRenderer);
@@ -177,46 +159,57 @@ namespace GL_Engine {
 		uint32_t count = this->ParticleCount;
 		ParticlePass->SetDrawFunction([count]() {glDrawArrays(GL_POINTS, 0, count); });
 		ParticlePass->BatchVao = this->ParticleVAO;
+		//Blended, so draw after the opaque passes
+		ParticlePass->sortLayer = CommandBucket::Translucent;
 		ParticlePass->AddBatchUnit(this);
-		ParticlePass->AddDataLink(ModelUniform.get(), 0);
-		ParticlePass->AddDataLink(TimeUniform.get(), TimeIndex);
-		ParticlePass->AddDataLink(EmitterUniform.get(), EmitterIndex);
-		ParticlePass->AddDataLink(DirectionUniform.get(), DirectionIndex);
+		ParticlePass->EnableDrawBlock("EmitterData");
+		ParticlePass->AddDrawBlockLink<glm::mat4>(DataSource::WorldMatrix(), "model");
+		ParticlePass->AddDrawBlockLink<float>(DataSource::Member<&ParticleEmitter::Time>(), "CurrentTime");
+		ParticlePass->AddDrawBlockLink<glm::vec3>(DataSource::Member<&ParticleEmitter::Position>(), "EmitterPosition");
+		ParticlePass->AddDrawBlockLink<glm::vec3>(DataSource::Member<&ParticleEmitter::Direction>(), "EmitterDirection");
 		
 
 		return std::move(ParticlePass);
 	}
 
+	//The time is set once per frame, which also picks up any movement
+	//of the emitter since the last frame
 	void ParticleSystem::UpdateTime(const float &_Diff) {
-		this->Time += _Diff;
+		this->GetComponent<ParticleEmitter>()->Time += _Diff;
+		this->UpdateEmitter();
 	}
 	void ParticleSystem::SetTime(const float& _CurrentTime) {
-		this->Time = _CurrentTime;
+		this->GetComponent<ParticleEmitter>()->Time = _CurrentTime;
+		this->UpdateEmitter();
+	}
+
+	void ParticleSystem::UpdateEmitter() {
+		auto &Emitter = *this->GetComponent<ParticleEmitter>();
+		Emitter.Position = glm::vec3(this->GetPosition());
+		Emitter.Direction = this->GetForward();
 	}
-	const float& ParticleSystem::GetTime() const {
-		return this->Time;
+	float ParticleSystem::GetTime() const {
+		return this->GetComponent<ParticleEmitter>()->Time;
 	}
 
 	void ParticleSystem::ParticleRenderer(RenderPass &_Pass, void *_Data) {
-		glEnable(GL_PROGRAM_POINT_SIZE);
-		glEnable(GL_BLEND);
+		CG_Data::StateCache::enable(GL_PROGRAM_POINT_SIZE);
+		CG_Data::StateCache::enable(GL_BLEND);
 
 		_Pass.shader->useShader();
 		_Pass.BatchVao->BindVAO();
 
-		for (auto&& batch : _Pass.batchUnits) {
-			if (batch->active && batch->entity->isActive()) {
-				for (auto l : _Pass.dataLink) {
-					l.uniform->SetData(batch->entity->GetData(l.eDataIndex));
-					l.uniform->Update();
-				}
+		for (size_t i = 0; i < _Pass.batchUnits.size(); i++) {
+			auto &batch = _Pass.batchUnits[i];
+			if (batch->active && batch->entity->isActive() && _Pass.IsVisible(i)) {
+				_Pass.BindDrawBlock(i);
 				batch->entity->UpdateUniforms();
 				_Pass.DrawFunction();
 			}
 		}
 
-		glDisable(GL_BLEND);
-		glDisable(GL_PROGRAM_POINT_SIZE);
+		CG_Data::StateCache::disable(GL_BLEND);
+		CG_Data::StateCache::disable(GL_PROGRAM_POINT_SIZE);
 	}
 
 }
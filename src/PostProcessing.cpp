@@ -1,5 +1,7 @@
 #include "PostProcessing.h"
 #include "CG_Engine.h"
+#include "GLState.h"
+#include "Profiler.h"
 
 namespace GL_Engine {
 
@@ -45,8 +47,7 @@ namespace GL_Engine {
 		//{
 		//case GaussianBlur:
 		//{
-			auto GaussianLambdaUpdater = [](const CG_Data::Uniform &u) {glUniform1fv(u.GetID(), 5, static_cast<const GLfloat*>(u.GetData())); };
-			auto uni = shader.registerUniform("GaussianWeights", GaussianLambdaUpdater);
+			auto uni = shader.registerUniform<float>("GaussianWeights", 5);
 			AttachmentStringComponents[0] += "uniform float GaussianWeights[5] = float[] (0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);\n";
 			AttachmentStringComponents[1] += "BloomEffect();\n";
 			return uni.get();
@@ -76,10 +77,10 @@ namespace GL_Engine {
 		shader.registerAttribute("vPosition", 0);
 		shader.registerAttribute("vTextureCoord", 1);
 		shader.registerTextureUnit("InputImage", 0);
-		auto resoUni = shader.registerUniform("resolution");
 		shader.compileShader();
 		shader.useShader();
-		glUniform2f(resoUni->GetID(), (float)_Width, (float)_Height);
+		ResolutionBinder = shader.getBinder<glm::vec2>("resolution");
+		ResolutionBinder.set(Resolution);
 
 		ScreenVAO = std::make_unique<CG_Data::VAO>();
 		ScreenVAO->BindVAO();
@@ -111,19 +112,38 @@ namespace GL_Engine {
 	}
 
 	void PostProcessing::Process() {
+		CG_PROFILE_SCOPE("PostProcessing::Process");
 		auto bindToken = ProcessingFBO->bind(0);
+		Draw();
+	}
+
+	void PostProcessing::AddPasses(RenderGraph &_Graph) {
+		auto input = _Graph.importTexture("PostProcessingInput", InputTexture);
+		auto output = _Graph.importTexture("PostProcessingOutput", OutputColourBuffer);
+		_Graph.addPass("PostProcessing",
+			[&](RenderGraph::PassBuilder &_Builder) {
+				_Builder.read(input);
+				_Builder.write(output);
+				_Builder.setFramebuffer(*ProcessingFBO);
+			},
+			[this](const RenderGraph &) {
+				Draw();
+			});
+		_Graph.markOutput(output);
+	}
+
+	void PostProcessing::Draw() {
+		CG_PROFILE_SCOPE("PostProcessing::Draw");
 		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		shader.useShader();
-		auto loc = glGetUniformLocation(shader.getShaderID(), "resolution");
-		glUniform2f(loc, Resolution.x, Resolution.y);
+		ResolutionBinder.set(Resolution);
 
 		for (auto u : Uniforms)
 			u->Update();
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, InputTexture->GetID());
+		CG_Data::StateCache::bindTexture(GL_TEXTURE0, GL_TEXTURE_2D, InputTexture->GetID());
 
 		ScreenVAO->BindVAO();
 		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
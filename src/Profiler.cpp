@@ -0,0 +1,268 @@
+#include "Profiler.h"
+#include "QueryPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+namespace GL_Engine {
+
+    Profiler::Profiler(){
+        this->epoch = 0;
+        this->epoch = now();
+    }
+
+    int64_t Profiler::now() const {
+        const auto time = std::chrono::steady_clock::now().time_since_epoch();
+        return std::chrono::duration_cast< std::chrono::nanoseconds >( time ).count()
+               - this->epoch;
+    }
+
+    void Profiler::setEnabled( bool _enabled ){
+        this->enabled = _enabled;
+    }
+
+    bool Profiler::isEnabled() const {
+        return this->enabled;
+    }
+
+    void Profiler::setGpuTiming( bool _gpuTiming ){
+        this->gpuTiming = _gpuTiming;
+    }
+
+    bool Profiler::isGpuTiming() const {
+        return this->gpuTiming;
+    }
+
+    uint32_t Profiler::begin( const char * _name ){
+        if ( !this->enabled ){
+            return InvalidEvent;
+        }
+        const uint32_t index = static_cast< uint32_t >( current.events.size() );
+        current.events.push_back( Event{ _name, openEvents++, now(), -1 } );
+
+        GLuint query = 0;
+        if ( this->gpuTiming ){
+            query = acquireQuery();
+            glQueryCounter( query, GL_TIMESTAMP );
+            lastQuery = query;
+        }
+        currentQueries.push_back( query );
+        currentQueries.push_back( 0 );
+        return eventBase + index;
+    }
+
+    uint32_t Profiler::begin( const std::string & _name ){
+        if ( !this->enabled ){
+            return InvalidEvent;
+        }
+        return begin( names.insert( _name ).first->c_str() );
+    }
+
+    void Profiler::end( uint32_t _event ){
+        // Events of an earlier frame were closed by endFrame()
+        if ( _event == InvalidEvent || _event < eventBase ||
+             _event - eventBase >= current.events.size() ){
+            return;
+        }
+        const uint32_t index = _event - eventBase;
+        auto & event = current.events[ index ];
+        if ( event.cpuEnd >= 0 ){
+            return;
+        }
+        event.cpuEnd = now();
+        if ( openEvents > 0 ){
+            openEvents--;
+        }
+        if ( currentQueries[ index * 2 ] != 0 ){
+            const GLuint query = acquireQuery();
+            glQueryCounter( query, GL_TIMESTAMP );
+            currentQueries[ index * 2 + 1 ] = query;
+            lastQuery = query;
+        }
+    }
+
+    void Profiler::endFrame(){
+        const int64_t time = now();
+        for ( auto & event : current.events ){
+            if ( event.cpuEnd < 0 ){
+                event.cpuEnd = time;
+            }
+        }
+        current.cpuEnd = time;
+        eventBase += static_cast< uint32_t >( current.events.size() );
+        openEvents = 0;
+
+        if ( lastQuery != 0 ){
+            // Map GPU timestamps onto the CPU timeline. GL_TIMESTAMP is the
+            // time the GPU has reached, so this does not wait for it
+            GLint64 gpuTime = 0;
+            glGetInteger64v( GL_TIMESTAMP, &gpuTime );
+            pending.push_back( PendingFrame{ std::move( current ),
+                                             gpuTime - time,
+                                             std::move( currentQueries ),
+                                             lastQuery } );
+        }
+        else if ( this->enabled || !current.events.empty() ){
+            pushHistory( std::move( current ) );
+        }
+        resolvePendingFrames();
+
+        current = Frame();
+        current.index = ++frameIndex;
+        current.cpuBegin = time;
+        currentQueries.clear();
+        lastQuery = 0;
+    }
+
+    void Profiler::resolvePendingFrames(){
+        while ( !pending.empty() ){
+            auto & frame = pending.front();
+            const bool overdue = pending.size() > MaxPendingFrames;
+            if ( frameIndex - frame.frame.index < GpuLatency && !overdue ){
+                break;
+            }
+
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv( frame.lastQuery, GL_QUERY_RESULT_AVAILABLE,
+                                &available );
+            if ( available ){
+                for ( size_t i = 0; i < frame.frame.events.size(); i++ ){
+                    const GLuint beginQuery = frame.queries[ i * 2 ];
+                    const GLuint endQuery = frame.queries[ i * 2 + 1 ];
+                    if ( beginQuery == 0 || endQuery == 0 ){
+                        continue;
+                    }
+                    GLuint64 beginTime = 0, endTime = 0;
+                    glGetQueryObjectui64v( beginQuery, GL_QUERY_RESULT, &beginTime );
+                    glGetQueryObjectui64v( endQuery, GL_QUERY_RESULT, &endTime );
+                    auto & event = frame.frame.events[ i ];
+                    event.gpuBegin = static_cast< int64_t >( beginTime ) - frame.gpuOffset;
+                    event.gpuEnd = static_cast< int64_t >( endTime ) - frame.gpuOffset;
+                }
+                frame.frame.gpuResolved = true;
+            }
+            else if ( !overdue ){
+                break;
+            }
+
+            releaseQueries( frame.queries );
+            pushHistory( std::move( frame.frame ) );
+            pending.pop_front();
+        }
+    }
+
+    GLuint Profiler::acquireQuery(){
+        return CG_Data::QueryPool::Get().Acquire( GL_TIMESTAMP );
+    }
+
+    void Profiler::releaseQueries( const std::vector< GLuint > & _queries ){
+        auto & pool = CG_Data::QueryPool::Get();
+        for ( GLuint query : _queries ){
+            pool.Release( GL_TIMESTAMP, query );
+        }
+    }
+
+    void Profiler::pushHistory( Frame && _frame ){
+        history.push_back( std::move( _frame ) );
+        while ( history.size() > HistoryFrames ){
+            history.pop_front();
+        }
+    }
+
+    const std::deque< Profiler::Frame > & Profiler::getFrames() const {
+        return this->history;
+    }
+
+    const Profiler::Frame * Profiler::getLatestFrame() const {
+        return history.empty() ? nullptr : &history.back();
+    }
+
+    std::vector< Profiler::Summary > Profiler::summarise( const Frame & _frame ){
+        std::vector< Summary > summaries;
+        for ( auto & event : _frame.events ){
+            auto summary = std::find_if( summaries.begin(), summaries.end(),
+                [ &event ]( const Summary & _s ){
+                    return std::strcmp( _s.name, event.name ) == 0;
+                } );
+            if ( summary == summaries.end() ){
+                summaries.push_back( Summary{ event.name, 0, 0.0, 0.0 } );
+                summary = summaries.end() - 1;
+            }
+            summary->calls++;
+            summary->cpuMilliseconds += ( event.cpuEnd - event.cpuBegin ) / 1e6;
+            if ( event.gpuBegin >= 0 ){
+                summary->gpuMilliseconds += ( event.gpuEnd - event.gpuBegin ) / 1e6;
+            }
+        }
+        return summaries;
+    }
+
+    static void writeJsonString( std::ostream & _stream, const char * _string ){
+        _stream << '"';
+        for ( const char * c = _string; *c; c++ ){
+            if ( *c == '"' || *c == '\\' ){
+                _stream << '\\' << *c;
+            }
+            else if ( static_cast< unsigned char >( *c ) < 0x20 ){
+                _stream << ' ';
+            }
+            else {
+                _stream << *c;
+            }
+        }
+        _stream << '"';
+    }
+
+    void Profiler::writeChromeTrace( std::ostream & _stream ) const {
+        // One process, with a CPU and a GPU track. Times in microseconds
+        const auto flags = _stream.flags();
+        _stream << std::fixed << std::setprecision( 3 );
+        _stream << "{\"traceEvents\":[\n"
+                << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+                   "\"args\":{\"name\":\"CPU\"}},\n"
+                << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+                   "\"args\":{\"name\":\"GPU\"}}";
+        auto writeEvent = [ &_stream ]( const char * _name, int _track,
+                                        int64_t _begin, int64_t _end,
+                                        uint64_t _frame ){
+            _stream << ",\n{\"name\":";
+            writeJsonString( _stream, _name );
+            _stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << _track
+                    << ",\"ts\":" << _begin / 1e3
+                    << ",\"dur\":" << ( _end - _begin ) / 1e3
+                    << ",\"args\":{\"frame\":" << _frame << "}}";
+        };
+        for ( auto & frame : history ){
+            writeEvent( "Frame", 1, frame.cpuBegin, frame.cpuEnd, frame.index );
+            for ( auto & event : frame.events ){
+                writeEvent( event.name, 1, event.cpuBegin, event.cpuEnd, frame.index );
+                if ( event.gpuBegin >= 0 ){
+                    writeEvent( event.name, 2, event.gpuBegin, event.gpuEnd, frame.index );
+                }
+            }
+        }
+        _stream << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        _stream.flags( flags );
+    }
+
+    bool Profiler::saveChromeTrace( const std::string & _path ) const {
+        std::ofstream file( _path );
+        if ( !file ){
+            return false;
+        }
+        writeChromeTrace( file );
+        return static_cast< bool >( file );
+    }
+
+    void Profiler::clear(){
+        history.clear();
+    }
+
+    Profiler & Profiler::get(){
+        static Profiler profiler;
+        return profiler;
+    }
+
+}
@@ -1,6 +1,8 @@
 
 #include "ProjectionMapping.h"
 #include "ModelLoader.h"
+#include "GLState.h"
+#include "Profiler.h"
 
 namespace GL_Engine{
 
@@ -15,7 +17,12 @@ namespace GL_Engine{
         vec4 clippingPlane; \n \
     };\n \
     in vec3 vPosition;\n \
+    #ifdef INSTANCED\n \
+    in mat4 instanceMatrix;\n \
+    #define modelMatrix instanceMatrix\n \
+    #else\n \
     uniform mat4 modelMatrix;\n \
+    #endif\n \
     void main(){\n \
         gl_Position = pvMatrix * modelMatrix * vec4( vPosition, 1.0 );\n \
     }\n \
@@ -28,6 +35,15 @@ namespace GL_Engine{
     }\n \
     ";
 
+    // Build the instanced variant of a default shader source, which reads the
+    // model matrix from a per-instance attribute rather than a uniform
+    static std::string instancedVariant( const std::string & _source ){
+        std::string source = _source;
+        auto versionEnd = source.find( '\n', source.find( "#version" ) );
+        source.insert( versionEnd + 1, "#define INSTANCED\n" );
+        return source;
+    }
+
     ProjectionMapping::ProjectionMapping( uint16_t _fbWidth, uint16_t _fbHeight,
                                           glm::vec3 _dir, const std::shared_ptr< CG_Data::UBO > ubo ){
 
@@ -90,36 +106,38 @@ namespace GL_Engine{
        // this->textureMaps[ ShadowMap ] = std::move( colourTex );
 
         this->renderer = std::make_shared< Renderer >();
+        this->renderer->SetCullingCamera( &this->mappingCamera );
 
 
         auto camUbo = mappingCamera.getCameraUbo();
         renderer->AddUBO( camUbo.get() );
 
-        auto matrixUniformUpdateLambda = []( const CG_Data::Uniform & u ){
-            glUniformMatrix4fv( u.GetID(), 1, GL_FALSE, 
-                                static_cast< const GLfloat * >( u.GetData() ) );
-        };
-
-
         defaultShader.registerShaderStage( std::string( defaultVertexShaderStr ),
                                            GL_VERTEX_SHADER );
         defaultShader.registerShaderStage( std::string( defaultFragmentShaderStr ),
                                            GL_FRAGMENT_SHADER );
         defaultShader.registerAttribute( "vPosition", 0 );
         defaultShader.registerUBO( "CameraProjectionData", camUbo );
-        defaultShader.registerUniform( "modelMatrix" );
+        defaultShader.registerUniform< glm::mat4 >( "modelMatrix" );
         defaultShader.compileShader();
-        defaultShader.getUniform( "modelMatrix" )->SetUpdateCallback( 
-                        matrixUniformUpdateLambda );
+
+        defaultInstancedShader.registerShaderStage(
+            instancedVariant( defaultVertexShaderStr ), GL_VERTEX_SHADER );
+        defaultInstancedShader.registerShaderStage(
+            std::string( defaultFragmentShaderStr ), GL_FRAGMENT_SHADER );
+        defaultInstancedShader.registerAttribute( "vPosition", 0 );
+        defaultInstancedShader.registerAttribute( "instanceMatrix",
+                                    RenderPass::DefaultInstanceLocation );
+        defaultInstancedShader.registerUBO( "CameraProjectionData", camUbo );
+        defaultInstancedShader.compileShader();
     }
     
     std::shared_ptr< RenderPass > 
-    ProjectionMapping::addRenderPass( uint16_t _modelMatrixIdx ){
+    ProjectionMapping::addRenderPass( DataSource _modelMatrix ){
         auto rPass = this->renderer->AddRenderPass( &this->defaultShader );
-        if( _modelMatrixIdx >= 0 ){
-            rPass->AddDataLink( defaultShader.getUniform( "modelMatrix" ).get(), 
-                                _modelMatrixIdx );
-        }
+        rPass->name = "ProjectionMapping";
+        rPass->AddDataLink( defaultShader.getUniform( "modelMatrix" ).get(),
+                            _modelMatrix );
         rPass->renderFunction = defaultRenderFunction;
         return rPass;
 
@@ -136,6 +154,16 @@ namespace GL_Engine{
                                            _renderPass ){
         this->renderer->AddRenderPass( _renderPass );
     }
+
+    // Add a render pass drawing all its batch units in one instanced call
+    std::shared_ptr< RenderPass > ProjectionMapping::addInstancedRenderPass(){
+        auto rPass = 
+            this->renderer->AddRenderPass( &this->defaultInstancedShader );
+        rPass->name = "ProjectionMapping::instanced";
+        rPass->EnableInstancing();
+        rPass->renderFunction = defaultRenderFunction;
+        return rPass;
+    }
     
 
     std::shared_ptr< CG_Data::Texture > 
@@ -152,13 +180,31 @@ namespace GL_Engine{
         auto bindToken = this->fbo->bind( 0 );
         //glViewport( 0, 0, this->fbWidth, this->fbHeight );
         //glBindFramebuffer( GL_FRAMEBUFFER, this->fbo->getID() );
+        this->renderMap();
+    }
 
+    void ProjectionMapping::addPasses( RenderGraph & _graph ){
+        auto shadowMap = _graph.importTexture( "ShadowMap",
+                                               this->textureMaps.at( ShadowMap ) );
+        _graph.addPass( "ShadowMap",
+            [ & ]( RenderGraph::PassBuilder & _builder ){
+                _builder.write( shadowMap );
+                _builder.setFramebuffer( *this->fbo );
+            },
+            [ this ]( const RenderGraph & ){
+                this->renderMap();
+            } );
+        _graph.markOutput( shadowMap );
+    }
+
+    void ProjectionMapping::renderMap(){
+        CG_PROFILE_SCOPE( "ProjectionMapping::render" );
         glClearColor( 0.1f, 0.2f, 0.3f, 1.0f );
         glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
         //_renderer->Render();
-        glCullFace( GL_FRONT );
+        CG_Data::StateCache::cullFace( GL_FRONT );
         this->renderer->Render();
-        glCullFace( GL_BACK );
+        CG_Data::StateCache::cullFace( GL_BACK );
     }
 
 
@@ -169,12 +215,17 @@ namespace GL_Engine{
         for (auto tex : _pass.Textures) {
             tex->Bind();
         }
-        for (auto&& batch : _pass.batchUnits) {
-            if (batch->active && batch->entity->isActive()) {
-                for (auto l : _pass.dataLink) {
-                    l.uniform->SetData(batch->entity->GetData(l.eDataIndex));
-                    l.uniform->Update();
-                }
+        if (_pass.instanced) {
+            _pass.DrawBatchInstanced();
+            return;
+        }
+        _pass.GatherLinkData();
+        size_t drawn = 0;
+        for (size_t i = 0; i < _pass.batchUnits.size(); i++) {
+            auto &batch = _pass.batchUnits[i];
+            if (batch->active && batch->entity->isActive() && _pass.IsVisible(i)) {
+                _pass.UpdateDataLinks(drawn++, *batch->entity);
+                _pass.BindDrawBlock(i);
                 batch->entity->UpdateUniforms();
                 batch->entity->update();
                 _pass.DrawFunction();
@@ -198,7 +249,12 @@ namespace GL_Engine{
     };\n \
     in vec3 vPosition;\n \
     out vec4 vWorldPos; \n \
+    #ifdef INSTANCED\n \
+    in mat4 instanceMatrix;\n \
+    #define modelMatrix instanceMatrix\n \
+    #else\n \
     uniform mat4 modelMatrix;\n \
+    #endif\n \
     void main(){\n \
         vWorldPos = modelMatrix * vec4( vPosition, 1.0 );\n \
         gl_Position = pvMatrix * modelMatrix * vec4( vPosition, 1.0 );\n \
@@ -307,22 +363,14 @@ namespace GL_Engine{
         // Create the two renderers
         this->receiverRenderer = std::make_shared< Renderer >();
         this->causticRenderer = std::make_shared< Renderer >();
+        this->receiverRenderer->SetCullingCamera( &this->mappingCamera );
+        this->causticRenderer->SetCullingCamera( &this->mappingCamera );
 
         // Set up the shaders and such
         auto camUbo = mappingCamera.getCameraUbo();
         receiverRenderer->AddUBO( camUbo.get() );
         causticRenderer->AddUBO( camUbo.get() );
 
-        auto matrixUniformUpdateLambda = []( const CG_Data::Uniform & u ){
-            glUniformMatrix4fv( u.GetID(), 1, GL_FALSE, 
-                                static_cast< const GLfloat * >( u.GetData() ) );
-        };
-
-        auto uint32UniformUpdateLambda = []( const CG_Data::Uniform & u ){
-            GLuint val = *static_cast< const GLuint * >( u.GetData() );
-            glUniform1ui( u.GetID(), val );
-        };
-
         // Default shaders
         defaultShader.registerShaderStage( std::string( defaultReceiverVertexShaderStr ),
                                            GL_VERTEX_SHADER );
@@ -330,10 +378,8 @@ namespace GL_Engine{
                                            GL_FRAGMENT_SHADER );
         defaultShader.registerAttribute( "vPosition", 0 );
         defaultShader.registerUBO( "CameraProjectionData", camUbo );
-        defaultShader.registerUniform( "modelMatrix" );
+        defaultShader.registerUniform< glm::mat4 >( "modelMatrix" );
         defaultShader.compileShader();
-        defaultShader.getUniform( "modelMatrix" )->SetUpdateCallback( 
-                        matrixUniformUpdateLambda );
 
         defaultCausticShader.registerShaderStage( std::string( defaultCausticVertexShaderStr ),
                                            GL_VERTEX_SHADER );
@@ -342,27 +388,46 @@ namespace GL_Engine{
         defaultCausticShader.registerAttribute( "vPosition", 0 );
         defaultCausticShader.registerAttribute( "vNormal", 2 );
         defaultCausticShader.registerUBO( "CameraProjectionData", camUbo );
-        defaultCausticShader.registerUniform( "modelMatrix" );
-        defaultCausticShader.registerUniform( "surfaceArea" );
+        defaultCausticShader.registerUniform< glm::mat4 >( "modelMatrix" );
+        defaultCausticShader.registerUniform< GLuint >( "surfaceArea" );
         defaultCausticShader.registerTextureUnit( "receiverTex", 0 );
         defaultCausticShader.registerTextureUnit( "splatterTex", 1 );
         defaultCausticShader.compileShader();
-        defaultCausticShader.getUniform( "modelMatrix" )->SetUpdateCallback( 
-            matrixUniformUpdateLambda );
-        defaultCausticShader.getUniform( "surfaceArea" )->SetUpdateCallback(
-            uint32UniformUpdateLambda
-        );
+
+        // Instanced variants of the default shaders
+        defaultInstancedShader.registerShaderStage(
+            instancedVariant( defaultReceiverVertexShaderStr ), GL_VERTEX_SHADER );
+        defaultInstancedShader.registerShaderStage(
+            std::string( defaultReceiverFragmentShaderStr ), GL_FRAGMENT_SHADER );
+        defaultInstancedShader.registerAttribute( "vPosition", 0 );
+        defaultInstancedShader.registerAttribute( "instanceMatrix",
+                                    RenderPass::DefaultInstanceLocation );
+        defaultInstancedShader.registerUBO( "CameraProjectionData", camUbo );
+        defaultInstancedShader.compileShader();
+
+        defaultInstancedCausticShader.registerShaderStage(
+            instancedVariant( defaultCausticVertexShaderStr ), GL_VERTEX_SHADER );
+        defaultInstancedCausticShader.registerShaderStage(
+            std::string( defaultCausticFragmentShaderStr ), GL_FRAGMENT_SHADER );
+        defaultInstancedCausticShader.registerAttribute( "vPosition", 0 );
+        defaultInstancedCausticShader.registerAttribute( "vNormal", 2 );
+        defaultInstancedCausticShader.registerAttribute( "instanceMatrix",
+                                    RenderPass::DefaultInstanceLocation );
+        defaultInstancedCausticShader.registerUBO( "CameraProjectionData", camUbo );
+        defaultInstancedCausticShader.registerUniform< GLuint >( "surfaceArea" );
+        defaultInstancedCausticShader.registerTextureUnit( "receiverTex", 0 );
+        defaultInstancedCausticShader.registerTextureUnit( "splatterTex", 1 );
+        defaultInstancedCausticShader.compileShader();
     }
     
     // Add a receiver render pass, using the default shader
     std::shared_ptr< RenderPass > 
-    CausticMapping::addReceiverPass( uint16_t _modelMatrixIdx ){
+    CausticMapping::addReceiverPass( DataSource _modelMatrix ){
         auto rPass = 
             this->receiverRenderer->AddRenderPass( &this->defaultShader );
-        if( _modelMatrixIdx >= 0 ){
-            rPass->AddDataLink( defaultShader.getUniform( "modelMatrix" ).get(), 
-                                _modelMatrixIdx );
-        }
+        rPass->name = "CausticMapping::receivers";
+        rPass->AddDataLink( defaultShader.getUniform( "modelMatrix" ).get(),
+                            _modelMatrix );
         
         rPass->renderFunction = defaultRenderFunction;
         return rPass;
@@ -384,13 +449,12 @@ namespace GL_Engine{
 
     // Add a caustic render pass, using the default shader
     std::shared_ptr< RenderPass > 
-    CausticMapping::addCausticPass( uint16_t _modelMatrixIdx ){
+    CausticMapping::addCausticPass( DataSource _modelMatrix ){
         auto rPass = 
             this->causticRenderer->AddRenderPass( &this->defaultCausticShader );
-        if( _modelMatrixIdx >= 0 ){
-            rPass->AddDataLink( defaultCausticShader.getUniform( "modelMatrix" ).get(), 
-                                _modelMatrixIdx );
-        }
+        rPass->name = "CausticMapping::caustics";
+        rPass->AddDataLink( defaultCausticShader.getUniform( "modelMatrix" ).get(),
+                            _modelMatrix );
         rPass->AddUniform( defaultCausticShader.getUniform( "surfaceArea" ).get(),
                            ( void * ) &this->surfaceArea );
         rPass->renderFunction = defaultCausticRenderFunction;
@@ -410,6 +474,30 @@ namespace GL_Engine{
         return rp;
     }
 
+    // Add a receiver pass drawing all its batch units in one instanced call
+    std::shared_ptr< RenderPass > CausticMapping::addInstancedReceiverPass(){
+        auto rPass = 
+            this->receiverRenderer->AddRenderPass( &this->defaultInstancedShader );
+        rPass->name = "CausticMapping::instancedReceivers";
+        rPass->EnableInstancing();
+        rPass->renderFunction = defaultRenderFunction;
+        return rPass;
+    }
+
+    // Add a caustic pass drawing all its batch units in one instanced call
+    std::shared_ptr< RenderPass > CausticMapping::addInstancedCausticPass(){
+        auto rPass = this->causticRenderer->AddRenderPass(
+                            &this->defaultInstancedCausticShader );
+        rPass->name = "CausticMapping::instancedCaustics";
+        rPass->EnableInstancing();
+        rPass->AddUniform( defaultInstancedCausticShader.getUniform( "surfaceArea" ).get(),
+                           ( void * ) &this->surfaceArea );
+        rPass->renderFunction = defaultCausticRenderFunction;
+        rPass->Textures.push_back( this->textureMaps.at( ReceiverWorldspaceTexture ) );
+        rPass->Textures.push_back( this->splatterTex );
+        return rPass;
+    }
+
     // Add an existing RP object to the caustic renderer
     void CausticMapping::addCausticPass( std::shared_ptr< RenderPass > 
                                            _renderPass ){
@@ -429,44 +517,85 @@ namespace GL_Engine{
 
     // Main Caustic mapping render function
     void CausticMapping::render( std::shared_ptr< Camera > _sceneCam ){
+        CG_PROFILE_SCOPE( "CausticMapping::render" );
         updateProjectionCamera( _sceneCam );
 
         // Render receiver pass
         auto bindToken = this->receiverFbo->bind( 0 );
-  
+        this->renderReceivers();
+
+        // Render caustic pass
+        bindToken = this->causticFbo->bind( 0 );
+        this->renderCaustics();
+    }
+
+    void CausticMapping::addPasses( RenderGraph & _graph,
+                                    std::shared_ptr< Camera > _sceneCam ){
+        auto receivers = _graph.importTexture( "CausticReceivers",
+            this->textureMaps.at( ReceiverWorldspaceTexture ) );
+        auto splatter = _graph.importTexture( "CausticSplatter",
+            this->textureMaps.at( CausticSplatterTexture ) );
+        auto depth = _graph.importTexture( "CausticDepth",
+            this->textureMaps.at( CausticDepthTexture ) );
+
+        _graph.addPass( "CausticReceivers",
+            [ & ]( RenderGraph::PassBuilder & _builder ){
+                _builder.write( receivers );
+                _builder.setFramebuffer( *this->receiverFbo );
+            },
+            [ this, _sceneCam ]( const RenderGraph & ){
+                this->updateProjectionCamera( _sceneCam );
+                this->renderReceivers();
+            } );
+        _graph.addPass( "CausticSplatter",
+            [ & ]( RenderGraph::PassBuilder & _builder ){
+                _builder.read( receivers );
+                _builder.write( splatter );
+                _builder.write( depth );
+                _builder.setFramebuffer( *this->causticFbo );
+            },
+            [ this ]( const RenderGraph & ){
+                this->renderCaustics();
+            } );
+        _graph.markOutput( splatter );
+        _graph.markOutput( depth );
+    }
+
+    void CausticMapping::renderReceivers(){
+        CG_PROFILE_SCOPE( "CausticMapping::receivers" );
         glClearColor( 0.1f, 0.9f, 0.3f, 1.0f );
         glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-        glCullFace( GL_BACK );
+        CG_Data::StateCache::cullFace( GL_BACK );
         this->receiverRenderer->Render();
+    }
 
-        GLuint qId;
-        glGenQueries( 1, &qId );
-        glBeginQuery( GL_SAMPLES_PASSED, qId );
+    void CausticMapping::renderCaustics(){
+        CG_PROFILE_SCOPE( "CausticMapping::caustics" );
+        this->samplesQuery.Begin();
 
-        // Render caustic pass
-        bindToken = this->causticFbo->bind( 0 );
-        glCullFace( GL_BACK );
+        CG_Data::StateCache::cullFace( GL_BACK );
         glClearColor( 0.0f, 0.0f, 0.0f, 0.0f );
         glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT ) ;
         // Disable depth discarding so the points can overlap while still
         // keeping depth info
-        glDepthFunc( GL_ALWAYS );
+        CG_Data::StateCache::depthFunc( GL_ALWAYS );
 
-        glEnable(GL_BLEND);
-        glBlendFunc( GL_ONE, GL_ONE );  
-        glEnable( GL_PROGRAM_POINT_SIZE );
+        CG_Data::StateCache::enable( GL_BLEND );
+        CG_Data::StateCache::blendFunc( GL_ONE, GL_ONE );
+        CG_Data::StateCache::enable( GL_PROGRAM_POINT_SIZE );
         this->causticRenderer->Render();
 
-        glDisable( GL_BLEND );
-        glEndQuery( GL_SAMPLES_PASSED );
+        CG_Data::StateCache::disable( GL_BLEND );
+        this->samplesQuery.End();
 
-        GLint samplesPassed;
-        glGetQueryObjectiv( qId, GL_QUERY_RESULT, &samplesPassed );
-        this->surfaceArea = ( uint32_t ) samplesPassed;
-        glDeleteQueries( 1, &qId );
+        // Reading the result now would wait for the GPU, so use the latest
+        // one available instead, a few frames old
+        if ( this->samplesQuery.HasResult() ){
+            this->surfaceArea = ( uint32_t ) this->samplesQuery.GetResult();
+        }
 
-        glCullFace( GL_BACK );
-        glDepthFunc( GL_LESS );
+        CG_Data::StateCache::cullFace( GL_BACK );
+        CG_Data::StateCache::depthFunc( GL_LESS );
     }
 
 
@@ -477,12 +606,17 @@ namespace GL_Engine{
         for (auto tex : _pass.Textures) {
             tex->Bind();
         }
-        for (auto&& batch : _pass.batchUnits) {
-            if (batch->active && batch->entity->isActive()) {
-                for (auto l : _pass.dataLink) {
-                    l.uniform->SetData(batch->entity->GetData(l.eDataIndex));
-                    l.uniform->Update();
-                }
+        if (_pass.instanced) {
+            _pass.DrawBatchInstanced();
+            return;
+        }
+        _pass.GatherLinkData();
+        size_t drawn = 0;
+        for (size_t i = 0; i < _pass.batchUnits.size(); i++) {
+            auto &batch = _pass.batchUnits[i];
+            if (batch->active && batch->entity->isActive() && _pass.IsVisible(i)) {
+                _pass.UpdateDataLinks(drawn++, *batch->entity);
+                _pass.BindDrawBlock(i);
                 batch->entity->UpdateUniforms();
                 batch->entity->update();
                 _pass.DrawFunction();
@@ -503,12 +637,17 @@ namespace GL_Engine{
         for (auto tex : _pass.Textures) {
             tex->Bind();
         }
-        for (auto&& batch : _pass.batchUnits) {
-            if (batch->active && batch->entity->isActive()) {
-                for (auto l : _pass.dataLink) {
-                    l.uniform->SetData(batch->entity->GetData(l.eDataIndex));
-                    l.uniform->Update();
-                }
+        if (_pass.instanced) {
+            _pass.DrawBatchInstanced();
+            return;
+        }
+        _pass.GatherLinkData();
+        size_t drawn = 0;
+        for (size_t i = 0; i < _pass.batchUnits.size(); i++) {
+            auto &batch = _pass.batchUnits[i];
+            if (batch->active && batch->entity->isActive() && _pass.IsVisible(i)) {
+                _pass.UpdateDataLinks(drawn++, *batch->entity);
+                _pass.BindDrawBlock(i);
                 batch->entity->UpdateUniforms();
                 batch->entity->update();
                 _pass.DrawFunction();
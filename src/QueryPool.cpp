@@ -0,0 +1,118 @@
+#include "QueryPool.h"
+#include <algorithm>
+
+namespace GL_Engine {
+	namespace CG_Data {
+
+		QueryPool::AsyncQuery::AsyncQuery(GLenum _Target) : Target(_Target) {
+			QueryPool::Get().AsyncQueries.push_back(this);
+		}
+
+		QueryPool::AsyncQuery::~AsyncQuery() {
+			auto &pool = QueryPool::Get();
+			pool.AsyncQueries.erase(std::remove(pool.AsyncQueries.begin(), pool.AsyncQueries.end(), this),
+				pool.AsyncQueries.end());
+			//The queries go back to the pool, an unread result is harmless
+			for (auto &inFlight : Queries)
+				pool.Release(Target, inFlight.query);
+			if (Active)
+				pool.Release(Target, Active);
+		}
+
+		void QueryPool::AsyncQuery::Begin() {
+			auto &pool = QueryPool::Get();
+			if (Active)
+				return;
+			if (Queries.size() >= MaxInFlight) {
+				pool.Stats.skipped++;
+				return;
+			}
+			Active = pool.Acquire(Target);
+			glBeginQuery(Target, Active);
+		}
+
+		void QueryPool::AsyncQuery::End() {
+			if (!Active)
+				return;
+			glEndQuery(Target);
+			Queries.push_back(InFlight{ Active, QueryPool::Get().Frame });
+			Active = 0;
+		}
+
+		void QueryPool::AsyncQuery::Poll() {
+			auto &pool = QueryPool::Get();
+			//Results arrive in issue order, so stop at the first missing one
+			while (!Queries.empty()) {
+				const InFlight inFlight = Queries.front();
+				GLint available = GL_FALSE;
+				glGetQueryObjectiv(inFlight.query, GL_QUERY_RESULT_AVAILABLE, &available);
+				if (!available)
+					break;
+				glGetQueryObjectui64v(inFlight.query, GL_QUERY_RESULT, &Result);
+				Latency = pool.Frame - inFlight.frame;
+				Resolved = true;
+				pool.Stats.results++;
+				pool.Release(Target, inFlight.query);
+				Queries.pop_front();
+			}
+		}
+
+		bool QueryPool::AsyncQuery::HasResult() const {
+			return Resolved;
+		}
+
+		GLuint64 QueryPool::AsyncQuery::GetResult() const {
+			return Result;
+		}
+
+		uint64_t QueryPool::AsyncQuery::GetResultLatency() const {
+			return Latency;
+		}
+
+		QueryPool::~QueryPool() {
+			//Query objects are left to the context, which may already be
+			//gone when the engine-wide pool is destroyed
+		}
+
+		GLuint QueryPool::Acquire(GLenum _Target) {
+			auto &free = Free[_Target];
+			if (free.empty()) {
+				GLuint query;
+				glGenQueries(1, &query);
+				Stats.created++;
+				return query;
+			}
+			const GLuint query = free.back();
+			free.pop_back();
+			Stats.free--;
+			return query;
+		}
+
+		void QueryPool::Release(GLenum _Target, GLuint _Query) {
+			if (_Query == 0)
+				return;
+			Free[_Target].push_back(_Query);
+			Stats.free++;
+		}
+
+		void QueryPool::EndFrame() {
+			for (auto query : AsyncQueries)
+				query->Poll();
+			Frame++;
+		}
+
+		uint64_t QueryPool::GetFrame() const {
+			return Frame;
+		}
+
+		const QueryPool::Statistics &QueryPool::GetStatistics() const {
+			return Stats;
+		}
+
+		QueryPool &QueryPool::Get() {
+			static QueryPool pool;
+			return pool;
+		}
+
+	}
+}
@@ -0,0 +1,432 @@
+#include "RenderGraph.h"
+#include "GLState.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace GL_Engine {
+
+    bool RenderGraph::TextureDesc::operator==( const TextureDesc & _other ) const {
+        return width == _other.width && height == _other.height &&
+               internalFormat == _other.internalFormat;
+    }
+
+    /* --- PassBuilder --- */
+
+    RenderGraph::PassBuilder::PassBuilder( RenderGraph & _graph, uint32_t _pass )
+        : graph( _graph ), pass( _pass ){
+    }
+
+    RenderGraph::ResourceHandle
+    RenderGraph::PassBuilder::read( ResourceHandle _resource ){
+        if ( _resource >= graph.resources.size() ) {
+            throw std::runtime_error( "Render graph pass reads an invalid resource" );
+        }
+        graph.passes[ pass ].reads.push_back( _resource );
+        return _resource;
+    }
+
+    RenderGraph::ResourceHandle
+    RenderGraph::PassBuilder::write( ResourceHandle _resource ){
+        if ( _resource >= graph.resources.size() ) {
+            throw std::runtime_error( "Render graph pass writes an invalid resource" );
+        }
+        graph.passes[ pass ].writes.push_back( _resource );
+        return _resource;
+    }
+
+    void RenderGraph::PassBuilder::setFramebuffer( const CG_Data::FBO & _fbo,
+                                                   uint8_t _colourAttachment ){
+        const GLenum attachment = GL_COLOR_ATTACHMENT0 + _colourAttachment;
+        setFramebuffer( _fbo, 1, &attachment );
+    }
+
+    void RenderGraph::PassBuilder::setFramebuffer( const CG_Data::FBO & _fbo,
+                                                   uint16_t _count,
+                                                   const GLenum * _colourAttachments ){
+        auto & p = graph.passes[ pass ];
+        p.framebuffer = _fbo.getID();
+        p.width = _fbo.getWidth();
+        p.height = _fbo.getHeight();
+        p.drawBuffers.assign( _colourAttachments, _colourAttachments + _count );
+        p.explicitFramebuffer = true;
+    }
+
+    void RenderGraph::PassBuilder::setSideEffect(){
+        graph.passes[ pass ].sideEffect = true;
+    }
+
+    /* --- RenderGraph --- */
+
+    RenderGraph::~RenderGraph(){
+        for ( auto & fb : transientFramebuffers ) {
+            glDeleteFramebuffers( 1, &fb.second );
+            CG_Data::StateCache::framebufferDeleted( fb.second );
+        }
+    }
+
+    void RenderGraph::reset(){
+        resources.clear();
+        passes.clear();
+        executionOrder.clear();
+        importedTextures.clear();
+    }
+
+    RenderGraph::ResourceHandle
+    RenderGraph::importTexture( const std::string & _name,
+                                std::shared_ptr< CG_Data::Texture > _texture ){
+        auto it = importedTextures.find( _texture->GetID() );
+        if ( it != importedTextures.end() ) {
+            return it->second;
+        }
+        Resource resource;
+        resource.name = _name;
+        resource.texture = std::move( _texture );
+        const auto handle = static_cast< ResourceHandle >( resources.size() );
+        importedTextures[ resource.texture->GetID() ] = handle;
+        resources.push_back( std::move( resource ) );
+        return handle;
+    }
+
+    RenderGraph::ResourceHandle
+    RenderGraph::createTexture( const std::string & _name, const TextureDesc & _desc ){
+        Resource resource;
+        resource.name = _name;
+        resource.desc = _desc;
+        resource.transient = true;
+        resources.push_back( std::move( resource ) );
+        return static_cast< ResourceHandle >( resources.size() - 1 );
+    }
+
+    void RenderGraph::markOutput( ResourceHandle _resource ){
+        if ( _resource >= resources.size() ) {
+            throw std::runtime_error( "Render graph output is an invalid resource" );
+        }
+        resources[ _resource ].output = true;
+    }
+
+    void RenderGraph::addPass( const std::string & _name,
+                               const SetupFunction & _setup,
+                               ExecuteFunction _execute ){
+        Pass pass;
+        pass.name = _name;
+        pass.execute = std::move( _execute );
+        passes.push_back( std::move( pass ) );
+        PassBuilder builder( *this, static_cast< uint32_t >( passes.size() - 1 ) );
+        _setup( builder );
+    }
+
+    void RenderGraph::cullPasses(){
+        // Walk back from the last pass, keeping a pass if a later kept pass
+        // (or the caller, for outputs) needs something it writes
+        std::vector< uint8_t > needed( resources.size(), 0 );
+        for ( size_t r = 0; r < resources.size(); r++ ) {
+            needed[ r ] = resources[ r ].output;
+        }
+        for ( size_t i = passes.size(); i-- > 0; ) {
+            auto & pass = passes[ i ];
+            pass.culled = !pass.sideEffect;
+            for ( auto w : pass.writes ) {
+                if ( needed[ w ] ) {
+                    pass.culled = false;
+                }
+            }
+            if ( pass.culled ) {
+                statistics.culledPasses++;
+                continue;
+            }
+            for ( auto r : pass.reads ) {
+                needed[ r ] = 1;
+            }
+        }
+    }
+
+    void RenderGraph::schedulePasses(){
+        // Dependencies in declaration order: read after write, and write
+        // after read or write, of the same resource
+        const size_t count = passes.size();
+        std::vector< std::vector< uint32_t > > dependents( count );
+        std::vector< uint32_t > remaining( count, 0 );
+        std::vector< int32_t > lastWriter( resources.size(), -1 );
+        std::vector< std::vector< uint32_t > > readers( resources.size() );
+        auto addEdge = [ & ]( int32_t _from, uint32_t _to ){
+            if ( _from < 0 || static_cast< uint32_t >( _from ) == _to ) {
+                return;
+            }
+            auto & d = dependents[ _from ];
+            if ( std::find( d.begin(), d.end(), _to ) == d.end() ) {
+                d.push_back( _to );
+                remaining[ _to ]++;
+            }
+        };
+        for ( uint32_t i = 0; i < count; i++ ) {
+            const auto & pass = passes[ i ];
+            if ( pass.culled ) {
+                continue;
+            }
+            for ( auto r : pass.reads ) {
+                addEdge( lastWriter[ r ], i );
+            }
+            for ( auto w : pass.writes ) {
+                addEdge( lastWriter[ w ], i );
+                for ( auto reader : readers[ w ] ) {
+                    addEdge( static_cast< int32_t >( reader ), i );
+                }
+            }
+            for ( auto r : pass.reads ) {
+                readers[ r ].push_back( i );
+            }
+            for ( auto w : pass.writes ) {
+                lastWriter[ w ] = static_cast< int32_t >( i );
+                readers[ w ].clear();
+            }
+        }
+
+        // Kahn's algorithm. Of the ready passes, run one that draws to the
+        // framebuffer already bound, or else the first declared
+        std::vector< uint32_t > ready;
+        for ( uint32_t i = 0; i < count; i++ ) {
+            if ( !passes[ i ].culled && remaining[ i ] == 0 ) {
+                ready.push_back( i );
+            }
+        }
+        executionOrder.clear();
+        GLuint currentFramebuffer = 0;
+        bool haveFramebuffer = false;
+        while ( !ready.empty() ) {
+            auto pick = ready.end();
+            if ( haveFramebuffer ) {
+                for ( auto it = ready.begin(); it != ready.end(); ++it ) {
+                    const auto & p = passes[ *it ];
+                    if ( p.explicitFramebuffer && p.framebuffer == currentFramebuffer &&
+                         ( pick == ready.end() || *it < *pick ) ) {
+                        pick = it;
+                    }
+                }
+            }
+            if ( pick == ready.end() ) {
+                pick = std::min_element( ready.begin(), ready.end() );
+            }
+            const uint32_t next = *pick;
+            ready.erase( pick );
+            executionOrder.push_back( next );
+            haveFramebuffer = passes[ next ].explicitFramebuffer;
+            currentFramebuffer = passes[ next ].framebuffer;
+            for ( auto d : dependents[ next ] ) {
+                if ( --remaining[ d ] == 0 ) {
+                    ready.push_back( d );
+                }
+            }
+        }
+    }
+
+    void RenderGraph::allocateTransients(){
+        // Lifetime of each transient, in execution slots
+        std::vector< int32_t > firstUse( resources.size(), -1 ),
+                               lastUse( resources.size(), -1 );
+        for ( size_t slot = 0; slot < executionOrder.size(); slot++ ) {
+            const auto & pass = passes[ executionOrder[ slot ] ];
+            auto touch = [ & ]( ResourceHandle _r ){
+                if ( firstUse[ _r ] < 0 ) {
+                    firstUse[ _r ] = static_cast< int32_t >( slot );
+                }
+                lastUse[ _r ] = static_cast< int32_t >( slot );
+            };
+            for ( auto r : pass.reads ) {
+                touch( r );
+            }
+            for ( auto w : pass.writes ) {
+                touch( w );
+            }
+        }
+
+        std::vector< ResourceHandle > transients;
+        for ( ResourceHandle r = 0; r < resources.size(); r++ ) {
+            resources[ r ].physical = -1;
+            if ( resources[ r ].transient && firstUse[ r ] >= 0 ) {
+                transients.push_back( r );
+            }
+        }
+        std::sort( transients.begin(), transients.end(),
+                   [ & ]( ResourceHandle _a, ResourceHandle _b ){
+                       return firstUse[ _a ] < firstUse[ _b ];
+                   } );
+
+        for ( auto & physical : texturePool ) {
+            physical.lastUse = -1;
+        }
+        std::vector< uint8_t > used( texturePool.size(), 0 );
+        for ( auto r : transients ) {
+            auto & resource = resources[ r ];
+            // Outputs must survive the whole frame, so never hand theirs on
+            const int32_t end = resource.output ? INT32_MAX : lastUse[ r ];
+            int32_t match = -1;
+            for ( size_t p = 0; p < texturePool.size(); p++ ) {
+                const auto & physical = texturePool[ p ];
+                if ( physical.desc == resource.desc &&
+                     physical.lastUse < firstUse[ r ] ) {
+                    match = static_cast< int32_t >( p );
+                    break;
+                }
+            }
+            if ( match < 0 ) {
+                const bool depth = isDepthFormat( resource.desc.internalFormat );
+                PhysicalTexture physical;
+                physical.desc = resource.desc;
+                physical.texture = std::make_shared< CG_Data::Texture >(
+                    GL_TEXTURE0, GL_TEXTURE_2D, [](){
+                        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+                        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+                        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+                        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+                    } );
+                glTexImage2D( GL_TEXTURE_2D, 0, resource.desc.internalFormat,
+                              resource.desc.width, resource.desc.height, 0,
+                              depth ? GL_DEPTH_COMPONENT : GL_RGBA,
+                              depth ? GL_FLOAT : GL_UNSIGNED_BYTE, nullptr );
+                texturePool.push_back( std::move( physical ) );
+                used.push_back( 0 );
+                match = static_cast< int32_t >( texturePool.size() - 1 );
+            }
+            texturePool[ match ].lastUse = end;
+            resource.physical = match;
+            used[ match ] = 1;
+            statistics.transientResources++;
+        }
+        for ( auto u : used ) {
+            statistics.transientTextures += u;
+        }
+    }
+
+    void RenderGraph::prepareTransientFramebuffer( Pass & _pass ){
+        std::vector< GLuint > colour;
+        GLuint depth = 0;
+        std::string key;
+        for ( auto w : _pass.writes ) {
+            const auto & resource = resources[ w ];
+            if ( !resource.transient ) {
+                continue;
+            }
+            const GLuint id = texturePool[ resource.physical ].texture->GetID();
+            if ( isDepthFormat( resource.desc.internalFormat ) ) {
+                depth = id;
+            }
+            else {
+                colour.push_back( id );
+            }
+            if ( _pass.width == 0 ) {
+                _pass.width = resource.desc.width;
+                _pass.height = resource.desc.height;
+            }
+            key += std::to_string( id ) + ",";
+        }
+        if ( key.empty() ) {
+            return;
+        }
+
+        _pass.drawBuffers.clear();
+        for ( size_t i = 0; i < colour.size(); i++ ) {
+            _pass.drawBuffers.push_back( GL_COLOR_ATTACHMENT0 + static_cast< GLenum >( i ) );
+        }
+        auto it = transientFramebuffers.find( key );
+        if ( it != transientFramebuffers.end() ) {
+            _pass.framebuffer = it->second;
+            return;
+        }
+
+        GLuint framebuffer;
+        glGenFramebuffers( 1, &framebuffer );
+        auto bindToken = CG_Data::FBO::staticBind( framebuffer );
+        for ( size_t i = 0; i < colour.size(); i++ ) {
+            glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + static_cast< GLenum >( i ),
+                                    GL_TEXTURE_2D, colour[ i ], 0 );
+        }
+        if ( depth ) {
+            glFramebufferTexture2D( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                    GL_TEXTURE_2D, depth, 0 );
+        }
+        const GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+        std::move( bindToken ).unbind();
+        if ( status != GL_FRAMEBUFFER_COMPLETE ) {
+            glDeleteFramebuffers( 1, &framebuffer );
+            CG_Data::StateCache::framebufferDeleted( framebuffer );
+            throw std::runtime_error( "Render graph pass \"" + _pass.name +
+                                      "\" has an incomplete framebuffer" );
+        }
+        transientFramebuffers[ key ] = framebuffer;
+        _pass.framebuffer = framebuffer;
+    }
+
+    void RenderGraph::execute(){
+        CG_PROFILE_SCOPE( "RenderGraph::execute" );
+        statistics = Statistics();
+        statistics.passes = static_cast< uint32_t >( passes.size() );
+        cullPasses();
+        schedulePasses();
+        allocateTransients();
+
+        CG_Data::FBO::FramebufferBindToken bindToken;
+        GLuint bound = 0;
+        for ( auto index : executionOrder ) {
+            auto & pass = passes[ index ];
+            if ( !pass.explicitFramebuffer ) {
+                prepareTransientFramebuffer( pass );
+            }
+            if ( pass.framebuffer != 0 ) {
+                if ( !bindToken.isValid() || bound != pass.framebuffer ) {
+                    bindToken = CG_Data::FBO::staticBind( pass.framebuffer );
+                    bound = pass.framebuffer;
+                    statistics.framebufferBinds++;
+                }
+                if ( pass.drawBuffers.empty() ) {
+                    glDrawBuffer( GL_NONE );
+                }
+                else {
+                    glDrawBuffers( static_cast< GLsizei >( pass.drawBuffers.size() ),
+                                   pass.drawBuffers.data() );
+                }
+                glViewport( 0, 0, pass.width, pass.height );
+            }
+            else if ( bindToken.isValid() ) {
+                // Back to whatever was bound before the graph ran
+                std::move( bindToken ).unbind();
+            }
+            CG_PROFILE_SCOPE( pass.name );
+            pass.execute( *this );
+        }
+        if ( bindToken.isValid() ) {
+            std::move( bindToken ).unbind();
+        }
+    }
+
+    std::shared_ptr< CG_Data::Texture >
+    RenderGraph::getTexture( ResourceHandle _resource ) const {
+        if ( _resource >= resources.size() ) {
+            throw std::runtime_error( "Invalid render graph resource" );
+        }
+        const auto & resource = resources[ _resource ];
+        if ( !resource.transient ) {
+            return resource.texture;
+        }
+        return resource.physical < 0 ? nullptr : texturePool[ resource.physical ].texture;
+    }
+
+    std::vector< std::string > RenderGraph::getExecutionOrder() const {
+        std::vector< std::string > names;
+        for ( auto index : executionOrder ) {
+            names.push_back( passes[ index ].name );
+        }
+        return names;
+    }
+
+    const RenderGraph::Statistics & RenderGraph::getStatistics() const {
+        return this->statistics;
+    }
+
+    bool RenderGraph::isDepthFormat( GLenum _format ){
+        return _format == GL_DEPTH_COMPONENT || _format == GL_DEPTH_COMPONENT16 ||
+               _format == GL_DEPTH_COMPONENT24 || _format == GL_DEPTH_COMPONENT32 ||
+               _format == GL_DEPTH_COMPONENT32F;
+    }
+
+}
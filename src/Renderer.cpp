@@ -1,4 +1,8 @@
 #include "Renderer.h"
+#include "GLState.h"
+#include "Profiler.h"
+#include <cstring>
+#include <stdexcept>
 
 using namespace GL_Engine;
 
@@ -22,6 +26,7 @@ std::shared_ptr<RenderPass> GL_Engine::Renderer::AddRenderPass() {
 	auto rPass =  std::make_shared< RenderPass >();
 	rPass->shader = nullptr;
 	rPass->renderFunction = DefaultRenderer;
+	rPass->GatherBounds = RenderPass::GatherBatchBounds;
 	rPass->Data = nullptr;
 	this->renderPasses.push_back( rPass );
 	return std::move( rPass );	
@@ -30,6 +35,7 @@ std::shared_ptr<RenderPass> GL_Engine::Renderer::AddRenderPass() {
 std::shared_ptr<RenderPass> GL_Engine::Renderer::AddRenderPass( Shader* _Shader ) {
 	auto rPass =  std::make_shared<RenderPass>() ;
 	rPass->renderFunction = DefaultRenderer;
+	rPass->GatherBounds = RenderPass::GatherBatchBounds;
 	rPass->Data = nullptr;
 	rPass->shader = _Shader;
 	auto passOut = rPass.get();
@@ -58,13 +64,118 @@ const std::vector< std::shared_ptr< RenderPass > > & GL_Engine::Renderer::getRen
 }
 
 void GL_Engine::Renderer::Render() const {
+	CG_PROFILE_SCOPE("Renderer::Render");
 	for (auto ubo : this->UBO_List) {
 		ubo->UpdateUBO();
 	}
+	if (cullingCamera) {
+		cullingStage.cull(cullingCamera->getProjectionMatrix() *
+						  cullingCamera->getViewMatrix(), renderPasses);
+	}
+	else {
+		//Passes may be shared with a culled renderer, whose results are
+		//for another camera
+		for (auto &pass : renderPasses) {
+			pass->Visibility.clear();
+		}
+	}
+	PackDrawBlocks();
+	//Render functions may render again (e.g. Water's reflections), so the
+	//bucket's storage is taken for this call and handed back afterwards.
+	//Passes are submitted in the order they were added, which the stable
+	//sort keeps for equal keys
+	CommandBucket bucket = std::move(commandBucket);
+	bucket.clear();
 	for (auto&& pass : renderPasses) {
-		pass->renderFunction(*pass, pass->Data);
+		bucket.submit(pass.get());
 	}
-	
+	bucket.sort();
+	bucket.execute();
+	commandBucket = std::move(bucket);
+}
+
+void GL_Engine::Renderer::PackDrawBlocks() const {
+	auto &ring = CG_Data::RingBuffer::Uniforms();
+	const GLsizeiptr alignment = ring.GetAlignment();
+
+	//Lay out every drawn unit's block first, so that each pass then fills
+	//its own disjoint range of the staging buffer
+	GLsizeiptr total = 0;
+	for (auto &&pass : renderPasses) {
+		if (!pass->UsesDrawBlock())
+			continue;
+		const GLsizeiptr stride = ((pass->drawBlockSize + alignment - 1) / alignment) * alignment;
+		pass->drawBlockOffsets.assign(pass->batchUnits.size(), -1);
+		for (size_t i = 0; i < pass->batchUnits.size(); i++) {
+			auto &batch = pass->batchUnits[i];
+			if (batch->active && batch->entity->isActive() && pass->IsVisible(i)) {
+				pass->drawBlockOffsets[i] = total;
+				total += stride;
+			}
+		}
+	}
+	if (total == 0)
+		return;
+
+	drawBlockData.resize(total);
+	for (auto &&pass : renderPasses) {
+		if (!pass->UsesDrawBlock())
+			continue;
+		//The pass' drawn units' blocks are consecutive, so each member is
+		//gathered for all of them at once
+		const auto &entities = pass->DrawnEntities();
+		if (entities.empty())
+			continue;
+		const GLsizeiptr stride = ((pass->drawBlockSize + alignment - 1) / alignment) * alignment;
+		GLintptr first = 0;
+		for (auto offset : pass->drawBlockOffsets) {
+			if (offset >= 0) {
+				first = offset;
+				break;
+			}
+		}
+		for (const auto &l : pass->drawBlockLinks) {
+			l.source.gather(entities.data(), entities.size(), l.size,
+							drawBlockData.data() + first + l.offset, stride);
+		}
+	}
+
+	GLuint buffer;
+	GLintptr base;
+	auto allocation = ring.Write(drawBlockData.data(), total, alignment);
+	if (allocation.Valid()) {
+		buffer = allocation.buffer;
+		base = allocation.offset;
+	}
+	else {
+		if (!drawBlockVBO) {
+			drawBlockVBO = std::make_unique<CG_Data::VBO>(nullptr, 0, GL_STREAM_DRAW, GL_UNIFORM_BUFFER);
+		}
+		drawBlockVBO->SetVBOData(drawBlockData.data(), total);
+		buffer = drawBlockVBO->GetID();
+		base = 0;
+	}
+	for (auto &&pass : renderPasses) {
+		if (!pass->UsesDrawBlock())
+			continue;
+		pass->drawBlockBuffer = buffer;
+		for (auto &offset : pass->drawBlockOffsets) {
+			if (offset >= 0)
+				offset += base;
+		}
+	}
+}
+
+void GL_Engine::Renderer::SetCullingCamera(Camera *_Camera) {
+	this->cullingCamera = _Camera;
+}
+
+Camera *GL_Engine::Renderer::GetCullingCamera() const {
+	return this->cullingCamera;
+}
+
+const CullingStage & GL_Engine::Renderer::GetCullingStage() const {
+	return this->cullingStage;
 }
 
 void GL_Engine::Renderer::AddUBO(CG_Data::UBO* _ubo) {
@@ -83,12 +194,17 @@ void Renderer::DefaultRenderer(RenderPass& _Pass, void* _Data) {
 	for (auto tex : _Pass.Textures) {
 		tex->Bind();
 	}
-	for (auto&& batch : _Pass.batchUnits) {
-		if (batch->active && batch->entity->isActive()) {
-			for (auto l : _Pass.dataLink) {
-				l.uniform->SetData(batch->entity->GetData(l.eDataIndex));
-				l.uniform->Update();
-			}
+	if (_Pass.instanced) {
+		_Pass.DrawBatchInstanced();
+		return;
+	}
+	_Pass.GatherLinkData();
+	size_t drawn = 0;
+	for (size_t i = 0; i < _Pass.batchUnits.size(); i++) {
+		auto &batch = _Pass.batchUnits[i];
+		if (batch->active && batch->entity->isActive() && _Pass.IsVisible(i)) {
+			_Pass.UpdateDataLinks(drawn++, *batch->entity);
+			_Pass.BindDrawBlock(i);
 			batch->entity->UpdateUniforms();
 			batch->entity->update();
 			_Pass.DrawFunction();
@@ -106,6 +222,190 @@ BatchUnit* RenderPass::AddBatchUnit(Entity* _Entity) {
 	return pOut;
 }
 
+bool RenderPass::GatherBatchBounds(RenderPass &_Pass, SphereList &_Spheres) {
+	if (!_Pass.BatchVao || _Pass.BatchVao->GetBounds().isEmpty())
+		return false;
+	const auto &bounds = _Pass.BatchVao->GetBounds();
+	for (auto &&batch : _Pass.batchUnits) {
+		_Spheres.push(bounds.transformed(batch->entity->GetTransformMatrix()));
+	}
+	return true;
+}
+
+const std::vector<EntityId> &RenderPass::DrawnEntities() {
+	drawnEntities.clear();
+	for (size_t i = 0; i < batchUnits.size(); i++) {
+		auto &batch = batchUnits[i];
+		if (batch->active && batch->entity->isActive() && IsVisible(i))
+			drawnEntities.push_back(batch->entity->GetId());
+	}
+	return drawnEntities;
+}
+
+void RenderPass::GatherLinkData() {
+	const auto &entities = DrawnEntities();
+	linkOffsets.resize(dataLink.size());
+	size_t total = 0;
+	for (size_t l = 0; l < dataLink.size(); l++) {
+		linkOffsets[l] = total;
+		total += dataLink[l].uniform->GetDataSize() * entities.size();
+	}
+	linkData.resize(total);
+	for (size_t l = 0; l < dataLink.size(); l++) {
+		const size_t size = dataLink[l].uniform->GetDataSize();
+		if (size > 0)
+			dataLink[l].source.gather(entities.data(), entities.size(), size,
+									  linkData.data() + linkOffsets[l], size);
+	}
+}
+
+void RenderPass::UpdateDataLinks(size_t _Drawn, const Entity &_Entity) {
+	for (size_t l = 0; l < dataLink.size(); l++) {
+		auto &link = dataLink[l];
+		const size_t size = link.uniform->GetDataSize();
+		if (size > 0)
+			link.uniform->SetData(linkData.data() + linkOffsets[l] + _Drawn * size);
+		else
+			link.uniform->SetData(_Entity.GetData(link.source));
+		link.uniform->Update();
+	}
+}
+
+void RenderPass::EnableDrawBlock(const std::string &_BlockName) {
+	auto layout = shader ? shader->getUniformBlockLayout(_BlockName) : nullptr;
+	if (!layout) {
+		throw std::runtime_error("Uniform block \"" + _BlockName + "\" is not active in the pass' shader");
+	}
+	shader->registerUniformBlock(_BlockName, DrawBlockBinding());
+	this->drawBlockName = _BlockName;
+	this->drawBlockSize = layout->dataSize;
+}
+
+void RenderPass::AddDrawBlockLink(DataSource _Source, const std::string &_Member, GLint _Size) {
+	auto layout = shader ? shader->getUniformBlockLayout(drawBlockName) : nullptr;
+	if (layout) {
+		auto member = layout->offsets.find(_Member);
+		if (member != layout->offsets.end()) {
+			DataBlockLink link = { _Source, member->second, _Size };
+			this->drawBlockLinks.push_back(link);
+			return;
+		}
+	}
+	throw std::runtime_error("Uniform block member \"" + _Member + "\" is not active");
+}
+
+void RenderPass::BindDrawBlock(size_t _Index) const {
+	if (!UsesDrawBlock() || _Index >= drawBlockOffsets.size() || drawBlockOffsets[_Index] < 0)
+		return;
+	CG_Data::StateCache::bindBufferRange(GL_UNIFORM_BUFFER, DrawBlockBinding(), drawBlockBuffer,
+										 drawBlockOffsets[_Index], drawBlockSize);
+}
+
+GLuint RenderPass::DrawBlockBinding() {
+	static const GLuint binding = CG_Data::UBO::ReserveBindingPost();
+	return binding;
+}
+
 void RenderPass::SetDrawFunction(std::function<void(void)> _dFunc) {
 	DrawFunction = _dFunc;
+}
+
+void RenderPass::EnableInstancing(GLuint _TransformLocation) {
+	this->instanced = true;
+	this->instanceTransformLocation = _TransformLocation;
+}
+
+void RenderPass::AddInstanceDataLink(DataSource _Source, GLuint _Location, GLint _Components) {
+	DataInstanceLink link = { _Source, _Location, _Components };
+	this->instanceLinks.push_back(link);
+}
+
+void RenderPass::SetInstancedDrawFunction(std::function<void(GLsizei)> _dFunc) {
+	InstancedDrawFunction = _dFunc;
+}
+
+GLsizei RenderPass::DrawBatchInstanced() {
+	//Per-instance layout: model matrix, then each linked data source
+	GLint floatsPerInstance = 16;
+	for (const auto &l : instanceLinks) {
+		floatsPerInstance += l.components;
+	}
+
+	const auto &entities = DrawnEntities();
+	const GLsizei instanceCount = static_cast<GLsizei>(entities.size());
+	if (instanceCount == 0)
+		return 0;
+	instanceData.resize(entities.size() * floatsPerInstance);
+	uint8_t *instances = reinterpret_cast<uint8_t*>(instanceData.data());
+	const size_t instanceStride = floatsPerInstance * sizeof(float);
+	//Through the entity, which rebuilds a matrix moved since the batch
+	//update
+	size_t instance = 0;
+	for (size_t i = 0; i < batchUnits.size(); i++) {
+		auto &batch = batchUnits[i];
+		if (!batch->active || !batch->entity->isActive() || !IsVisible(i))
+			continue;
+		const auto transform = batch->entity->GetTransformMatrix();
+		std::memcpy(instances + instance++ * instanceStride, glm::value_ptr(transform), 16 * sizeof(float));
+	}
+	size_t linkOffset = 16;
+	for (const auto &l : instanceLinks) {
+		l.source.gather(entities.data(), entities.size(), l.components * sizeof(float),
+						instances + linkOffset * sizeof(float), instanceStride);
+		linkOffset += l.components;
+	}
+
+	//Stream the instance data through the vertex ring, falling back to the
+	//pass' own buffer if the ring is full for this frame
+	const GLsizeiptr dataSize = instanceData.size() * sizeof(float);
+	auto allocation = CG_Data::RingBuffer::Vertices().Write(instanceData.data(), dataSize);
+	if (allocation.Valid()) {
+		glBindBuffer(GL_ARRAY_BUFFER, allocation.buffer);
+	}
+	else {
+		if (!instanceVBO) {
+			instanceVBO = std::make_unique<CG_Data::VBO>(nullptr, 0, GL_STREAM_DRAW);
+		}
+		instanceVBO->SetVBOData(instanceData.data(), dataSize);
+		allocation.offset = 0;
+	}
+
+	//Point the per-instance attributes at the buffer. Done every draw, as the
+	//VAO may be shared with non-instanced passes
+	const GLsizei stride = floatsPerInstance * sizeof(float);
+	for (GLuint column = 0; column < 4; column++) {
+		const GLuint location = instanceTransformLocation + column;
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride,
+							  reinterpret_cast<void*>(allocation.offset + column * 4 * sizeof(float)));
+		glVertexAttribDivisor(location, 1);
+	}
+	size_t offset = 16;
+	for (const auto &l : instanceLinks) {
+		glEnableVertexAttribArray(l.location);
+		glVertexAttribPointer(l.location, l.components, GL_FLOAT, GL_FALSE, stride,
+							  reinterpret_cast<void*>(allocation.offset + offset * sizeof(float)));
+		glVertexAttribDivisor(l.location, 1);
+		offset += l.components;
+	}
+
+	if (InstancedDrawFunction) {
+		InstancedDrawFunction(instanceCount);
+	}
+	else {
+		glDrawElementsInstanced(GL_TRIANGLES, BatchVao->getIndexCount(),
+								GL_UNSIGNED_INT, nullptr, instanceCount);
+	}
+
+	//Restore the shared VAO's attribute state, so later non-instanced draws
+	//of it don't read per-instance data
+	for (GLuint column = 0; column < 4; column++) {
+		glVertexAttribDivisor(instanceTransformLocation + column, 0);
+		glDisableVertexAttribArray(instanceTransformLocation + column);
+	}
+	for (const auto &l : instanceLinks) {
+		glVertexAttribDivisor(l.location, 0);
+		glDisableVertexAttribArray(l.location);
+	}
+	return instanceCount;
 }
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "RingBuffer.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace GL_Engine {
+	namespace CG_Data {
+
+		std::vector<RingBuffer*> RingBuffer::Rings;
+		uint64_t RingBuffer::NextSerial = 1;
+
+		//Owned by hand rather than as function statics, whose destructors
+		//would call GL after the context is gone
+		static RingBuffer *UniformRing = nullptr;
+		static RingBuffer *VertexRing = nullptr;
+
+		//The ring is only ever bound to the copy target, so that writing to
+		//it never disturbs an element array or uniform buffer binding
+		static constexpr GLenum WriteTarget = GL_COPY_WRITE_BUFFER;
+
+		static bool HasBufferStorage() {
+			return (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) && glad_glBufferStorage != nullptr;
+		}
+
+		RingBuffer::RingBuffer(GLenum _Target, GLsizeiptr _FrameCapacity, unsigned int _FrameCount)
+			: Target(_Target), FrameCapacity(_FrameCapacity), FrameCount(std::max(_FrameCount, 1u)),
+			  Serial(NextSerial++) {
+			if (Target == GL_UNIFORM_BUFFER) {
+				GLint alignment = 0;
+				glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+				DefaultAlignment = std::max<GLsizeiptr>(alignment, 1);
+			}
+			//Keep every region start aligned
+			FrameCapacity = ((FrameCapacity + DefaultAlignment - 1) / DefaultAlignment) * DefaultAlignment;
+			const GLsizeiptr totalSize = FrameCapacity * FrameCount;
+
+			glGenBuffers(1, &this->ID);
+			glBindBuffer(WriteTarget, this->ID);
+			if (HasBufferStorage()) {
+				const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+				glBufferStorage(WriteTarget, totalSize, nullptr, flags);
+				MappedPointer = static_cast<uint8_t*>(glMapBufferRange(WriteTarget, 0, totalSize, flags));
+				if (!MappedPointer) {
+					glBindBuffer(WriteTarget, 0);
+					glDeleteBuffers(1, &this->ID);
+					throw std::runtime_error("Failed to persistently map ring buffer");
+				}
+				Persistent = true;
+			}
+			else {
+				glBufferData(WriteTarget, totalSize, nullptr, GL_STREAM_DRAW);
+			}
+			glBindBuffer(WriteTarget, 0);
+
+			Fences.resize(FrameCount, nullptr);
+			Rings.push_back(this);
+		}
+
+		RingBuffer::~RingBuffer() {
+			Rings.erase(std::remove(Rings.begin(), Rings.end(), this), Rings.end());
+			for (auto &fence : Fences) {
+				if (fence)
+					glDeleteSync(fence);
+			}
+			if (Persistent) {
+				glBindBuffer(WriteTarget, this->ID);
+				glUnmapBuffer(WriteTarget);
+				glBindBuffer(WriteTarget, 0);
+			}
+			glDeleteBuffers(1, &this->ID);
+		}
+
+		RingBuffer::Allocation RingBuffer::Write(const void *_Data, GLsizeiptr _Size, GLsizeiptr _Alignment) {
+			const GLsizeiptr alignment = _Alignment > 0 ? _Alignment : DefaultAlignment;
+			const GLsizeiptr offset = ((Head + alignment - 1) / alignment) * alignment;
+			if (_Size <= 0 || offset + _Size > FrameCapacity) {
+				Stats.failedAllocations++;
+				return Allocation();
+			}
+			Head = offset + _Size;
+
+			const GLintptr bufferOffset = (Frame % FrameCount) * FrameCapacity + offset;
+			if (Persistent) {
+				std::memcpy(MappedPointer + bufferOffset, _Data, _Size);
+			}
+			else {
+				//The fences guarantee the GPU is done with this region, so
+				//the driver need not synchronise
+				glBindBuffer(WriteTarget, this->ID);
+				void *pointer = glMapBufferRange(WriteTarget, bufferOffset, _Size,
+					GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+				if (!pointer) {
+					glBindBuffer(WriteTarget, 0);
+					Stats.failedAllocations++;
+					return Allocation();
+				}
+				std::memcpy(pointer, _Data, _Size);
+				glUnmapBuffer(WriteTarget);
+				glBindBuffer(WriteTarget, 0);
+			}
+
+			Stats.allocations++;
+			Stats.bytesWritten += _Size;
+			return Allocation{ this->ID, bufferOffset, _Size, Serial, Frame };
+		}
+
+		bool RingBuffer::IsLive(const Allocation &_Allocation) const {
+			return _Allocation.ring == Serial && _Allocation.frame == Frame;
+		}
+
+		void RingBuffer::EndFrame() {
+			Fences[Frame % FrameCount] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			Frame++;
+			Head = 0;
+
+			//Wait for the GPU to finish with the region about to be reused
+			GLsync &fence = Fences[Frame % FrameCount];
+			if (!fence)
+				return;
+			GLenum status = glClientWaitSync(fence, 0, 0);
+			if (status == GL_TIMEOUT_EXPIRED) {
+				Stats.stalls++;
+				do {
+					status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+				} while (status == GL_TIMEOUT_EXPIRED);
+			}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+
+		GLuint RingBuffer::GetID() const {
+			return this->ID;
+		}
+
+		GLenum RingBuffer::GetTarget() const {
+			return this->Target;
+		}
+
+		GLsizeiptr RingBuffer::GetAlignment() const {
+			return this->DefaultAlignment;
+		}
+
+		bool RingBuffer::IsPersistent() const {
+			return this->Persistent;
+		}
+
+		uint64_t RingBuffer::GetFrame() const {
+			return this->Frame;
+		}
+
+		const RingBuffer::Statistics &RingBuffer::GetStatistics() const {
+			return this->Stats;
+		}
+
+		RingBuffer &RingBuffer::Uniforms() {
+			if (!UniformRing)
+				UniformRing = new RingBuffer(GL_UNIFORM_BUFFER, 1 << 20);
+			return *UniformRing;
+		}
+
+		RingBuffer &RingBuffer::Vertices() {
+			if (!VertexRing)
+				VertexRing = new RingBuffer(GL_ARRAY_BUFFER, 4 << 20);
+			return *VertexRing;
+		}
+
+		void RingBuffer::ReleaseShared() {
+			delete UniformRing;
+			UniformRing = nullptr;
+			delete VertexRing;
+			VertexRing = nullptr;
+		}
+
+		void RingBuffer::EndFrameAll() {
+			for (auto ring : Rings) {
+				ring->EndFrame();
+			}
+		}
+
+	}
+}
@@ -1,5 +1,6 @@
 #include "Shader.h"
 #include "File_IO.h"
+#include "GLState.h"
 #include <stdexcept>
 
 namespace GL_Engine{
@@ -13,6 +14,7 @@ namespace GL_Engine{
     Shader::~Shader(){
         if (initialised) {
             glDeleteProgram(this->shaderID);
+            CG_Data::StateCache::programDeleted(this->shaderID);
             initialised = false;
         }
     }
@@ -20,6 +22,7 @@ namespace GL_Engine{
     void Shader::cleanup() {
         if( initialised ) {
             glDeleteProgram( this->shaderID );
+            CG_Data::StateCache::programDeleted( this->shaderID );
             initialised = false;
         }
     }
@@ -58,9 +61,87 @@ namespace GL_Engine{
             return 0;
         }
 
+        // Record the size of each active uniform block, members are
+        // filled in below
+        this->blockLayouts.clear();
+        GLint activeBlocks = 0;
+        glGetProgramiv( this->shaderID, GL_ACTIVE_UNIFORM_BLOCKS, &activeBlocks );
+        std::vector< std::string > blockNames( activeBlocks );
+        for ( GLint i = 0; i < activeBlocks; i++ ){
+            GLchar nameBuffer[ 256 ];
+            GLsizei nameLength = 0;
+            glGetActiveUniformBlockName( this->shaderID, ( GLuint ) i,
+                                         sizeof( nameBuffer ), &nameLength,
+                                         nameBuffer );
+            blockNames[ i ].assign( nameBuffer, nameLength );
+            glGetActiveUniformBlockiv( this->shaderID, ( GLuint ) i,
+                                       GL_UNIFORM_BLOCK_DATA_SIZE,
+                                       &this->blockLayouts[ blockNames[ i ] ].dataSize );
+        }
+
+        // Resolve every active uniform's location once
+        this->uniformLocations.clear();
+        GLint activeUniforms = 0;
+        glGetProgramiv( this->shaderID, GL_ACTIVE_UNIFORMS, &activeUniforms );
+        for ( GLint i = 0; i < activeUniforms; i++ ){
+            GLchar nameBuffer[ 256 ];
+            GLsizei nameLength = 0;
+            GLint size;
+            GLenum type;
+            glGetActiveUniform( this->shaderID, ( GLuint ) i, sizeof( nameBuffer ),
+                                &nameLength, &size, &type, nameBuffer );
+            std::string name( nameBuffer, nameLength );
+            GLint location = glGetUniformLocation( this->shaderID, name.c_str() );
+            // Arrays are reported as "name[0]", make them reachable by "name"
+            // and every element by "name[N]"
+            auto bracket = name.find( '[' );
+            const bool array = size > 1 && bracket != std::string::npos &&
+                               name.compare( bracket, std::string::npos, "[0]" ) == 0;
+            if ( location < 0 ){
+                // Block member, record its offset within the block
+                GLuint index = ( GLuint ) i;
+                GLint blockIndex = -1, offset = -1;
+                glGetActiveUniformsiv( this->shaderID, 1, &index,
+                                       GL_UNIFORM_BLOCK_INDEX, &blockIndex );
+                glGetActiveUniformsiv( this->shaderID, 1, &index,
+                                       GL_UNIFORM_OFFSET, &offset );
+                if ( blockIndex >= 0 && blockIndex < activeBlocks ){
+                    auto & offsets = this->blockLayouts[ blockNames[ blockIndex ] ].offsets;
+                    if ( bracket != std::string::npos ){
+                        offsets[ name.substr( 0, bracket ) ] = offset;
+                    }
+                    offsets[ name ] = offset;
+                    if ( array ){
+                        GLint stride = 0;
+                        glGetActiveUniformsiv( this->shaderID, 1, &index,
+                                               GL_UNIFORM_ARRAY_STRIDE, &stride );
+                        for ( GLint element = 1; element < size; element++ ){
+                            offsets[ name.substr( 0, bracket ) + "[" +
+                                     std::to_string( element ) + "]" ] =
+                                offset + element * stride;
+                        }
+                    }
+                }
+                continue;
+            }
+            if ( bracket != std::string::npos ){
+                this->uniformLocations[ name.substr( 0, bracket ) ] = location;
+            }
+            this->uniformLocations[ name ] = location;
+            if ( array ){
+                // Element locations need not be consecutive, so ask for each
+                for ( GLint element = 1; element < size; element++ ){
+                    const std::string elementName = name.substr( 0, bracket ) +
+                        "[" + std::to_string( element ) + "]";
+                    this->uniformLocations[ elementName ] =
+                        glGetUniformLocation( this->shaderID, elementName.c_str() );
+                }
+            }
+        }
+
         for ( auto uniform : this->uniforms ){
             uniform->uniformObject->SetID( 
-                    glGetUniformLocation( shaderID, uniform->name.c_str() ) );
+                    getUniformLocation( uniform->name ) );
             this->uniformMap[ uniform->name ] = uniform->uniformObject;
         }
 
@@ -68,12 +149,14 @@ namespace GL_Engine{
             ubo.second->blockIndex = glGetUniformBlockIndex( this->shaderID,
                                                             ubo.first.c_str() );
         }
+        for ( auto & block : uniformBlocks ) {
+            block.second.blockIndex = glGetUniformBlockIndex( this->shaderID,
+                                                              block.first.c_str() );
+        }
 
-        glUseProgram( this->shaderID );
+        CG_Data::StateCache::useProgram( this->shaderID );
         for( auto tex : textureLocations ){
-            glUniform1i( glGetUniformLocation( this->shaderID, 
-                                               tex.first.c_str() ),
-                         tex.second );
+            glUniform1i( getUniformLocation( tex.first ), tex.second );
         }
 
         for ( auto attrib : this->attributes ){
@@ -99,10 +182,11 @@ namespace GL_Engine{
 
         unsigned int tempVao;
         glGenVertexArrays( 1, &tempVao );
-        glBindVertexArray( tempVao );
+        CG_Data::StateCache::bindVertexArray( tempVao );
 
         glValidateProgram( this->shaderID );
         glDeleteVertexArrays( 1, &tempVao );
+        CG_Data::StateCache::vertexArrayDeleted( tempVao );
         glGetProgramiv( this->shaderID, GL_VALIDATE_STATUS, &result );
         if ( !result ) {
             glGetProgramInfoLog( this->shaderID, sizeof( errorBuffer ),
@@ -149,14 +233,20 @@ namespace GL_Engine{
     }
 
     void Shader::useShader() const {
-        if ( uboBlockIndices.size() > 0 ) {
-            for ( auto & ubo : uboBlockIndices ) {
-                auto bPost = ubo.second->ubo->GetBindingPost();
-                glUniformBlockBinding( this->shaderID, ubo.second->blockIndex,
-                                       bPost );
+        for ( auto & ubo : uboBlockIndices ) {
+            auto bPost = ubo.second->ubo->GetBindingPost();
+            CG_Data::StateCache::uniformBlockBinding( this->shaderID,
+                                                      ubo.second->blockIndex,
+                                                      bPost );
+        }
+        for ( auto & block : uniformBlocks ) {
+            if ( block.second.blockIndex != GL_INVALID_INDEX ) {
+                CG_Data::StateCache::uniformBlockBinding( this->shaderID,
+                                                          block.second.blockIndex,
+                                                          block.second.binding );
             }
         }
-        glUseProgram( this->shaderID );
+        CG_Data::StateCache::useProgram( this->shaderID );
     }
 
     std::shared_ptr< CG_Data::Uniform >
@@ -217,6 +307,27 @@ namespace GL_Engine{
         this->uboBlockIndices[ _uboName ] = std::move( uboStruct );
     }
 
+    void Shader::registerUniformBlock( const std::string & _blockName,
+                                       GLuint _binding ){
+        auto & block = this->uniformBlocks[ _blockName ];
+        block.binding = _binding;
+        if ( this->initialised ) {
+            block.blockIndex = glGetUniformBlockIndex( this->shaderID,
+                                                       _blockName.c_str() );
+        }
+    }
+
+    const Shader::UniformBlockLayout *
+    Shader::getUniformBlockLayout( const std::string & _blockName ) const {
+        auto it = this->blockLayouts.find( _blockName );
+        return it == this->blockLayouts.end() ? nullptr : &it->second;
+    }
+
+    GLint Shader::getUniformLocation( const std::string & _uniformName ) const {
+        auto it = this->uniformLocations.find( _uniformName );
+        return it == this->uniformLocations.end() ? -1 : it->second;
+    }
+
     std::shared_ptr< CG_Data::Uniform > 
     Shader::getUniform(uint8_t index) const {
         return this->uniforms[ index ]->uniformObject;
@@ -0,0 +1,329 @@
+#include "Skeleton.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || \
+    ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#define CG_SKELETON_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace GL_Engine {
+
+    // _out = _a * _b, for column major matrices. _out may alias _b but
+    // not _a
+    static inline void multiply( const glm::mat4 & _a, const glm::mat4 & _b, glm::mat4 & _out ){
+#ifdef CG_SKELETON_SSE
+        const float * a = &_a[ 0 ][ 0 ];
+        const __m128 a0 = _mm_loadu_ps( a ), a1 = _mm_loadu_ps( a + 4 );
+        const __m128 a2 = _mm_loadu_ps( a + 8 ), a3 = _mm_loadu_ps( a + 12 );
+        for ( int c = 0; c < 4; c++ ){
+            // Column c of the product is _a times column c of _b
+            const float * b = &_b[ c ][ 0 ];
+            __m128 column = _mm_mul_ps( a0, _mm_set1_ps( b[ 0 ] ) );
+            column = _mm_add_ps( column, _mm_mul_ps( a1, _mm_set1_ps( b[ 1 ] ) ) );
+            column = _mm_add_ps( column, _mm_mul_ps( a2, _mm_set1_ps( b[ 2 ] ) ) );
+            column = _mm_add_ps( column, _mm_mul_ps( a3, _mm_set1_ps( b[ 3 ] ) ) );
+            _mm_storeu_ps( &_out[ c ][ 0 ], column );
+        }
+#else
+        _out = _a * _b;
+#endif
+    }
+
+    uint32_t Skeleton::addJoint( NameId _name, uint32_t _parent, const glm::mat4 & _bindLocal ){
+        const uint32_t joint = static_cast< uint32_t >( names.size() );
+        names.push_back( _name );
+        parents.push_back( _parent );
+        bindLocals.push_back( _bindLocal );
+        // Translation, rotation and scale, for blending. Bind transforms
+        // are assumed free of shear
+        const glm::vec3 x = _bindLocal[ 0 ];
+        const glm::vec3 y = _bindLocal[ 1 ];
+        const glm::vec3 z = _bindLocal[ 2 ];
+        const glm::vec3 scale( glm::length( x ), glm::length( y ), glm::length( z ) );
+        const glm::mat3 rotation( x / scale.x, y / scale.y, z / scale.z );
+        bindTranslations.push_back( glm::vec3( _bindLocal[ 3 ] ) );
+        bindRotations.push_back( glm::normalize( glm::quat_cast( rotation ) ) );
+        bindScales.push_back( scale );
+        animated.push_back( 0 );
+        maskedFrom.push_back( UINT32_MAX );
+        locals.push_back( _bindLocal );
+        models.emplace_back( 1.0f );
+        publishedModels.emplace_back( 1.0f );
+        return joint;
+    }
+
+    uint32_t Skeleton::addClip( NameId _name, double _length ){
+        Clip clip;
+        clip.name = _name;
+        clip.length = _length;
+        clip.channels.resize( names.size() );
+        clip.cursors.resize( names.size() );
+        clips.push_back( std::move( clip ) );
+        return static_cast< uint32_t >( clips.size() - 1 );
+    }
+
+    void Skeleton::setAnimation( uint32_t _clip, uint32_t _joint, std::shared_ptr< NodeAnimation > _animation ){
+        animated[ _joint ] |= _animation ? 1 : 0;
+        clips[ _clip ].channels[ _joint ] = std::move( _animation );
+        clips[ _clip ].cursors[ _joint ] = NodeAnimation::Cursor();
+    }
+
+    uint32_t Skeleton::addPalette(){
+        paletteOffsets.push_back( paletteOffsets.back() );
+        return static_cast< uint32_t >( paletteOffsets.size() - 2 );
+    }
+
+    uint32_t Skeleton::addPaletteEntry( uint32_t _joint, const glm::mat4 & _inverseBind ){
+        paletteJoints.push_back( _joint );
+        inverseBinds.push_back( _inverseBind );
+        palettes[ 0 ].emplace_back( 1.0f );
+        palettes[ 1 ].emplace_back( 1.0f );
+        keyPalettes[ 0 ].emplace_back( 1.0f );
+        keyPalettes[ 1 ].emplace_back( 1.0f );
+        const uint32_t index = paletteOffsets.back() - paletteOffsets[ paletteOffsets.size() - 2 ];
+        paletteOffsets.back()++;
+        return index;
+    }
+
+    void Skeleton::setGlobalInverse( const glm::mat4 & _globalInverse ){
+        globalInverse = _globalInverse;
+    }
+
+    uint32_t Skeleton::findJoint( NameId _name ) const {
+        for ( uint32_t joint = 0; joint < names.size(); joint++ ){
+            if ( names[ joint ] == _name ){
+                return joint;
+            }
+        }
+        return NoJoint;
+    }
+
+    uint32_t Skeleton::getJointCount() const {
+        return static_cast< uint32_t >( names.size() );
+    }
+
+    uint32_t Skeleton::getParent( uint32_t _joint ) const {
+        return parents[ _joint ];
+    }
+
+    NameId Skeleton::getJointName( uint32_t _joint ) const {
+        return names[ _joint ];
+    }
+
+    uint32_t Skeleton::findClip( NameId _name ) const {
+        for ( uint32_t clip = 0; clip < clips.size(); clip++ ){
+            if ( clips[ clip ].name == _name ){
+                return clip;
+            }
+        }
+        return NoClip;
+    }
+
+    uint32_t Skeleton::getClipCount() const {
+        return static_cast< uint32_t >( clips.size() );
+    }
+
+    double Skeleton::getClipLength( uint32_t _clip ) const {
+        return _clip < clips.size() ? clips[ _clip ].length : 0.0;
+    }
+
+    void Skeleton::maskJoint( uint32_t _joint, uint32_t _fromTier ){
+        maskedFrom[ _joint ] = std::min( maskedFrom[ _joint ], _fromTier );
+    }
+
+    void Skeleton::maskBelowDepth( uint32_t _fromTier, uint32_t _depth ){
+        std::vector< uint32_t > depths( names.size() );
+        for ( uint32_t joint = 0; joint < names.size(); joint++ ){
+            const uint32_t parent = parents[ joint ];
+            depths[ joint ] = parent == NoJoint ? 0 : depths[ parent ] + 1;
+            if ( depths[ joint ] > _depth ){
+                maskJoint( joint, _fromTier );
+            }
+        }
+    }
+
+    uint32_t Skeleton::sampleClip( uint32_t _clip, double _time, uint32_t _tier, LocalPose & _pose,
+                                   bool _advanceCursors ){
+        // A tree built for another rig may name clips this one lacks,
+        // which pose as the bind pose, as with single clips
+        Clip * clip = _clip < clips.size() ? &clips[ _clip ] : nullptr;
+        uint32_t sampled = 0;
+        for ( uint32_t joint = 0; joint < names.size(); joint++ ){
+            const NodeAnimation * animation = clip ? clip->channels[ joint ].get() : nullptr;
+            if ( !animation || _tier >= maskedFrom[ joint ] ){
+                _pose.translations[ joint ] = bindTranslations[ joint ];
+                _pose.rotations[ joint ] = bindRotations[ joint ];
+                _pose.scales[ joint ] = bindScales[ joint ];
+                continue;
+            }
+            NodeAnimation::Cursor scratch;
+            animation->Sample( static_cast< float >( _time ),
+                               _advanceCursors ? clip->cursors[ joint ] : scratch,
+                               _pose.translations[ joint ], _pose.rotations[ joint ], _pose.scales[ joint ] );
+            sampled++;
+        }
+        return sampled;
+    }
+
+    uint32_t Skeleton::sample( const Source & _source, double _time, uint32_t _tier ){
+        uint32_t sampled = 0;
+        if ( _source.tree ){
+            const uint32_t jointCount = static_cast< uint32_t >( names.size() );
+            auto pose = PosePool::get().acquire( jointCount );
+            sampled = _source.tree->evaluate( *this, _time, _tier, *pose );
+            for ( uint32_t joint = 0; joint < jointCount; joint++ ){
+                if ( !animated[ joint ] ){
+                    locals[ joint ] = bindLocals[ joint ];
+                }
+                else if ( _tier < maskedFrom[ joint ] ){
+                    // Translate * rotate * scale, as NodeAnimation::Sample
+                    glm::mat4 & local = locals[ joint ];
+                    local = glm::mat4_cast( pose->rotations[ joint ] );
+                    local[ 0 ] *= pose->scales[ joint ].x;
+                    local[ 1 ] *= pose->scales[ joint ].y;
+                    local[ 2 ] *= pose->scales[ joint ].z;
+                    local[ 3 ] = glm::vec4( pose->translations[ joint ], 1.0f );
+                }
+            }
+            return sampled;
+        }
+        if ( _source.clip >= clips.size() ){
+            std::copy( bindLocals.begin(), bindLocals.end(), locals.begin() );
+            return 0;
+        }
+        Clip & clip = clips[ _source.clip ];
+        for ( uint32_t joint = 0; joint < names.size(); joint++ ){
+            const NodeAnimation * animation = clip.channels[ joint ].get();
+            if ( !animation ){
+                locals[ joint ] = bindLocals[ joint ];
+            }
+            else if ( _tier < maskedFrom[ joint ] ){
+                const double time = std::fmod( _time, animation->AnimationLength );
+                locals[ joint ] = animation->Sample( static_cast< float >( time ), clip.cursors[ joint ] );
+                sampled++;
+            }
+        }
+        return sampled;
+    }
+
+    void Skeleton::pose(){
+        std::copy( bindLocals.begin(), bindLocals.end(), locals.begin() );
+        evaluate( palettes[ front ^ 1 ].data() );
+        keysValid = false;
+    }
+
+    uint32_t Skeleton::pose( unsigned int _animationId, double _time, uint32_t _tier ){
+        return pose( Source{ nullptr, _animationId }, _time, _tier );
+    }
+
+    uint32_t Skeleton::pose( const BlendTree & _tree, double _time, uint32_t _tier ){
+        return pose( Source{ &_tree, 0 }, _time, _tier );
+    }
+
+    uint32_t Skeleton::pose( const Source & _source, double _time, uint32_t _tier ){
+        const uint32_t sampled = sample( _source, _time, _tier );
+        evaluate( palettes[ front ^ 1 ].data() );
+        keysValid = false;
+        lastTime = _time;
+        timed = true;
+        return sampled;
+    }
+
+    uint32_t Skeleton::poseBlended( unsigned int _animationId, double _time,
+                                    uint32_t _interval, uint32_t _tier ){
+        return poseBlended( Source{ nullptr, _animationId }, _time, _interval, _tier );
+    }
+
+    uint32_t Skeleton::poseBlended( const BlendTree & _tree, double _time,
+                                    uint32_t _interval, uint32_t _tier ){
+        return poseBlended( Source{ &_tree, 0 }, _time, _interval, _tier );
+    }
+
+    uint32_t Skeleton::poseBlended( const Source & _source, double _time,
+                                    uint32_t _interval, uint32_t _tier ){
+        const double frameTime = timed ? std::max( _time - lastTime, 0.0 ) : 0.0;
+        lastTime = _time;
+        timed = true;
+        uint32_t sampled = 0;
+        if ( !keysValid || _time < keyTimes[ 0 ] || _time > keyTimes[ 1 ] ){
+            const double span = keyTimes[ 1 ] - keyTimes[ 0 ];
+            if ( keysValid && _time >= keyTimes[ 1 ] && _time <= keyTimes[ 1 ] + span ){
+                // Playing on, the last key starts the next span
+                std::swap( keyPalettes[ 0 ], keyPalettes[ 1 ] );
+                keyTimes[ 0 ] = keyTimes[ 1 ];
+            }
+            else {
+                sampled += sample( _source, _time, _tier );
+                evaluate( keyPalettes[ 0 ].data() );
+                keyTimes[ 0 ] = _time;
+            }
+            keyTimes[ 1 ] = keyTimes[ 0 ] + frameTime * _interval;
+            sampled += sample( _source, keyTimes[ 1 ], _tier );
+            evaluate( keyPalettes[ 1 ].data() );
+            keysValid = true;
+        }
+
+        const double span = keyTimes[ 1 ] - keyTimes[ 0 ];
+        const float t = span > 0.0 ? static_cast< float >( ( _time - keyTimes[ 0 ] ) / span ) : 0.0f;
+        const glm::mat4 * from = keyPalettes[ 0 ].data();
+        const glm::mat4 * to = keyPalettes[ 1 ].data();
+        glm::mat4 * back = palettes[ front ^ 1 ].data();
+        for ( size_t entry = 0; entry < paletteJoints.size(); entry++ ){
+            // Linear, which is close enough for the small steps between keys
+            for ( int column = 0; column < 4; column++ ){
+                back[ entry ][ column ] = from[ entry ][ column ] +
+                    ( to[ entry ][ column ] - from[ entry ][ column ] ) * t;
+            }
+        }
+        return sampled;
+    }
+
+    void Skeleton::publish(){
+        front ^= 1;
+        std::copy( models.begin(), models.end(), publishedModels.begin() );
+    }
+
+    void Skeleton::update(){
+        pose();
+        publish();
+    }
+
+    void Skeleton::update( unsigned int _animationId, double _time, uint32_t _tier ){
+        pose( _animationId, _time, _tier );
+        publish();
+    }
+
+    void Skeleton::update( const BlendTree & _tree, double _time, uint32_t _tier ){
+        pose( _tree, _time, _tier );
+        publish();
+    }
+
+    void Skeleton::evaluate( glm::mat4 * _palette ){
+        // Parents precede children, so each parent is final when read
+        const uint32_t jointCount = static_cast< uint32_t >( names.size() );
+        for ( uint32_t joint = 0; joint < jointCount; joint++ ){
+            const uint32_t parent = parents[ joint ];
+            multiply( parent == NoJoint ? globalInverse : models[ parent ],
+                      locals[ joint ], models[ joint ] );
+        }
+        const uint32_t entryCount = static_cast< uint32_t >( paletteJoints.size() );
+        for ( uint32_t entry = 0; entry < entryCount; entry++ ){
+            multiply( models[ paletteJoints[ entry ] ], inverseBinds[ entry ], _palette[ entry ] );
+        }
+    }
+
+    const glm::mat4 & Skeleton::getModelTransform( uint32_t _joint ) const {
+        return publishedModels[ _joint ];
+    }
+
+    const glm::mat4 * Skeleton::getPalette( uint32_t _palette ) const {
+        return palettes[ front ].data() + paletteOffsets[ _palette ];
+    }
+
+    uint32_t Skeleton::getPaletteSize( uint32_t _palette ) const {
+        return paletteOffsets[ _palette + 1 ] - paletteOffsets[ _palette ];
+    }
+
+}
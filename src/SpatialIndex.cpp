@@ -0,0 +1,492 @@
+#include "SpatialIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace GL_Engine {
+
+    /* --- QueryResults --- */
+
+    void SpatialIndex::QueryResults::clear(){
+        entities.clear();
+        offsets.assign( 1, 0 );
+    }
+
+    size_t SpatialIndex::QueryResults::size() const {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    const EntityId * SpatialIndex::QueryResults::begin( size_t _query ) const {
+        return entities.data() + offsets[ _query ];
+    }
+
+    const EntityId * SpatialIndex::QueryResults::end( size_t _query ) const {
+        return entities.data() + offsets[ _query + 1 ];
+    }
+
+    /* --- SpatialIndex --- */
+
+    SpatialIndex::SpatialIndex( TransformStore & _transforms, const glm::vec3 & _centre,
+                                float _halfSize, uint32_t _maxDepth )
+        : transforms( _transforms ){
+        reset( _centre, _halfSize, _maxDepth );
+    }
+
+    void SpatialIndex::reset( const glm::vec3 & _centre, float _halfSize, uint32_t _maxDepth ){
+        maxDepth = std::min( _maxDepth, MaxDepthLimit );
+        minHalfSize = _halfSize / static_cast< float >( 1u << maxDepth );
+        nodes.clear();
+        Node node{};
+        node.parent = None;
+        node.first = None;
+        // Outside, whose bounds are never tested
+        node.halfSize = std::numeric_limits< float >::infinity();
+        nodes.push_back( node );
+        // Root
+        node.centre = _centre;
+        node.halfSize = _halfSize;
+        nodes.push_back( node );
+
+        freeNodes.clear();
+        statistics.nodes = 1;
+        statistics.outside = 0;
+        for ( uint32_t i = 0; i < items.size(); i++ ){
+            link( i );
+        }
+    }
+
+    uint32_t SpatialIndex::targetDepth( float _radius ) const {
+        if ( _radius <= minHalfSize ){
+            return maxDepth;
+        }
+        // The deepest level whose cells are no smaller than the radius
+        return static_cast< uint32_t >( std::max( 0, std::ilogb( nodes[ Root ].halfSize / _radius ) ) );
+    }
+
+    bool SpatialIndex::isOutside( const glm::vec4 & _sphere ) const {
+        const Node & root = nodes[ Root ];
+        return _sphere.w > root.halfSize ||
+               glm::any( glm::greaterThan( glm::abs( glm::vec3( _sphere ) - root.centre ),
+                                           glm::vec3( root.halfSize ) ) );
+    }
+
+    bool SpatialIndex::inCell( const glm::vec4 & _sphere, uint32_t _node ) const {
+        return glm::all( glm::lessThanEqual( glm::abs( glm::vec3( _sphere ) - nodes[ _node ].centre ),
+                                             glm::vec3( nodes[ _node ].halfSize ) ) );
+    }
+
+    bool SpatialIndex::fits( const Item & _item ) const {
+        if ( _item.node == Outside ){
+            return isOutside( _item.sphere );
+        }
+        // At the target depth the radius is at most the cell's half size
+        // and more than a child's, bar at the deepest level. Cells lie
+        // within the root, so the centre being in the cell keeps the
+        // item out of the outside list
+        const float radius = _item.sphere.w;
+        return radius <= _item.cellHalfSize &&
+               ( radius > _item.cellHalfSize * 0.5f || _item.cellHalfSize <= minHalfSize ) &&
+               glm::all( glm::lessThanEqual( glm::abs( glm::vec3( _item.sphere ) - _item.cellCentre ),
+                                             glm::vec3( _item.cellHalfSize ) ) );
+    }
+
+    uint32_t SpatialIndex::descend( uint32_t _from, const glm::vec4 & _sphere ){
+        const glm::vec3 centre( _sphere );
+        const uint32_t depth = targetDepth( _sphere.w );
+        uint32_t n = _from;
+        while ( nodes[ n ].depth < depth ){
+            const glm::vec3 nodeCentre = nodes[ n ].centre;
+            const uint32_t octant = ( centre.x >= nodeCentre.x ? 1u : 0u ) |
+                                    ( centre.y >= nodeCentre.y ? 2u : 0u ) |
+                                    ( centre.z >= nodeCentre.z ? 4u : 0u );
+            if ( nodes[ n ].children[ octant ] == 0 ){
+                Node child{};
+                child.halfSize = nodes[ n ].halfSize * 0.5f;
+                child.centre = nodeCentre + glm::vec3( octant & 1u ? child.halfSize : -child.halfSize,
+                                                       octant & 2u ? child.halfSize : -child.halfSize,
+                                                       octant & 4u ? child.halfSize : -child.halfSize );
+                child.depth = nodes[ n ].depth + 1;
+                child.parent = n;
+                child.first = None;
+                uint32_t index;
+                if ( !freeNodes.empty() ){
+                    index = freeNodes.back();
+                    freeNodes.pop_back();
+                    nodes[ index ] = child;
+                }
+                else {
+                    index = static_cast< uint32_t >( nodes.size() );
+                    nodes.push_back( child );
+                }
+                nodes[ n ].children[ octant ] = index;
+                statistics.nodes++;
+            }
+            n = nodes[ n ].children[ octant ];
+        }
+        return n;
+    }
+
+    void SpatialIndex::release( uint32_t _node ){
+        while ( _node != Root && _node != Outside && nodes[ _node ].count == 0 ){
+            const uint32_t parent = nodes[ _node ].parent;
+            for ( uint32_t & child : nodes[ parent ].children ){
+                if ( child == _node ){
+                    child = 0;
+                }
+            }
+            freeNodes.push_back( _node );
+            statistics.nodes--;
+            _node = parent;
+        }
+    }
+
+    void SpatialIndex::attach( uint32_t _item, uint32_t _node ){
+        Item & item = items[ _item ];
+        item.node = _node;
+        item.cellCentre = nodes[ _node ].centre;
+        item.cellHalfSize = nodes[ _node ].halfSize;
+        item.previous = None;
+        item.next = nodes[ _node ].first;
+        if ( item.next != None ){
+            items[ item.next ].previous = _item;
+        }
+        nodes[ _node ].first = _item;
+    }
+
+    void SpatialIndex::detach( uint32_t _item ){
+        Item & item = items[ _item ];
+        if ( item.previous != None ){
+            items[ item.previous ].next = item.next;
+        }
+        else {
+            nodes[ item.node ].first = item.next;
+        }
+        if ( item.next != None ){
+            items[ item.next ].previous = item.previous;
+        }
+    }
+
+    void SpatialIndex::link( uint32_t _item ){
+        const glm::vec4 & sphere = items[ _item ].sphere;
+        const uint32_t node = isOutside( sphere ) ? Outside : descend( Root, sphere );
+        attach( _item, node );
+        for ( uint32_t n = node; n != None; n = nodes[ n ].parent ){
+            nodes[ n ].count++;
+        }
+        statistics.outside += node == Outside;
+    }
+
+    void SpatialIndex::unlink( uint32_t _item ){
+        const uint32_t node = items[ _item ].node;
+        detach( _item );
+        for ( uint32_t n = node; n != None; n = nodes[ n ].parent ){
+            nodes[ n ].count--;
+        }
+        statistics.outside -= node == Outside;
+        items[ _item ].node = None;
+        release( node );
+    }
+
+    void SpatialIndex::insert( EntityId _entity, const BoundingVolume & _localBounds ){
+        if ( _localBounds.isEmpty() ){
+            remove( _entity );
+            return;
+        }
+        if ( _entity >= itemOf.size() ){
+            itemOf.resize( _entity + 1, None );
+        }
+        uint32_t index = itemOf[ _entity ];
+        if ( index == None ){
+            index = static_cast< uint32_t >( items.size() );
+            Item item{};
+            item.entity = _entity;
+            item.node = None;
+            items.push_back( item );
+            itemOf[ _entity ] = index;
+            statistics.entities++;
+        }
+        items[ index ].localCentre = _localBounds.centre;
+        items[ index ].localRadius = _localBounds.radius;
+        transforms.update( _entity );
+        refit( index );
+    }
+
+    void SpatialIndex::remove( EntityId _entity ){
+        if ( !contains( _entity ) ){
+            return;
+        }
+        const uint32_t index = itemOf[ _entity ];
+        unlink( index );
+        // Move the last item into the gap, repointing its neighbours
+        const uint32_t last = static_cast< uint32_t >( items.size() - 1 );
+        if ( index != last ){
+            const uint32_t node = items[ last ].node;
+            detach( last );
+            items[ index ] = items[ last ];
+            itemOf[ items[ index ].entity ] = index;
+            attach( index, node );
+        }
+        items.pop_back();
+        itemOf[ _entity ] = None;
+        statistics.entities--;
+    }
+
+    void SpatialIndex::copy( EntityId _from, EntityId _to ){
+        if ( !contains( _from ) ){
+            return;
+        }
+        const Item & item = items[ itemOf[ _from ] ];
+        BoundingVolume bounds;
+        bounds.centre = item.localCentre;
+        bounds.radius = item.localRadius;
+        insert( _to, bounds );
+    }
+
+    bool SpatialIndex::contains( EntityId _entity ) const {
+        return _entity < itemOf.size() && itemOf[ _entity ] != None;
+    }
+
+    glm::vec4 SpatialIndex::getSphere( EntityId _entity ) const {
+        return items[ itemOf[ _entity ] ].sphere;
+    }
+
+    void SpatialIndex::refit( uint32_t _item ){
+        Item & item = items[ _item ];
+        const glm::mat4 & m = transforms.getMatrix( item.entity );
+        const float scaleSq = std::max( glm::dot( glm::vec3( m[ 0 ] ), glm::vec3( m[ 0 ] ) ),
+                              std::max( glm::dot( glm::vec3( m[ 1 ] ), glm::vec3( m[ 1 ] ) ),
+                                        glm::dot( glm::vec3( m[ 2 ] ), glm::vec3( m[ 2 ] ) ) ) );
+        item.sphere = glm::vec4( glm::vec3( m * glm::vec4( item.localCentre, 1.0f ) ),
+                                 item.localRadius * std::sqrt( scaleSq ) );
+        statistics.refitted++;
+        if ( item.node != None && fits( item ) ){
+            return;
+        }
+        statistics.relinked++;
+        if ( item.node == None || item.node == Outside || isOutside( item.sphere ) ){
+            if ( item.node != None ){
+                unlink( _item );
+            }
+            link( _item );
+            return;
+        }
+        // Move within the lowest ancestor the entity still fits under,
+        // leaving the counts above it unchanged. Small moves stay local
+        const uint32_t depth = targetDepth( item.sphere.w );
+        uint32_t ancestor = item.node;
+        while ( nodes[ ancestor ].depth > depth || !inCell( item.sphere, ancestor ) ){
+            ancestor = nodes[ ancestor ].parent;
+        }
+        const uint32_t previous = item.node;
+        detach( _item );
+        for ( uint32_t n = previous; n != ancestor; n = nodes[ n ].parent ){
+            nodes[ n ].count--;
+        }
+        release( previous );
+        const uint32_t node = descend( ancestor, item.sphere );
+        attach( _item, node );
+        for ( uint32_t n = node; n != ancestor; n = nodes[ n ].parent ){
+            nodes[ n ].count++;
+        }
+    }
+
+    void SpatialIndex::update(){
+        statistics.refitted = 0;
+        statistics.relinked = 0;
+        transforms.takeMoved( moved );
+        for ( TransformStore::Handle handle : moved ){
+            if ( contains( handle ) ){
+                refit( itemOf[ handle ] );
+            }
+        }
+    }
+
+    void SpatialIndex::appendSubtree( uint32_t _node, std::vector< EntityId > & _out ) const {
+        uint32_t stack[ 8 * MaxDepthLimit + 1 ];
+        uint32_t top = 0;
+        stack[ top++ ] = _node;
+        while ( top > 0 ){
+            const Node & node = nodes[ stack[ --top ] ];
+            for ( uint32_t i = node.first; i != None; i = items[ i ].next ){
+                _out.push_back( items[ i ].entity );
+            }
+            for ( uint32_t child : node.children ){
+                if ( child != 0 && nodes[ child ].count > 0 ){
+                    stack[ top++ ] = child;
+                }
+            }
+        }
+    }
+
+    template< typename BoxTest, typename SphereTest >
+    void SpatialIndex::query( BoxTest && _box, SphereTest && _sphere,
+                              std::vector< EntityId > & _out ) const {
+        for ( uint32_t i = nodes[ Outside ].first; i != None; i = items[ i ].next ){
+            if ( _sphere( items[ i ].sphere ) ){
+                _out.push_back( items[ i ].entity );
+            }
+        }
+        // Each level pushes at most eight nodes and pops one
+        uint32_t stack[ 8 * MaxDepthLimit + 1 ];
+        uint32_t top = 0;
+        if ( nodes[ Root ].count > 0 ){
+            stack[ top++ ] = Root;
+        }
+        while ( top > 0 ){
+            const uint32_t n = stack[ --top ];
+            const Node & node = nodes[ n ];
+            const auto containment = _box( node.centre, glm::vec3( node.halfSize * 2.0f ) );
+            if ( containment == Frustum::Containment::Outside ){
+                continue;
+            }
+            if ( containment == Frustum::Containment::Inside ){
+                appendSubtree( n, _out );
+                continue;
+            }
+            for ( uint32_t i = node.first; i != None; i = items[ i ].next ){
+                if ( _sphere( items[ i ].sphere ) ){
+                    _out.push_back( items[ i ].entity );
+                }
+            }
+            for ( uint32_t child : node.children ){
+                if ( child != 0 && nodes[ child ].count > 0 ){
+                    stack[ top++ ] = child;
+                }
+            }
+        }
+    }
+
+    void SpatialIndex::queryFrustum( const Frustum & _frustum,
+                                     std::vector< EntityId > & _out ) const {
+        query( [ &_frustum ]( const glm::vec3 & _centre, const glm::vec3 & _halfExtents ){
+                   return _frustum.testBox( _centre, _halfExtents );
+               },
+               [ &_frustum ]( const glm::vec4 & _sphere ){
+                   return _frustum.testSphere( glm::vec3( _sphere ), _sphere.w );
+               }, _out );
+    }
+
+    void SpatialIndex::querySphere( const glm::vec3 & _centre, float _radius,
+                                    std::vector< EntityId > & _out ) const {
+        const float radiusSq = _radius * _radius;
+        query( [ &_centre, radiusSq ]( const glm::vec3 & _boxCentre, const glm::vec3 & _halfExtents ){
+                   const glm::vec3 offset = glm::abs( _centre - _boxCentre );
+                   const glm::vec3 nearest = glm::max( offset - _halfExtents, glm::vec3( 0.0f ) );
+                   if ( glm::dot( nearest, nearest ) > radiusSq ){
+                       return Frustum::Containment::Outside;
+                   }
+                   const glm::vec3 furthest = offset + _halfExtents;
+                   return glm::dot( furthest, furthest ) <= radiusSq ?
+                          Frustum::Containment::Inside : Frustum::Containment::Intersecting;
+               },
+               [ &_centre, _radius ]( const glm::vec4 & _sphere ){
+                   const glm::vec3 offset = glm::vec3( _sphere ) - _centre;
+                   const float reach = _radius + _sphere.w;
+                   return glm::dot( offset, offset ) <= reach * reach;
+               }, _out );
+    }
+
+    void SpatialIndex::queryBox( const glm::vec3 & _min, const glm::vec3 & _max,
+                                 std::vector< EntityId > & _out ) const {
+        query( [ &_min, &_max ]( const glm::vec3 & _centre, const glm::vec3 & _halfExtents ){
+                   const glm::vec3 boxMin = _centre - _halfExtents;
+                   const glm::vec3 boxMax = _centre + _halfExtents;
+                   if ( glm::any( glm::lessThan( boxMax, _min ) ) ||
+                        glm::any( glm::greaterThan( boxMin, _max ) ) ){
+                       return Frustum::Containment::Outside;
+                   }
+                   return glm::all( glm::greaterThanEqual( boxMin, _min ) ) &&
+                          glm::all( glm::lessThanEqual( boxMax, _max ) ) ?
+                          Frustum::Containment::Inside : Frustum::Containment::Intersecting;
+               },
+               [ &_min, &_max ]( const glm::vec4 & _sphere ){
+                   const glm::vec3 centre( _sphere );
+                   const glm::vec3 nearest = glm::clamp( centre, _min, _max ) - centre;
+                   return glm::dot( nearest, nearest ) <= _sphere.w * _sphere.w;
+               }, _out );
+    }
+
+    void SpatialIndex::querySpheres( const glm::vec4 * _spheres, size_t _count,
+                                     QueryResults & _results ) const {
+        _results.clear();
+        for ( size_t i = 0; i < _count; i++ ){
+            querySphere( glm::vec3( _spheres[ i ] ), _spheres[ i ].w, _results.entities );
+            _results.offsets.push_back( static_cast< uint32_t >( _results.entities.size() ) );
+        }
+    }
+
+    void SpatialIndex::queryFrustums( const Frustum * _frustums, size_t _count,
+                                      QueryResults & _results ) const {
+        _results.clear();
+        for ( size_t i = 0; i < _count; i++ ){
+            queryFrustum( _frustums[ i ], _results.entities );
+            _results.offsets.push_back( static_cast< uint32_t >( _results.entities.size() ) );
+        }
+    }
+
+    EntityId SpatialIndex::raycast( const glm::vec3 & _origin, const glm::vec3 & _direction,
+                                    float _maxDistance, float * _distance ) const {
+        EntityId hit = InvalidEntity;
+        float nearest = _maxDistance;
+        auto testItems = [ & ]( uint32_t _first ){
+            for ( uint32_t i = _first; i != None; i = items[ i ].next ){
+                // Entry distance of the ray into the sphere, or 0 if the
+                // origin is inside it
+                const glm::vec3 offset = _origin - glm::vec3( items[ i ].sphere );
+                const float b = glm::dot( offset, _direction );
+                const float c = glm::dot( offset, offset ) - items[ i ].sphere.w * items[ i ].sphere.w;
+                const float discriminant = b * b - c;
+                if ( discriminant < 0.0f || ( c > 0.0f && b > 0.0f ) ){
+                    continue;
+                }
+                const float t = std::max( 0.0f, -b - std::sqrt( discriminant ) );
+                if ( t <= nearest ){
+                    nearest = t;
+                    hit = items[ i ].entity;
+                }
+            }
+        };
+
+        testItems( nodes[ Outside ].first );
+        const glm::vec3 inverse = 1.0f / _direction;
+        uint32_t stack[ 8 * MaxDepthLimit + 1 ];
+        uint32_t top = 0;
+        if ( nodes[ Root ].count > 0 ){
+            stack[ top++ ] = Root;
+        }
+        while ( top > 0 ){
+            const Node & node = nodes[ stack[ --top ] ];
+            // Slab test against the loose bounds, skipping nodes entered
+            // beyond the nearest hit so far
+            const glm::vec3 halfExtents( node.halfSize * 2.0f );
+            const glm::vec3 t0 = ( node.centre - halfExtents - _origin ) * inverse;
+            const glm::vec3 t1 = ( node.centre + halfExtents - _origin ) * inverse;
+            const glm::vec3 tMin = glm::min( t0, t1 ), tMax = glm::max( t0, t1 );
+            const float enter = std::max( std::max( tMin.x, tMin.y ), std::max( tMin.z, 0.0f ) );
+            const float exit = std::min( std::min( tMax.x, tMax.y ), tMax.z );
+            if ( enter > exit || enter > nearest ){
+                continue;
+            }
+            testItems( node.first );
+            for ( uint32_t child : node.children ){
+                if ( child != 0 && nodes[ child ].count > 0 ){
+                    stack[ top++ ] = child;
+                }
+            }
+        }
+        if ( _distance && hit != InvalidEntity ){
+            *_distance = nearest;
+        }
+        return hit;
+    }
+
+    const SpatialIndex::Statistics & SpatialIndex::getStatistics() const {
+        return this->statistics;
+    }
+
+    SpatialIndex & SpatialIndex::get(){
+        static SpatialIndex index;
+        return index;
+    }
+
+}
@@ -1,4 +1,6 @@
 #include "Terrain.h"
+#include "GLState.h"
+#include <algorithm>
 namespace GL_Engine {
 
 #pragma region TerrainGenerator
@@ -48,12 +50,13 @@ namespace GL_Engine {
 		return MeshData{ Indices, Mesh, texcoord };
 	}
 
-	std::vector<float>
+	std::pmr::vector<float>
 	TerrainGenerator::GenerateHeights ( int MeshSize, int DivisionCount, 
-								        int GridX, int GridZ ){
+								        int GridX, int GridZ,
+										std::pmr::memory_resource *_Resource ){
 		int startingX = GridX * (DivisionCount - 1);
 		int startingZ = GridZ * (DivisionCount - 1);
-		std::vector<float> heights;
+		std::pmr::vector<float> heights( _Resource );
 		heights.reserve(DivisionCount * DivisionCount);
 		for (int z = 0; z < DivisionCount; z++) {
 			unsigned int zIndex = z * DivisionCount;
@@ -65,20 +68,20 @@ namespace GL_Engine {
 		return heights;
 	}
 
-	std::vector<glm::vec3> 
+	std::pmr::vector<glm::vec3> 
 	TerrainGenerator::GetSmoothNormals( const MeshData &meshData, 
-										const std::vector< float > Heights ){
-		auto indices = meshData.Indices;
-		auto vertices = meshData.Mesh;
+										const std::pmr::vector< float > &Heights,
+										std::pmr::memory_resource *_Resource ){
+		const auto &indices = meshData.Indices;
+		const auto &vertices = meshData.Mesh;
 
-		std::vector< glm::vec3 > faceNormals;
-		faceNormals.reserve( indices.size() / 3 );
-
-		std::vector< std::vector< glm::vec3 > > vertexNormalList;
-		vertexNormalList.resize( vertices.size() );
+		// Sum the normals of the faces around each vertex, then normalise
+		std::pmr::vector< glm::vec3 > vertexNormals( vertices.size(),
+													 glm::vec3( 0.0f ),
+													 _Resource );
 
 		// Calculate the normal for each face (3 vertices)
-		for ( auto fi = 0; fi < indices.size(); fi += 3 ){
+		for ( size_t fi = 0; fi + 2 < indices.size(); fi += 3 ){
 			// Get the vertex indices for the face
 			unsigned int face[3] = { 
 				indices[ fi ],
@@ -96,40 +99,31 @@ namespace GL_Engine {
 
 			glm::vec3 p3( vertices[ face[ 2 ] ].x,
 						  Heights[ face[ 2 ] ], 
-						  vertices[ face[ 2 ] ].y )
-						  ;
+						  vertices[ face[ 2 ] ].y );
+
 			glm::vec3 A = p3 - p2;
 			glm::vec3 B = p1 - p2;
-			glm::vec3 faceNorm = glm::cross( A, B );
-			faceNorm = glm::normalize( faceNorm );
-			faceNormals.push_back( faceNorm );
-			vertexNormalList[ face[ 0 ] ].push_back( faceNorm );
-			vertexNormalList[ face[ 1 ] ].push_back( faceNorm );
-			vertexNormalList[ face[ 2 ] ].push_back( faceNorm );
+			glm::vec3 faceNorm = glm::normalize( glm::cross( A, B ) );
+			vertexNormals[ face[ 0 ] ] += faceNorm;
+			vertexNormals[ face[ 1 ] ] += faceNorm;
+			vertexNormals[ face[ 2 ] ] += faceNorm;
 		}
-		// We may have more than one normal per vertex, so here we merge them
-		std::vector< glm::vec3 > vertexNormals;
-		vertexNormals.resize( vertices.size() );
-		for ( unsigned int vli = 0; vli < vertexNormalList.size(); vli++ ){
-			glm::vec3 nSum( 0.0f, 0.0f, 0.0f );
-			for ( auto fn : vertexNormalList[ vli ] ){
-				nSum += fn;
-			}
-			//nSum = nSum / (float)vertexNormalList[vli].size();
-			vertexNormals[ vli ] = glm::normalize( nSum );
+		for ( auto &n : vertexNormals ){
+			n = glm::normalize( n );
 		}
 
-
 		return vertexNormals;
 	}
 
 	ChunkData 
 	TerrainGenerator::GenerateChunk( int GridX, int GridZ,
-									 const MeshData &meshData ) {
-		auto Heights = GenerateHeights( meshData.MeshSize,
-										meshData.DivisionCount, GridX, GridZ );
-		auto Normals = GetSmoothNormals( meshData, Heights );
-		ChunkData data = { Heights, Normals };
+									 const MeshData &meshData,
+									 std::pmr::memory_resource *_Resource ) {
+		ChunkData data;
+		data.Heights = GenerateHeights( meshData.MeshSize,
+										meshData.DivisionCount, GridX, GridZ,
+										_Resource );
+		data.Normals = GetSmoothNormals( meshData, data.Heights, _Resource );
 		return data;
 	}
 	float TerrainGenerator::getHeight( int x, int z ) {
@@ -197,8 +191,27 @@ namespace GL_Engine {
 								const MeshData &meshData, 
 								int GridX, int GridZ ) {
 
+		// The generated data only lives until it is uploaded, so take it
+		// from a scratch buffer sized for it up front
+		const size_t vertexCount = meshData.Mesh.size();
+		std::pmr::monotonic_buffer_resource scratch(
+			vertexCount * ( sizeof( float ) + sizeof( glm::vec3 ) ) + 64 );
 		auto chunkData = TerrainGenerator::GenerateChunk( GridX, GridZ, 
-														  meshData );
+														  meshData, &scratch );
+		this->Upload( baseVBOs, meshData, GridX, GridZ, chunkData );
+	}
+
+	TerrainChunk::TerrainChunk( const MeshBaseVBOs & baseVBOs,
+								const MeshData &meshData,
+								int GridX, int GridZ,
+								ChunkData &_Data ) {
+		this->Upload( baseVBOs, meshData, GridX, GridZ, _Data );
+	}
+
+	void TerrainChunk::Upload( const MeshBaseVBOs & baseVBOs,
+							   const MeshData &meshData,
+							   int GridX, int GridZ,
+							   ChunkData &chunkData ) {
 		this->BindVAO();
 		baseVBOs.IndexVBO->BindVBO();
 		baseVBOs.MeshVBO->BindVBO();
@@ -208,7 +221,7 @@ namespace GL_Engine {
 		glEnableVertexAttribArray(2);	//UV always at index 2
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
 
-		auto Heights = chunkData.Heights;
+		auto &Heights = chunkData.Heights;
 		auto HeightVBO = std::make_unique<CG_Data::VBO>( 
 			&Heights[0], Heights.size() * sizeof( float ), GL_STATIC_DRAW );
 	
@@ -216,7 +229,14 @@ namespace GL_Engine {
 		glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 0, nullptr);
 		this->AddVBO(std::move(HeightVBO));
 
-		auto Normals = chunkData.Normals;
+		//Chunk spans [0, MeshSize] in x and z, before its translation
+		auto heightRange = std::minmax_element(Heights.begin(), Heights.end());
+		this->SetBounds(BoundingVolume::fromBox(
+			glm::vec3(0.0f, *heightRange.first, 0.0f),
+			glm::vec3((float)meshData.MeshSize, *heightRange.second,
+					  (float)meshData.MeshSize)));
+
+		auto &Normals = chunkData.Normals;
 		auto NormalVBO = std::make_unique< CG_Data::VBO >( 
 			&Normals[0], Normals.size() * sizeof( glm::vec3 ), GL_STATIC_DRAW );
 
@@ -240,7 +260,7 @@ namespace GL_Engine {
 													   this->DivisionCount );
 		meshData.DivisionCount = this->DivisionCount;
 		meshData.MeshSize = this->MeshSize;
-		glBindVertexArray(0);
+		CG_Data::StateCache::bindVertexArray(0);
 		baseVBOs.MeshVBO = std::make_shared<CG_Data::VBO>(
 			&meshData.Mesh[0], meshData.Mesh.size() * sizeof(glm::vec2), 
 			GL_STATIC_DRAW );
@@ -264,14 +284,58 @@ namespace GL_Engine {
 		return newChunk;
 	}
 
+	std::vector< std::shared_ptr< TerrainChunk > >
+	Terrain::GenerateChunks( const std::vector< glm::ivec2 > &_Grids ){
+		// Generation is pure CPU work, only the upload needs the GL thread
+		std::vector< ChunkData > chunkData( _Grids.size() );
+		JobSystem::get().parallelFor( 0, _Grids.size(), 1,
+			[ this, &_Grids, &chunkData ]( size_t _begin, size_t _end ){
+				for ( size_t i = _begin; i < _end; i++ ){
+					chunkData[ i ] = TerrainGenerator::GenerateChunk(
+						_Grids[ i ].x, _Grids[ i ].y, this->meshData );
+				}
+			} );
+
+		std::vector< std::shared_ptr< TerrainChunk > > chunks;
+		chunks.reserve( _Grids.size() );
+		for ( size_t i = 0; i < _Grids.size(); i++ ){
+			auto newChunk = std::make_shared< TerrainChunk >( 
+				this->baseVBOs, meshData, _Grids[ i ].x, _Grids[ i ].y,
+				chunkData[ i ] );
+			this->tPack.TerrainChunks.push_back( newChunk );
+			chunks.push_back( std::move( newChunk ) );
+		}
+		return chunks;
+	}
+
+	void Terrain::GenerateChunkAsync( int xGrid, int zGrid ){
+		auto &jobs = JobSystem::get();
+		jobs.schedule( [ this, &jobs, xGrid, zGrid ](){
+			auto chunkData = std::make_shared< ChunkData >(
+				TerrainGenerator::GenerateChunk( xGrid, zGrid, this->meshData ) );
+			jobs.runOnMainThread( [ this, chunkData, xGrid, zGrid ](){
+				this->tPack.TerrainChunks.push_back(
+					std::make_shared< TerrainChunk >( this->baseVBOs, meshData,
+													  xGrid, zGrid, *chunkData ) );
+			} );
+		} );
+	}
+
 	std::unique_ptr< RenderPass >
 	Terrain::GetRenderPass( Shader * _GroundShader, bool isProj ) {
 		auto renderPass = std::make_unique< RenderPass >();
-		renderPass->Data = static_cast< TerrainPack * >( &tPack );
+		auto data = std::make_unique< TerrainPassData >();
+		data->pack = &tPack;
+		data->translation = 
+			_GroundShader->getBinder< glm::mat4 >( "GroundTranslation" );
+		renderPass->Data = data.get();
+		this->passData.push_back( std::move( data ) );
 		if( !isProj ){
 			renderPass->renderFunction = &TerrainRenderer;
+			renderPass->name = "Terrain";
 		} else {
 			renderPass->renderFunction = &TerrainProjRenderer;
+			renderPass->name = "Terrain::projection";
 		}
 		GLsizei nCount = ( GLsizei ) meshData.Indices.size();
 
@@ -280,15 +344,15 @@ namespace GL_Engine {
 		};
 		
 		renderPass->SetDrawFunction(drawFunct);
+		renderPass->GatherBounds = &GatherChunkBounds;
 		renderPass->shader = _GroundShader;
-		tPack.translationUniformLocation =
-			_GroundShader->getUniform( "GroundTranslation" )->GetID();
 		return std::move( renderPass );
 	}
 
 
 	void Terrain::TerrainRenderer(RenderPass &Pass, void* _Data) {
-		auto chunks = static_cast<TerrainPack*>(_Data);
+		auto data = static_cast<TerrainPassData*>(_Data);
+		auto chunks = data->pack;
 
 		Pass.shader->useShader();
 		for (auto tex : Pass.Textures) {
@@ -296,32 +360,41 @@ namespace GL_Engine {
 		}
 		for( auto dLink : Pass.dataLink ){
 			dLink.uniform->SetData( chunks->terrainEntity.GetData( 
-										dLink.eDataIndex ) );
+										dLink.source ) );
 			dLink.uniform->Update();
 		}
-		auto translationUniformLocation =
-			Pass.shader->getUniform( "GroundTranslation" )->GetID();
 		chunks->terrainEntity.UpdateUniforms();
-		for (auto chunk : chunks->TerrainChunks) {
-			glUniformMatrix4fv( translationUniformLocation, 1, 
-							    GL_FALSE, 
-								glm::value_ptr( chunk->Translation ) );
+		for (size_t i = 0; i < chunks->TerrainChunks.size(); i++) {
+			if (!Pass.IsVisible(i))
+				continue;
+			auto &chunk = chunks->TerrainChunks[i];
+			data->translation.set( chunk->Translation );
 			chunk->BindVAO();
 			Pass.DrawFunction();
 		}
 	}
 
+	bool Terrain::GatherChunkBounds( RenderPass &rPass, SphereList &_spheres ) {
+		auto chunks = static_cast< TerrainPassData* >( rPass.Data )->pack;
+		// Chunks are drawn offset within the terrain entity's model space
+		const glm::mat4 model = chunks->terrainEntity.GetTransformMatrix();
+		for ( auto &chunk : chunks->TerrainChunks ) {
+			_spheres.push( chunk->GetBounds().transformed( model * chunk->Translation ) );
+		}
+		return true;
+	}
+
 	void Terrain::TerrainProjRenderer( RenderPass &rPass, void* _data ) {
-		auto chunks = static_cast< TerrainPack* >( _data );
+		auto data = static_cast< TerrainPassData* >( _data );
+		auto chunks = data->pack;
 
 		rPass.shader->useShader();
-		auto translationUniformLocation =
-			rPass.shader->getUniform( "GroundTranslation" )->GetID();
 
-		for ( auto chunk : chunks->TerrainChunks ) {
-			glUniformMatrix4fv( translationUniformLocation, 1, 
-							    GL_FALSE, 
-								glm::value_ptr( chunk->Translation ) );
+		for ( size_t i = 0; i < chunks->TerrainChunks.size(); i++ ) {
+			if ( !rPass.IsVisible( i ) )
+				continue;
+			auto &chunk = chunks->TerrainChunks[ i ];
+			data->translation.set( chunk->Translation );
 			chunk->BindVAO();
 			rPass.DrawFunction();
 		}
@@ -0,0 +1,498 @@
+#include "TransformStore.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+#include <utility>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/quaternion.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#if defined( __SSE__ ) || defined( _M_X64 ) || \
+    ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#define CG_TRANSFORM_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace GL_Engine {
+
+    static_assert( TransformStore::ChunkSize % 64 == 0,
+                   "Chunks must hold whole dirty words" );
+
+    TransformStore::Chunk & TransformStore::chunk( Handle _handle ) const {
+        return *chunks[ _handle / ChunkSize ];
+    }
+
+    uint32_t TransformStore::lane( Handle _handle ){
+        return _handle % ChunkSize;
+    }
+
+    bool TransformStore::isLinked( const Chunk & _chunk, uint32_t _lane ){
+        return ( _chunk.linked[ _lane / 64 ] >> ( _lane % 64 ) ) & 1;
+    }
+
+    glm::mat4 & TransformStore::target( Chunk & _chunk, uint32_t _lane ){
+        return isLinked( _chunk, _lane ) ? _chunk.local[ _lane ] : _chunk.world[ _lane ];
+    }
+
+    TransformStore::Handle TransformStore::create(){
+        Handle handle;
+        if ( !freeHandles.empty() ){
+            handle = freeHandles.back();
+            freeHandles.pop_back();
+        }
+        else {
+            handle = next++;
+            if ( handle / ChunkSize >= chunks.size() ){
+                chunks.push_back( std::make_unique< Chunk >() );
+                dirtyCounts.push_back( 0 );
+            }
+        }
+
+        auto & c = chunk( handle );
+        const uint32_t l = lane( handle );
+        c.px[ l ] = c.py[ l ] = c.pz[ l ] = 0.0f;
+        c.qx[ l ] = c.qy[ l ] = c.qz[ l ] = 0.0f;
+        c.qw[ l ] = 1.0f;
+        c.sx[ l ] = c.sy[ l ] = c.sz[ l ] = 1.0f;
+        c.world[ l ] = glm::mat4( 1.0f );
+        c.parent[ l ] = InvalidHandle;
+        c.children[ l ] = 0;
+        c.offset[ l ] = nullptr;
+        statistics.transforms++;
+        return handle;
+    }
+
+    void TransformStore::destroy( Handle _handle ){
+        if ( _handle == InvalidHandle ){
+            return;
+        }
+        auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        // Children become roots, keeping their local transform
+        for ( Handle child = 0; c.children[ l ] > 0 && child < next; child++ ){
+            if ( chunk( child ).parent[ lane( child ) ] == _handle ){
+                setParent( child, InvalidHandle );
+            }
+        }
+        setParent( _handle, InvalidHandle );
+        uint64_t & word = c.dirty[ l / 64 ];
+        const uint64_t bit = uint64_t( 1 ) << ( l % 64 );
+        if ( word & bit ){
+            word &= ~bit;
+            dirtyCounts[ _handle / ChunkSize ]--;
+        }
+        freeHandles.push_back( _handle );
+        statistics.transforms--;
+    }
+
+    void TransformStore::setPosition( Handle _handle, const glm::vec3 & _position ){
+        auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        c.px[ l ] = _position.x;
+        c.py[ l ] = _position.y;
+        c.pz[ l ] = _position.z;
+        markDirty( _handle );
+    }
+
+    void TransformStore::setOrientation( Handle _handle, const glm::quat & _orientation ){
+        auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        c.qx[ l ] = _orientation.x;
+        c.qy[ l ] = _orientation.y;
+        c.qz[ l ] = _orientation.z;
+        c.qw[ l ] = _orientation.w;
+        markDirty( _handle );
+    }
+
+    void TransformStore::setScale( Handle _handle, const glm::vec3 & _scale ){
+        auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        c.sx[ l ] = _scale.x;
+        c.sy[ l ] = _scale.y;
+        c.sz[ l ] = _scale.z;
+        markDirty( _handle );
+    }
+
+    glm::vec3 TransformStore::getPosition( Handle _handle ) const {
+        const auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        return glm::vec3( c.px[ l ], c.py[ l ], c.pz[ l ] );
+    }
+
+    glm::quat TransformStore::getOrientation( Handle _handle ) const {
+        const auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        glm::quat orientation;
+        orientation.x = c.qx[ l ];
+        orientation.y = c.qy[ l ];
+        orientation.z = c.qz[ l ];
+        orientation.w = c.qw[ l ];
+        return orientation;
+    }
+
+    glm::vec3 TransformStore::getScale( Handle _handle ) const {
+        const auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        return glm::vec3( c.sx[ l ], c.sy[ l ], c.sz[ l ] );
+    }
+
+    bool TransformStore::isDirty( Handle _handle ) const {
+        const auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        return ( c.dirty[ l / 64 ] >> ( l % 64 ) ) & 1;
+    }
+
+    void TransformStore::markDirty( Handle _handle ){
+        auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        uint64_t & word = c.dirty[ l / 64 ];
+        const uint64_t bit = uint64_t( 1 ) << ( l % 64 );
+        if ( !( word & bit ) ){
+            word |= bit;
+            dirtyCounts[ _handle / ChunkSize ]++;
+        }
+    }
+
+    void TransformStore::setParent( Handle _handle, Handle _parent,
+                                    const glm::mat4 * _parentOffset ){
+        for ( Handle ancestor = _parent; ancestor != InvalidHandle;
+              ancestor = getParent( ancestor ) ){
+            if ( ancestor == _handle ){
+                throw std::runtime_error( "Transform parent would form a cycle" );
+            }
+        }
+        auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        const Handle previous = c.parent[ l ];
+        if ( previous == _parent && c.offset[ l ] == _parentOffset ){
+            return;
+        }
+        c.parent[ l ] = _parent;
+        c.offset[ l ] = _parentOffset;
+        if ( previous != _parent ){
+            if ( previous != InvalidHandle ){
+                chunk( previous ).children[ lane( previous ) ]--;
+                updateLinked( previous );
+            }
+            if ( _parent != InvalidHandle ){
+                chunk( _parent ).children[ lane( _parent ) ]++;
+                updateLinked( _parent );
+            }
+        }
+        updateLinked( _handle );
+        markDirty( _handle );
+        hierarchyDirty = true;
+    }
+
+    TransformStore::Handle TransformStore::getParent( Handle _handle ) const {
+        return chunk( _handle ).parent[ lane( _handle ) ];
+    }
+
+    void TransformStore::updateLinked( Handle _handle ){
+        auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        const bool linked = c.parent[ l ] != InvalidHandle || c.children[ l ] > 0 ||
+                            c.offset[ l ] != nullptr;
+        if ( linked == isLinked( c, l ) ){
+            return;
+        }
+        const uint64_t bit = uint64_t( 1 ) << ( l % 64 );
+        if ( linked ){
+            c.linked[ l / 64 ] |= bit;
+        }
+        else {
+            c.linked[ l / 64 ] &= ~bit;
+            c.changed[ l / 64 ] &= ~bit;
+        }
+        // The matrix now belongs in the other slot
+        markDirty( _handle );
+        hierarchyDirty = true;
+    }
+
+    glm::mat4 & TransformStore::getMatrix( Handle _handle ){
+        return chunk( _handle ).world[ lane( _handle ) ];
+    }
+
+    const glm::mat4 & TransformStore::getMatrix( Handle _handle ) const {
+        return chunk( _handle ).world[ lane( _handle ) ];
+    }
+
+    glm::mat4 TransformStore::getLocalMatrix( Handle _handle ) const {
+        const glm::mat4 rotation = glm::toMat4( getOrientation( _handle ) );
+        return glm::translate( glm::mat4( 1.0f ), getPosition( _handle ) ) *
+               glm::inverse( rotation ) * glm::scale( glm::mat4( 1.0f ), getScale( _handle ) );
+    }
+
+    void TransformStore::buildMatrix( Chunk & _chunk, uint32_t _lane ){
+        // T * inverse( R ) * S. R is a rotation, so its inverse is the
+        // rotation of the conjugate quaternion
+        const float x = _chunk.qx[ _lane ], y = _chunk.qy[ _lane ];
+        const float z = _chunk.qz[ _lane ], w = _chunk.qw[ _lane ];
+        const float sx = _chunk.sx[ _lane ], sy = _chunk.sy[ _lane ];
+        const float sz = _chunk.sz[ _lane ];
+        const float xx = x * x, yy = y * y, zz = z * z;
+        const float xy = x * y, xz = x * z, yz = y * z;
+        const float wx = w * x, wy = w * y, wz = w * z;
+
+        auto & m = target( _chunk, _lane );
+        m[ 0 ] = glm::vec4( 1.0f - 2.0f * ( yy + zz ), 2.0f * ( xy - wz ),
+                            2.0f * ( xz + wy ), 0.0f ) * sx;
+        m[ 1 ] = glm::vec4( 2.0f * ( xy + wz ), 1.0f - 2.0f * ( xx + zz ),
+                            2.0f * ( yz - wx ), 0.0f ) * sy;
+        m[ 2 ] = glm::vec4( 2.0f * ( xz - wy ), 2.0f * ( yz + wx ),
+                            1.0f - 2.0f * ( xx + yy ), 0.0f ) * sz;
+        m[ 3 ] = glm::vec4( _chunk.px[ _lane ], _chunk.py[ _lane ],
+                            _chunk.pz[ _lane ], 1.0f );
+    }
+
+    void TransformStore::buildMatrices( Chunk & _chunk, uint32_t _first, uint32_t _mask ){
+#ifdef CG_TRANSFORM_SSE
+        // Lane i of each register belongs to transform _first + i. Columns
+        // are built component-wise, then transposed into one matrix column
+        // per transform
+        const __m128 x = _mm_load_ps( _chunk.qx + _first );
+        const __m128 y = _mm_load_ps( _chunk.qy + _first );
+        const __m128 z = _mm_load_ps( _chunk.qz + _first );
+        const __m128 w = _mm_load_ps( _chunk.qw + _first );
+        const __m128 one = _mm_set1_ps( 1.0f );
+        const __m128 two = _mm_set1_ps( 2.0f );
+
+        const __m128 x2 = _mm_mul_ps( x, two );
+        const __m128 y2 = _mm_mul_ps( y, two );
+        const __m128 z2 = _mm_mul_ps( z, two );
+        const __m128 xx = _mm_mul_ps( x, x2 ), yy = _mm_mul_ps( y, y2 );
+        const __m128 zz = _mm_mul_ps( z, z2 );
+        const __m128 xy = _mm_mul_ps( x, y2 ), xz = _mm_mul_ps( x, z2 );
+        const __m128 yz = _mm_mul_ps( y, z2 );
+        const __m128 wx = _mm_mul_ps( w, x2 ), wy = _mm_mul_ps( w, y2 );
+        const __m128 wz = _mm_mul_ps( w, z2 );
+
+        const __m128 sx = _mm_load_ps( _chunk.sx + _first );
+        const __m128 sy = _mm_load_ps( _chunk.sy + _first );
+        const __m128 sz = _mm_load_ps( _chunk.sz + _first );
+
+        __m128 c0x = _mm_mul_ps( _mm_sub_ps( one, _mm_add_ps( yy, zz ) ), sx );
+        __m128 c0y = _mm_mul_ps( _mm_sub_ps( xy, wz ), sx );
+        __m128 c0z = _mm_mul_ps( _mm_add_ps( xz, wy ), sx );
+        __m128 c1x = _mm_mul_ps( _mm_add_ps( xy, wz ), sy );
+        __m128 c1y = _mm_mul_ps( _mm_sub_ps( one, _mm_add_ps( xx, zz ) ), sy );
+        __m128 c1z = _mm_mul_ps( _mm_sub_ps( yz, wx ), sy );
+        __m128 c2x = _mm_mul_ps( _mm_sub_ps( xz, wy ), sz );
+        __m128 c2y = _mm_mul_ps( _mm_add_ps( yz, wx ), sz );
+        __m128 c2z = _mm_mul_ps( _mm_sub_ps( one, _mm_add_ps( xx, yy ) ), sz );
+        __m128 c3x = _mm_load_ps( _chunk.px + _first );
+        __m128 c3y = _mm_load_ps( _chunk.py + _first );
+        __m128 c3z = _mm_load_ps( _chunk.pz + _first );
+        __m128 c0w = _mm_setzero_ps(), c1w = _mm_setzero_ps();
+        __m128 c2w = _mm_setzero_ps(), c3w = one;
+
+        _MM_TRANSPOSE4_PS( c0x, c0y, c0z, c0w );
+        _MM_TRANSPOSE4_PS( c1x, c1y, c1z, c1w );
+        _MM_TRANSPOSE4_PS( c2x, c2y, c2z, c2w );
+        _MM_TRANSPOSE4_PS( c3x, c3y, c3z, c3w );
+        const __m128 columns[ 4 ][ 4 ] = { { c0x, c1x, c2x, c3x },
+                                           { c0y, c1y, c2y, c3y },
+                                           { c0z, c1z, c2z, c3z },
+                                           { c0w, c1w, c2w, c3w } };
+        for ( uint32_t i = 0; i < 4; i++ ){
+            if ( !( _mask & ( 1u << i ) ) ){
+                continue;
+            }
+            float * m = &target( _chunk, _first + i )[ 0 ][ 0 ];
+            _mm_storeu_ps( m, columns[ i ][ 0 ] );
+            _mm_storeu_ps( m + 4, columns[ i ][ 1 ] );
+            _mm_storeu_ps( m + 8, columns[ i ][ 2 ] );
+            _mm_storeu_ps( m + 12, columns[ i ][ 3 ] );
+        }
+#else
+        for ( uint32_t i = 0; i < 4; i++ ){
+            if ( _mask & ( 1u << i ) ){
+                buildMatrix( _chunk, _first + i );
+            }
+        }
+#endif
+    }
+
+    void TransformStore::rebuild( Handle _handle ){
+        auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        uint64_t & word = c.dirty[ l / 64 ];
+        const uint64_t bit = uint64_t( 1 ) << ( l % 64 );
+        if ( word & bit ){
+            buildMatrix( c, l );
+            word &= ~bit;
+            dirtyCounts[ _handle / ChunkSize ]--;
+            // Descendants are left to the next propagation
+            c.changed[ l / 64 ] |= c.linked[ l / 64 ] & bit;
+            if ( !isLinked( c, l ) ){
+                moved.push_back( _handle );
+            }
+        }
+    }
+
+    void TransformStore::update( Handle _handle ){
+        rebuild( _handle );
+        auto & c = chunk( _handle );
+        const uint32_t l = lane( _handle );
+        if ( !isLinked( c, l ) ){
+            return;
+        }
+        glm::mat4 parentMatrix( 1.0f );
+        if ( c.parent[ l ] != InvalidHandle ){
+            update( c.parent[ l ] );
+            parentMatrix = getMatrix( c.parent[ l ] );
+        }
+        if ( c.offset[ l ] ){
+            parentMatrix = parentMatrix * *c.offset[ l ];
+        }
+        c.world[ l ] = parentMatrix * c.local[ l ];
+        moved.push_back( _handle );
+    }
+
+    void TransformStore::update(){
+        statistics.rebuilt = 0;
+        statistics.lanesComputed = 0;
+        for ( size_t i = 0; i < chunks.size(); i++ ){
+            if ( dirtyCounts[ i ] == 0 ){
+                continue;
+            }
+            auto & c = *chunks[ i ];
+            for ( uint32_t w = 0; w < ChunkSize / 64; w++ ){
+                uint64_t word = c.dirty[ w ];
+                if ( word == 0 ){
+                    continue;
+                }
+                // One group of four lanes per nibble of the dirty word
+                for ( uint32_t group = 0; word != 0; group += 4, word >>= 4 ){
+                    const uint32_t mask = static_cast< uint32_t >( word & 0xF );
+                    if ( mask == 0 ){
+                        continue;
+                    }
+                    buildMatrices( c, w * 64 + group, mask );
+                    statistics.lanesComputed += 4;
+                }
+                c.changed[ w ] |= c.dirty[ w ] & c.linked[ w ];
+                // Linked lanes are recorded once propagated
+                for ( uint64_t bits = c.dirty[ w ] & ~c.linked[ w ]; bits != 0;
+                      bits &= bits - 1 ){
+                    moved.push_back( static_cast< Handle >(
+                        i * ChunkSize + w * 64 + std::countr_zero( bits ) ) );
+                }
+                c.dirty[ w ] = 0;
+            }
+            statistics.rebuilt += dirtyCounts[ i ];
+            dirtyCounts[ i ] = 0;
+        }
+        propagate();
+    }
+
+    void TransformStore::buildHierarchy(){
+        nodes.clear();
+        levelOffsets.clear();
+        // Depth of every linked transform, found by walking up to its root
+        std::vector< uint32_t > depths( next, NoParent );
+        std::vector< uint32_t > levelSizes;
+        std::vector< Handle > linked;
+        for ( size_t i = 0; i < chunks.size(); i++ ){
+            const auto & c = *chunks[ i ];
+            for ( uint32_t l = 0; l < ChunkSize; l++ ){
+                if ( !isLinked( c, l ) ){
+                    continue;
+                }
+                const Handle handle = static_cast< Handle >( i * ChunkSize + l );
+                uint32_t depth = 0;
+                for ( Handle h = c.parent[ l ]; h != InvalidHandle; h = getParent( h ) ){
+                    if ( depths[ h ] != NoParent ){
+                        depth += depths[ h ] + 1;
+                        break;
+                    }
+                    depth++;
+                }
+                depths[ handle ] = depth;
+                if ( depth >= levelSizes.size() ){
+                    levelSizes.resize( depth + 1, 0 );
+                }
+                levelSizes[ depth ]++;
+                linked.push_back( handle );
+            }
+        }
+
+        // Counting sort by depth, so every parent precedes its children
+        levelOffsets.resize( levelSizes.size() + 1, 0 );
+        for ( size_t d = 0; d < levelSizes.size(); d++ ){
+            levelOffsets[ d + 1 ] = levelOffsets[ d ] + levelSizes[ d ];
+        }
+        std::vector< uint32_t > cursors( levelOffsets.begin(), levelOffsets.end() - 1 );
+        std::vector< uint32_t > nodeIndices( next, NoParent );
+        nodes.resize( linked.size() );
+        for ( Handle handle : linked ){
+            const uint32_t index = cursors[ depths[ handle ] ]++;
+            nodes[ index ].handle = handle;
+            nodeIndices[ handle ] = index;
+        }
+        for ( auto & node : nodes ){
+            const Handle parent = getParent( node.handle );
+            node.parent = parent == InvalidHandle ? NoParent : nodeIndices[ parent ];
+        }
+        nodeChanged.assign( nodes.size(), 0 );
+
+        statistics.hierarchyNodes = static_cast< uint32_t >( nodes.size() );
+        statistics.hierarchyLevels = static_cast< uint32_t >( levelSizes.size() );
+        hierarchyDirty = false;
+    }
+
+    void TransformStore::propagate(){
+        statistics.propagated = 0;
+        if ( hierarchyDirty ){
+            buildHierarchy();
+        }
+        // Parents are a level up, so each level reads only results of the
+        // one before
+        for ( size_t d = 0; d + 1 < levelOffsets.size(); d++ ){
+            for ( uint32_t i = levelOffsets[ d ]; i < levelOffsets[ d + 1 ]; i++ ){
+                const Node & node = nodes[ i ];
+                auto & c = chunk( node.handle );
+                const uint32_t l = lane( node.handle );
+                const bool changed = ( ( c.changed[ l / 64 ] >> ( l % 64 ) ) & 1 ) ||
+                                     c.offset[ l ] != nullptr ||
+                                     ( node.parent != NoParent && nodeChanged[ node.parent ] );
+                nodeChanged[ i ] = changed;
+                if ( !changed ){
+                    continue;
+                }
+                if ( node.parent != NoParent ){
+                    const glm::mat4 & parent = getMatrix( nodes[ node.parent ].handle );
+                    c.world[ l ] = c.offset[ l ] ? parent * *c.offset[ l ] * c.local[ l ]
+                                                 : parent * c.local[ l ];
+                }
+                else {
+                    c.world[ l ] = c.offset[ l ] ? *c.offset[ l ] * c.local[ l ] : c.local[ l ];
+                }
+                moved.push_back( node.handle );
+                statistics.propagated++;
+            }
+        }
+        for ( auto & c : chunks ){
+            std::fill( std::begin( c->changed ), std::end( c->changed ), 0 );
+        }
+    }
+
+    const std::vector< TransformStore::Handle > & TransformStore::getMoved() const {
+        return this->moved;
+    }
+
+    void TransformStore::takeMoved( std::vector< Handle > & _out ){
+        _out.clear();
+        std::swap( _out, this->moved );
+    }
+
+    const TransformStore::Statistics & TransformStore::getStatistics() const {
+        return this->statistics;
+    }
+
+    TransformStore & TransformStore::get(){
+        static TransformStore store;
+        return store;
+    }
+
+}
@@ -1,5 +1,8 @@
 #include "Water.h"
 #include "ModelLoader.h"
+#include "GLState.h"
+#include "FrameArena.h"
+#include "Profiler.h"
 
 namespace GL_Engine{
 
@@ -14,6 +17,13 @@ Water::Water( uint16_t _fbWidth, uint16_t _fbHeight,
     this->sceneCamera = _sceneCamera;
     this->renderers = _renderers;
     this->waterVao = _waterData;
+    // The reflection and refraction passes render through the scene camera,
+    // so cull against it. Each Render culls against the camera as it is at
+    // the time, i.e. the reflected camera for the reflection pass
+    for( auto & renderer : this->renderers ){
+        if( !renderer->GetCullingCamera() )
+            renderer->SetCullingCamera( this->sceneCamera.get() );
+    }
     auto cameraUbo = sceneCamera->getCameraUbo();
 
     /* Create Shader */
@@ -35,25 +45,11 @@ Water::Water( uint16_t _fbWidth, uint16_t _fbHeight,
 	waterShader->registerTextureUnit( "dudvMap", 2 );
 	waterShader->registerUBO( std::string( "cameraProjectionData" ),
                               cameraUbo );
-	waterShader->registerUniform( "time" );
-    waterShader->registerUniform( "modelMatrix" );
+	auto waterTimeUniform = waterShader->registerUniform< float >( "time" );
+    auto waterModelUniform =
+        waterShader->registerUniform< glm::mat4 >( "modelMatrix" );
 	waterShader->compileShader();
 
-    auto matrixUniformUpdateLambda = []( const CG_Data::Uniform & u ){
-        glUniformMatrix4fv( u.GetID(), 1, GL_FALSE, 
-                            static_cast< const GLfloat * >( u.GetData() ) );
-    };
-    auto floatUniformUpdateLambda = []( const CG_Data::Uniform & u ){
-        glUniform1f( u.GetID(),
-                     *static_cast< const GLfloat * >( u.GetData() ) );
-    };
-
-    auto waterModelUniform = waterShader->getUniform( "modelMatrix" );
-    waterModelUniform->SetUpdateCallback( matrixUniformUpdateLambda );
-
-    auto waterTimeUniform = waterShader->getUniform( "time" );
-    waterTimeUniform->SetUpdateCallback( floatUniformUpdateLambda );
-
 
 
     /* Create FBO */
@@ -81,6 +77,7 @@ Water::Water( uint16_t _fbWidth, uint16_t _fbHeight,
 
     /* Set up render pass */
     this->waterRenderPass = std::make_shared< RenderPass >();
+    waterRenderPass->name = "Water";
 	waterRenderPass->renderFunction = defaultWaterRenderer;
 	waterRenderPass->Data = this;
 	waterRenderPass->shader = this->waterShader.get();
@@ -96,25 +93,51 @@ Water::Water( uint16_t _fbWidth, uint16_t _fbHeight,
 	//waterRenderPass->AddDataLink( WaterTimeUniform, waterTimeIndex );
 	waterRenderPass->AddBatchUnit( this );
 
-    auto waterModelMatrixIdx = this->AddData( 
-    ( void * ) glm::value_ptr( this->TransformMatrix ) );
     waterRenderPass->AddDataLink( waterModelUniform.get(),
-                                  waterModelMatrixIdx );
+                                  DataSource::WorldMatrix() );
 
-    auto waterTimeMatrixIdx = this->AddData( ( void * ) &this->time );
+    this->AddComponent< WaterPlane >();
     waterRenderPass->AddDataLink( waterTimeUniform.get(),
-                                  waterTimeMatrixIdx );
+                                  DataSource::Member< &WaterPlane::time >() );
 
     waterObjects.push_back( this );
 
     waterStopwatch.Initialise();
-    time = 0.0f;
 }
 
 std::shared_ptr< RenderPass > Water::getRenderPass(){
     return this->waterRenderPass;
 }
 
+void Water::addPasses( RenderGraph & _graph ){
+    // The surface is not drawn, so neither texture is needed
+    if( !this->isActive() )
+        return;
+    auto reflection = _graph.importTexture( "WaterReflection", this->reflTex );
+    auto refraction = _graph.importTexture( "WaterRefraction", this->refrTex );
+    _graph.addPass( "WaterReflection",
+        [ & ]( RenderGraph::PassBuilder & _builder ){
+            _builder.write( reflection );
+            _builder.setFramebuffer( *this->waterFbo, 0 );
+        },
+        [ this ]( const RenderGraph & ){
+            this->renderScene( true );
+            this->reflectionRendered = true;
+        } );
+    _graph.addPass( "WaterRefraction",
+        [ & ]( RenderGraph::PassBuilder & _builder ){
+            _builder.write( refraction );
+            _builder.setFramebuffer( *this->waterFbo, 1 );
+        },
+        [ this ]( const RenderGraph & ){
+            this->renderScene( false );
+            this->refractionRendered = true;
+        } );
+    // Sampled by the water pass, drawn after the graph
+    _graph.markOutput( reflection );
+    _graph.markOutput( refraction );
+}
+
 void Water::cleanup(){
     waterShader->cleanup();
     waterFbo->cleanup();
@@ -137,68 +160,78 @@ void Water::defaultWaterRenderer( RenderPass & _rPass, void * _data ){
     auto that = ( Water * ) _data;
     if( !that->isActive() )
         return;
-    auto camera = that->sceneCamera;
+
+    auto frameTimeMicros = that->waterStopwatch.MeasureTime().count();
+    that->GetComponent< WaterPlane >()->time +=
+        static_cast<float>( frameTimeMicros ) / 1.0e6f;
+
+    // Render here whichever texture no render graph pass did this frame
+    if( !that->reflectionRendered ){
+        auto bindToken = that->waterFbo->bind( 0 );
+        that->renderScene( true );
+    }
+    if( !that->refractionRendered ){
+        auto bindToken = that->waterFbo->bind( 1 );
+        that->renderScene( false );
+    }
+    that->reflectionRendered = false;
+    that->refractionRendered = false;
+
+    that->waterShader->useShader();
+	that->waterVao->BindVAO();
+    that->reflTex->Bind();
+    that->refrTex->Bind();
+    that->dudvTexture->Bind();
+    for( auto dLink : _rPass.dataLink ){
+        dLink.uniform->SetData( that->GetData( dLink.source ) );
+        dLink.uniform->Update();
+    }
+    that->UpdateUniforms();
+    that->update();
+    _rPass.DrawFunction();
+    
+}
+
+void Water::renderScene( bool _reflect ){
+    CG_PROFILE_SCOPE( _reflect ? "Water::reflection" : "Water::refraction" );
+    auto camera = this->sceneCamera;
     auto camUbo = const_cast< CameraUboData * >( camera->getCameraUboData() );
-    std::vector< bool > waterState;
+    FrameVector< bool > waterState( &FrameArena::get() );
     waterState.reserve( waterObjects.size() );
     for( auto waterObj : waterObjects ){
         waterState.push_back( waterObj->isActive() );
         waterObj->Deactivate();
     }
 
-    auto frameTimeMicros = that->waterStopwatch.MeasureTime().count();
-    that->time += static_cast<float>( frameTimeMicros ) / 1.0e6f;
-
-
-    that->Deactivate();
-    
-    glEnable ( GL_CLIP_DISTANCE0 );
+    // Clip away everything on the other side of the water from the
+    // texture's point of view
+    const float side = camera->getCameraPosition().y < 0 ? -1.0f : 1.0f;
+    CG_Data::StateCache::enable( GL_CLIP_DISTANCE0 );
     camUbo->clippingPlane[ 0 ] = 0;
-    camUbo->clippingPlane[ 1 ] = camera->getCameraPosition().y < 0 ? -1.0f : 1.0f;
+    camUbo->clippingPlane[ 1 ] = _reflect ? side : -side;
     camUbo->clippingPlane[ 2 ] = 0;
     camUbo->clippingPlane[ 3 ] = 0;
-    
-    // Reflect pass
-    camera->reflectCamera();
+
+    if( _reflect )
+        camera->reflectCamera();
     camera->update();
-    
-    auto bindToken = that->waterFbo->bind( 0 );
-    for( auto & renderer : that->renderers ){
+
+    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+    for( auto & renderer : this->renderers ){
         renderer->Render();
     }
-    camera->reflectCamera();
 
-    // Refract pass
-    camUbo->clippingPlane[ 1 ] *= -1;
-    camera->update();
-    bindToken = that->waterFbo->bind( 1 );
-    for( auto &renderer : that->renderers ){
-        renderer->Render();
+    if( _reflect ){
+        camera->reflectCamera();
+        camera->update();
     }
 
     for( size_t i = 0; i < waterObjects.size(); i++ ){
         if( waterState[ i ] )
             waterObjects[ i ]->Activate();
     }
-
-    std::move( bindToken ).unbind();
     camUbo->clippingPlane[ 1 ] = 1000;
-    glDisable( GL_CLIP_DISTANCE0 );
-    that->Activate();
-
-    that->waterShader->useShader();
-	that->waterVao->BindVAO();
-    that->reflTex->Bind();
-    that->refrTex->Bind();
-    that->dudvTexture->Bind();
-    for( auto dLink : _rPass.dataLink ){
-        dLink.uniform->SetData( that->GetData( dLink.eDataIndex ) );
-        dLink.uniform->Update();
-    }
-    that->UpdateUniforms();
-    that->update();
-    _rPass.DrawFunction();
-    
+    CG_Data::StateCache::disable( GL_CLIP_DISTANCE0 );
 }
 
 
@@ -11,7 +11,12 @@ layout (std140) uniform CameraProjectionData{
 };
 in vec3 vPosition;
 in vec3 vNormal;
+#ifdef INSTANCED
+in mat4 instanceMatrix;
+#define modelMatrix instanceMatrix
+#else
 uniform mat4 modelMatrix;
+#endif
 uniform sampler2D receiverTex;
 uniform uint surfaceArea;
 out vec4 outCol;
@@ -0,0 +1,131 @@
+#include "TestCheck.h"
+#include "AnimationSampler.h"
+#include <vector>
+
+using namespace GL_Engine;
+
+namespace {
+
+    // Largest error of a compressed track at the source keys and across
+    // the clip
+    template< typename T >
+    float measure( const KeyTrack< T > & _track, const KeyTimes & _times,
+                   const CompressedTrack< T > & _compressed, float _length ){
+        float error = 0.0f;
+        uint32_t sourceCursor = 0, cursor = 0;
+        auto check = [ & ]( float _time ){
+            float t;
+            const uint32_t key = _times.seek( _time, cursor, t );
+            error = std::max( error, keyError( _track.sample( _time, sourceCursor ),
+                                               _compressed.sample( key, t ) ) );
+        };
+        for ( float time : _track.getTimes() ){
+            check( time );
+        }
+        for ( int i = 0; i <= 1000; i++ ){
+            check( _length * i / 1000.0f );
+        }
+        return error;
+    }
+
+    // Tracks sharing key times each stay within their tolerance, and
+    // report the error they reach
+    void testSharedTimes(){
+        constexpr float Length = 100.0f;
+        KeyTrack< glm::vec3 > positions, scales;
+        KeyTrack< glm::quat > rotations;
+        for ( int i = 0; i <= 100; i++ ){
+            positions.addKey( float( i ), glm::vec3( std::sin( i * 0.1f ), std::cos( i * 0.05f ), i * 0.01f ) );
+            rotations.addKey( float( i ), glm::angleAxis( std::sin( i * 0.07f ), glm::vec3( 0.0f, 1.0f, 0.0f ) ) );
+        }
+        scales.addKey( 0.0f, glm::vec3( 1.0f ) );
+        scales.addKey( Length, glm::vec3( 1.0f ) );
+
+        KeyTimes times;
+        times.setGrid( Length, 101 );
+        const TrackEncoder< glm::vec3 > positionEncoder( positions, times, 1e-3f );
+        const TrackEncoder< glm::vec3 > scaleEncoder( scales, times, 1e-4f );
+        const TrackEncoder< glm::quat > rotationEncoder( rotations, times, 1e-3f );
+        CG_CHECK( scaleEncoder.isConstant() && !positionEncoder.isConstant() );
+        times.select( [ & ]( uint32_t _first, uint32_t _last ){
+            return positionEncoder.spans( _first, _last ) && scaleEncoder.spans( _first, _last ) &&
+                   rotationEncoder.spans( _first, _last );
+        } );
+        CG_CHECK( times.size() > 1 && times.size() < 101 );
+        CG_CHECK( times.getFrames().front() == 0 && times.getFrames().back() == 100 );
+
+        CompressedTrack< glm::vec3 > compressedPositions, compressedScales;
+        CompressedTrack< glm::quat > compressedRotations;
+        const float positionError = compressedPositions.encode( positionEncoder, times );
+        const float scaleError = compressedScales.encode( scaleEncoder, times );
+        const float rotationError = compressedRotations.encode( rotationEncoder, times );
+        CG_CHECK( compressedPositions.size() == times.size() );
+        CG_CHECK( compressedScales.size() == 1 );
+
+        CG_CHECK( positionError <= 1e-3f && scaleError <= 1e-4f && rotationError <= 1e-3f );
+        const float measuredPosition = measure( positions, times, compressedPositions, Length );
+        const float measuredRotation = measure( rotations, times, compressedRotations, Length );
+        CG_CHECK( measuredPosition <= positionError + 1e-6f );
+        CG_CHECK( measuredRotation <= rotationError + 1e-6f );
+        CG_CHECK( measure( scales, times, compressedScales, Length ) <= 1e-4f );
+    }
+
+    // A source key between the grid's frames cannot be restored; the
+    // error at it is reported rather than hidden
+    void testKeyBetweenFrames(){
+        KeyTrack< glm::vec3 > track;
+        track.addKey( 0.0f, glm::vec3( 0.0f ) );
+        track.addKey( 0.3f, glm::vec3( 1.0f, 0.0f, 0.0f ) );
+        track.addKey( 1.0f, glm::vec3( 0.0f ) );
+
+        KeyTimes times;
+        times.setGrid( 1.0, 4 );
+        const TrackEncoder< glm::vec3 > encoder( track, times, 1e-3f );
+        times.select( [ & ]( uint32_t _first, uint32_t _last ){
+            return encoder.spans( _first, _last );
+        } );
+        CompressedTrack< glm::vec3 > compressed;
+        const float error = compressed.encode( encoder, times );
+        CG_CHECK( error > 1e-3f );
+        // The frames either side of the key are kept, the grid's best,
+        // and the linear tail after it needs no more
+        CG_CHECK( ( times.getFrames() == std::vector< uint16_t >{ 0, 1, 3 } ) );
+        // The reported error is the one at the source key
+        CG_CHECK( std::abs( measure( track, times, compressed, 1.0f ) - error ) < 1e-5f );
+        CG_CHECK( encoder.spanError( 0, 1, FLT_MAX ) >= error - 1e-5f );
+    }
+
+    // Grids clamp to the addressable frames
+    void testClampedGrid(){
+        KeyTimes times;
+        times.setGrid( 10.0, KeyTimes::MaxFrames * 2 );
+        CG_CHECK( times.getFrameCount() == KeyTimes::MaxFrames );
+        times.setGrid( 0.0, 0 );
+        CG_CHECK( times.getFrameCount() == 1 && times.getFramesPerTime() == 0.0f );
+    }
+
+    // Quantised keys decode within their precision
+    void testQuantisation(){
+        std::vector< glm::vec3 > values{ glm::vec3( -5.0f, 0.0f, 2.0f ), glm::vec3( 5.0f, 1.0f, 2.0f ) };
+        const KeyRange range = keyRange( values );
+        glm::vec3 decoded;
+        unpackKey( packKey( glm::vec3( 1.234f, 0.5f, 2.0f ), range ), range, decoded );
+        CG_CHECK( glm::length( decoded - glm::vec3( 1.234f, 0.5f, 2.0f ) ) < 1e-3f );
+
+        for ( float angle = -3.0f; angle <= 3.0f; angle += 0.37f ){
+            const glm::quat rotation = glm::angleAxis( angle, glm::normalize( glm::vec3( 0.3f, -0.8f, 0.5f ) ) );
+            glm::quat unpacked;
+            unpackKey( packKey( rotation, KeyRange() ), KeyRange(), unpacked );
+            CG_CHECK( keyError( rotation, unpacked ) < 1e-3f );
+        }
+    }
+
+}
+
+int main(){
+    testSharedTimes();
+    testKeyBetweenFrames();
+    testClampedGrid();
+    testQuantisation();
+    return CG_TEST_RESULT();
+}
@@ -0,0 +1,70 @@
+#include "TestCheck.h"
+#include "BlendTree.h"
+#include "Skeleton.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <stdexcept>
+#include <vector>
+
+using namespace GL_Engine;
+
+namespace {
+
+    // Inputs must be nodes already added
+    void testValidation(){
+        BlendTree tree;
+        // Not yet added, including the node itself
+        CG_CHECK_THROWS( tree.addBlend( 0, 0 ), std::runtime_error );
+        CG_CHECK( tree.size() == 0 );
+
+        const auto walk = tree.addClip( 0 );
+        const auto run = tree.addClip( 1 );
+        const auto blend = tree.addBlend( walk, run, 0.5f );
+        CG_CHECK( blend == 2 && tree.size() == 3 );
+        CG_CHECK_THROWS( tree.addBlend( walk, 3 ), std::runtime_error );
+        CG_CHECK_THROWS( tree.addBlend( 100, walk ), std::runtime_error );
+
+        // Additive inputs must be clips
+        CG_CHECK_THROWS( tree.addAdditive( walk, blend ), std::runtime_error );
+        CG_CHECK_THROWS( tree.addAdditive( walk, 7 ), std::runtime_error );
+        const auto additive = tree.addAdditive( blend, run );
+        CG_CHECK( additive == 3 );
+
+        // A failed layer leaves no node or mask behind
+        CG_CHECK_THROWS( tree.addLayer( additive, 9, { 1.0f } ), std::runtime_error );
+        CG_CHECK( tree.size() == 4 );
+        const auto layer = tree.addLayer( additive, walk, { 1.0f, 0.0f } );
+        CG_CHECK( layer == 4 && tree.size() == 5 );
+    }
+
+    // Clips the skeleton lacks pose as the bind pose
+    void testMissingClips(){
+        Skeleton skeleton;
+        const glm::vec3 rootPosition( 1.0f, 2.0f, 3.0f ), childPosition( 0.0f, 1.0f, 0.0f );
+        const glm::quat childRotation = glm::angleAxis( 0.5f, glm::vec3( 0.0f, 0.0f, 1.0f ) );
+        const uint32_t root = skeleton.addJoint( 0, Skeleton::NoJoint,
+                                                 glm::translate( glm::mat4( 1.0f ), rootPosition ) );
+        skeleton.addJoint( 1, root, glm::translate( glm::mat4( 1.0f ), childPosition ) *
+                                    glm::mat4_cast( childRotation ) *
+                                    glm::scale( glm::mat4( 1.0f ), glm::vec3( 2.0f ) ) );
+        CG_CHECK( skeleton.getClipCount() == 0 );
+        CG_CHECK( skeleton.getClipLength( 5 ) == 0.0 );
+
+        BlendTree tree;
+        tree.addBlend( tree.addClip( 5 ), tree.addClip( 6 ), 0.5f );
+        LocalPose pose;
+        PosePool pool;
+        CG_CHECK( tree.evaluate( skeleton, 1.0, 0, pose, pool ) == 0 );
+        CG_CHECK( pose.size() == 2 );
+        CG_CHECK( glm::length( pose.translations[ 0 ] - rootPosition ) < 1e-5f );
+        CG_CHECK( glm::length( pose.translations[ 1 ] - childPosition ) < 1e-5f );
+        CG_CHECK( keyError( pose.rotations[ 1 ], childRotation ) < 1e-4f );
+        CG_CHECK( glm::length( pose.scales[ 1 ] - glm::vec3( 2.0f ) ) < 1e-5f );
+    }
+
+}
+
+int main(){
+    testValidation();
+    testMissingClips();
+    return CG_TEST_RESULT();
+}
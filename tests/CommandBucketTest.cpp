@@ -0,0 +1,88 @@
+#include "TestCheck.h"
+#include "CommandBucket.h"
+#include "Entity.h"
+#include <memory>
+#include <vector>
+
+using namespace GL_Engine;
+
+namespace {
+
+    // Keys are ordered field by field, most significant first
+    void testKeyLayout(){
+        const uint64_t opaque = CommandBucket::makeKey( CommandBucket::Opaque, 0xFFF, 0xFFFF, 0xFFFF, 0xFFFF );
+        const uint64_t translucent = CommandBucket::makeKey( CommandBucket::Translucent, 0, 0, 0, 0 );
+        CG_CHECK( opaque < translucent );
+        CG_CHECK( CommandBucket::makeKey( 0, 1, 0xFFFF, 0, 0 ) < CommandBucket::makeKey( 0, 2, 0, 0, 0 ) );
+        CG_CHECK( CommandBucket::makeKey( 0, 0, 1, 0xFFFF, 0 ) < CommandBucket::makeKey( 0, 0, 2, 0, 0 ) );
+        CG_CHECK( CommandBucket::makeKey( 0, 0, 0, 1, 0xFFFF ) < CommandBucket::makeKey( 0, 0, 0, 2, 0 ) );
+        CG_CHECK( CommandBucket::makeKey( 0, 0, 0, 0, 1 ) < CommandBucket::makeKey( 0, 0, 0, 0, 2 ) );
+        // Fields wider than their bits are masked, not carried
+        CG_CHECK( CommandBucket::makeKey( 0, 0x1000, 0, 0, 0 ) == CommandBucket::makeKey( 0, 0, 0, 0, 0 ) );
+    }
+
+    // Sorted by key, passes with equal keys in submission order
+    void testSortOrder(){
+        constexpr size_t Count = 2000;
+        std::vector< std::unique_ptr< RenderPass > > passes;
+        CommandBucket bucket;
+        uint32_t random = 12345;
+        for ( size_t i = 0; i < Count; i++ ){
+            passes.push_back( std::make_unique< RenderPass >() );
+            random = random * 1664525u + 1013904223u;
+            // Few distinct values per field, so many keys are equal
+            const uint64_t key = CommandBucket::makeKey(
+                static_cast< uint8_t >( ( random >> 8 ) % 3 * 7 ), ( random >> 12 ) % 4,
+                static_cast< uint16_t >( ( random >> 16 ) % 3 ), ( random >> 20 ) % 2,
+                static_cast< uint16_t >( ( random >> 24 ) % 5 * 1000 ) );
+            bucket.submit( key, passes.back().get() );
+        }
+        bucket.sort();
+
+        const auto & commands = bucket.getCommands();
+        CG_CHECK( commands.size() == Count );
+        auto order = [ &passes ]( const RenderPass * _pass ){
+            for ( size_t i = 0; i < passes.size(); i++ ){
+                if ( passes[ i ].get() == _pass ){
+                    return i;
+                }
+            }
+            return passes.size();
+        };
+        for ( size_t i = 1; i < commands.size(); i++ ){
+            CG_CHECK( commands[ i - 1 ].key <= commands[ i ].key );
+            if ( commands[ i - 1 ].key == commands[ i ].key ){
+                CG_CHECK( order( commands[ i - 1 ].pass ) < order( commands[ i ].pass ) );
+            }
+        }
+    }
+
+    // Keys sharing every byte skip all scatter passes, keeping the order
+    void testEqualKeys(){
+        std::vector< std::unique_ptr< RenderPass > > passes;
+        CommandBucket bucket;
+        for ( size_t i = 0; i < 10; i++ ){
+            passes.push_back( std::make_unique< RenderPass >() );
+            bucket.submit( CommandBucket::makeKey( CommandBucket::Overlay, 3, 4, 5, 6 ), passes.back().get() );
+        }
+        bucket.sort();
+        for ( size_t i = 0; i < passes.size(); i++ ){
+            CG_CHECK( bucket.getCommands()[ i ].pass == passes[ i ].get() );
+        }
+
+        bucket.clear();
+        CG_CHECK( bucket.size() == 0 );
+        bucket.sort();
+        bucket.submit( 7, passes[ 0 ].get() );
+        bucket.sort();
+        CG_CHECK( bucket.size() == 1 && bucket.getCommands()[ 0 ].key == 7 );
+    }
+
+}
+
+int main(){
+    testKeyLayout();
+    testSortOrder();
+    testEqualKeys();
+    return CG_TEST_RESULT();
+}
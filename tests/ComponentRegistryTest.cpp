@@ -0,0 +1,100 @@
+#include "TestCheck.h"
+#include "ComponentRegistry.h"
+#include <algorithm>
+#include <vector>
+
+using namespace GL_Engine;
+
+namespace {
+
+    struct Health {
+        int value;
+    };
+    struct Speed {
+        float value;
+    };
+
+    // The dense arrays hold exactly the entities with a component, each
+    // reachable through the sparse array
+    void checkConsistent( const ComponentPool< Health > & _pool, std::vector< EntityId > _expected ){
+        std::vector< EntityId > entities = _pool.getEntities();
+        std::sort( entities.begin(), entities.end() );
+        std::sort( _expected.begin(), _expected.end() );
+        CG_CHECK( entities == _expected );
+        CG_CHECK( _pool.size() == _expected.size() );
+        for ( size_t i = 0; i < _pool.getEntities().size(); i++ ){
+            const EntityId entity = _pool.getEntities()[ i ];
+            CG_CHECK( _pool.has( entity ) );
+            CG_CHECK( _pool.tryGet( entity ) == _pool.data() + i );
+            CG_CHECK( _pool.data()[ i ].value == static_cast< int >( entity ) * 10 );
+        }
+    }
+
+    void testInsertErase(){
+        ComponentPool< Health > pool;
+        CG_CHECK( !pool.has( 0 ) && pool.tryGet( 3 ) == nullptr );
+
+        for ( EntityId entity : { 5u, 1u, 9u, 3u } ){
+            pool.emplace( entity, static_cast< int >( entity ) * 10 );
+        }
+        checkConsistent( pool, { 1, 3, 5, 9 } );
+        CG_CHECK( !pool.has( 2 ) && !pool.has( 100 ) );
+
+        // Erasing from the middle moves the last component into the gap
+        pool.remove( 1 );
+        checkConsistent( pool, { 3, 5, 9 } );
+        CG_CHECK( pool.getEntities()[ 1 ] == 3 );
+        // Erasing the last, and what is absent
+        pool.remove( 3 );
+        pool.remove( 3 );
+        pool.remove( 42 );
+        checkConsistent( pool, { 5, 9 } );
+
+        // Re-inserting, and replacing in place
+        pool.emplace( 1, 10 );
+        pool.emplace( 5, 50 );
+        checkConsistent( pool, { 1, 5, 9 } );
+
+        for ( EntityId entity : { 1u, 5u, 9u } ){
+            pool.remove( entity );
+        }
+        checkConsistent( pool, {} );
+    }
+
+    void testRegistry(){
+        ComponentRegistry registry;
+        for ( EntityId entity = 0; entity < 8; entity++ ){
+            registry.add< Health >( entity, static_cast< int >( entity ) );
+            if ( entity % 2 == 0 ){
+                registry.add< Speed >( entity, entity * 0.5f );
+            }
+        }
+        // Views visit the entities having every component
+        std::vector< EntityId > visited;
+        registry.view< Health, Speed >().each( [ & ]( EntityId _entity, Health & _health, Speed & _speed ){
+            CG_CHECK( _health.value == static_cast< int >( _entity ) );
+            CG_CHECK( _speed.value == _entity * 0.5f );
+            visited.push_back( _entity );
+        } );
+        std::sort( visited.begin(), visited.end() );
+        CG_CHECK( ( visited == std::vector< EntityId >{ 0, 2, 4, 6 } ) );
+
+        size_t healthy = 0;
+        registry.view< Health >().each( [ & ]( EntityId, Health & ){ healthy++; } );
+        CG_CHECK( healthy == 8 );
+
+        registry.copy( 2, 11 );
+        CG_CHECK( registry.has< Health >( 11 ) && registry.has< Speed >( 11 ) );
+        CG_CHECK( registry.tryGet< Health >( 11 )->value == 2 );
+        registry.destroy( 2 );
+        CG_CHECK( !registry.has< Health >( 2 ) && !registry.has< Speed >( 2 ) );
+        CG_CHECK( registry.has< Health >( 11 ) );
+    }
+
+}
+
+int main(){
+    testInsertErase();
+    testRegistry();
+    return CG_TEST_RESULT();
+}
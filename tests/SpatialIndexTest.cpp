@@ -0,0 +1,178 @@
+#include "TestCheck.h"
+#include "SpatialIndex.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <vector>
+
+using namespace GL_Engine;
+
+namespace {
+
+    struct Random {
+        uint32_t state{ 88172645u };
+        float next( float _min, float _max ){
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return _min + ( _max - _min ) * ( state / 4294967295.0f );
+        }
+        glm::vec3 vector( float _min, float _max ){
+            const float x = next( _min, _max ), y = next( _min, _max );
+            return glm::vec3( x, y, next( _min, _max ) );
+        }
+    };
+
+    std::vector< EntityId > sorted( std::vector< EntityId > _entities ){
+        std::sort( _entities.begin(), _entities.end() );
+        return _entities;
+    }
+
+    // Entities in an octree of half size 64, some outside it, of varied
+    // sizes so they are stored at different depths
+    struct Scene {
+        TransformStore transforms;
+        SpatialIndex index{ transforms, glm::vec3( 0.0f ), 64.0f, 6 };
+        std::vector< EntityId > entities;
+        Random random;
+
+        Scene(){
+            for ( int i = 0; i < 500; i++ ){
+                const EntityId entity = transforms.create();
+                transforms.setPosition( entity, random.vector( -80.0f, 80.0f ) );
+                const float size = i % 10 == 0 ? random.next( 4.0f, 20.0f ) : random.next( 0.05f, 1.0f );
+                index.insert( entity, BoundingVolume::fromBox( glm::vec3( -size ), glm::vec3( size ) ) );
+                entities.push_back( entity );
+            }
+            transforms.update();
+            index.update();
+        }
+
+        // Move some entities, some of them far enough to change cell
+        void move(){
+            for ( size_t i = 0; i < entities.size(); i += 4 ){
+                transforms.setPosition( entities[ i ], random.vector( -80.0f, 80.0f ) );
+            }
+            transforms.update();
+            index.update();
+        }
+
+        template< typename Test >
+        std::vector< EntityId > bruteForce( Test _test ) const {
+            std::vector< EntityId > hits;
+            for ( EntityId entity : entities ){
+                if ( _test( index.getSphere( entity ) ) ){
+                    hits.push_back( entity );
+                }
+            }
+            return hits;
+        }
+    };
+
+    void checkQueries( Scene & _scene ){
+        // Spheres follow their transforms
+        for ( EntityId entity : _scene.entities ){
+            const glm::vec3 centre( _scene.index.getSphere( entity ) );
+            CG_CHECK( glm::length( centre - _scene.transforms.getPosition( entity ) ) < 1e-3f );
+        }
+
+        for ( int query = 0; query < 20; query++ ){
+            const glm::vec3 centre = _scene.random.vector( -70.0f, 70.0f );
+            const float radius = _scene.random.next( 1.0f, 40.0f );
+            std::vector< EntityId > hits;
+            _scene.index.querySphere( centre, radius, hits );
+            CG_CHECK( sorted( hits ) == _scene.bruteForce( [ & ]( const glm::vec4 & _sphere ){
+                return glm::length( glm::vec3( _sphere ) - centre ) <= radius + _sphere.w;
+            } ) );
+
+            const glm::vec3 extent = _scene.random.vector( 1.0f, 40.0f );
+            hits.clear();
+            _scene.index.queryBox( centre - extent, centre + extent, hits );
+            CG_CHECK( sorted( hits ) == _scene.bruteForce( [ & ]( const glm::vec4 & _sphere ){
+                const glm::vec3 nearest = glm::clamp( glm::vec3( _sphere ), centre - extent, centre + extent );
+                return glm::length( nearest - glm::vec3( _sphere ) ) <= _sphere.w;
+            } ) );
+
+            Frustum frustum;
+            frustum.extract( glm::perspective( glm::radians( 60.0f ), 1.5f, 0.1f, 60.0f ) *
+                             glm::lookAt( centre, centre + _scene.random.vector( -1.0f, 1.0f ),
+                                          glm::vec3( 0.0f, 1.0f, 0.0f ) ) );
+            hits.clear();
+            _scene.index.queryFrustum( frustum, hits );
+            CG_CHECK( sorted( hits ) == _scene.bruteForce( [ & ]( const glm::vec4 & _sphere ){
+                return frustum.testSphere( glm::vec3( _sphere ), _sphere.w );
+            } ) );
+        }
+    }
+
+    // Entry distance of a ray into a sphere, negative for a miss
+    float rayEntry( const glm::vec3 & _origin, const glm::vec3 & _direction, const glm::vec4 & _sphere ){
+        const glm::vec3 offset = _origin - glm::vec3( _sphere );
+        const float b = glm::dot( offset, _direction );
+        const float c = glm::dot( offset, offset ) - _sphere.w * _sphere.w;
+        const float discriminant = b * b - c;
+        if ( discriminant < 0.0f || ( c > 0.0f && b > 0.0f ) ){
+            return -1.0f;
+        }
+        return std::max( 0.0f, -b - std::sqrt( discriminant ) );
+    }
+
+    void checkRaycasts( Scene & _scene ){
+        int hits = 0;
+        for ( int ray = 0; ray < 200; ray++ ){
+            const glm::vec3 origin = _scene.random.vector( -90.0f, 90.0f );
+            const glm::vec3 direction = glm::normalize( _scene.random.vector( -1.0f, 1.0f ) );
+            const float maxDistance = 150.0f;
+            float expected = maxDistance;
+            bool expectHit = false;
+            for ( EntityId entity : _scene.entities ){
+                const float entry = rayEntry( origin, direction, _scene.index.getSphere( entity ) );
+                if ( entry >= 0.0f && entry <= expected ){
+                    expected = entry;
+                    expectHit = true;
+                }
+            }
+            float distance = -1.0f;
+            const EntityId hit = _scene.index.raycast( origin, direction, maxDistance, &distance );
+            CG_CHECK( ( hit != SpatialIndex::InvalidEntity ) == expectHit );
+            if ( hit != SpatialIndex::InvalidEntity ){
+                hits++;
+                CG_CHECK( std::abs( distance - expected ) < 1e-4f );
+                CG_CHECK( std::abs( rayEntry( origin, direction, _scene.index.getSphere( hit ) ) - distance ) < 1e-4f );
+            }
+        }
+        // The scene is dense enough that most rays hit something
+        CG_CHECK( hits > 50 );
+    }
+
+    void testRemove( Scene & _scene ){
+        for ( size_t i = 0; i < _scene.entities.size(); i += 2 ){
+            _scene.index.remove( _scene.entities[ i ] );
+            CG_CHECK( !_scene.index.contains( _scene.entities[ i ] ) );
+        }
+        std::vector< EntityId > kept;
+        for ( size_t i = 1; i < _scene.entities.size(); i += 2 ){
+            kept.push_back( _scene.entities[ i ] );
+        }
+        _scene.entities = kept;
+        CG_CHECK( _scene.index.getStatistics().entities == kept.size() );
+        std::vector< EntityId > hits;
+        _scene.index.querySphere( glm::vec3( 0.0f ), 1000.0f, hits );
+        CG_CHECK( sorted( hits ) == sorted( kept ) );
+    }
+
+}
+
+int main(){
+    Scene scene;
+    CG_CHECK( scene.index.getStatistics().entities == scene.entities.size() );
+    CG_CHECK( scene.index.getStatistics().outside > 0 );
+    checkQueries( scene );
+    checkRaycasts( scene );
+    scene.move();
+    CG_CHECK( scene.index.getStatistics().relinked > 0 );
+    checkQueries( scene );
+    checkRaycasts( scene );
+    testRemove( scene );
+    checkQueries( scene );
+    return CG_TEST_RESULT();
+}
@@ -0,0 +1,53 @@
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <iostream>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// Checks for the unit tests, which report each failure on stderr and
+// keep going. A test's main returns CG_TEST_RESULT(), non-zero if any
+// check failed
+namespace GL_Engine {
+    namespace Test {
+        inline int & failures(){
+            static int count = 0;
+            return count;
+        }
+
+        inline bool near( const glm::mat4 & _a, const glm::mat4 & _b, float _tolerance ){
+            for ( int column = 0; column < 4; column++ ){
+                for ( int row = 0; row < 4; row++ ){
+                    if ( std::abs( _a[ column ][ row ] - _b[ column ][ row ] ) > _tolerance ){
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+    }
+}
+
+#define CG_CHECK( _condition ) \
+    do { \
+        if ( !( _condition ) ){ \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #_condition << std::endl; \
+            GL_Engine::Test::failures()++; \
+        } \
+    } while ( 0 )
+
+#define CG_CHECK_THROWS( _expression, _exception ) \
+    do { \
+        bool thrown = false; \
+        try { \
+            _expression; \
+        } \
+        catch ( const _exception & ){ \
+            thrown = true; \
+        } \
+        CG_CHECK( thrown && #_expression " throws " #_exception ); \
+    } while ( 0 )
+
+#define CG_TEST_RESULT() ( GL_Engine::Test::failures() == 0 ? 0 : 1 )
+
+#endif // TEST_CHECK_H
@@ -0,0 +1,122 @@
+#include "TestCheck.h"
+#include "TransformStore.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <stdexcept>
+#include <vector>
+
+using namespace GL_Engine;
+
+namespace {
+
+    constexpr float Tolerance = 1e-4f;
+
+    // T * inverse( R ) * S, the matrix the store documents
+    glm::mat4 reference( const glm::vec3 & _position, const glm::quat & _orientation,
+                         const glm::vec3 & _scale ){
+        return glm::translate( glm::mat4( 1.0f ), _position ) *
+               glm::mat4_cast( glm::conjugate( _orientation ) ) *
+               glm::scale( glm::mat4( 1.0f ), _scale );
+    }
+
+    struct Random {
+        uint32_t state{ 2463534242u };
+        float next( float _min, float _max ){
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            return _min + ( _max - _min ) * ( state / 4294967295.0f );
+        }
+        glm::vec3 vector( float _min, float _max ){
+            const float x = next( _min, _max ), y = next( _min, _max );
+            return glm::vec3( x, y, next( _min, _max ) );
+        }
+        glm::quat rotation(){
+            const float angle = next( -3.14f, 3.14f );
+            return glm::angleAxis( angle, glm::normalize( vector( -1.0f, 1.0f ) + glm::vec3( 0.0f, 0.0f, 0.01f ) ) );
+        }
+    };
+
+    // The batch kernel against glm, over more than one chunk and with
+    // SIMD groups only partly dirty
+    void testKernel(){
+        TransformStore store;
+        Random random;
+        const uint32_t count = TransformStore::ChunkSize * 2 + 13;
+        std::vector< TransformStore::Handle > handles;
+        std::vector< glm::vec3 > positions, scales;
+        std::vector< glm::quat > orientations;
+        for ( uint32_t i = 0; i < count; i++ ){
+            handles.push_back( store.create() );
+            positions.push_back( random.vector( -100.0f, 100.0f ) );
+            orientations.push_back( random.rotation() );
+            scales.push_back( random.vector( 0.1f, 3.0f ) );
+            store.setPosition( handles[ i ], positions[ i ] );
+            store.setOrientation( handles[ i ], orientations[ i ] );
+            store.setScale( handles[ i ], scales[ i ] );
+        }
+        store.update();
+        CG_CHECK( store.getStatistics().rebuilt == count );
+        for ( uint32_t i = 0; i < count; i++ ){
+            CG_CHECK( !store.isDirty( handles[ i ] ) );
+            CG_CHECK( Test::near( store.getMatrix( handles[ i ] ),
+                                  reference( positions[ i ], orientations[ i ], scales[ i ] ), Tolerance ) );
+        }
+
+        // Every third transform moves; the others must keep their matrix
+        for ( uint32_t i = 0; i < count; i += 3 ){
+            positions[ i ] = random.vector( -10.0f, 10.0f );
+            orientations[ i ] = random.rotation();
+            store.setPosition( handles[ i ], positions[ i ] );
+            store.setOrientation( handles[ i ], orientations[ i ] );
+        }
+        store.update();
+        CG_CHECK( store.getStatistics().rebuilt == ( count + 2 ) / 3 );
+        for ( uint32_t i = 0; i < count; i++ ){
+            CG_CHECK( Test::near( store.getMatrix( handles[ i ] ),
+                                  reference( positions[ i ], orientations[ i ], scales[ i ] ), Tolerance ) );
+        }
+    }
+
+    // World matrices of a hierarchy derive from the parents'
+    void testHierarchy(){
+        TransformStore store;
+        Random random;
+        const auto root = store.create();
+        const auto child = store.create();
+        const auto grandchild = store.create();
+        const glm::mat4 offset = glm::translate( glm::mat4( 1.0f ), glm::vec3( 0.0f, 2.0f, 0.0f ) );
+        store.setParent( child, root );
+        store.setParent( grandchild, child, &offset );
+        for ( auto handle : { root, child, grandchild } ){
+            store.setPosition( handle, random.vector( -5.0f, 5.0f ) );
+            store.setOrientation( handle, random.rotation() );
+            store.setScale( handle, random.vector( 0.5f, 2.0f ) );
+        }
+        store.update();
+        const glm::mat4 rootWorld = store.getLocalMatrix( root );
+        const glm::mat4 childWorld = rootWorld * store.getLocalMatrix( child );
+        const glm::mat4 grandchildWorld = childWorld * offset * store.getLocalMatrix( grandchild );
+        CG_CHECK( Test::near( store.getMatrix( root ), rootWorld, Tolerance ) );
+        CG_CHECK( Test::near( store.getMatrix( child ), childWorld, Tolerance ) );
+        CG_CHECK( Test::near( store.getMatrix( grandchild ), grandchildWorld, Tolerance ) );
+        CG_CHECK( Test::near( store.getLocalMatrix( child ),
+                              reference( store.getPosition( child ), store.getOrientation( child ),
+                                         store.getScale( child ) ), Tolerance ) );
+
+        // Moving the root moves its descendants
+        store.setPosition( root, glm::vec3( 10.0f, 0.0f, 0.0f ) );
+        store.update();
+        CG_CHECK( Test::near( store.getMatrix( grandchild ),
+                              store.getLocalMatrix( root ) * store.getLocalMatrix( child ) * offset *
+                              store.getLocalMatrix( grandchild ), Tolerance ) );
+
+        CG_CHECK_THROWS( store.setParent( root, grandchild ), std::runtime_error );
+    }
+
+}
+
+int main(){
+    testKernel();
+    testHierarchy();
+    return CG_TEST_RESULT();
+}